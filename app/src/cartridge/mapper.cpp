@@ -0,0 +1,359 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: mapper.cpp
+ * Description: This file contains the register decoding and the bank
+ *              mapping of the cartridge memory bank controllers.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "mapper.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+namespace emulator
+{
+    namespace
+    {
+        constexpr std::array<std::size_t, 6> RAM_SIZES = {0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000};
+
+        bool enablesRam(const uint8_t value) { return (value & 0x0F) == 0x0A; }
+
+        void storeLe(uint8_t* bytes, uint64_t value, const std::size_t size)
+        {
+            for (std::size_t i = 0; i < size; ++i, value >>= 8)
+                bytes[i] = value & 0xFF;
+        }
+    }
+
+    CartridgeHeader parseHeader(const Rom& rom)
+    {
+        const uint8_t type = rom.data()[CartridgeHeader::TYPE];
+        const uint8_t ramCode = rom.data()[CartridgeHeader::RAM_SIZE];
+        const std::size_t ramSize = ramCode < RAM_SIZES.size() ? RAM_SIZES[ramCode] : 0;
+        CartridgeHeader header;
+
+        header.color = rom.data()[CartridgeHeader::CGB_FLAG] & 0x80;
+        switch (type) {
+            case 0x00: break;
+            case 0x08: header.ramSize = ramSize; break;
+            case 0x09: header.ramSize = ramSize; header.battery = true; break;
+            case 0x01: header.mapper = MapperType::Mbc1; break;
+            case 0x02: header.mapper = MapperType::Mbc1; header.ramSize = ramSize; break;
+            case 0x03: header.mapper = MapperType::Mbc1; header.ramSize = ramSize; header.battery = true; break;
+            case 0x05: header.mapper = MapperType::Mbc2; header.ramSize = Mapper::MBC2_RAM_SIZE; break;
+            case 0x06: header.mapper = MapperType::Mbc2; header.ramSize = Mapper::MBC2_RAM_SIZE; header.battery = true; break;
+            case 0x0F: header.mapper = MapperType::Mbc3; header.timer = true; header.battery = true; break;
+            case 0x10: header.mapper = MapperType::Mbc3; header.ramSize = ramSize; header.timer = true; header.battery = true; break;
+            case 0x11: header.mapper = MapperType::Mbc3; break;
+            case 0x12: header.mapper = MapperType::Mbc3; header.ramSize = ramSize; break;
+            case 0x13: header.mapper = MapperType::Mbc3; header.ramSize = ramSize; header.battery = true; break;
+            case 0x19: case 0x1C: header.mapper = MapperType::Mbc5; break;
+            case 0x1A: case 0x1D: header.mapper = MapperType::Mbc5; header.ramSize = ramSize; break;
+            case 0x1B: case 0x1E: header.mapper = MapperType::Mbc5; header.ramSize = ramSize; header.battery = true; break;
+            default: header.mapper = MapperType::Unsupported; break;
+        }
+        return header;
+    }
+
+    void Mapper::load(const Rom& image)
+    {
+        rom = &image;
+        header = parseHeader(image);
+        save.close();
+        buffer.assign(header.ramSize, 0xFF);
+        ram = buffer;
+        rtc.fill(0);
+        rtcLatched.fill(0);
+        rtcCycles = 0;
+        reset();
+    }
+
+    void Mapper::unload()
+    {
+        rom = nullptr;
+        header = {};
+        save.close();
+        buffer.clear();
+        ram = {};
+        bus.unmap(0x00, 2 * ROM_PAGES);
+        bus.unmap(RAM_FIRST_PAGE, RAM_PAGES);
+    }
+
+    void Mapper::reset()
+    {
+        if (rom == nullptr)
+            return;
+        romSelect = 1;
+        ramSelect = 0;
+        mode = false;
+        rtcLatch = 0xFF;
+        ramEnabled = header.mapper == MapperType::None;  // Plain RAM carts have no enable register
+
+        romBank = 1;
+        lowBank = 0;
+        ramBank = 0;
+        bus.mapReadOnly(0x00, ROM_PAGES, rom->bank(0), this, 0);
+        bus.mapReadOnly(ROM_PAGES, ROM_PAGES, rom->bank(1), this, 1);
+        mapRam();
+        updateBanks();
+    }
+
+    bool Mapper::attachSave(const std::filesystem::path& path, const std::chrono::milliseconds interval)
+    {
+        const std::size_t rtcSize = header.timer ? RTC_SAVE_SIZE : 0;
+
+        if (rom == nullptr || !header.battery || buffer.size() + rtcSize == 0)
+            return false;
+        if (!save.open(path, buffer.size() + rtcSize, interval))
+            return false;
+
+        // A new or short file starts from the current RAM and clock
+        uint8_t* bytes = save.data();
+        const std::size_t loaded = std::min(save.loadedSize(), buffer.size());
+
+        std::memcpy(bytes + loaded, buffer.data() + loaded, buffer.size() - loaded);
+        if (loaded < buffer.size())
+            save.markDirty(loaded, buffer.size() - loaded);
+        if (rtcSize != 0 && save.loadedSize() == save.size())
+            loadRtc();
+        ram = {bytes, buffer.size()};
+        storeRtc();
+        mapRam();
+        return true;
+    }
+
+    void Mapper::clock(const uint32_t tCycles)
+    {
+        if (!header.timer || (rtc[DaysHigh] & 0x40))  // Halted
+            return;
+        rtcCycles += tCycles;
+        if (rtcCycles < RTC_CLOCK)
+            return;
+        while (rtcCycles >= RTC_CLOCK) {
+            rtcCycles -= RTC_CLOCK;
+            tickRtc();
+        }
+        storeRtc();
+    }
+
+    uint8_t Mapper::read(const uint16_t addr)
+    {
+        // Only the RAM pages are read through here, when they aren't plain memory
+        if (addr >= 0xA000 && ramEnabled && rtcSelected())
+            return rtcLatched[ramSelect - 0x08];
+        return 0xFF;
+    }
+
+    void Mapper::write(const uint16_t addr, const uint8_t value)
+    {
+        if (addr < 0x8000) {
+            writeRegister(addr, value);
+            return;
+        }
+        if (!ramEnabled)
+            return;
+        if (rtcSelected()) {
+            constexpr std::array<uint8_t, RTC_REGISTERS> MASKS = {0x3F, 0x3F, 0x1F, 0xFF, 0xC1};
+            const uint8_t index = ramSelect - 0x08;
+
+            rtc[index] = value & MASKS[index];
+            rtcLatched[index] = rtc[index];
+            if (index == Seconds)
+                rtcCycles = 0;
+            storeRtc();
+        } else if (header.mapper == MapperType::Mbc2 && !ram.empty()) {
+            const std::size_t offset = (addr - 0xA000) % MBC2_RAM_SIZE;
+
+            ram[offset] = value | 0xF0;  // 4-bit cells, the top reads as ones
+            save.markDirty(offset);
+        } else if (!ram.empty()) {
+            // Tracked RAM: the pages read from the save file, writes land here
+            const std::size_t offset = (ramBank * RAM_BANK_SIZE + (addr - 0xA000)) % ram.size();
+
+            ram[offset] = value;
+            save.markDirty(offset);
+        }
+    }
+
+    void Mapper::writeRegister(const uint16_t addr, const uint8_t value)
+    {
+        switch (header.mapper) {
+            case MapperType::Mbc1:
+                if (addr < 0x2000)
+                    ramEnabled = enablesRam(value);
+                else if (addr < 0x4000)
+                    romSelect = value & 0x1F;
+                else if (addr < 0x6000)
+                    ramSelect = value & 0x03;
+                else
+                    mode = value & 0x01;
+                break;
+            case MapperType::Mbc2:
+                // Address bit 8 tells the two registers apart
+                if (addr >= 0x4000)
+                    return;
+                if (addr & 0x0100)
+                    romSelect = value & 0x0F;
+                else
+                    ramEnabled = enablesRam(value);
+                break;
+            case MapperType::Mbc3:
+                if (addr < 0x2000) {
+                    ramEnabled = enablesRam(value);
+                } else if (addr < 0x4000) {
+                    romSelect = value & 0x7F;
+                } else if (addr < 0x6000) {
+                    ramSelect = value;
+                } else {
+                    if (rtcLatch == 0x00 && value == 0x01) {
+                        rtcLatched = rtc;
+                        storeRtc();
+                    }
+                    rtcLatch = value;
+                }
+                break;
+            case MapperType::Mbc5:
+                if (addr < 0x2000)
+                    ramEnabled = enablesRam(value);
+                else if (addr < 0x3000)
+                    romSelect = (romSelect & 0x100) | value;
+                else if (addr < 0x4000)
+                    romSelect = (romSelect & 0xFF) | ((value & 0x01) << 8);
+                else if (addr < 0x6000)
+                    ramSelect = value & 0x0F;
+                break;
+            default:
+                return;
+        }
+        updateBanks();
+    }
+
+    void Mapper::updateBanks()
+    {
+        const std::size_t banks = rom->banks();
+        std::size_t rom0 = 0;
+        std::size_t rom1 = romSelect;
+        std::size_t ram0 = 0;
+
+        switch (header.mapper) {
+            case MapperType::Mbc1:
+                rom1 = (ramSelect << 5) | (romSelect == 0 ? 1 : romSelect);
+                if (mode) {
+                    rom0 = ramSelect << 5;
+                    ram0 = ramSelect;
+                }
+                break;
+            case MapperType::Mbc2:
+            case MapperType::Mbc3:
+                rom1 = romSelect == 0 ? 1 : romSelect;
+                ram0 = header.mapper == MapperType::Mbc3 ? ramSelect & 0x07 : 0;
+                break;
+            case MapperType::Mbc5:
+                ram0 = ramSelect;
+                break;
+            default:
+                rom1 = 1;
+                break;
+        }
+
+        // Only repoint what changed: a switch to the current bank is free
+        rom0 %= banks;
+        rom1 %= banks;
+        ram0 %= std::max<std::size_t>(1, ram.size() / RAM_BANK_SIZE);
+        if (rom1 != romBank) {
+            romBank = rom1;
+            bus.remap(ROM_PAGES, ROM_PAGES, rom->bank(romBank), romBank);
+        }
+        if (rom0 != lowBank) {
+            lowBank = rom0;
+            bus.remap(0x00, ROM_PAGES, rom->bank(lowBank), lowBank);
+        }
+        if (ram0 != ramBank || (ramEnabled && !rtcSelected()) != ramMapped || rtcSelected() != rtcMapped) {
+            ramBank = ram0;
+            mapRam();
+        }
+    }
+
+    void Mapper::mapRam()
+    {
+        rtcMapped = rtcSelected();
+        ramMapped = ramEnabled && !rtcMapped;
+        if (!ramMapped || ram.empty()) {
+            bus.mapHandler(RAM_FIRST_PAGE, RAM_PAGES, this);
+            return;
+        }
+
+        // RAM smaller than the 8KB window (2KB, MBC2's 512 cells) repeats through it
+        const std::size_t base = ramBank * RAM_BANK_SIZE;
+
+        for (uint8_t page = 0; page < RAM_PAGES; ++page) {
+            uint8_t* bytes = ram.data() + (base + page * MemoryBus::PAGE_SIZE) % ram.size();
+
+            if (header.mapper == MapperType::Mbc2 || save.isOpen())
+                bus.mapReadOnly(RAM_FIRST_PAGE + page, 1, bytes, this, ramBank);
+            else
+                bus.map(RAM_FIRST_PAGE + page, 1, bytes, ramBank);
+        }
+    }
+
+    void Mapper::tickRtc()
+    {
+        // Counters set out of range count up to their bit width before wrapping
+        rtc[Seconds] = (rtc[Seconds] + 1) & 0x3F;
+        if (rtc[Seconds] != 60)
+            return;
+        rtc[Seconds] = 0;
+        rtc[Minutes] = (rtc[Minutes] + 1) & 0x3F;
+        if (rtc[Minutes] != 60)
+            return;
+        rtc[Minutes] = 0;
+        rtc[Hours] = (rtc[Hours] + 1) & 0x1F;
+        if (rtc[Hours] != 24)
+            return;
+        rtc[Hours] = 0;
+
+        const uint16_t days = ((rtc[DaysHigh] & 0x01) << 8 | rtc[DaysLow]) + 1;
+
+        rtc[DaysLow] = days & 0xFF;
+        rtc[DaysHigh] = (rtc[DaysHigh] & 0xFE) | ((days >> 8) & 0x01);
+        if (days > 0x1FF)
+            rtc[DaysHigh] |= 0x80;  // Day counter carry
+    }
+
+    void Mapper::storeRtc()
+    {
+        if (!header.timer || !save.isOpen())
+            return;
+
+        // Registers then latched registers as 32-bit values, then the time
+        // of the save as a 64-bit UNIX timestamp, all little-endian
+        uint8_t* footer = save.data() + ram.size();
+
+        for (std::size_t i = 0; i < RTC_REGISTERS; ++i) {
+            storeLe(footer + 4 * i, rtc[i], 4);
+            storeLe(footer + 4 * (RTC_REGISTERS + i), rtcLatched[i], 4);
+        }
+        storeLe(footer + 8 * RTC_REGISTERS, static_cast<uint64_t>(std::time(nullptr)), 8);
+        save.markDirty(ram.size(), RTC_SAVE_SIZE);
+    }
+
+    void Mapper::loadRtc()
+    {
+        const uint8_t* footer = save.data() + buffer.size();
+
+        for (std::size_t i = 0; i < RTC_REGISTERS; ++i) {
+            rtc[i] = footer[4 * i];
+            rtcLatched[i] = footer[4 * (RTC_REGISTERS + i)];
+        }
+    }
+}
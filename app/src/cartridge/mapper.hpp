@@ -0,0 +1,163 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: mapper.hpp
+ * Description: Cartridge memory bank controllers (MBC1, MBC2, MBC3
+ *              with its clock, MBC5). A bank switch only repoints
+ *              the memory bus pages at the selected bank, no bank
+ *              data is ever copied.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef MAPPER_HPP
+#define MAPPER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "memory_bus.hpp"
+#include "rom.hpp"
+#include "save_file.hpp"
+
+namespace emulator
+{
+    enum class MapperType : uint8_t
+    {
+        None,   // 32KB ROM, optional 8KB RAM
+        Mbc1,
+        Mbc2,
+        Mbc3,
+        Mbc5,
+        Unsupported,
+    };
+
+    // Header fields the mapper is built from
+    struct CartridgeHeader
+    {
+        static constexpr uint16_t CGB_FLAG = 0x0143;
+        static constexpr uint16_t TYPE = 0x0147;
+        static constexpr uint16_t RAM_SIZE = 0x0149;
+
+        MapperType mapper = MapperType::None;
+        std::size_t ramSize = 0;
+        bool battery = false;
+        bool timer = false;
+        bool color = false;     // Uses the CGB features (CGB flag bit 7)
+    };
+
+    [[nodiscard]] CartridgeHeader parseHeader(const Rom& rom);
+
+    // Owns the cartridge RAM and maps ROM and RAM on the bus: the ROM
+    // pages read straight from the image and send their writes (the MBC
+    // registers) here, the RAM pages are plain memory while RAM is enabled.
+    // Disabled RAM and the MBC3 clock registers are read through here.
+    // With a save file attached, the RAM lives in the file's mapping and
+    // its writes come through here too, to be marked dirty.
+    class Mapper : public MemoryHandler
+    {
+    public:
+        static constexpr std::size_t RAM_BANK_SIZE = 0x2000;
+        static constexpr std::size_t MBC2_RAM_SIZE = 512;       // 4-bit cells
+        static constexpr uint32_t RTC_CLOCK = 4194304;          // T-cycles per second at normal speed
+        static constexpr std::size_t RTC_SAVE_SIZE = 48;        // Clock footer of the .sav file, as other emulators write it
+
+        explicit Mapper(MemoryBus& bus): bus(bus) {}
+        ~Mapper() override = default;
+
+        Mapper(const Mapper&) = delete;
+        Mapper& operator=(const Mapper&) = delete;
+
+        // Builds the controller `rom`'s header asks for and maps bank 0
+        // and 1. The ROM must outlive the mapping.
+        void load(const Rom& rom);
+
+        // Puts the pages back on the bus's flat memory
+        void unload();
+
+        // Battery-backed cartridges: moves the RAM (and the MBC3 clock) into
+        // `path`, mapped, loading what the file already holds. Writes reach
+        // the disk from a background thread at most once per `interval`.
+        // Returns false, keeping the RAM in memory, without a battery or if
+        // the file can't be mapped. Loading another ROM closes it.
+        bool attachSave(const std::filesystem::path& path,
+            std::chrono::milliseconds interval = SaveFile::DEFAULT_INTERVAL);
+
+        // Writes the dirty save file bytes back now
+        void flushSave() { save.flush(); }
+
+        // Power-on state of the registers: bank 1, RAM disabled
+        void reset();
+
+        // Advances the MBC3 clock by `tCycles` of normal speed time
+        void clock(uint32_t tCycles);
+
+        uint8_t read(uint16_t addr) override;
+        void write(uint16_t addr, uint8_t value) override;
+
+        [[nodiscard]] MapperType getType() const { return header.mapper; }
+        [[nodiscard]] const CartridgeHeader& getHeader() const { return header; }
+        [[nodiscard]] std::size_t getRomBank() const { return romBank; }
+        [[nodiscard]] std::size_t getRamBank() const { return ramBank; }
+        [[nodiscard]] bool isRamEnabled() const { return ramEnabled; }
+        [[nodiscard]] std::span<uint8_t> getRam() { return ram; }
+        [[nodiscard]] std::span<const uint8_t> getRam() const { return ram; }
+        [[nodiscard]] const SaveFile& getSave() const { return save; }
+
+    private:
+        static constexpr uint8_t ROM_PAGES = Rom::BANK_SIZE / MemoryBus::PAGE_SIZE;
+        static constexpr uint8_t RAM_FIRST_PAGE = 0xA0;
+        static constexpr uint8_t RAM_PAGES = RAM_BANK_SIZE / MemoryBus::PAGE_SIZE;
+
+        // MBC3 clock registers 0x08-0x0C
+        enum Rtc : uint8_t { Seconds, Minutes, Hours, DaysLow, DaysHigh, RTC_REGISTERS };
+
+        MemoryBus& bus;
+        const Rom* rom = nullptr;
+        CartridgeHeader header;
+        std::vector<uint8_t> buffer;  // The RAM without a save file
+        SaveFile save;
+        std::span<uint8_t> ram;       // buffer, or the start of the save file
+
+        // Registers
+        uint16_t romSelect = 1;
+        uint8_t ramSelect = 0;       // MBC1 upper bits, MBC3 RAM bank or clock register, MBC5 RAM bank
+        bool mode = false;           // MBC1 banking mode
+        bool ramEnabled = false;
+
+        // What they currently map
+        std::size_t romBank = 1;     // At 0x4000-0x7FFF
+        std::size_t lowBank = 0;     // At 0x0000-0x3FFF (MBC1 mode 1)
+        std::size_t ramBank = 0;
+        bool ramMapped = false;      // RAM pages are memory, not this handler
+        bool rtcMapped = false;
+
+        std::array<uint8_t, RTC_REGISTERS> rtc{};
+        std::array<uint8_t, RTC_REGISTERS> rtcLatched{};
+        uint32_t rtcCycles = 0;      // Towards the next second
+        uint8_t rtcLatch = 0xFF;     // Last value written to 0x6000-0x7FFF
+
+        void writeRegister(uint16_t addr, uint8_t value);
+        void updateBanks();
+        void mapRam();
+        [[nodiscard]] bool rtcSelected() const { return header.timer && ramSelect >= 0x08 && ramSelect <= 0x0C; }
+        void tickRtc();
+
+        // Copy of the clock registers in the save file footer
+        void storeRtc();
+        void loadRtc();
+    };
+}
+
+#endif // MAPPER_HPP
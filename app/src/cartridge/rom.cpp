@@ -0,0 +1,213 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: rom.cpp
+ * Description: This file contains the mapped and buffered loaders
+ *              of the cartridge ROM.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "rom.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(GCOLOR_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace emulator
+{
+    namespace
+    {
+        constexpr uint8_t GZIP_MAGIC[] = {0x1F, 0x8B};
+        constexpr std::size_t CHUNK = 64 * 1024;  // Read size of the buffered loader
+
+        // Closes the descriptor on every return path
+        class File
+        {
+        public:
+            explicit File(const std::filesystem::path& path): fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)) {}
+            ~File() { if (fd >= 0) ::close(fd); }
+
+            File(const File&) = delete;
+            File& operator=(const File&) = delete;
+
+            [[nodiscard]] int get() const { return fd; }
+
+        private:
+            int fd;
+        };
+
+        bool isCompressed(const int fd)
+        {
+            uint8_t magic[sizeof(GZIP_MAGIC)] = {};
+
+            return pread(fd, magic, sizeof(magic), 0) == sizeof(magic)
+                && std::memcmp(magic, GZIP_MAGIC, sizeof(magic)) == 0;
+        }
+
+        // Appends the whole stream to `buffer`, false past MAX_SIZE
+        bool readAll(const int fd, std::vector<uint8_t>& buffer)
+        {
+            while (buffer.size() <= Rom::MAX_SIZE) {
+                const std::size_t used = buffer.size();
+
+                buffer.resize(used + CHUNK);
+                const ssize_t count = ::read(fd, buffer.data() + used, CHUNK);
+
+                if (count < 0) {
+                    buffer.clear();
+                    return false;
+                }
+                buffer.resize(used + count);
+                if (count == 0)
+                    return true;
+            }
+            return false;
+        }
+
+#if defined(GCOLOR_ZLIB)
+        bool inflateAll(const int fd, std::vector<uint8_t>& buffer)
+        {
+            gzFile file = gzdopen(dup(fd), "rb");
+
+            if (file == nullptr)
+                return false;
+            while (buffer.size() <= Rom::MAX_SIZE) {
+                const std::size_t used = buffer.size();
+
+                buffer.resize(used + CHUNK);
+                const int count = gzread(file, buffer.data() + used, CHUNK);
+
+                if (count < 0)
+                    break;
+                buffer.resize(used + count);
+                if (count == 0) {
+                    gzclose(file);
+                    return true;
+                }
+            }
+            gzclose(file);
+            return false;
+        }
+#endif
+    }
+
+    Rom::~Rom()
+    {
+        close();
+    }
+
+    Rom::Rom(Rom&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Rom& Rom::operator=(Rom&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            bytes = std::exchange(other.bytes, nullptr);
+            length = std::exchange(other.length, 0);
+            mapped = std::exchange(other.mapped, false);
+            buffer = std::move(other.buffer);
+        }
+        return *this;
+    }
+
+    bool Rom::open(const std::filesystem::path& path)
+    {
+        const File file(path);
+        struct stat info{};
+
+        close();
+        if (file.get() < 0 || fstat(file.get(), &info) != 0)
+            return false;
+
+        const auto size = static_cast<std::size_t>(info.st_size);
+
+        if (!S_ISREG(info.st_mode) || size < MIN_SIZE || size > MAX_SIZE || size % BANK_SIZE != 0
+            || isCompressed(file.get()))
+            return read(path);
+
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, file.get(), 0);
+
+        if (mapping == MAP_FAILED)
+            return read(path);
+        bytes = static_cast<const uint8_t*>(mapping);
+        length = size;
+        mapped = true;
+        return true;
+    }
+
+    bool Rom::read(const std::filesystem::path& path)
+    {
+        const File file(path);
+        struct stat info{};
+
+        close();
+        if (file.get() < 0)
+            return false;
+        if (fstat(file.get(), &info) == 0 && S_ISREG(info.st_mode))
+            buffer.reserve(std::min<std::size_t>(info.st_size, MAX_SIZE) + CHUNK);
+
+        bool loaded;
+
+        if (isCompressed(file.get())) {
+#if defined(GCOLOR_ZLIB)
+            loaded = inflateAll(file.get(), buffer);
+#else
+            loaded = false;
+#endif
+        } else {
+            loaded = readAll(file.get(), buffer);
+        }
+        if (!loaded || buffer.empty()) {
+            close();
+            return false;
+        }
+        pad();
+        return true;
+    }
+
+    void Rom::assign(const uint8_t* data, const std::size_t size)
+    {
+        close();
+        buffer.assign(data, data + std::min(size, MAX_SIZE));
+        pad();
+    }
+
+    void Rom::close()
+    {
+        if (mapped)
+            munmap(const_cast<uint8_t*>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+        mapped = false;
+        buffer.clear();
+        buffer.shrink_to_fit();
+    }
+
+    void Rom::pad()
+    {
+        const std::size_t size = std::max(MIN_SIZE, (buffer.size() + BANK_SIZE - 1) / BANK_SIZE * BANK_SIZE);
+
+        buffer.resize(size, 0xFF);
+        bytes = buffer.data();
+        length = buffer.size();
+    }
+}
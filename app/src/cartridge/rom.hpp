@@ -0,0 +1,82 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: rom.hpp
+ * Description: Cartridge ROM image. Regular files are mapped shared
+ *              and read-only, so every emulator running the same
+ *              game uses the same page cache pages and opening one
+ *              costs the same whatever its size.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef ROM_HPP
+#define ROM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace emulator
+{
+    class Rom
+    {
+    public:
+        static constexpr std::size_t BANK_SIZE = 0x4000;
+        static constexpr std::size_t MIN_SIZE = 2 * BANK_SIZE;      // What 0x0000-0x7FFF shows
+        static constexpr std::size_t MAX_SIZE = 512 * BANK_SIZE;    // 8MB, the largest MBC5 cartridge
+
+        Rom() = default;
+        ~Rom();
+
+        Rom(const Rom&) = delete;
+        Rom& operator=(const Rom&) = delete;
+        Rom(Rom&& other) noexcept;
+        Rom& operator=(Rom&& other) noexcept;
+
+        // Maps `path` when it is a regular, uncompressed file holding a
+        // whole number of banks, otherwise falls back to read(). Returns
+        // false if it can't be loaded, leaving the ROM empty.
+        bool open(const std::filesystem::path& path);
+
+        // Buffered loader: reads `path` into memory, gunzipping it if it is
+        // compressed (GCOLOR_ZLIB builds), and pads it with 0xFF to a whole
+        // number of banks. Works on pipes and devices too.
+        bool read(const std::filesystem::path& path);
+
+        // Copies an image already in memory, padded the same way
+        void assign(const uint8_t* bytes, std::size_t length);
+
+        void close();
+
+        [[nodiscard]] const uint8_t* data() const { return bytes; }
+        [[nodiscard]] std::size_t size() const { return length; }
+        [[nodiscard]] bool empty() const { return length == 0; }
+        [[nodiscard]] bool isMapped() const { return mapped; }
+
+        [[nodiscard]] std::size_t banks() const { return length / BANK_SIZE; }
+
+        // Bank `index`, wrapped around the ROM size like the cartridge does
+        [[nodiscard]] const uint8_t* bank(const std::size_t index) const
+        {
+            return bytes + (index % banks()) * BANK_SIZE;
+        }
+
+    private:
+        const uint8_t* bytes = nullptr;
+        std::size_t length = 0;
+        bool mapped = false;            // bytes is a mapping, otherwise it points into buffer
+        std::vector<uint8_t> buffer;
+
+        void pad();
+    };
+}
+
+#endif // ROM_HPP
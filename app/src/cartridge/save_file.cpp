@@ -0,0 +1,122 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: save_file.cpp
+ * Description: This file contains the mapping of the save file and
+ *              its background flusher.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "save_file.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace emulator
+{
+    SaveFile::~SaveFile()
+    {
+        close();
+    }
+
+    bool SaveFile::open(const std::filesystem::path& path, const std::size_t size,
+        const std::chrono::milliseconds interval)
+    {
+        close();
+        if (size == 0)
+            return false;
+
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat info{};
+
+        if (fd < 0)
+            return false;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)
+            || (static_cast<std::size_t>(info.st_size) < size && ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+            ::close(fd);
+            return false;
+        }
+
+        // The mapping keeps the file open
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+
+        // Chunks of whole host pages, few enough for one bit each
+        const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+        chunkShift = std::countr_zero(std::bit_ceil(std::max({page, std::size_t{1}, (size + CHUNKS - 1) / CHUNKS})));
+        bytes = static_cast<uint8_t*>(mapping);
+        length = size;
+        loaded = std::min<std::size_t>(info.st_size, size);
+        dirty.store(0, std::memory_order_relaxed);
+        stopping = false;
+        flusher = std::thread(&SaveFile::run, this, interval);
+        return true;
+    }
+
+    void SaveFile::close()
+    {
+        if (bytes == nullptr)
+            return;
+        {
+            const std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        flusher.join();
+        syncDirty();
+        munmap(bytes, length);
+        bytes = nullptr;
+        length = 0;
+        loaded = 0;
+    }
+
+    void SaveFile::flush()
+    {
+        if (bytes == nullptr)
+            return;
+
+        const std::lock_guard lock(mutex);
+
+        syncDirty();
+    }
+
+    void SaveFile::run(const std::chrono::milliseconds interval)
+    {
+        std::unique_lock lock(mutex);
+
+        while (!wake.wait_for(lock, interval, [this] { return stopping; }))
+            syncDirty();
+    }
+
+    void SaveFile::syncDirty()
+    {
+        // Writes made from here on set their bits again and are synced next time
+        uint64_t chunks = dirty.exchange(0, std::memory_order_acquire);
+
+        while (chunks != 0) {
+            const auto first = static_cast<std::size_t>(std::countr_zero(chunks));
+            const auto count = static_cast<std::size_t>(std::countr_one(chunks >> first));
+            const std::size_t offset = first << chunkShift;
+
+            msync(bytes + offset, std::min(count << chunkShift, length - offset), MS_SYNC);
+            syncs.fetch_add(1, std::memory_order_relaxed);
+            chunks = count + first >= CHUNKS ? 0 : chunks & (~uint64_t{0} << (first + count));
+        }
+    }
+}
@@ -0,0 +1,113 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: save_file.hpp
+ * Description: Battery-backed cartridge RAM kept in a .sav file
+ *              mapped into memory, written back to disk by a
+ *              background thread.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef SAVE_FILE_HPP
+#define SAVE_FILE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace emulator
+{
+    // The file is mapped shared, so its bytes are the RAM: nothing is
+    // copied on writes. markDirty() sets one bit per chunk of the file;
+    // the flusher thread msyncs the dirty chunks, merged into runs, at most
+    // once per interval. The emulation thread never waits on the disk.
+    class SaveFile
+    {
+    public:
+        static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{1000};
+
+        SaveFile() = default;
+        ~SaveFile();
+
+        SaveFile(const SaveFile&) = delete;
+        SaveFile& operator=(const SaveFile&) = delete;
+
+        // Maps `size` bytes of `path`, creating or extending the file as
+        // needed, and starts the flusher. Returns false, leaving the save
+        // closed, if the file can't be mapped.
+        bool open(const std::filesystem::path& path, std::size_t size,
+            std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+
+        // Writes back what is dirty, stops the flusher and unmaps
+        void close();
+
+        // Records a write to [offset, offset + length). Cheap enough for
+        // every cartridge RAM write: a load, and an atomic or the first
+        // time a chunk is written between two flushes.
+        void markDirty(const std::size_t offset, const std::size_t length = 1)
+        {
+            if (bytes == nullptr)
+                return;
+            const uint64_t chunks = chunkMask(offset, length);
+
+            if ((dirty.load(std::memory_order_relaxed) & chunks) != chunks)
+                dirty.fetch_or(chunks, std::memory_order_release);
+        }
+
+        // Writes back what is dirty now, on the calling thread
+        void flush();
+
+        [[nodiscard]] bool isOpen() const { return bytes != nullptr; }
+        [[nodiscard]] uint8_t* data() { return bytes; }
+        [[nodiscard]] const uint8_t* data() const { return bytes; }
+        [[nodiscard]] std::size_t size() const { return length; }
+
+        // Bytes that came from the file, the rest of the mapping is new
+        [[nodiscard]] std::size_t loadedSize() const { return loaded; }
+
+        // msync calls made so far, each covering a run of dirty chunks
+        [[nodiscard]] uint64_t getSyncCount() const { return syncs.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr std::size_t CHUNKS = 64;  // Bits of `dirty`
+
+        uint8_t* bytes = nullptr;
+        std::size_t length = 0;
+        std::size_t loaded = 0;
+        std::size_t chunkShift = 12;  // log2 of the chunk size, a multiple of the host page size
+
+        std::atomic<uint64_t> dirty{0};
+        std::atomic<uint64_t> syncs{0};
+
+        std::thread flusher;
+        std::mutex mutex;             // Guards `stopping`, serializes the flushes
+        std::condition_variable wake;
+        bool stopping = false;
+
+        [[nodiscard]] uint64_t chunkMask(const std::size_t offset, const std::size_t length) const
+        {
+            const std::size_t first = offset >> chunkShift;
+            const std::size_t last = (offset + length - 1) >> chunkShift;
+            const std::size_t count = last - first + 1;
+
+            return (count >= CHUNKS ? ~uint64_t{0} : (uint64_t{1} << count) - 1) << first;
+        }
+
+        void run(std::chrono::milliseconds interval);
+        void syncDirty();
+    };
+}
+
+#endif // SAVE_FILE_HPP
@@ -0,0 +1,120 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: block_cache.cpp
+ * Description: This file contains the implementation of the
+ *              basic block cache used by CPU::runCached.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "block_cache.hpp"
+
+#include <algorithm>
+
+namespace emulator
+{
+    BlockCache::BlockCache(): lookup(0x10000, nullptr)
+    {
+
+    }
+
+    const Block* BlockCache::findSlow(const uint16_t pc, const uint16_t bank)
+    {
+        const auto it = blocks.find(key(pc, bank));
+
+        if (it == blocks.end())
+            return nullptr;
+        lookup[pc] = it->second.get();
+        return lookup[pc];
+    }
+
+    const Block* BlockCache::insert(Block block)
+    {
+        retired.clear();
+
+        auto owned = std::make_unique<Block>(std::move(block));
+        Block* inserted = owned.get();
+        inserted->id = ++nextId;
+        const uint32_t last = inserted->start + inserted->size - 1;
+
+        for (uint32_t page = inserted->start >> 8; page <= last >> 8; ++page)
+            pageBlocks[page].push_back(inserted);
+        for (uint32_t addr = inserted->start; addr <= last; ++addr)
+            codeMap[addr >> 3] |= 1 << (addr & 7);
+
+        lookup[inserted->start] = inserted;
+        blocks[key(inserted->start, inserted->bank)] = std::move(owned);
+        return inserted;
+    }
+
+    void BlockCache::invalidate(const uint16_t addr)
+    {
+        const uint8_t page = addr >> 8;
+        std::array<Block*, 8> stale;
+        std::size_t count;
+
+        // Rarely more than one block covers a byte: a full buffer means
+        // another pass for the rest
+        do {
+            count = 0;
+            for (Block* block : pageBlocks[page]) {
+                if (addr >= block->start && addr < block->start + block->size && count < stale.size())
+                    stale[count++] = block;
+            }
+            for (std::size_t i = 0; i < count; ++i)
+                retire(stale[i]);
+        } while (count == stale.size());
+    }
+
+    void BlockCache::retire(Block* block)
+    {
+        const uint32_t last = block->start + block->size - 1;
+
+        block->valid = false;
+        for (uint32_t page = block->start >> 8; page <= last >> 8; ++page) {
+            std::erase(pageBlocks[page], block);
+            rebuildCodeMap(page);
+        }
+        if (lookup[block->start] == block)
+            lookup[block->start] = nullptr;
+
+        const auto it = blocks.find(key(block->start, block->bank));
+        retired.push_back(std::move(it->second));
+        blocks.erase(it);
+    }
+
+    void BlockCache::rebuildCodeMap(const uint8_t page)
+    {
+        const uint32_t first = page << 8;
+        const uint32_t end = first + 0x100;
+
+        std::fill_n(codeMap.begin() + (first >> 3), 0x100 / 8, 0);
+        for (const Block* block : pageBlocks[page]) {
+            const uint32_t from = std::max<uint32_t>(block->start, first);
+            const uint32_t to = std::min<uint32_t>(block->start + block->size, end);
+
+            for (uint32_t addr = from; addr < to; ++addr)
+                codeMap[addr >> 3] |= 1 << (addr & 7);
+        }
+    }
+
+    void BlockCache::clear()
+    {
+        for (auto& [key, block] : blocks) {
+            block->valid = false;
+            retired.push_back(std::move(block));
+        }
+        blocks.clear();
+        std::fill(lookup.begin(), lookup.end(), nullptr);
+        for (auto& page : pageBlocks)
+            page.clear();
+        codeMap.fill(0);
+    }
+}
@@ -0,0 +1,105 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: block_cache.hpp
+ * Description: Cache of predecoded basic blocks, keyed by bank and
+ *              start address. A block is a straight-line run of
+ *              instructions ending at the first control flow
+ *              instruction, replayed without fetching the opcodes.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef BLOCK_CACHE_HPP
+#define BLOCK_CACHE_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace emulator
+{
+    // One decoded instruction of a block, with its immediate byte or
+    // little-endian word (the CB opcode for a CB prefix), 0 without one
+    struct MicroOp
+    {
+        uint8_t opcode;
+        uint8_t length;
+        uint16_t operand;
+    };
+
+    struct Block
+    {
+        uint16_t start;   // Address of the first instruction
+        uint16_t size;    // Bytes covered, operands included
+        uint16_t bank;    // Bank mapped at `start` when the block was decoded
+        bool valid = true;
+        std::vector<MicroOp> ops;
+        uint32_t id = 0;  // Unique per insert, tells a re-decoded block from the one it replaced
+        bool liveOperands = false;  // Its one op runs into the next bank region: its operand is fetched when it runs
+    };
+
+    class BlockCache
+    {
+    public:
+        static constexpr std::size_t MAX_BLOCK_INSTRUCTIONS = 64;
+
+        BlockCache();
+        ~BlockCache() = default;
+
+        // The cache is derived state: a copy starts empty and refills on demand
+        BlockCache(const BlockCache&) : BlockCache() {}
+        BlockCache& operator=(const BlockCache&) { clear(); return *this; }
+
+        // Returns the block starting at `pc` in `bank`, or nullptr
+        [[nodiscard]] const Block* find(const uint16_t pc, const uint16_t bank)
+        {
+            const Block* block = lookup[pc];
+
+            if (block != nullptr && block->bank == bank)
+                return block;
+            return findSlow(pc, bank);
+        }
+
+        const Block* insert(Block block);
+
+        // True if `addr` belongs to at least one cached block
+        [[nodiscard]] bool isCode(const uint16_t addr) const
+        {
+            return codeMap[addr >> 3] & (1 << (addr & 7));
+        }
+
+        // Drops every block covering `addr` (self-modifying code)
+        void invalidate(uint16_t addr);
+        void clear();
+
+        [[nodiscard]] std::size_t size() const { return blocks.size(); }
+
+    private:
+        static uint32_t key(const uint16_t pc, const uint16_t bank) { return (bank << 16) | pc; }
+
+        const Block* findSlow(uint16_t pc, uint16_t bank);
+        void retire(Block* block);
+        void rebuildCodeMap(uint8_t page);
+
+        std::unordered_map<uint32_t, std::unique_ptr<Block>> blocks;
+        std::vector<const Block*> lookup; // Last block seen at each address, any bank
+        std::array<std::vector<Block*>, 256> pageBlocks; // Blocks overlapping each 256-byte page
+        std::array<uint8_t, 0x10000 / 8> codeMap{}; // One bit per address covered by a block
+        uint32_t nextId = 0;
+
+        // Invalidated blocks stay alive until the next insert, since the CPU
+        // may still be replaying one of them
+        std::vector<std::unique_ptr<Block>> retired;
+    };
+}
+
+#endif // BLOCK_CACHE_HPP
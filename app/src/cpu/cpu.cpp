@@ -15,6 +15,10 @@
 
 
 #include "cpu.hpp"
+#include "opcodes.hpp"
+
+#include <algorithm>
+#include <bit>
 
 namespace emulator
 {
@@ -26,225 +30,236 @@ namespace emulator
 
     }
 
-    std::array<void (*)(CPU*), 256> CPU::instruction_table = {
-        [](CPU *cpu) { /* Does nothing, just consumes one CPU cycle */ },  // 0x00 NOP
-        [](CPU *cpu) { cpu->ldReg16_d16(cpu->BC); },                    // 0x01 LD BC,d16
-        [](CPU *cpu) { cpu->ldMemReg16_A(cpu->BC); },                   // 0x02 LD (BC),A
-        [](CPU *cpu) { cpu->incReg16(cpu->BC); },                       // 0x03 INC BC
-        [](CPU *cpu) { cpu->incReg8(cpu->B); },                         // 0x04 INC B
-        [](CPU *cpu) { cpu->decReg8(cpu->B); },                         // 0x05 DEC B
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->D); },                       // 0x06 LD B,d8
-        [](CPU *cpu) {},                            // 0x07 RLCA
-
-#warning need to be fixed
-        [](CPU *cpu) { cpu->ldMemA16_SP(); },                             // 0x08 LD (a16),SP
-        [](CPU *cpu) { cpu->addHL_Reg16(cpu->BC); },                      // 0x09 ADD HL,BC
-        [](CPU *cpu) { cpu->ldA_MemReg16(cpu->BC); },                     // 0x0A LD A,(BC)
-        [](CPU *cpu) { cpu->decReg16(cpu->BC); },                      // 0x0B DEC BC
-        [](CPU *cpu) { cpu->incReg8(cpu->C); },                        // 0x0C INC C
-        [](CPU *cpu) { cpu->decReg8(cpu->C); },                        // 0x0D DEC C
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->C); },                      // 0x0E LD C,d8
-        [](CPU *cpu) {},                            // 0x0F RRCA
-
-        [](CPU *cpu) {},                            // 0x10 STOP 0
-        [](CPU *cpu) { cpu->ldReg16_d16(cpu->DE); },                   // 0x11 LD DE,d16
-        [](CPU *cpu) { cpu->ldMemReg16_A(cpu->DE); },                  // 0x12 LD (DE),A
-        [](CPU *cpu) { cpu->incReg16(cpu->DE); },                      // 0x13 INC DE
-        [](CPU *cpu) { cpu->incReg8(cpu->D); },                        // 0x14 INC D
-        [](CPU *cpu) { cpu->decReg8(cpu->D); },                        // 0x15 DEC D
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->D); },                      // 0x16 LD D,d8
-        [](CPU *cpu) {},                            // 0x17 RLA
-        [](CPU *cpu) {},                            // 0x18 JR r8
-        [](CPU *cpu) { cpu->addHL_Reg16(cpu->DE); },                      // 0x19 ADD HL,DE
-        [](CPU *cpu) { cpu->ldA_MemReg16(cpu->DE); },                  // 0x1A LD A,(DE)
-        [](CPU *cpu) { cpu->decReg16(cpu->DE); },                      // 0x1B DEC DE
-        [](CPU *cpu) { cpu->incReg8(cpu->E); },                        // 0x1C INC E
-        [](CPU *cpu) { cpu->decReg8(cpu->E); },                        // 0x1D DEC E
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->E); },                      // 0x1E LD E,d8
-        [](CPU *cpu) {},                            // 0x1F RRA
-
-        [](CPU *cpu) {},                            // 0x20 JR NZ,r8
-        [](CPU *cpu) { cpu->ldReg16_d16(cpu->HL); },                   // 0x21 LD HL,d16
-        [](CPU *cpu) { cpu->ldMemHLplus_A(); },                           // 0x22 LD (HL+),A
-        [](CPU *cpu) { cpu->incReg16(cpu->HL); },                      // 0x23 INC HL
-        [](CPU *cpu) { cpu->incReg8(cpu->H); },                        // 0x24 INC H
-        [](CPU *cpu) { cpu->decReg8(cpu->H); },                        // 0x25 DEC H
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->H); },                      // 0x26 LD H,d8
-        [](CPU *cpu) {  },                            // 0x27 DAA
-
-        [](CPU *cpu) {  },                            // 0x28 JR Z,r8
-        [](CPU *cpu) { cpu->addHL_HL(); },                                // 0x29 ADD HL,HL
-        [](CPU *cpu) { cpu->ldA_MemHLplus(); },                           // 0x2A LD A,(HL+)
-        [](CPU *cpu) { cpu->decReg16(cpu->HL); },                      // 0x2B DEC HL
-        [](CPU *cpu) { cpu->incReg8(cpu->L); },                        // 0x2C INC L
-        [](CPU *cpu) { cpu->decReg8(cpu->L); },                        // 0x2D DEC L
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->L); },                      // 0x2E LD L,d8
-        [](CPU *cpu) {},                            // 0x2F CPL
-
-        [](CPU *cpu) {},                            // 0x30 JR NC,r8
-        [](CPU *cpu) { cpu->ldReg16_d16(cpu->SP); },                   // 0x31 LD SP,d16
-        [](CPU *cpu) { cpu->ldMemHLminus_A(); },                          // 0x32 LD (HL-),A
-        [](CPU *cpu) { cpu->incReg16(cpu->SP); },                      // 0x33 INC SP
-        [](CPU *cpu) { cpu->incMemHL(); },                                // 0x34 INC (HL)
-        [](CPU *cpu) { cpu->decMemHL(); },                                // 0x35 DEC (HL)
-        [](CPU *cpu) { cpu->ldMemHL_d8(); },                              // 0x36 LD (HL),d8
-        [](CPU *cpu) {},                            // 0x37 SCF
-
-        [](CPU *cpu) {},                            // 0x38 JR C,r8
-        [](CPU *cpu) { cpu->addHL_Reg16(cpu->SP); },                      // 0x39 ADD HL,SP
-        [](CPU *cpu) { cpu->ldA_MemHLminus(); },                          // 0x3A LD A,(HL-)
-        [](CPU *cpu) { cpu->decReg16(cpu->SP); },                      // 0x3B DEC SP
-        [](CPU *cpu) { cpu->incReg8(cpu->A); },                        // 0x3C INC A
-        [](CPU *cpu) { cpu->decReg8(cpu->A); },                        // 0x3D DEC A
-        [](CPU *cpu) { cpu->ldReg8_d8(cpu->A); },                      // 0x3E LD A,d8
-        [](CPU *cpu) {},                            // 0x3F CCF
-#warning ld B in B look for optimisation
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->B); },  // 0x40 LD B,B
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->C); },  // 0x41 LD B,C
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->D); },  // 0x42 LD B,D
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->E); },  // 0x43 LD B,E
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->H); },  // 0x44 LD B,H
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->L); },  // 0x45 LD B,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->B); },            // 0x46 LD B,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->B, cpu->A); },  // 0x47 LD B,A
-
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->B); },  // 0x48 LD C,B
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->C); },  // 0x49 LD C,C
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->D); },  // 0x4A LD C,D
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->E); },  // 0x4B LD C,E
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->H); },  // 0x4C LD C,H
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->L); },  // 0x4D LD C,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->C); },            // 0x4E LD C,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->C, cpu->A); },  // 0x4F LD C,A
-
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->B); },  // 0x50 LD D,B
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->C); },  // 0x51 LD D,C
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->D); },  // 0x52 LD D,D
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->E); },  // 0x53 LD D,E
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->H); },  // 0x54 LD D,H
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->L); },  // 0x55 LD D,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->D); },                 // 0x56 LD D,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->D, cpu->A); },  // 0x57 LD D,A
-
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->B); },  // 0x58 LD E,B
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->C); },  // 0x59 LD E,C
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->D); },  // 0x5A LD E,D
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->E); },  // 0x5B LD E,E
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->H); },  // 0x5C LD E,H
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->L); },  // 0x5D LD E,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->E); },            // 0x5E LD E,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->E, cpu->A); },  // 0x5F LD E,A
-
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->B); },  // 0x60 LD H,B
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->C); },  // 0x61 LD H,C
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->D); },  // 0x62 LD H,D
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->E); },  // 0x63 LD H,E
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->H); },  // 0x64 LD H,H
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->L); },  // 0x65 LD H,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->H); },            // 0x66 LD H,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->H, cpu->A); },  // 0x67 LD H,A
-
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->B); },  // 0x68 LD L,B
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->C); },  // 0x69 LD L,C
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->D); },  // 0x6A LD L,D
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->E); },  // 0x6B LD L,E
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->H); },  // 0x6C LD L,H
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->L); },  // 0x6D LD L,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->L); },            // 0x6E LD L,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->L, cpu->A); },  // 0x6F LD L,A
-
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->B); },                // 0x70 LD (HL),B
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->C); },                // 0x71 LD (HL),C
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->D); },                // 0x72 LD (HL),D
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->E); },                // 0x73 LD (HL),E
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->H); },                // 0x74 LD (HL),H
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->L); },                // 0x75 LD (HL),L
-
-        [](CPU *cpu) {},                            // 0x76 HALT
-
-        [](CPU *cpu) { cpu->ldMemHL_Reg8(cpu->A); },                 // 0x77 LD (HL),A
-
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->B); },  // 0x78 LD A,B
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->C); },  // 0x79 LD A,C
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->D); },  // 0x7A LD A,D
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->E); },  // 0x7B LD A,E
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->H); },  // 0x7C LD A,H
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->L); },  // 0x7D LD A,L
-        [](CPU *cpu) { cpu->ldReg8_MemHL(cpu->A); },  // 0x7E LD A,(HL)
-        [](CPU *cpu) { cpu->ld(cpu->A, cpu->A); },  // 0x7F LD A,A
-
-        [](CPU *cpu) { cpu->add(cpu->B); },     // 0x80
-        [](CPU *cpu) { cpu->add(cpu->C); },     // 0x81
-        [](CPU *cpu) { cpu->add(cpu->D); },     // 0x82
-        [](CPU *cpu) { cpu->add(cpu->E); },     // 0x83
-        [](CPU *cpu) { cpu->add(cpu->H); },     // 0x84
-        [](CPU *cpu) { cpu->add(cpu->L); },     // 0x85
-        [](CPU *cpu) { /* uint8_t valueAtHL = readMemory(HL); add(valueAtHL); */ },     // 0x86
-        [](CPU *cpu) { cpu->add_a_a(); },       // 0x87
-
-        [](CPU *cpu) { cpu->adc(cpu->B); },     // 0x88
-        [](CPU *cpu) { cpu->adc(cpu->C); },     // 0x89
-        [](CPU *cpu) { cpu->adc(cpu->D); },     // 0x8A
-        [](CPU *cpu) { cpu->adc(cpu->E); },     // 0x8B
-        [](CPU *cpu) { cpu->adc(cpu->H); },     // 0x8C
-        [](CPU *cpu) { cpu->adc(cpu->L); },     // 0x8D
-        [](CPU *cpu) { /* uint8_t valueAtHL = readMemory(HL); adc(valueAtHL); */ },     // 0x8E
-        [](CPU *cpu) { cpu->adc_a_a(); },       // 0x8F
-
-        [](CPU *cpu) { cpu->sub(cpu->B); },     // 0x90
-        [](CPU *cpu) { cpu->sub(cpu->C); },     // 0x91
-        [](CPU *cpu) { cpu->sub(cpu->D); },     // 0x92
-        [](CPU *cpu) { cpu->sub(cpu->E); },     // 0x93
-        [](CPU *cpu) { cpu->sub(cpu->H); },     // 0x94
-        [](CPU *cpu) { cpu->sub(cpu->L); },     // 0x95
-        [](CPU *cpu) { /* uint8_t valueAtHL = readMemory(HL); adc(valueAtHL); */ },     // 0x96
-        [](CPU *cpu) { cpu->sub_a_a(); },       // 0x97
-
-        [](CPU *cpu) { cpu->sbc(cpu->B); },     // 0x98
-        [](CPU *cpu) { cpu->sbc(cpu->C); },     // 0x99
-        [](CPU *cpu) { cpu->sbc(cpu->D); },     // 0x9A
-        [](CPU *cpu) { cpu->sbc(cpu->E); },     // 0x9B
-        [](CPU *cpu) { cpu->sbc(cpu->H); },     // 0x9C
-        [](CPU *cpu) { cpu->sbc(cpu->L); },     // 0x9D
-        [](CPU *cpu) { },                       // 0x9E
-        [](CPU *cpu) { cpu->sbc_a_a(); },       // 0x9F
-
-        [](CPU *cpu) { cpu->and_op(cpu->B); },       // 0xA0
-        [](CPU *cpu) { cpu->and_op(cpu->C); },       // 0xA1
-        [](CPU *cpu) { cpu->and_op(cpu->D); },       // 0xA2
-        [](CPU *cpu) { cpu->and_op(cpu->E); },       // 0xA3
-        [](CPU *cpu) { cpu->and_op(cpu->H); },       // 0xA4
-        [](CPU *cpu) { cpu->and_op(cpu->L); },       // 0xA5
-        [](CPU *cpu) { },       // 0xA6
-        [](CPU *cpu) { cpu->and_a_a(); },            // 0xA7
-
-        [](CPU *cpu) { cpu->xor_op(cpu->B); },       // 0xA8
-        [](CPU *cpu) { cpu->xor_op(cpu->C); },       // 0xA9
-        [](CPU *cpu) { cpu->xor_op(cpu->D); },       // 0xAA
-        [](CPU *cpu) { cpu->xor_op(cpu->E); },       // 0xAB
-        [](CPU *cpu) { cpu->xor_op(cpu->H); },       // 0xAC
-        [](CPU *cpu) { cpu->xor_op(cpu->L); },       // 0xAD
-        [](CPU *cpu) {  },                           // 0xAE
-        [](CPU *cpu) { cpu->xor_a_a(); },            // 0xAF
-
-        [](CPU *cpu) { cpu->or_op(cpu->B); },        // 0xB0
-        [](CPU *cpu) { cpu->or_op(cpu->C); },        // 0xB1
-        [](CPU *cpu) { cpu->or_op(cpu->D); },        // 0xB2
-        [](CPU *cpu) { cpu->or_op(cpu->E); },        // 0xB3
-        [](CPU *cpu) { cpu->or_op(cpu->H); },        // 0xB4
-        [](CPU *cpu) { cpu->or_op(cpu->L); },        // 0xB5
-        [](CPU *cpu) {  },                           // 0xB6
-        [](CPU *cpu) { cpu->or_a_a(); },             // 0xB7
-
-        [](CPU *cpu) { cpu->cp(cpu->B); },           // 0xB8
-        [](CPU *cpu) { cpu->cp(cpu->C); },           // 0xB9
-        [](CPU *cpu) { cpu->cp(cpu->D); },           // 0xBA
-        [](CPU *cpu) { cpu->cp(cpu->E); },           // 0xBB
-        [](CPU *cpu) { cpu->cp(cpu->H); },           // 0xBC
-        [](CPU *cpu) { cpu->cp(cpu->L); },           // 0xBD
-        [](CPU *cpu) {  },                           // 0xBE
-        [](CPU *cpu) { cpu->cp_a_a(); },             // 0xBF
-    };
+    // Opcodes are decoded at compile time from their bit fields:
+    // xx yyy zzz, with p = yyy >> 1 and q = yyy & 1.
+    // r8 index: B C D E H L (HL) A, r16 index: BC DE HL SP (AF for PUSH/POP),
+    // condition index: NZ Z NC C.
+    template <uint8_t R>
+    uint8_t CPU::readReg8()
+    {
+        if constexpr (R == 6)
+            return readMemory(HL);
+        else
+            return reg8<R>();
+    }
+
+    template <uint8_t R>
+    void CPU::writeReg8(const uint8_t value)
+    {
+        if constexpr (R == 6)
+            writeMemory(HL, value);
+        else
+            reg8<R>() = value;
+    }
+
+    template <uint8_t R>
+    uint8_t& CPU::reg8()
+    {
+        static_assert(R != 6, "(HL) is not a register");
+        if constexpr (R == 0) return B;
+        else if constexpr (R == 1) return C;
+        else if constexpr (R == 2) return D;
+        else if constexpr (R == 3) return E;
+        else if constexpr (R == 4) return H;
+        else if constexpr (R == 5) return L;
+        else return A;
+    }
+
+    template <uint8_t P>
+    uint16_t& CPU::reg16()
+    {
+        if constexpr (P == 0) return BC;
+        else if constexpr (P == 1) return DE;
+        else if constexpr (P == 2) return HL;
+        else return SP;
+    }
+
+    template <uint8_t CC>
+    bool CPU::condition() const
+    {
+        if constexpr (CC == 0) return !getZeroFlag();
+        else if constexpr (CC == 1) return getZeroFlag();
+        else if constexpr (CC == 2) return !getCarryFlag();
+        else return getCarryFlag();
+    }
+
+    template <uint8_t Y>
+    void CPU::alu(const uint8_t value)
+    {
+        if constexpr (Y == 0) add(value);
+        else if constexpr (Y == 1) adc(value);
+        else if constexpr (Y == 2) sub(value);
+        else if constexpr (Y == 3) sbc(value);
+        else if constexpr (Y == 4) and_op(value);
+        else if constexpr (Y == 5) xor_op(value);
+        else if constexpr (Y == 6) or_op(value);
+        else cp(value);
+    }
+
+    template <uint8_t Opcode, bool Replay>
+    void CPU::executeOpcode(CPU* cpu)
+    {
+        constexpr uint8_t x = Opcode >> 6;
+        constexpr uint8_t y = (Opcode >> 3) & 7;
+        constexpr uint8_t z = Opcode & 7;
+        constexpr uint8_t p = y >> 1;
+        constexpr uint8_t q = y & 1;
+
+        cpu->cycles += INSTRUCTION_CYCLES[Opcode];
+        if constexpr (x == 0) {
+            if constexpr (z == 0) {
+                if constexpr (y == 0) { /* NOP */ }
+                else if constexpr (y == 1) cpu->ldMemA16_SP(cpu->nextWord<Replay>()); // LD (a16),SP
+                else if constexpr (y == 2) cpu->stop();                       // STOP 0
+                else if constexpr (y == 3) cpu->jr(true, cpu->nextByte<Replay>()); // JR r8
+                else cpu->jr(cpu->condition<y - 4>(), cpu->nextByte<Replay>()); // JR cc,r8
+            }
+            else if constexpr (z == 1) {
+                if constexpr (q == 0) cpu->ldReg16_d16(cpu->reg16<p>(), cpu->nextWord<Replay>()); // LD r16,d16
+                else cpu->addHL_Reg16(cpu->reg16<p>());                       // ADD HL,r16
+            }
+            else if constexpr (z == 2) {
+                if constexpr (q == 0) {
+                    if constexpr (p == 0) cpu->ldMemReg16_A(cpu->BC);         // LD (BC),A
+                    else if constexpr (p == 1) cpu->ldMemReg16_A(cpu->DE);    // LD (DE),A
+                    else if constexpr (p == 2) cpu->ldMemHLplus_A();          // LD (HL+),A
+                    else cpu->ldMemHLminus_A();                               // LD (HL-),A
+                } else {
+                    if constexpr (p == 0) cpu->ldA_MemReg16(cpu->BC);         // LD A,(BC)
+                    else if constexpr (p == 1) cpu->ldA_MemReg16(cpu->DE);    // LD A,(DE)
+                    else if constexpr (p == 2) cpu->ldA_MemHLplus();          // LD A,(HL+)
+                    else cpu->ldA_MemHLminus();                               // LD A,(HL-)
+                }
+            }
+            else if constexpr (z == 3) {
+                if constexpr (q == 0) cpu->incReg16(cpu->reg16<p>());         // INC r16
+                else cpu->decReg16(cpu->reg16<p>());                          // DEC r16
+            }
+            else if constexpr (z == 4) {
+                if constexpr (y == 6) cpu->incMemHL();                        // INC (HL)
+                else cpu->incReg8(cpu->reg8<y>());                            // INC r8
+            }
+            else if constexpr (z == 5) {
+                if constexpr (y == 6) cpu->decMemHL();                        // DEC (HL)
+                else cpu->decReg8(cpu->reg8<y>());                            // DEC r8
+            }
+            else if constexpr (z == 6) {
+                if constexpr (y == 6) cpu->ldMemHL_d8(cpu->nextByte<Replay>()); // LD (HL),d8
+                else cpu->ldReg8_d8(cpu->reg8<y>(), cpu->nextByte<Replay>()); // LD r8,d8
+            }
+            else {
+                if constexpr (y == 0) cpu->rlca();                            // RLCA
+                else if constexpr (y == 1) cpu->rrca();                       // RRCA
+                else if constexpr (y == 2) cpu->rla();                        // RLA
+                else if constexpr (y == 3) cpu->rra();                        // RRA
+                else if constexpr (y == 4) cpu->daa();                        // DAA
+                else if constexpr (y == 5) cpu->cpl();                        // CPL
+                else if constexpr (y == 6) cpu->scf();                        // SCF
+                else cpu->ccf();                                              // CCF
+            }
+        }
+        else if constexpr (x == 1) {
+            if constexpr (y == 6 && z == 6) cpu->halt();                      // HALT
+            else if constexpr (z == 6) cpu->ldReg8_MemHL(cpu->reg8<y>());     // LD r8,(HL)
+            else if constexpr (y == 6) cpu->ldMemHL_Reg8(cpu->reg8<z>());     // LD (HL),r8
+            else cpu->ld(cpu->reg8<y>(), cpu->reg8<z>());                     // LD r8,r8
+        }
+        else if constexpr (x == 2) {
+            cpu->alu<y>(cpu->readReg8<z>());                                  // ALU A,r8
+        }
+        else {
+            if constexpr (z == 0) {
+                if constexpr (y < 4) cpu->ret(cpu->condition<y>());           // RET cc
+                else if constexpr (y == 4) cpu->writeMemory(0xFF00 | cpu->nextByte<Replay>(), cpu->A); // LDH (a8),A
+                else if constexpr (y == 5) cpu->SP = cpu->addSP_r8(cpu->nextByte<Replay>()); // ADD SP,r8
+                else if constexpr (y == 6) cpu->A = cpu->readMemory(0xFF00 | cpu->nextByte<Replay>()); // LDH A,(a8)
+                else cpu->HL = cpu->addSP_r8(cpu->nextByte<Replay>());        // LD HL,SP+r8
+            }
+            else if constexpr (z == 1) {
+                if constexpr (q == 0) {
+                    if constexpr (p == 3) cpu->setAF(cpu->pop());             // POP AF
+                    else cpu->reg16<p>() = cpu->pop();                        // POP r16
+                }
+                else if constexpr (p == 0) cpu->ret(true);                    // RET
+                else if constexpr (p == 1) cpu->reti();                       // RETI
+                else if constexpr (p == 2) cpu->PC = cpu->HL;                 // JP HL
+                else cpu->SP = cpu->HL;                                       // LD SP,HL
+            }
+            else if constexpr (z == 2) {
+                if constexpr (y < 4) cpu->jp(cpu->condition<y>(), cpu->nextWord<Replay>()); // JP cc,a16
+                else if constexpr (y == 4) cpu->writeMemory(0xFF00 | cpu->C, cpu->A); // LD (C),A
+                else if constexpr (y == 5) cpu->writeMemory(cpu->nextWord<Replay>(), cpu->A); // LD (a16),A
+                else if constexpr (y == 6) cpu->A = cpu->readMemory(0xFF00 | cpu->C); // LD A,(C)
+                else cpu->A = cpu->readMemory(cpu->nextWord<Replay>());       // LD A,(a16)
+            }
+            else if constexpr (z == 3) {
+                if constexpr (y == 0) cpu->jp(true, cpu->nextWord<Replay>()); // JP a16
+                else if constexpr (y == 1) cb_instruction_table[cpu->nextByte<Replay>()](cpu); // CB prefix
+                else if constexpr (y == 6) cpu->ime = false;                  // DI
+                else if constexpr (y == 7) cpu->ei();                         // EI
+                else cpu->lock();                                             // Illegal
+            }
+            else if constexpr (z == 4) {
+                if constexpr (y < 4) cpu->call(cpu->condition<y>(), cpu->nextWord<Replay>()); // CALL cc,a16
+                else cpu->lock();                                             // Illegal
+            }
+            else if constexpr (z == 5) {
+                if constexpr (q == 0 && p == 3) cpu->push(cpu->getAF());      // PUSH AF
+                else if constexpr (q == 0) cpu->push(cpu->reg16<p>());        // PUSH r16
+                else if constexpr (p == 0) cpu->call(true, cpu->nextWord<Replay>()); // CALL a16
+                else cpu->lock();                                             // Illegal
+            }
+            else if constexpr (z == 6) {
+                cpu->alu<y>(cpu->nextByte<Replay>());                         // ALU A,d8
+            }
+            else {
+                cpu->rst(y * 8);                                              // RST
+            }
+        }
+    }
+
+    template <uint8_t Opcode>
+    void CPU::executeCBOpcode(CPU* cpu)
+    {
+        constexpr uint8_t x = Opcode >> 6;
+        constexpr uint8_t y = (Opcode >> 3) & 7;
+        constexpr uint8_t z = Opcode & 7;
+
+        cpu->cycles += cbInstructionCycles(Opcode);
+        if constexpr (x == 0) {
+            const uint8_t value = cpu->readReg8<z>();
+
+            if constexpr (y == 0) cpu->writeReg8<z>(cpu->rlc(value));         // RLC r8
+            else if constexpr (y == 1) cpu->writeReg8<z>(cpu->rrc(value));    // RRC r8
+            else if constexpr (y == 2) cpu->writeReg8<z>(cpu->rl(value));     // RL r8
+            else if constexpr (y == 3) cpu->writeReg8<z>(cpu->rr(value));     // RR r8
+            else if constexpr (y == 4) cpu->writeReg8<z>(cpu->sla(value));    // SLA r8
+            else if constexpr (y == 5) cpu->writeReg8<z>(cpu->sra(value));    // SRA r8
+            else if constexpr (y == 6) cpu->writeReg8<z>(cpu->swap(value));   // SWAP r8
+            else cpu->writeReg8<z>(cpu->srl(value));                          // SRL r8
+        }
+        else if constexpr (x == 1) cpu->bit(y, cpu->readReg8<z>());          // BIT y,r8
+        else if constexpr (x == 2) cpu->writeReg8<z>(cpu->readReg8<z>() & ~(1 << y)); // RES y,r8
+        else cpu->writeReg8<z>(cpu->readReg8<z>() | (1 << y));               // SET y,r8
+    }
+
+    template <bool CBPrefixed, bool Replay, std::size_t... Opcodes>
+    constexpr std::array<void (*)(CPU*), 256> CPU::makeInstructionTable(std::index_sequence<Opcodes...>)
+    {
+        if constexpr (CBPrefixed)
+            return {&executeCBOpcode<Opcodes>...};
+        else
+            return {&executeOpcode<Opcodes, Replay>...};
+    }
+
+    constexpr std::array<void (*)(CPU*), 256> CPU::instruction_table =
+        makeInstructionTable<false, false>(std::make_index_sequence<256>{});
+
+    constexpr std::array<void (*)(CPU*), 256> CPU::replay_instruction_table =
+        makeInstructionTable<false, true>(std::make_index_sequence<256>{});
+
+    constexpr std::array<void (*)(CPU*), 256> CPU::cb_instruction_table =
+        makeInstructionTable<true, false>(std::make_index_sequence<256>{});
 
     void CPU::reset() {
         AF = 0x01B0;    // A = 0x01, F = 0xB0 (initial flags for Gameboy)
@@ -256,23 +271,432 @@ namespace emulator
         SP = 0xFFFE;    // Stack pointer is initialized to 0xFFFE
 
         // Clear interrupt flags or any other control bits
+        ime = false;
+        eiCycles = UINT64_MAX;
+        idleLooping = false;
+        state = CpuState::Running;
 
         // Optionally, reset the state of internal flags in F
-        F = 0xB0;  // Assuming this is the default flag register state (e.g., zero flag set)
+        setFlags(0xB0);  // Assuming this is the default flag register state (e.g., zero flag set)
     }
 
     void CPU::executeInstruction()
     {
-        //fetch();
-        //decode();
-        //execute();
+        execute(readNextByte());
+    }
+
+    uint64_t CPU::runTable(const uint64_t count)
+    {
+        if (state != CpuState::Running)
+            return 0;
+        for (uint64_t executed = 0; executed < count; ++executed) {
+            instruction_table[readNextByte()](this);
+            if (state != CpuState::Running)
+                return executed + 1;
+        }
+        return count;
+    }
+
+    uint64_t CPU::beginSlice(const uint32_t tCycles)
+    {
+        sliceEnd = cycles + tCycles;
+        ++sliceCount;
+        idleLooping = false;
+
+        // An EI that ended the previous slice still lets one instruction
+        // run before its interrupt can be taken
+        if (ime && eiCycles == cycles)
+            sliceEnd = std::min(sliceEnd, cycles + 1);
+        return cycles;
     }
 
-    void CPU::decode()
+    uint64_t CPU::runForTable(const uint32_t tCycles)
     {
+        const uint64_t start = beginSlice(tCycles);
 
+        while (cycles < sliceEnd && state == CpuState::Running)
+            instruction_table[readNextByte()](this);
+
+        // Time keeps flowing while the CPU is halted, stopped or locked
+        skipTo(sliceEnd);
+        return cycles - start;
+    }
+
+    void CPU::writeIo(const uint16_t addr, const uint8_t value)
+    {
+        // A new IE or IF may make an interrupt pending
+        if (addr == IF_REGISTER || addr == IE_REGISTER)
+            endSliceAt(cycles);
+        if (ioHandler != nullptr)
+            ioHandler->writeIo(addr, value);
+        else
+            bus.write(addr, value);
+    }
+
+    void CPU::requestInterrupt(const Interrupt interrupt)
+    {
+        bus.write(IF_REGISTER, bus.read(IF_REGISTER) | 1 << static_cast<uint8_t>(interrupt));
+        endSliceAt(cycles);
+
+        // STOP is left by a joypad input
+        if (interrupt == Interrupt::Joypad && state == CpuState::Stopped)
+            state = CpuState::Running;
+    }
+
+    void CPU::copyMemory(const uint16_t dest, const uint16_t source, const uint16_t length)
+    {
+        bus.copy(dest, source, length);
+        for (uint16_t i = 0; i < length; ++i) {
+            const uint16_t addr = dest + i;
+
+            if (bus.isWritable(addr >> MemoryBus::PAGE_BITS) && blockCache.isCode(addr))
+                blockCache.invalidate(addr);
+        }
+    }
+
+    void CPU::skipTo(const uint64_t cycle)
+    {
+        if (state == CpuState::Running || cycle <= cycles)
+            return;
+        haltStats.skippedCycles += cycle - cycles;
+        cycles = cycle;
+    }
+
+    bool CPU::serviceInterrupts()
+    {
+        const uint8_t pending = bus.read(IE_REGISTER) & bus.read(IF_REGISTER) & 0x1F;
+
+        if (pending == 0)
+            return false;
+        if (state == CpuState::Halted)
+            state = CpuState::Running;
+        if (!ime || eiCycles == cycles)
+            return false;
+
+        const int index = std::countr_zero(pending);
+
+        ime = false;
+        idleLooping = false;
+        bus.write(IF_REGISTER, bus.read(IF_REGISTER) & ~(1 << index));
+        push(PC);
+        PC = 0x40 + index * 8;
+        cycles += 20;
+        return true;
     }
 
+    // IME is set right away, but an interrupt is only taken after the
+    // instruction following EI, so the slice ends there
+    void CPU::ei()
+    {
+        ime = true;
+        eiCycles = cycles;
+        endSliceAt(cycles + 1);
+    }
+
+    // The loop is proven idle by two arrivals at its start, one pass apart
+    // and within the same slice, with the same registers and the same bytes
+    // at the addresses it reads. No event ran in between, so memory could
+    // not change under that pass. Later arrivals only need to match the proof.
+    void CPU::skipIdleLoop(const uint16_t branch)
+    {
+        const Block* block = blockCache.find(PC, codeBank(PC));
+
+        if (block == nullptr && (block = compileBlock(PC)) == nullptr)
+            return;
+
+        IdleLoopEntry& entry = idleLoops[block->id % idleLoops.size()];
+
+        if (entry.blockId != block->id)
+            entry = {block->id, analyzeIdleLoop(*block, branch, bus)};
+        if (entry.loop.cycles == 0)
+            return;
+
+        IdleLoopProof arrival{block->id, {getAF(), BC, DE, HL, SP}, {}, {}, entry.loop.readCount, cycles, sliceCount, false};
+
+        for (uint8_t i = 0; i < arrival.reads; ++i) {
+            const LoopReadOperand& read = entry.loop.reads[i];
+            uint16_t addr = read.addr;
+
+            switch (read.mode) {
+                case LoopRead::Absolute: break;
+                case LoopRead::HighC: addr = 0xFF00 | C; break;
+                case LoopRead::BC: addr = BC; break;
+                case LoopRead::DE: addr = DE; break;
+                case LoopRead::HL: addr = HL; break;
+            }
+            if (isFreeRunning(addr))
+                return;
+            arrival.addresses[i] = addr;
+            arrival.values[i] = bus.read(addr);
+        }
+
+        IdleLoopProof& proof = idleLoopProof;
+        const bool same = proof.blockId == arrival.blockId && proof.registers == arrival.registers
+            && proof.addresses == arrival.addresses && proof.values == arrival.values;
+
+        arrival.proven = same && (proof.proven
+            || (proof.slice == sliceCount && cycles - proof.cycles == entry.loop.cycles));
+        proof = arrival;
+        if (!proof.proven || sliceEnd <= cycles)
+            return;
+
+        const uint64_t passes = (sliceEnd - cycles) / entry.loop.cycles;
+
+        cycles += passes * entry.loop.cycles;
+        proof.cycles = cycles;
+        idleLooping = true;
+        idleLoopStats.skippedCycles += passes * entry.loop.cycles;
+        ++idleLoopStats.skips;
+    }
+
+    bool CPU::isIdleLooping() const
+    {
+        if (!idleLooping)
+            return false;
+        for (uint8_t i = 0; i < idleLoopProof.reads; ++i) {
+            if (bus.read(idleLoopProof.addresses[i]) != idleLoopProof.values[i])
+                return false;
+        }
+        return true;
+    }
+
+    bool CPU::idleLoopReads(const uint16_t first, const uint16_t last) const
+    {
+        for (uint8_t i = 0; i < idleLoopProof.reads; ++i) {
+            if (idleLoopProof.addresses[i] >= first && idleLoopProof.addresses[i] <= last)
+                return true;
+        }
+        return false;
+    }
+
+    const Block* CPU::compileBlock(const uint16_t pc)
+    {
+        Block block{pc, 0, codeBank(pc), true, {}};
+        uint32_t addr = pc;
+
+        while (block.ops.size() < BlockCache::MAX_BLOCK_INSTRUCTIONS) {
+            // Decoded as executed: handler pages fetch open bus
+            const uint8_t opcode = bus.fetch(addr);
+            const uint8_t length = instructionLength(opcode);
+
+            // Blocks never wrap around the address space, and only their
+            // first instruction may run into the next bank region: it is
+            // then alone, its operands read when it runs
+            if (addr + length > 0x10000)
+                break;
+            if ((addr + length - 1) >> MemoryBus::BANK_BITS != pc >> MemoryBus::BANK_BITS) {
+                if (block.ops.empty()) {
+                    block.ops.push_back({opcode, length, 0});
+                    block.liveOperands = true;
+                    addr += length;
+                }
+                break;
+            }
+
+            const uint16_t operand = length == 3 ? bus.fetchWord(addr + 1) : length == 2 ? bus.fetch(addr + 1) : 0;
+
+            block.ops.push_back({opcode, length, operand});
+            addr += length;
+            if (endsBasicBlock(opcode))
+                break;
+        }
+        if (block.ops.empty())
+            return nullptr;
+        block.size = addr - pc;
+        return blockCache.insert(std::move(block));
+    }
+
+#if defined(__GNUC__)
+// Expands X(0x00) ... X(0xFF) in opcode order
+#define OPCODE_ROW(X, row) X(row##0) X(row##1) X(row##2) X(row##3) X(row##4) X(row##5) X(row##6) X(row##7) \
+                           X(row##8) X(row##9) X(row##A) X(row##B) X(row##C) X(row##D) X(row##E) X(row##F)
+#define ALL_OPCODES(X) OPCODE_ROW(X, 0x0) OPCODE_ROW(X, 0x1) OPCODE_ROW(X, 0x2) OPCODE_ROW(X, 0x3) \
+                       OPCODE_ROW(X, 0x4) OPCODE_ROW(X, 0x5) OPCODE_ROW(X, 0x6) OPCODE_ROW(X, 0x7) \
+                       OPCODE_ROW(X, 0x8) OPCODE_ROW(X, 0x9) OPCODE_ROW(X, 0xA) OPCODE_ROW(X, 0xB) \
+                       OPCODE_ROW(X, 0xC) OPCODE_ROW(X, 0xD) OPCODE_ROW(X, 0xE) OPCODE_ROW(X, 0xF)
+
+#define OPCODE_LABEL(op) &&op_##op,
+
+// instruction_table is constexpr, so each call below is resolved at compile
+// time and inlined into its label. Only HALT, STOP and illegal opcodes can
+// leave the running state, so only they check it.
+// Each loop defines OPCODE_TABLE: instruction_table, or
+// replay_instruction_table for the block replay, whose operands are
+// predecoded.
+// PC and the cycle counter live in the locals `pc` and `cyc` between
+// handlers: the sync around a handler folds away for everything but the
+// branches, so neither the fetch nor the budget check wait on a reload.
+// Each loop defines DISPATCH_NEXT to check its budget and pick the next
+// opcode, EXIT_SUSPENDED for when the CPU stops running, and JUMPED_BACK
+// for a jump to a lower address, which may close an idle loop.
+#define OPCODE_HANDLER(op)                                      \
+    op_##op:                                                    \
+        PC = pc;                                                \
+        cycles = cyc;                                           \
+        OPCODE_TABLE[op](this);                                 \
+        if constexpr (isLoopJump(op)) {                         \
+            if (PC < pc)                                        \
+                JUMPED_BACK(pc - 1);                            \
+        }                                                       \
+        pc = PC;                                                \
+        cyc = cycles;                                           \
+        if constexpr (suspendsExecution(op)) {                  \
+            if (state != CpuState::Running)                     \
+                EXIT_SUSPENDED();                               \
+        }                                                       \
+        DISPATCH_NEXT();
+
+    uint64_t CPU::run(const uint64_t count)
+    {
+        static void* const dispatch_table[256] = { ALL_OPCODES(OPCODE_LABEL) };
+        uint64_t remaining = count;
+        uint16_t pc = PC;
+        uint64_t cyc = cycles;
+
+        if (remaining == 0 || state != CpuState::Running)
+            return 0;
+        goto *dispatch_table[bus.fetch(pc++)];
+
+#define OPCODE_TABLE instruction_table
+#define EXIT_SUSPENDED() return count - remaining + 1
+#define JUMPED_BACK(branch) static_cast<void>(branch)
+#define DISPATCH_NEXT()                                         \
+        if (--remaining == 0)                                   \
+            return count;                                       \
+        goto *dispatch_table[bus.fetch(pc++)]
+        ALL_OPCODES(OPCODE_HANDLER)
+#undef DISPATCH_NEXT
+#undef JUMPED_BACK
+#undef EXIT_SUSPENDED
+#undef OPCODE_TABLE
+    }
+
+    uint64_t CPU::runFor(const uint32_t tCycles)
+    {
+        static void* const dispatch_table[256] = { ALL_OPCODES(OPCODE_LABEL) };
+        const uint64_t start = beginSlice(tCycles);
+        uint16_t pc = PC;
+        uint64_t cyc = cycles;
+
+        if (tCycles == 0)
+            return 0;
+        if (state != CpuState::Running)
+            goto suspended;
+        goto *dispatch_table[bus.fetch(pc++)];
+
+        // Time keeps flowing while the CPU is halted, stopped or locked
+    suspended:
+        skipTo(sliceEnd);
+        return cycles - start;
+
+        // sliceEnd is reloaded each time: a handler writing an I/O register can lower it
+#define OPCODE_TABLE instruction_table
+#define EXIT_SUSPENDED() goto suspended
+#define JUMPED_BACK(branch) skipIdleLoop(branch)
+#define DISPATCH_NEXT()                                         \
+        if (cyc >= sliceEnd)                                    \
+            return cyc - start;                                 \
+        goto *dispatch_table[bus.fetch(pc++)]
+        ALL_OPCODES(OPCODE_HANDLER)
+#undef DISPATCH_NEXT
+#undef JUMPED_BACK
+#undef EXIT_SUSPENDED
+#undef OPCODE_TABLE
+    }
+
+    uint64_t CPU::runCached(const uint64_t count)
+    {
+        static void* const dispatch_table[256] = { ALL_OPCODES(OPCODE_LABEL) };
+        uint64_t remaining = count;
+        uint16_t pc;
+        uint64_t cyc = cycles;
+        const Block* block;
+        const MicroOp* op;
+        const MicroOp* end;
+
+        if (remaining == 0 || state != CpuState::Running)
+            return 0;
+
+    next_block:
+        block = blockCache.find(PC, codeBank(PC));
+        if (block == nullptr && (block = compileBlock(PC)) == nullptr)
+            return count - remaining;
+        if (block->liveOperands) [[unlikely]] {
+            // The bank past its region may have been switched since
+            instruction_table[readNextByte()](this);
+            cyc = cycles;
+            if (state != CpuState::Running)
+                return count - remaining + 1;
+            if (--remaining == 0)
+                return count;
+            goto next_block;
+        }
+        op = block->ops.data();
+        end = op + block->ops.size();
+        pc = PC + 1;
+        operand = op->operand;
+        goto *dispatch_table[op->opcode];
+
+        // A write may have invalidated the block being replayed: its
+        // remaining ops are stale, so look the block up again from PC
+#define OPCODE_TABLE replay_instruction_table
+#define EXIT_SUSPENDED() return count - remaining + 1
+#define JUMPED_BACK(branch) static_cast<void>(branch)
+#define DISPATCH_NEXT()                                         \
+        if (--remaining == 0)                                   \
+            return count;                                       \
+        if (++op == end || !block->valid)                       \
+            goto next_block;                                    \
+        ++pc;                                                   \
+        operand = op->operand;                                  \
+        goto *dispatch_table[op->opcode]
+        ALL_OPCODES(OPCODE_HANDLER)
+#undef DISPATCH_NEXT
+#undef JUMPED_BACK
+#undef EXIT_SUSPENDED
+#undef OPCODE_TABLE
+    }
+
+#undef OPCODE_HANDLER
+#undef OPCODE_LABEL
+#undef ALL_OPCODES
+#undef OPCODE_ROW
+#else
+    uint64_t CPU::run(const uint64_t count)
+    {
+        return runTable(count);
+    }
+
+    uint64_t CPU::runFor(const uint32_t tCycles)
+    {
+        return runForTable(tCycles);
+    }
+
+    uint64_t CPU::runCached(const uint64_t count)
+    {
+        uint64_t executed = 0;
+
+        if (state != CpuState::Running)
+            return 0;
+        while (executed < count) {
+            const Block* block = blockCache.find(PC, codeBank(PC));
+
+            if (block == nullptr && (block = compileBlock(PC)) == nullptr)
+                return executed;
+            for (const MicroOp& op : block->ops) {
+                ++PC;
+                operand = op.operand;
+                (block->liveOperands ? instruction_table : replay_instruction_table)[op.opcode](this);
+                if (++executed == count || state != CpuState::Running)
+                    return executed;
+                if (!block->valid)
+                    break;
+            }
+        }
+        return count;
+    }
+#endif
+
     void CPU::incReg16(uint16_t &reg)
     {
         ++reg;
@@ -280,24 +704,17 @@ namespace emulator
 
     void CPU::incReg8(uint8_t &reg)
     {
-        uint8_t newFlags = F & CARRY_FLAG_MASK;
-
+        updateFlags(FlagOp::Inc, reg, 1, getCarryFlag());
         ++reg;
-        newFlags |= ((reg == 0x00) ? ZERO_FLAG_MASK |
-            HALF_CARRY_FLAG_MASK : (((reg & 0x0F) == 0x00) ? HALF_CARRY_FLAG_MASK : 0));
-        F = newFlags;
     }
 
 #warning just an exemple can be implemented well better
     void CPU::incMemHL()
     {
-        uint8_t value = readMemory(HL);
-        ++value;
-        writeMemory(HL, value);
+        const uint8_t value = readMemory(HL);
 
-        F = (F & CARRY_FLAG_MASK) |
-            ((value == 0) ? ZERO_FLAG_MASK : 0) |
-            (((value & 0x0F) == 0x00) ? HALF_CARRY_FLAG_MASK : 0);
+        updateFlags(FlagOp::Inc, value, 1, getCarryFlag());
+        writeMemory(HL, value + 1);
     }
 
     void CPU::decReg16(uint16_t &reg)
@@ -307,24 +724,16 @@ namespace emulator
 
     void CPU::decReg8(uint8_t &reg)
     {
-        uint8_t newFlags = CARRY_FLAG_MASK | SUBTRACT_FLAG_MASK;
-
+        updateFlags(FlagOp::Dec, reg, 1, getCarryFlag());
         --reg;
-        newFlags |= (reg == 0x00) ? ZERO_FLAG_MASK :
-            ((reg & 0x0F) == 0x0F) ? HALF_CARRY_FLAG_MASK : 0;
-        F = newFlags;
     }
 
     void CPU::decMemHL()
     {
-        uint8_t value = readMemory(HL);
-        --value;
-        writeMemory(HL, value);
+        const uint8_t value = readMemory(HL);
 
-        F = (F & CARRY_FLAG_MASK) |
-            SUBTRACT_FLAG_MASK |
-            ((value == 0) ? ZERO_FLAG_MASK : 0) |
-            (((value & 0x0F) == 0x00) ? HALF_CARRY_FLAG_MASK : 0);
+        updateFlags(FlagOp::Dec, value, 1, getCarryFlag());
+        writeMemory(HL, value - 1);
     }
 
     void CPU::ld(uint8_t& dest, const uint8_t src)
@@ -332,9 +741,9 @@ namespace emulator
         dest = src;
     }
 
-    void CPU::ldReg16_d16(uint16_t& reg)
+    void CPU::ldReg16_d16(uint16_t& reg, const uint16_t value)
     {
-        reg = readNextWord();
+        reg = value;
     }
 
     void CPU::ldMemReg16_A(uint16_t &addr)
@@ -342,14 +751,14 @@ namespace emulator
         writeMemory(addr, A);
     }
 
-    void CPU::ldReg8_d8(uint8_t &reg)
+    void CPU::ldReg8_d8(uint8_t &reg, const uint8_t value)
     {
-        reg = readNextByte();
+        reg = value;
     }
 
-    void CPU::ldMemA16_SP()
+    void CPU::ldMemA16_SP(const uint16_t addr)
     {
-
+        write16Bits(addr, SP);
     }
 
     void CPU::ldA_MemReg16(uint16_t& reg)
@@ -374,10 +783,10 @@ namespace emulator
         HL--;
     }
 
-    void CPU::ldMemHL_d8()
+    void CPU::ldMemHL_d8(const uint8_t value)
     {
 #warning maybe bad
-        writeMemory(HL, readNextByte());
+        writeMemory(HL, value);
     }
 
     void CPU::ldA_MemHLminus()
@@ -399,171 +808,348 @@ namespace emulator
     }
 
     void CPU::add(const uint8_t reg) {
-        const uint16_t result = A + reg;
-
-        //newFlags |= ((A ^ reg ^ result) & 0x10) ? HALF_CARRY_FLAG_MASK : 0;
-        uint8_t newFlags = (((A & 0xF) + (reg & 0xF)) > 0xF) ? HALF_CARRY_FLAG_MASK : 0;
-
-        A = result & 0xFF;
-
-        F = newFlags |
-            ((A == 0) ? ZERO_FLAG_MASK : 0) |
-            ((result & 0x100) ? CARRY_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Add, reg, 0);
     }
 
     void CPU::add_a_a() {
-        const uint16_t result = A + A;
-
-        uint8_t newFlags = ((A & 0xF) > 0x07) ? HALF_CARRY_FLAG_MASK : 0;
-
-        A = result & 0xFF;
-
-        F = newFlags |
-            ((A == 0) ? ZERO_FLAG_MASK : 0) |
-            ((result & 0x100) ? CARRY_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Add, A, 0);
     }
 
     void CPU::addHL_Reg16(const uint16_t reg)
     {
-        uint32_t result = HL + reg;
+        const uint32_t result = HL + reg;
 
-        uint8_t newFlags = F & ZERO_FLAG_MASK;
+        uint8_t newFlags = getZeroFlag() ? ZERO_FLAG_MASK : 0;
 
-        newFlags |= (((HL & 0x0FFF) + (reg & 0x0FFF) >  0x7FF) ? HALF_CARRY_FLAG_MASK : 0) |
+        newFlags |= (((HL & 0x0FFF) + (reg & 0x0FFF) > 0x0FFF) ? HALF_CARRY_FLAG_MASK : 0) |
             ((result > 0xFFFF) ? CARRY_FLAG_MASK : 0);
 
         HL = result & 0xFFFF;
 
-        F = newFlags;
+        setFlags(newFlags);
     }
 
     void CPU::addHL_HL()
     {
-        const uint16_t result = HL + HL;
-
-        uint8_t newFlags = F & ZERO_FLAG_MASK;
-
-        newFlags |= (((HL & 0x0FFF) > 0x07FF) ? HALF_CARRY_FLAG_MASK : 0) |
-            ((result > 0xFFFF) ? CARRY_FLAG_MASK : 0);
-
-        HL = result & 0xFFFF;
+        addHL_Reg16(HL);
+    }
 
-        F = newFlags;
+    uint16_t CPU::addSP_r8(const uint8_t offset)
+    {
+        // Flags come from the unsigned low byte addition
+        setFlags((((SP & 0x0F) + (offset & 0x0F)) > 0x0F ? HALF_CARRY_FLAG_MASK : 0) |
+            (((SP & 0xFF) + offset) > 0xFF ? CARRY_FLAG_MASK : 0));
+        return SP + static_cast<int8_t>(offset);
     }
 
     void CPU::adc(const uint8_t reg) {
-        const uint8_t carry = getCarryFlag();
-        const uint16_t result = A + reg + carry;
-
-        uint8_t newFlags = (((A & 0xF) + (reg & 0xF) + carry) > 0xF) ? HALF_CARRY_FLAG_MASK : 0;
-
-        A = result & 0xFF;
-
-        F = newFlags |
-            ((A == 0) ? ZERO_FLAG_MASK : 0) |
-            ((result & 0x100) ? CARRY_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Add, reg, getCarryFlag());
     }
 
     void CPU::adc_a_a() {
-        const uint8_t carry = getCarryFlag();
-        const uint16_t result = A + A + carry;
-
-        uint8_t newFlags = (((2 * (A & 0xF)) + carry) > 0xF) ? HALF_CARRY_FLAG_MASK : 0;
-
-        A = result & 0xFF;
-
-        F = newFlags |
-            ((A == 0) ? ZERO_FLAG_MASK : 0) |
-            ((result & 0x100) ? CARRY_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Add, A, getCarryFlag());
     }
 
     void CPU::sub(const uint8_t reg) {
-        const uint16_t result = A - reg;
-        uint8_t newFlags = SUBTRACT_FLAG_MASK |
-            (((A & 0xF) < (reg & 0xF)) ? HALF_CARRY_FLAG_MASK : 0) |
-            ((A < reg) ? CARRY_FLAG_MASK : 0);
-
-        A = result & 0xFF;
-
-        F = newFlags |
-            ((A == 0) ? ZERO_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Sub, reg, 0);
     }
 
     void CPU::sub_a_a() {
         A = 0;
-        F = SUBTRACT_FLAG_MASK | ZERO_FLAG_MASK;
+        setFlags(SUBTRACT_FLAG_MASK | ZERO_FLAG_MASK);
     }
 
     void CPU::sbc(const uint8_t reg) {
-        const uint8_t carry = getCarryFlag();
-        const uint16_t result = A - reg - carry;
-
-        uint8_t newFlags = SUBTRACT_FLAG_MASK |
-            (((A & 0xF) < ((reg & 0xF) + carry)) ? HALF_CARRY_FLAG_MASK : 0) |
-            ((A < (reg + carry)) ? CARRY_FLAG_MASK : 0);
-
-        A = result & 0xFF;
-
-        F = newFlags | ((A == 0) ? ZERO_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Sub, reg, getCarryFlag());
     }
 
     void CPU::sbc_a_a() {
-        const uint8_t carry = getCarryFlag();
-
-        A = carry ? 0xFF : 0x00;
-
-        F = SUBTRACT_FLAG_MASK |
-            (carry ? CARRY_FLAG_MASK : 0) |
-            ((A == 0) ? ZERO_FLAG_MASK : 0);
+        A = arithmetic(FlagOp::Sub, A, getCarryFlag());
     }
 
     void CPU::and_op(const uint8_t reg)
     {
         A &= reg;
 
-        F = HALF_CARRY_FLAG_MASK |
-            ((A == 0) ? ZERO_FLAG_MASK : 0);
+        setFlags(HALF_CARRY_FLAG_MASK |
+            ((A == 0) ? ZERO_FLAG_MASK : 0));
     }
 
     void CPU::and_a_a()
     {
-        F = HALF_CARRY_FLAG_MASK | ((A == 0) ? ZERO_FLAG_MASK : 0);
+        setFlags(HALF_CARRY_FLAG_MASK | ((A == 0) ? ZERO_FLAG_MASK : 0));
     }
 
     void CPU::xor_op(const uint8_t reg)
     {
         A ^= reg;
-        F = ((A == 0) ? ZERO_FLAG_MASK : 0);
+        setFlags((A == 0) ? ZERO_FLAG_MASK : 0);
     }
 
     void CPU::xor_a_a()
     {
         A = 0;
-        F = ZERO_FLAG_MASK;
+        setFlags(ZERO_FLAG_MASK);
     }
 
     void CPU::or_op(const uint8_t reg)
     {
         A |= reg;
-        F = ((A == 0) ? ZERO_FLAG_MASK : 0);
+        setFlags((A == 0) ? ZERO_FLAG_MASK : 0);
     }
 
     void CPU::or_a_a()
     {
-        F = ((A == 0) ? ZERO_FLAG_MASK : 0);
+        setFlags((A == 0) ? ZERO_FLAG_MASK : 0);
     }
 
     void CPU::cp(const uint8_t reg)
     {
         // Implicit comparison of A with reg, without modifying A
-        F = SUBTRACT_FLAG_MASK |
-            (((A & 0xF) < (reg & 0xF)) ? HALF_CARRY_FLAG_MASK : 0) |
-            ((A < reg) ? CARRY_FLAG_MASK : 0) |
-            ((A == reg) ? ZERO_FLAG_MASK : 0);
+        arithmetic(FlagOp::Sub, reg, 0);
     }
 
     void CPU::cp_a_a()
     {
-        F = SUBTRACT_FLAG_MASK | ZERO_FLAG_MASK;
+        setFlags(SUBTRACT_FLAG_MASK | ZERO_FLAG_MASK);
+    }
+
+    uint8_t CPU::rlc(const uint8_t value)
+    {
+        const uint8_t result = (value << 1) | (value >> 7);
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x80) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    uint8_t CPU::rrc(const uint8_t value)
+    {
+        const uint8_t result = (value >> 1) | (value << 7);
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x01) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    uint8_t CPU::rl(const uint8_t value)
+    {
+        const uint8_t result = (value << 1) | getCarryFlag();
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x80) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    uint8_t CPU::rr(const uint8_t value)
+    {
+        const uint8_t result = (value >> 1) | (getCarryFlag() << 7);
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x01) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    uint8_t CPU::sla(const uint8_t value)
+    {
+        const uint8_t result = value << 1;
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x80) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    uint8_t CPU::sra(const uint8_t value)
+    {
+        const uint8_t result = (value >> 1) | (value & 0x80);
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x01) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    uint8_t CPU::swap(const uint8_t value)
+    {
+        const uint8_t result = (value << 4) | (value >> 4);
+
+        setFlags((result == 0) ? ZERO_FLAG_MASK : 0);
+        return result;
+    }
+
+    uint8_t CPU::srl(const uint8_t value)
+    {
+        const uint8_t result = value >> 1;
+
+        setFlags(((result == 0) ? ZERO_FLAG_MASK : 0) | ((value & 0x01) ? CARRY_FLAG_MASK : 0));
+        return result;
+    }
+
+    void CPU::bit(const uint8_t index, const uint8_t value)
+    {
+        setFlags((getCarryFlag() ? CARRY_FLAG_MASK : 0) |
+            HALF_CARRY_FLAG_MASK |
+            ((value & (1 << index)) ? 0 : ZERO_FLAG_MASK));
+    }
+
+    // The accumulator rotates always clear Z, unlike their CB counterparts
+    void CPU::rlca()
+    {
+        A = rlc(A);
+        setFlags(getFlags() & CARRY_FLAG_MASK);
+    }
+
+    void CPU::rrca()
+    {
+        A = rrc(A);
+        setFlags(getFlags() & CARRY_FLAG_MASK);
+    }
+
+    void CPU::rla()
+    {
+        A = rl(A);
+        setFlags(getFlags() & CARRY_FLAG_MASK);
+    }
+
+    void CPU::rra()
+    {
+        A = rr(A);
+        setFlags(getFlags() & CARRY_FLAG_MASK);
+    }
+
+    void CPU::daa()
+    {
+        const uint8_t flags = getFlags();
+        uint8_t newFlags = flags & (SUBTRACT_FLAG_MASK | CARRY_FLAG_MASK);
+
+        if (flags & SUBTRACT_FLAG_MASK) {
+            if (flags & CARRY_FLAG_MASK)
+                A -= 0x60;
+            if (flags & HALF_CARRY_FLAG_MASK)
+                A -= 0x06;
+        } else {
+            if ((flags & CARRY_FLAG_MASK) || A > 0x99) {
+                A += 0x60;
+                newFlags |= CARRY_FLAG_MASK;
+            }
+            if ((flags & HALF_CARRY_FLAG_MASK) || (A & 0x0F) > 0x09)
+                A += 0x06;
+        }
+        setFlags(newFlags | ((A == 0) ? ZERO_FLAG_MASK : 0));
+    }
+
+    void CPU::cpl()
+    {
+        A = ~A;
+        setFlags(getFlags() | SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK);
+    }
+
+    void CPU::scf()
+    {
+        setFlags((getZeroFlag() ? ZERO_FLAG_MASK : 0) | CARRY_FLAG_MASK);
+    }
+
+    void CPU::ccf()
+    {
+        const uint8_t flags = getFlags();
+
+        setFlags((flags & ZERO_FLAG_MASK) | ((flags & CARRY_FLAG_MASK) ^ CARRY_FLAG_MASK));
+    }
+
+    void CPU::jr(const bool condition, const uint8_t offset)
+    {
+        if (condition) {
+            PC += static_cast<int8_t>(offset);
+            cycles += 4;
+        }
+    }
+
+    void CPU::jp(const bool condition, const uint16_t addr)
+    {
+        if (condition) {
+            PC = addr;
+            cycles += 4;
+        }
+    }
+
+    void CPU::call(const bool condition, const uint16_t addr)
+    {
+        if (condition) {
+            push(PC);
+            PC = addr;
+            cycles += 12;
+        }
+    }
+
+    void CPU::ret(const bool condition)
+    {
+        if (condition) {
+            PC = pop();
+            cycles += 12;
+        }
+    }
+
+    void CPU::reti()
+    {
+        PC = pop();
+        ime = true;
+    }
+
+    void CPU::rst(const uint16_t vector)
+    {
+        push(PC);
+        PC = vector;
+    }
+
+    void CPU::push(const uint16_t value)
+    {
+        SP -= 2;
+        write16Bits(SP, value);
+    }
+
+    uint16_t CPU::pop()
+    {
+        const uint16_t value = read16Bits(SP);
+
+        SP += 2;
+        return value;
+    }
+
+    void CPU::halt()
+    {
+        if ((bus.read(IE_REGISTER) & bus.read(IF_REGISTER) & 0x1F) == 0) {
+            state = CpuState::Halted;
+            ++haltStats.halts;
+            return;
+        }
+
+        // With an interrupt already pending HALT does not halt. If IME is
+        // set it is serviced next, and right after EI it returns to the HALT.
+        if (ime) {
+            if (eiCycles + INSTRUCTION_CYCLES[0x76] == cycles)
+                --PC;
+            endSliceAt(cycles);
+            return;
+        }
+
+        // HALT bug: PC is not incremented past the next opcode, whose byte
+        // is then read again as the first operand or the next opcode
+        ++haltStats.haltBugs;
+        if (bus.read(PC) == 0x76) {
+            state = CpuState::Locked;  // HALT would run again forever
+            return;
+        }
+        instruction_table[bus.read(PC)](this);
+    }
+
+    void CPU::stop()
+    {
+        readNextByte();  // STOP is followed by a padding byte
+        state = CpuState::Stopped;
+
+        // An armed speed switch (KEY1 bit 0) happens right now: the slice
+        // ends here instead of running the clock on to its end
+        if (getIoRegister(KEY1_REGISTER) & 0x01)
+            endSliceAt(cycles);
+    }
+
+    // Illegal opcodes hang the SM83: PC stays on the opcode
+    void CPU::lock()
+    {
+        --PC;
+        state = CpuState::Locked;
     }
 }
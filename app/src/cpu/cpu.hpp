@@ -22,15 +22,68 @@
 
 #include <cstdint>
 #include <iostream>
+#include <algorithm>
 #include <array>
+#include <utility>
 
-constexpr uint8_t ZERO_FLAG_MASK = 0x80;  // Bit 7
-constexpr uint8_t SUBTRACT_FLAG_MASK = 0x40;  // Bit 6
-constexpr uint8_t HALF_CARRY_FLAG_MASK = 0x20;  // Bit 5
-constexpr uint8_t CARRY_FLAG_MASK = 0x10;  // Bit 4
+#include "block_cache.hpp"
+#include "idle_loop.hpp"
+#include "flags.hpp"
+#include "memory_bus.hpp"
 
 namespace emulator
 {
+    namespace jit
+    {
+        class Recompiler;
+    }
+
+    // Interrupt sources, in priority order: bit n of IE/IF, vector 0x40 + 8n
+    enum class Interrupt : uint8_t
+    {
+        VBlank,
+        LcdStat,
+        Timer,
+        Serial,
+        Joypad,
+    };
+
+    // Receives the CPU accesses to the I/O registers (0xFF00-0xFF7F) and
+    // IE, HRAM excepted. This is how the peripherals see software reading
+    // and reprogramming them. The registers are stored in the memory bus:
+    // writeIo() stores the value, readIo() may compute it.
+    class IoHandler
+    {
+    public:
+        virtual ~IoHandler() = default;
+        virtual uint8_t readIo(uint16_t addr) = 0;
+        virtual void writeIo(uint16_t addr, uint8_t value) = 0;
+    };
+
+    enum class CpuState : uint8_t
+    {
+        Running,
+        Halted,   // HALT, until an interrupt is pending
+        Stopped,  // STOP, until a joypad input
+        Locked,   // Illegal opcode, only a reset recovers
+    };
+
+    // What HALT and STOP saved: cycles the clock jumped over instead of
+    // dispatching, accumulated since the CPU was created
+    struct HaltStats
+    {
+        uint64_t skippedCycles = 0;
+        uint64_t halts = 0;
+        uint64_t haltBugs = 0;
+    };
+
+    // What the idle loop detector saved, accumulated since the CPU was created
+    struct IdleLoopStats
+    {
+        uint64_t skippedCycles = 0;
+        uint64_t skips = 0;
+    };
+
     class CPU
     {
     public:
@@ -45,6 +98,84 @@ namespace emulator
             instruction_table[opcode](this);
         }; // Execute the decoded instruction
 
+        // Main interpreter loop: fetches and executes up to `count` instructions.
+        // Uses threaded dispatch (computed goto) when the compiler supports it,
+        // so every handler is inlined and jumps straight to the next one.
+        // Returns the number of instructions executed, which is lower than
+        // `count` only if HALT, STOP or an illegal opcode left the running state.
+        uint64_t run(uint64_t count);
+
+        // Portable fallback of run(), dispatching through instruction_table
+        uint64_t runTable(uint64_t count);
+
+        // Same contract as run(), but replays predecoded basic blocks from the
+        // block cache, immediates included, instead of fetching every opcode
+        // and operand. Not faster than run() on the benchmarks: the threaded
+        // loop's fetch is already one page table load.
+        uint64_t runCached(uint64_t count);
+
+        // Batch entry point: runs instructions until at least `tCycles`
+        // T-cycles have elapsed and returns the cycles actually consumed,
+        // which can overshoot by the last instruction. A CPU that is not
+        // running (HALT, STOP, locked) consumes the whole budget.
+        // The slice ends sooner when endSliceAt() asks for it, which EI,
+        // IE/IF writes and requestInterrupt() do so interrupts are not
+        // held back until the budget runs out, and STOP with a speed
+        // switch armed in KEY1 so it happens at the STOP.
+        uint64_t runFor(uint32_t tCycles);
+
+        // Portable fallback of runFor(), dispatching through instruction_table
+        uint64_t runForTable(uint32_t tCycles);
+
+        // Makes the running runFor() return once `cycle` is reached, so a
+        // peripheral reprogrammed by the CPU can bring its next event forward
+        void endSliceAt(const uint64_t cycle) { sliceEnd = std::min(sliceEnd, cycle); }
+
+        // Raises `interrupt` in IF. The running slice ends so it can be serviced.
+        void requestInterrupt(Interrupt interrupt);
+
+        // Dispatches the highest priority interrupt both enabled in IE and
+        // requested in IF, when IME is set and no EI is still delaying it.
+        // Any such interrupt wakes a halted CPU, even with IME clear.
+        // Returns true if an interrupt was dispatched.
+        bool serviceInterrupts();
+
+        // Moves the clock of a CPU that is not running straight to `cycle`.
+        // A halted CPU only wakes on an interrupt, and interrupts only come
+        // from scheduled events, so nothing can happen in between.
+        void skipTo(uint64_t cycle);
+
+        // Holds the CPU off the bus for `count` cycles (CGB DMA): its clock
+        // moves on, nothing runs. Only between runFor() calls.
+        void stall(const uint32_t count) { cycles += count; }
+
+        // Takes a stopped CPU out of STOP without a joypad input, as the
+        // end of a CGB speed switch does
+        void resume() { if (state == CpuState::Stopped) state = CpuState::Running; }
+
+        [[nodiscard]] const HaltStats& getHaltStats() const { return haltStats; }
+        [[nodiscard]] const IdleLoopStats& getIdleLoopStats() const { return idleLoopStats; }
+
+        // True if the last runFor() slice ended spinning in a loop proven
+        // idle, and the memory it reads still holds the values it spins on.
+        // Only a change of that memory or an interrupt can end it.
+        [[nodiscard]] bool isIdleLooping() const;
+
+        // True if that loop reads an address in [first, last]
+        [[nodiscard]] bool idleLoopReads(uint16_t first, uint16_t last) const;
+
+        void setIoHandler(IoHandler* handler) { ioHandler = handler; }
+
+        // Sets an I/O register from the hardware side, without notifying the I/O handler
+        void setIoRegister(const uint16_t addr, const uint8_t value) { bus.write(addr, value); }
+
+        // DMA from the hardware side, see MemoryBus::copy(). Drops the
+        // cached code it overwrites.
+        void copyMemory(uint16_t dest, uint16_t source, uint16_t length);
+
+        // Stored value of an I/O register, without going through the I/O handler
+        [[nodiscard]] uint8_t getIoRegister(const uint16_t addr) const { return bus.read(addr); }
+
         // Method to reset the CPU (initial state)
         void reset();
 
@@ -57,15 +188,15 @@ namespace emulator
         void decMemHL();
 
         void ld(uint8_t&, uint8_t);
-        void ldReg16_d16(uint16_t&);
+        void ldReg16_d16(uint16_t&, uint16_t);
         void ldMemReg16_A(uint16_t&);
-        void ldReg8_d8(uint8_t&);
-        void ldMemA16_SP();
+        void ldReg8_d8(uint8_t&, uint8_t);
+        void ldMemA16_SP(uint16_t);
         void ldA_MemReg16(uint16_t&);
         void ldMemHLplus_A();
         void ldA_MemHLplus();
         void ldMemHLminus_A();
-        void ldMemHL_d8();
+        void ldMemHL_d8(uint8_t);
         void ldA_MemHLminus();
         void ldReg8_MemHL(uint8_t&);
         void ldMemHL_Reg8(uint8_t);
@@ -98,11 +229,41 @@ namespace emulator
         void cp(uint8_t);
         void cp_a_a();
 
-
-        void ADD_A_n() { /* uint8_t immediateValue = fetchNextByte(); add(immediateValue); */ }
-        void ADC_A_n() { /* uint8_t immediateValue = fetchNextByte(); adc(immediateValue); */ }
-        void SUB_A_n() { /* uint8_t immediateValue = fetchNextByte(); adc(immediateValue); */ }
-        void SBC_A_n() { /* uint8_t immediateValue = fetchNextByte(); adc(immediateValue); */ }
+        uint16_t addSP_r8(uint8_t);
+
+        // Rotates and shifts (CB prefix): return the result and set the flags
+        uint8_t rlc(uint8_t);
+        uint8_t rrc(uint8_t);
+        uint8_t rl(uint8_t);
+        uint8_t rr(uint8_t);
+        uint8_t sla(uint8_t);
+        uint8_t sra(uint8_t);
+        uint8_t swap(uint8_t);
+        uint8_t srl(uint8_t);
+        void bit(uint8_t, uint8_t);
+
+        void rlca();
+        void rrca();
+        void rla();
+        void rra();
+        void daa();
+        void cpl();
+        void scf();
+        void ccf();
+
+        // The immediate is fetched whether or not the branch is taken
+        void jr(bool, uint8_t);
+        void jp(bool, uint16_t);
+        void call(bool, uint16_t);
+        void ret(bool);
+        void reti();
+        void rst(uint16_t);
+        void push(uint16_t);
+        uint16_t pop();
+
+        void halt();
+        void stop();
+        void lock();
 
         [[nodiscard]] uint8_t getA() const { return A; }
         void setA(const uint8_t value) { A = value; }
@@ -110,25 +271,150 @@ namespace emulator
         [[nodiscard]] uint8_t getB() const { return B; }
         void setB(const uint8_t value) { B = value; }
 
-        [[nodiscard]] bool getZeroFlag() const { return F & ZERO_FLAG_MASK; }
-        [[nodiscard]] bool getSubtractFlag() const { return F & SUBTRACT_FLAG_MASK; }
-        [[nodiscard]] bool getHalfCarryFlag() const { return F & HALF_CARRY_FLAG_MASK; }
-        [[nodiscard]] bool getCarryFlag() const { return F & CARRY_FLAG_MASK; }
+        [[nodiscard]] uint8_t getC() const { return C; }
+        void setC(const uint8_t value) { C = value; }
+
+        [[nodiscard]] uint8_t getD() const { return D; }
+        void setD(const uint8_t value) { D = value; }
+
+        [[nodiscard]] uint8_t getE() const { return E; }
+        void setE(const uint8_t value) { E = value; }
+
+        [[nodiscard]] uint8_t getH() const { return H; }
+        void setH(const uint8_t value) { H = value; }
 
+        [[nodiscard]] uint8_t getL() const { return L; }
+        void setL(const uint8_t value) { L = value; }
+
+        [[nodiscard]] uint16_t getAF() const { return (A << 8) | getFlags(); }
+        void setAF(const uint16_t value) { A = value >> 8; setFlags(value & 0xF0); }  // Low nibble of F is always 0
+
+        [[nodiscard]] uint16_t getBC() const { return BC; }
+        void setBC(const uint16_t value) { BC = value; }
+
+        [[nodiscard]] uint16_t getDE() const { return DE; }
+        void setDE(const uint16_t value) { DE = value; }
+
+        [[nodiscard]] uint16_t getHL() const { return HL; }
+        void setHL(const uint16_t value) { HL = value; }
+
+        [[nodiscard]] uint16_t getSP() const { return SP; }
+        void setSP(const uint16_t value) { SP = value; }
+
+        [[nodiscard]] uint16_t getPC() const { return PC; }
+        void setPC(const uint16_t value) { PC = value; }
+
+        [[nodiscard]] uint64_t getCycles() const { return cycles; }
+
+        [[nodiscard]] bool getIME() const { return ime; }
+        [[nodiscard]] CpuState getState() const { return state; }
+
+        // Memory map the CPU accesses go through. Page 0xFF must stay mapped
+        // read-write, the I/O registers and IE are kept there: on the bus's
+        // flat memory for a CPU on its own, in its block for a GameBoy.
+        [[nodiscard]] MemoryBus& getMemoryBus() { return bus; }
+        [[nodiscard]] const MemoryBus& getMemoryBus() const { return bus; }
+
+        // Drops every decoded block, once the pages holding code were remapped
+        void flushBlocks() { blockCache.clear(); }
+
+        [[nodiscard]] uint8_t readMemory(const uint16_t addr) const
+        {
+            if (addr >= IO_REGISTERS && isIoRegister(addr) && ioHandler != nullptr) [[unlikely]]
+                return ioHandler->readIo(addr);
+            return bus.read(addr);
+        }
+
+        void writeMemory(const uint16_t addr, const uint8_t val)
+        {
+            if (addr >= IO_REGISTERS && isIoRegister(addr)) [[unlikely]] {
+                writeIo(addr, val);
+                return;
+            }
+            bus.write(addr, val);
+            // Writes to ROM reach the mapper, they never change code
+            if (bus.isWritable(addr >> MemoryBus::PAGE_BITS) && blockCache.isCode(addr))
+                blockCache.invalidate(addr);
+        }
+
+        static constexpr uint16_t IO_REGISTERS = 0xFF00;
+        static constexpr uint16_t IF_REGISTER = 0xFF0F;
+        static constexpr uint16_t KEY1_REGISTER = 0xFF4D;
+        static constexpr uint16_t HIGH_RAM = 0xFF80;
+        static constexpr uint16_t IE_REGISTER = 0xFFFF;
+
+        // For an address from 0xFF00 up: true outside HRAM
+        static constexpr bool isIoRegister(const uint16_t addr) { return addr < HIGH_RAM || addr == IE_REGISTER; }
+
+        [[nodiscard]] bool getSubtractFlag() const { return getFlags() & SUBTRACT_FLAG_MASK; }
+        [[nodiscard]] bool getHalfCarryFlag() const { return getFlags() & HALF_CARRY_FLAG_MASK; }
+
+#if defined(GCOLOR_LAZY_FLAGS)
+        // F is only valid without a pending operation, otherwise its flags
+        // are computed from the recorded operands on read
+        [[nodiscard]] uint8_t getFlags() const
+        {
+            return flagOp == FlagOp::None ? F : aluFlags(flagOp, flagLhs, flagRhs, flagCarry);
+        }
+        void setFlags(const uint8_t value) { F = value; flagOp = FlagOp::None; }
+
+        // Z and C are read alone by the conditional instructions and by
+        // INC/DEC, which keep the carry: only that flag is computed, and
+        // the operation stays pending
+        [[nodiscard]] bool getZeroFlag() const
+        {
+            return flagOp == FlagOp::None ? (F & ZERO_FLAG_MASK) : computeZero(flagOp, flagLhs, flagRhs, flagCarry);
+        }
+        [[nodiscard]] bool getCarryFlag() const
+        {
+            return flagOp == FlagOp::None ? (F & CARRY_FLAG_MASK) : computeCarry(flagOp, flagLhs, flagRhs, flagCarry);
+        }
+#else
         [[nodiscard]] uint8_t getFlags() const { return F; }
+        void setFlags(const uint8_t value) { F = value; }
 
-        void setZeroFlag(const bool value) { F = value ? (F | ZERO_FLAG_MASK) : (F & ~ZERO_FLAG_MASK); }
-        void setSubtractFlag(const bool value) { F = value ? (F | SUBTRACT_FLAG_MASK) : (F & ~SUBTRACT_FLAG_MASK); }
-        void setHalfCarryFlag(const bool value) { F = value ? (F | HALF_CARRY_FLAG_MASK) : (F & ~HALF_CARRY_FLAG_MASK); }
-        void setCarryFlag(const bool value) { F = value ? (F | CARRY_FLAG_MASK) : (F & ~CARRY_FLAG_MASK); }
+        [[nodiscard]] bool getZeroFlag() const { return F & ZERO_FLAG_MASK; }
+        [[nodiscard]] bool getCarryFlag() const { return F & CARRY_FLAG_MASK; }
+#endif
+
+        void setZeroFlag(const bool value) { setFlags(value ? (getFlags() | ZERO_FLAG_MASK) : (getFlags() & ~ZERO_FLAG_MASK)); }
+        void setSubtractFlag(const bool value) { setFlags(value ? (getFlags() | SUBTRACT_FLAG_MASK) : (getFlags() & ~SUBTRACT_FLAG_MASK)); }
+        void setHalfCarryFlag(const bool value) { setFlags(value ? (getFlags() | HALF_CARRY_FLAG_MASK) : (getFlags() & ~HALF_CARRY_FLAG_MASK)); }
+        void setCarryFlag(const bool value) { setFlags(value ? (getFlags() | CARRY_FLAG_MASK) : (getFlags() & ~CARRY_FLAG_MASK)); }
         // F = (F & ~CARRY_FLAG_MASK) | (value * CARRY_FLAG_MASK);
 
-        void clearCarryFlag() { F &= ~CARRY_FLAG_MASK; }
+        void clearCarryFlag() { setFlags(getFlags() & ~CARRY_FLAG_MASK); }
 
-        void clearFlags() { F = 0; }
+        void clearFlags() { setFlags(0); }
 
     private:
-        static std::array<void (*)(CPU*), 256> instruction_table;
+        // The recompiler reads the register file and shares the block cache
+        friend class jit::Recompiler;
+
+        // Generated at compile time in cpu.cpp, one specialized function per
+        // opcode. Defined constexpr, so the threaded loop can inline entries;
+        // executeOpcode is forced inline, GCC otherwise keeps about half of
+        // them out of line in a function that large, and PC then goes
+        // through memory for every operand fetch.
+        // replay_instruction_table takes the immediates from `operand`
+        // instead of fetching them.
+        static const std::array<void (*)(CPU*), 256> instruction_table;
+        static const std::array<void (*)(CPU*), 256> replay_instruction_table;
+        static const std::array<void (*)(CPU*), 256> cb_instruction_table;
+
+        template <uint8_t Opcode, bool Replay = false> [[gnu::always_inline]] static inline void executeOpcode(CPU* cpu);
+        template <uint8_t Opcode> static void executeCBOpcode(CPU* cpu);
+
+        template <bool CBPrefixed, bool Replay, std::size_t... Opcodes>
+        static constexpr std::array<void (*)(CPU*), 256> makeInstructionTable(std::index_sequence<Opcodes...>);
+
+        // Operand encodings resolved at compile time
+        template <uint8_t R> uint8_t readReg8();            // r8 index, 6 is (HL)
+        template <uint8_t R> void writeReg8(uint8_t value);
+        template <uint8_t R> uint8_t& reg8();
+        template <uint8_t P> uint16_t& reg16();             // BC DE HL SP
+        template <uint8_t CC> [[nodiscard]] bool condition() const; // NZ Z NC C
+        template <uint8_t Y> void alu(uint8_t value);       // ADD ADC SUB SBC AND XOR OR CP
 
         // Registers
         union {
@@ -166,18 +452,144 @@ namespace emulator
         uint16_t PC; // Program counter
         uint16_t SP; // Stack pointer
 
-        // Methods to handle CPU instructions
-        void fetch() {}; // Fetch the next instruction
-        void decode(); // Decode the fetched instruction
+        uint64_t cycles = 0; // T-cycles elapsed since power on
 
-        uint8_t readMemory(const uint8_t reg) { return 0; }
+        bool ime = false; // Interrupt master enable
+        CpuState state = CpuState::Running;
 
-        uint16_t readNextWord() { return 0; }
-        uint8_t readNextByte() { return 0; }
+        uint64_t sliceEnd = 0;             // runFor() returns once cycles reach it
+        uint64_t eiCycles = UINT64_MAX;    // Cycle count right after the last EI
 
-        void write16Bits(uint16_t, uint16_t) {  }
+        IoHandler* ioHandler = nullptr;
+        HaltStats haltStats;
 
-        void writeMemory(uint16_t addr, uint8_t val) { /* memory[addr] = val; */}
+        // Idle loop detection, see skipIdleLoop()
+        struct IdleLoopEntry
+        {
+            uint32_t blockId = 0;
+            IdleLoop loop;
+        };
+
+        // A pass of the loop block `blockId` from `registers`, reading
+        // `values`, came back to `registers`: while those values hold, it
+        // spins. `cycles` and `slice` date the last arrival at its start.
+        struct IdleLoopProof
+        {
+            uint32_t blockId = 0;
+            std::array<uint16_t, 5> registers{};
+            std::array<uint16_t, IdleLoop::MAX_READS> addresses{};
+            std::array<uint8_t, IdleLoop::MAX_READS> values{};
+            uint8_t reads = 0;
+            uint64_t cycles = 0;
+            uint64_t slice = 0;
+            bool proven = false;
+        };
+
+        std::array<IdleLoopEntry, 64> idleLoops{};  // Analyses, direct mapped by block id
+        IdleLoopProof idleLoopProof;
+        IdleLoopStats idleLoopStats;
+        uint64_t sliceCount = 0;
+        bool idleLooping = false;
+
+        // Called when the jump at `branch` goes back to PC. If the block at
+        // PC is a loop proven idle, the passes left in the slice are skipped.
+        void skipIdleLoop(uint16_t branch);
+
+        // Starts a runFor() slice of `tCycles` and returns the current cycle
+        uint64_t beginSlice(uint32_t tCycles);
+
+        void writeIo(uint16_t addr, uint8_t value);
+        void ei();
+
+#if defined(GCOLOR_LAZY_FLAGS)
+        // Last flag-setting operation, evaluated when F is read
+        FlagOp flagOp = FlagOp::None;
+        uint8_t flagLhs = 0;
+        uint8_t flagRhs = 0;
+        uint8_t flagCarry = 0;
+#endif
+
+        // Sets F from an arithmetic operation: computes it right away, or
+        // records the operation when flags are evaluated lazily
+        void updateFlags(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+        {
+#if defined(GCOLOR_LAZY_FLAGS)
+            flagOp = op;
+            flagLhs = lhs;
+            flagRhs = rhs;
+            flagCarry = carry;
+#else
+            F = aluFlags(op, lhs, rhs, carry);
+#endif
+        }
+
+        // A op rhs for ADD/ADC (FlagOp::Add) and SUB/SBC/CP (FlagOp::Sub):
+        // sets F and returns the result. With flag tables and eager flags,
+        // both come from a single table load.
+        uint8_t arithmetic(const FlagOp op, const uint8_t rhs, const uint8_t carry)
+        {
+#if defined(GCOLOR_FLAG_TABLES) && !defined(GCOLOR_LAZY_FLAGS)
+            const AluResult alu = lookupAlu(op, A, rhs, carry);
+
+            F = alu.flags;
+            return alu.result;
+#else
+            updateFlags(op, A, rhs, carry);
+            return computeAlu(op, A, rhs, carry).result;
+#endif
+        }
+
+        MemoryBus bus;  // The I/O registers and IE stay on its page 0xFF
+
+        BlockCache blockCache;
+        uint16_t operand = 0;  // Immediate of the MicroOp runCached() is replaying
+
+        // Bank mapped at `addr`, part of the block cache key
+        [[nodiscard]] uint16_t codeBank(const uint16_t addr) const { return bus.bank(addr >> MemoryBus::PAGE_BITS); }
+
+        // Decodes the basic block starting at `pc` and adds it to the cache
+        const Block* compileBlock(uint16_t pc);
+
+        // Methods to handle CPU instructions
+        uint16_t readNextWord()
+        {
+            const uint16_t word = bus.fetchWord(PC);
+            PC += 2;
+            return word;
+        }
+        uint8_t readNextByte() { return bus.fetch(PC++); }
+
+        // Immediate operands, fetched after the opcode or, for a replayed
+        // MicroOp, taken from it
+        template <bool Replay> uint8_t nextByte()
+        {
+            if constexpr (Replay) {
+                ++PC;
+                return static_cast<uint8_t>(operand);
+            } else {
+                return readNextByte();
+            }
+        }
+        template <bool Replay> uint16_t nextWord()
+        {
+            if constexpr (Replay) {
+                PC += 2;
+                return operand;
+            } else {
+                return readNextWord();
+            }
+        }
+
+        [[nodiscard]] uint16_t read16Bits(const uint16_t addr) const
+        {
+            return readMemory(addr) | (readMemory(addr + 1) << 8);
+        }
+
+        void write16Bits(const uint16_t addr, const uint16_t value)
+        {
+            writeMemory(addr, value & 0xFF);
+            writeMemory(addr + 1, value >> 8);
+        }
 
         // Helper methods for instruction decoding
         // void handle_opcodes(uint8_t opcode);
@@ -0,0 +1,41 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: flag_tables.cpp
+ * Description: This file contains the precomputed ADD and SUB
+ *              result and flag tables declared in flags.hpp.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "flags.hpp"
+
+namespace emulator
+{
+    namespace
+    {
+        // Filled once at startup: 128K entries is past what constexpr
+        // evaluation handles comfortably
+        std::array<AluResult, 0x20000> makeAluTable(const FlagOp op)
+        {
+            std::array<AluResult, 0x20000> table{};
+
+            for (uint32_t carry = 0; carry < 2; ++carry) {
+                for (uint32_t lhs = 0; lhs < 0x100; ++lhs) {
+                    for (uint32_t rhs = 0; rhs < 0x100; ++rhs)
+                        table[aluTableIndex(lhs, rhs, carry)] = computeAlu(op, lhs, rhs, carry);
+                }
+            }
+            return table;
+        }
+    }
+
+    alignas(64) const std::array<AluResult, 0x20000> ADD_FLAG_TABLE = makeAluTable(FlagOp::Add);
+    alignas(64) const std::array<AluResult, 0x20000> SUB_FLAG_TABLE = makeAluTable(FlagOp::Sub);
+}
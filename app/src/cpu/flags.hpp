@@ -0,0 +1,147 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: flags.hpp
+ * Description: Bit masks of the F register and the flag rules of
+ *              the 8-bit arithmetic instructions, shared by the
+ *              eager, lazy and table flag evaluation paths.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef FLAGS_HPP
+#define FLAGS_HPP
+
+#include <array>
+#include <cstdint>
+
+constexpr uint8_t ZERO_FLAG_MASK = 0x80;  // Bit 7
+constexpr uint8_t SUBTRACT_FLAG_MASK = 0x40;  // Bit 6
+constexpr uint8_t HALF_CARRY_FLAG_MASK = 0x20;  // Bit 5
+constexpr uint8_t CARRY_FLAG_MASK = 0x10;  // Bit 4
+
+namespace emulator
+{
+    // Arithmetic operations whose flags can be deferred.
+    // ADC/SBC/CP are Add/Sub with a carry in (CP discards the result),
+    // Inc/Dec carry the preserved C flag instead.
+    enum class FlagOp : uint8_t
+    {
+        None,
+        Add,
+        Sub,
+        Inc,
+        Dec,
+    };
+
+    // Flags produced by `op` on its operands, as packed into F
+    constexpr uint8_t computeFlags(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+        switch (op) {
+            case FlagOp::Add: {
+                const unsigned result = lhs + rhs + carry;
+
+                return (((result & 0xFF) == 0) ? ZERO_FLAG_MASK : 0) |
+                    ((((lhs & 0xF) + (rhs & 0xF) + carry) > 0xF) ? HALF_CARRY_FLAG_MASK : 0) |
+                    ((result > 0xFF) ? CARRY_FLAG_MASK : 0);
+            }
+            case FlagOp::Sub: {
+                const int result = lhs - rhs - carry;
+
+                return SUBTRACT_FLAG_MASK |
+                    (((result & 0xFF) == 0) ? ZERO_FLAG_MASK : 0) |
+                    (((lhs & 0xF) < ((rhs & 0xF) + carry)) ? HALF_CARRY_FLAG_MASK : 0) |
+                    ((result < 0) ? CARRY_FLAG_MASK : 0);
+            }
+            case FlagOp::Inc: {
+                const uint8_t result = lhs + 1;
+
+                return ((result == 0) ? ZERO_FLAG_MASK : 0) |
+                    (((result & 0x0F) == 0x00) ? HALF_CARRY_FLAG_MASK : 0) |
+                    (carry ? CARRY_FLAG_MASK : 0);
+            }
+            case FlagOp::Dec: {
+                const uint8_t result = lhs - 1;
+
+                return SUBTRACT_FLAG_MASK |
+                    ((result == 0) ? ZERO_FLAG_MASK : 0) |
+                    (((result & 0x0F) == 0x0F) ? HALF_CARRY_FLAG_MASK : 0) |
+                    (carry ? CARRY_FLAG_MASK : 0);
+            }
+            default:
+                return 0;
+        }
+    }
+
+    // The Z or C flag alone of `op`, as computeFlags() sets it: what the
+    // conditional instructions and INC/DEC read of a pending operation
+    constexpr bool computeZero(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+        switch (op) {
+            case FlagOp::Add: return ((lhs + rhs + carry) & 0xFF) == 0;
+            case FlagOp::Sub: return ((lhs - rhs - carry) & 0xFF) == 0;
+            case FlagOp::Inc: return lhs == 0xFF;
+            case FlagOp::Dec: return lhs == 0x01;
+            default: return false;
+        }
+    }
+
+    constexpr bool computeCarry(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+        switch (op) {
+            case FlagOp::Add: return lhs + rhs + carry > 0xFF;
+            case FlagOp::Sub: return lhs < rhs + carry;
+            case FlagOp::Inc:
+            case FlagOp::Dec: return carry != 0;
+            default: return false;
+        }
+    }
+
+    struct AluResult
+    {
+        uint8_t result;
+        uint8_t flags;
+    };
+
+    // Result byte and flags of ADD/ADC (FlagOp::Add) or SUB/SBC/CP (FlagOp::Sub)
+    constexpr AluResult computeAlu(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+        const uint8_t result = op == FlagOp::Add ? lhs + rhs + carry : lhs - rhs - carry;
+
+        return {result, computeFlags(op, lhs, rhs, carry)};
+    }
+
+    // computeAlu precomputed for every operand pair and carry in, built in
+    // flag_tables.cpp. Used instead of the formulas with GCOLOR_FLAG_TABLES.
+    extern const std::array<AluResult, 0x20000> ADD_FLAG_TABLE;
+    extern const std::array<AluResult, 0x20000> SUB_FLAG_TABLE;
+
+    constexpr uint32_t aluTableIndex(const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+        return (carry << 16) | (lhs << 8) | rhs;
+    }
+
+    inline AluResult lookupAlu(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+        return (op == FlagOp::Add ? ADD_FLAG_TABLE : SUB_FLAG_TABLE)[aluTableIndex(lhs, rhs, carry)];
+    }
+
+    // Flags of `op` as the build computes them: one table load for the
+    // arithmetic with GCOLOR_FLAG_TABLES, the formulas otherwise
+    inline uint8_t aluFlags(const FlagOp op, const uint8_t lhs, const uint8_t rhs, const uint8_t carry)
+    {
+#if defined(GCOLOR_FLAG_TABLES)
+        if (op == FlagOp::Add || op == FlagOp::Sub)
+            return lookupAlu(op, lhs, rhs, carry).flags;
+#endif
+        return computeFlags(op, lhs, rhs, carry);
+    }
+}
+
+#endif // FLAGS_HPP
@@ -0,0 +1,137 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: idle_loop.cpp
+ * Description: This file contains the idle loop analysis of decoded
+ *              blocks.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "idle_loop.hpp"
+#include "opcodes.hpp"
+
+namespace emulator
+{
+    namespace
+    {
+        // r8 index (B C D E H L (HL) A) to its bit in a written register mask
+        constexpr uint8_t registerBit(const uint8_t r) { return r < 6 ? 1 << r : 0; }
+
+        constexpr uint8_t BC_BITS = registerBit(0) | registerBit(1);
+        constexpr uint8_t DE_BITS = registerBit(2) | registerBit(3);
+        constexpr uint8_t HL_BITS = registerBit(4) | registerBit(5);
+
+        // Adds the read of `opcode`, if it reads memory. Returns false for
+        // anything with another side effect: writes, stack, SP, flow. The
+        // addresses are taken from the registers as a pass starts, so a read
+        // through a register `written` earlier in the pass is rejected too.
+        bool addRead(IdleLoop& loop, const uint8_t* bytes, uint8_t& written)
+        {
+            const uint8_t opcode = bytes[0];
+            const uint8_t x = opcode >> 6;
+            const uint8_t y = (opcode >> 3) & 7;
+            const uint8_t z = opcode & 7;
+            LoopReadOperand read{LoopRead::HL, 0};
+            uint8_t writes = 0;
+
+            if (x == 0) {
+                if (opcode == 0x0A || opcode == 0x1A) {                        // LD A,(BC) / LD A,(DE)
+                    read.mode = opcode == 0x0A ? LoopRead::BC : LoopRead::DE;
+                } else if (opcode == 0x00 || z == 7 || (z >= 4 && z <= 6 && y != 6)) {
+                    written |= z == 7 ? 0 : registerBit(y);
+                    return true;                                               // NOP, INC/DEC r, LD r,d8, rotates, DAA, CPL, SCF, CCF
+                } else {
+                    return false;
+                }
+            } else if (x == 1) {
+                if (y == 6)                                                    // LD (HL),r / HALT
+                    return false;
+                if (z != 6) {                                                  // LD r,r'
+                    written |= registerBit(y);
+                    return true;
+                }
+                writes = registerBit(y);                                       // LD r,(HL)
+            } else if (x == 2) {
+                if (z != 6)                                                    // ALU A,r
+                    return true;
+            } else if (opcode == 0xCB) {
+                const uint8_t cb = bytes[1];
+
+                if ((cb & 7) != 6) {                                           // Register operand
+                    written |= (cb >> 6) == 1 ? 0 : registerBit(cb & 7);
+                    return true;
+                }
+                if ((cb >> 6) != 1)                                            // Read-modify-write of (HL)
+                    return false;
+            } else if ((opcode & 0xC7) == 0xC6) {                              // ALU A,d8
+                return true;
+            } else if (opcode == 0xF0) {                                       // LDH A,(a8)
+                read = {LoopRead::Absolute, static_cast<uint16_t>(0xFF00 | bytes[1])};
+            } else if (opcode == 0xFA) {                                       // LD A,(a16)
+                read = {LoopRead::Absolute, static_cast<uint16_t>(bytes[1] | (bytes[2] << 8))};
+            } else if (opcode == 0xF2) {                                       // LD A,(C)
+                read.mode = LoopRead::HighC;
+            } else {
+                return false;
+            }
+
+            switch (read.mode) {
+                case LoopRead::Absolute:
+                    if (isFreeRunning(read.addr))
+                        return false;
+                    break;
+                case LoopRead::HighC: if (written & registerBit(1)) return false; break;
+                case LoopRead::BC: if (written & BC_BITS) return false; break;
+                case LoopRead::DE: if (written & DE_BITS) return false; break;
+                case LoopRead::HL: if (written & HL_BITS) return false; break;
+            }
+            if (loop.readCount == IdleLoop::MAX_READS)
+                return false;
+            loop.reads[loop.readCount++] = read;
+            written |= writes;
+            return true;
+        }
+    }
+
+    IdleLoop analyzeIdleLoop(const Block& block, const uint16_t branch, const MemoryBus& bus)
+    {
+        IdleLoop loop;
+        uint16_t addr = block.start;
+        uint32_t cycles = 0;
+        uint8_t written = 0;  // B-L registers set so far in the pass
+
+        if (block.ops.size() > IdleLoop::MAX_INSTRUCTIONS)
+            return {};
+
+        for (std::size_t i = 0; i < block.ops.size(); ++i) {
+            const MicroOp& op = block.ops[i];
+            uint8_t bytes[3] = {};
+
+            for (uint8_t j = 0; j < op.length; ++j)
+                bytes[j] = bus.read(addr + j);
+
+            if (i + 1 == block.ops.size()) {
+                // The block must end with the jump that was just taken
+                if (addr != branch || !isLoopJump(op.opcode))
+                    return {};
+                cycles += INSTRUCTION_CYCLES[op.opcode] + 4;  // Taken
+            } else {
+                if (!addRead(loop, bytes, written))
+                    return {};
+                cycles += INSTRUCTION_CYCLES[op.opcode];
+                if (op.opcode == 0xCB)
+                    cycles += cbInstructionCycles(bytes[1]);
+            }
+            addr += op.length;
+        }
+        loop.cycles = static_cast<uint16_t>(cycles);
+        return loop;
+    }
+}
@@ -0,0 +1,69 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: idle_loop.hpp
+ * Description: Static analysis of decoded blocks looking for busy-wait
+ *              loops: a block jumping back to its own start, without
+ *              writes, that only reads memory and computes on
+ *              registers. Such a loop can only exit once what it
+ *              reads changes, which CPU::runFor then skips ahead to.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef IDLE_LOOP_HPP
+#define IDLE_LOOP_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "block_cache.hpp"
+#include "memory_bus.hpp"
+
+namespace emulator
+{
+    // Where a read of the loop takes its address from
+    enum class LoopRead : uint8_t
+    {
+        Absolute,   // LDH A,(a8) / LD A,(a16)
+        HighC,      // LD A,(C)
+        BC,
+        DE,
+        HL,
+    };
+
+    struct LoopReadOperand
+    {
+        LoopRead mode;
+        uint16_t addr;  // Absolute reads only
+    };
+
+    struct IdleLoop
+    {
+        static constexpr std::size_t MAX_INSTRUCTIONS = 8;
+        static constexpr std::size_t MAX_READS = 4;
+
+        uint16_t cycles = 0;  // T-cycles of one pass, 0 if the block cannot be an idle loop
+        uint8_t readCount = 0;
+        std::array<LoopReadOperand, MAX_READS> reads{};
+    };
+
+    // Analyses `block`, which ends with the jump at `branch` back to its
+    // start. Its operands are read from `bus`.
+    [[nodiscard]] IdleLoop analyzeIdleLoop(const Block& block, uint16_t branch, const MemoryBus& bus);
+
+    // Registers changing on their own between events (the timer counters),
+    // which a loop can't be proven to wait on
+    [[nodiscard]] constexpr bool isFreeRunning(const uint16_t addr)
+    {
+        return addr == 0xFF04 || addr == 0xFF05;
+    }
+}
+
+#endif // IDLE_LOOP_HPP
@@ -0,0 +1,646 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: recompiler.cpp
+ * Description: This file contains the implementation of the x86-64
+ *              dynamic recompiler.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "recompiler.hpp"
+#include "opcodes.hpp"
+#include "x64_emitter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace emulator::jit
+{
+    namespace
+    {
+        using x64::AluOp;
+        using x64::Cond;
+        using x64::Emitter;
+        using x64::Reg;
+        using x64::Reg8;
+
+        // r8 index (B C D E H L (HL) A) to its host register and State field
+        constexpr Reg8 REG8[8] = {Reg8::CH, Reg8::CL, Reg8::DH, Reg8::DL, Reg8::BH, Reg8::BL, Reg8::AH, Reg8::AL};
+        constexpr int32_t REG8_OFFSET[8] = {
+            offsetof(State, bc) + 1, offsetof(State, bc), offsetof(State, de) + 1, offsetof(State, de),
+            offsetof(State, hl) + 1, offsetof(State, hl), offsetof(State, value), offsetof(State, a),
+        };
+
+        // r16 index (BC DE HL SP) to its host register and State field
+        constexpr Reg REG16[4] = {Reg::RCX, Reg::RDX, Reg::RBX, Reg::R9};
+        constexpr int32_t REG16_OFFSET[4] = {
+            offsetof(State, bc), offsetof(State, de), offsetof(State, hl), offsetof(State, sp),
+        };
+
+        // ALU index (ADD ADC SUB SBC AND XOR OR CP) to the x86 operation
+        constexpr AluOp ALU_OP[8] = {AluOp::Add, AluOp::Adc, AluOp::Sub, AluOp::Sbb, AluOp::And, AluOp::Xor, AluOp::Or, AluOp::Cmp};
+
+        // Bits of the x86 flags as loaded into AH by LAHF
+        constexpr uint8_t HOST_ZERO = 0x40;
+        constexpr uint8_t HOST_ADJUST = 0x10;
+        constexpr uint8_t HOST_CARRY = 0x01;
+
+        struct FlagAccess
+        {
+            uint8_t reads;
+            uint8_t writes;
+        };
+
+        constexpr uint8_t ALL_FLAGS = ZERO_FLAG_MASK | SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK | CARRY_FLAG_MASK;
+
+        // Flags read and written by the opcodes the builder translates.
+        // Anything else may read them all, including the code after an exit.
+        constexpr FlagAccess flagAccess(const uint8_t opcode)
+        {
+            const uint8_t x = opcode >> 6;
+            const uint8_t y = (opcode >> 3) & 7;
+            const uint8_t z = opcode & 7;
+
+            if ((x == 0 && (z == 4 || z == 5) && y != 6))                       // INC/DEC r8
+                return {0, ZERO_FLAG_MASK | SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK};
+            if (x == 2 || (x == 3 && z == 6))                                   // ALU A,r8 / A,d8
+                return {(y == 1 || y == 3) ? CARRY_FLAG_MASK : uint8_t{0}, ALL_FLAGS};
+            if (x == 0 && z == 7 && y == 5)                                     // CPL
+                return {0, SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK};
+            if (x == 0 && z == 7 && y >= 6)                                     // SCF / CCF
+                return {y == 7 ? CARRY_FLAG_MASK : uint8_t{0}, SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK | CARRY_FLAG_MASK};
+            if ((x == 0 && z < 4) || x == 1 || opcode == 0xE0 || opcode == 0xE2 || opcode == 0xEA ||
+                opcode == 0xF0 || opcode == 0xF2 || opcode == 0xFA || opcode == 0xF9)
+                return {(x == 0 && z == 0 && y != 0) ? ALL_FLAGS : uint8_t{0}, 0}; // JR cc reads, loads don't
+            return {ALL_FLAGS, 0};
+        }
+
+        // Emits one block: the prologue loads State into the host registers
+        // and every exit jumps to a shared epilogue writing them back
+        class BlockBuilder
+        {
+        public:
+            enum class Step : uint8_t
+            {
+                Unsupported,  // Left to the interpreter, the block stops before it
+                Next,
+                End,          // Translated, but nothing after it is
+            };
+
+            explicit BlockBuilder(const uint16_t start): start(start)
+            {
+                code.push(Reg::RBP);
+                code.push(Reg::RBX);
+                code.alu64(AluOp::Sub, Reg::RSP, 8);  // Keeps calls 16-byte aligned
+                code.mov(Reg::RBP, Reg::RDI);
+                load();
+                top = code.size();
+            }
+
+            [[nodiscard]] const Emitter& emitter() const { return code; }
+            [[nodiscard]] uint16_t maxCycles() const { return longestExit; }
+
+            // `bytes` holds the opcode and its operands, `next` the address
+            // after it and `cycles` the block time including this instruction.
+            // Flags no later instruction reads are not computed.
+            Step instruction(const uint8_t* bytes, const uint16_t next, const uint32_t cycles, const bool liveFlags)
+            {
+                flagsLive = liveFlags;
+                const uint8_t opcode = bytes[0];
+                const uint8_t x = opcode >> 6;
+                const uint8_t y = (opcode >> 3) & 7;
+                const uint8_t z = opcode & 7;
+                const uint8_t p = y >> 1;
+                const uint8_t q = y & 1;
+                const uint8_t imm8 = bytes[1];
+                const uint16_t imm16 = bytes[1] | (bytes[2] << 8);
+
+                if (x == 0) {
+                    if (opcode == 0x00)                                        // NOP
+                        return Step::Next;
+                    if (z == 0 && y >= 3) {                                    // JR / JR cc
+                        const uint16_t target = next + static_cast<int8_t>(imm8);
+
+                        if (y == 3)
+                            exit(target, cycles + 4);
+                        else
+                            branch(y - 4, target, next, cycles);
+                        return Step::End;
+                    }
+                    if (z == 1 && q == 0) {                                    // LD r16,d16
+                        code.movImm32(REG16[p], imm16);
+                        return Step::Next;
+                    }
+                    if (z == 2 && q == 0) {                                    // LD (r16),A
+                        write(cycles, [&] { loadAddress(p); }, [&] { code.movzx8(Reg::RDX, Reg::RBP, offsetof(State, a)); });
+                        stepHL(p);
+                        exit(next, cycles);
+                        return Step::End;
+                    }
+                    if (z == 2) {                                              // LD A,(r16)
+                        read(cycles, [&] { loadAddress(p); });
+                        code.load8(Reg8::AL, Reg::RBP, offsetof(State, value));
+                        stepHL(p);
+                        return Step::Next;
+                    }
+                    if (z == 3) {                                              // INC/DEC r16
+                        q == 0 ? code.inc16(REG16[p]) : code.dec16(REG16[p]);
+                        return Step::Next;
+                    }
+                    if ((z == 4 || z == 5) && y != 6) {                        // INC/DEC r8
+                        z == 4 ? code.inc(REG8[y]) : code.dec(REG8[y]);
+                        packFlags(HOST_ZERO | HOST_ADJUST, z == 5 ? SUBTRACT_FLAG_MASK : 0, true);
+                        return Step::Next;
+                    }
+                    if (z == 6 && y != 6) {                                    // LD r8,d8
+                        code.mov(REG8[y], imm8);
+                        return Step::Next;
+                    }
+                    if (z == 6) {                                              // LD (HL),d8
+                        write(cycles, [&] { loadAddress(2); }, [&] { code.movImm32(Reg::RDX, imm8); });
+                        exit(next, cycles);
+                        return Step::End;
+                    }
+                    if (z == 7 && y == 5) {                                    // CPL
+                        code.notOp(Reg8::AL);
+                        code.alu32(AluOp::Or, Reg::R8, SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK);
+                        return Step::Next;
+                    }
+                    if (z == 7 && y == 6) {                                    // SCF
+                        code.alu32(AluOp::And, Reg::R8, ZERO_FLAG_MASK);
+                        code.alu32(AluOp::Or, Reg::R8, CARRY_FLAG_MASK);
+                        return Step::Next;
+                    }
+                    if (z == 7 && y == 7) {                                    // CCF
+                        code.alu32(AluOp::And, Reg::R8, ZERO_FLAG_MASK | CARRY_FLAG_MASK);
+                        code.alu32(AluOp::Xor, Reg::R8, CARRY_FLAG_MASK);
+                        return Step::Next;
+                    }
+                    return Step::Unsupported;
+                }
+                if (x == 1) {
+                    if (opcode == 0x76)                                        // HALT
+                        return Step::Unsupported;
+                    if (y == 6) {                                              // LD (HL),r8
+                        write(cycles, [&] { loadAddress(2); }, [&] { code.movzx8(Reg::RDX, Reg::RBP, REG8_OFFSET[z]); });
+                        exit(next, cycles);
+                        return Step::End;
+                    }
+                    if (z == 6) {                                              // LD r8,(HL)
+                        read(cycles, [&] { loadAddress(2); });
+                        code.load8(REG8[y], Reg::RBP, offsetof(State, value));
+                    }
+                    else if (y != z)                                           // LD r8,r8
+                        code.mov(REG8[y], REG8[z]);
+                    return Step::Next;
+                }
+                if (x == 2) {                                                  // ALU A,r8
+                    if (z == 6) {
+                        read(cycles, [&] { loadAddress(2); });
+                        code.load8(Reg8::AH, Reg::RBP, offsetof(State, value));
+                    }
+                    alu(y, REG8[z]);
+                    return Step::Next;
+                }
+
+                switch (opcode) {
+                    case 0xC6: case 0xCE: case 0xD6: case 0xDE:                // ALU A,d8
+                    case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+                        code.mov(Reg8::AH, imm8);
+                        alu(y, Reg8::AH);
+                        return Step::Next;
+                    case 0xC3:                                                 // JP a16
+                        exit(imm16, cycles + 4);
+                        return Step::End;
+                    case 0xC2: case 0xCA: case 0xD2: case 0xDA:                // JP cc,a16
+                        branch(y, imm16, next, cycles);
+                        return Step::End;
+                    case 0xE9:                                                 // JP HL
+                        code.store16(Reg::RBP, offsetof(State, pc), Reg::RBX);
+                        exitCycles(cycles);
+                        return Step::End;
+                    case 0xF9:                                                 // LD SP,HL
+                        code.mov32(Reg::R9, Reg::RBX);
+                        return Step::Next;
+                    case 0xE0:                                                 // LDH (a8),A
+                    case 0xE2:                                                 // LD (C),A
+                    case 0xEA:                                                 // LD (a16),A
+                        write(cycles, [&] { loadHighAddress(opcode, imm8, imm16); },
+                            [&] { code.movzx8(Reg::RDX, Reg::RBP, offsetof(State, a)); });
+                        exit(next, cycles);
+                        return Step::End;
+                    case 0xF0:                                                 // LDH A,(a8)
+                    case 0xF2:                                                 // LD A,(C)
+                    case 0xFA:                                                 // LD A,(a16)
+                        read(cycles, [&] { loadHighAddress(opcode, imm8, imm16); });
+                        code.load8(Reg8::AL, Reg::RBP, offsetof(State, value));
+                        return Step::Next;
+                    default:
+                        return Step::Unsupported;
+                }
+            }
+
+            // Leaves the block at `pc` after `cycles` T-cycles. A jump back
+            // to the start of the block stays in native code while the
+            // budget allows another pass.
+            void exit(const uint16_t pc, const uint32_t cycles)
+            {
+                if (pc == start) {
+                    commitCycles(cycles);
+                    code.load64(Reg::RSI, Reg::RBP, offsetof(State, cycles));
+                    code.cmp64(Reg::RSI, Reg::RBP, offsetof(State, limit));
+                    const std::size_t leave = code.jcc(Cond::A);
+
+                    code.add64Mem(Reg::RBP, offsetof(State, loops), 1);
+                    code.jmpTo(top);
+                    code.bind(leave);
+                    code.store16Imm(Reg::RBP, offsetof(State, pc), pc);
+                    exits.push_back(code.jmp());
+                    longestExit = std::max<uint16_t>(longestExit, cycles);
+                    return;
+                }
+                code.store16Imm(Reg::RBP, offsetof(State, pc), pc);
+                exitCycles(cycles);
+            }
+
+            // Binds every exit to the epilogue
+            void finish()
+            {
+                for (const std::size_t at : exits)
+                    code.bind(at);
+                store();
+                code.alu64(AluOp::Add, Reg::RSP, 8);
+                code.pop(Reg::RBX);
+                code.pop(Reg::RBP);
+                code.ret();
+            }
+
+        private:
+            Emitter code;
+            uint16_t start;
+            std::size_t top = 0;  // First instruction, after the prologue
+            std::vector<std::size_t> exits;
+            uint16_t longestExit = 0;
+            uint32_t committed = 0;  // Cycles already added to State::cycles on every path
+            bool flagsLive = true;
+
+            void load()
+            {
+                code.movzx8(Reg::RAX, Reg::RBP, offsetof(State, a));
+                code.movzx8(Reg::R8, Reg::RBP, offsetof(State, f));
+                for (uint8_t p = 0; p < 4; ++p)
+                    code.movzx16(REG16[p], Reg::RBP, REG16_OFFSET[p]);
+            }
+
+            void store()
+            {
+                code.store8(Reg::RBP, offsetof(State, a), Reg8::AL);
+                code.store8(Reg::RBP, offsetof(State, f), Reg::R8);
+                for (uint8_t p = 0; p < 4; ++p)
+                    code.store16(Reg::RBP, REG16_OFFSET[p], REG16[p]);
+            }
+
+            void exitCycles(const uint32_t cycles)
+            {
+                commitCycles(cycles);
+                exits.push_back(code.jmp());
+                longestExit = std::max<uint16_t>(longestExit, cycles);
+            }
+
+            // Brings State::cycles to `cycles` into the block
+            void commitCycles(const uint32_t cycles)
+            {
+                if (cycles != committed)
+                    code.add64Mem(Reg::RBP, offsetof(State, cycles), cycles - committed);
+            }
+
+            // Conditional jump on condition index `cc` (NZ Z NC C)
+            void branch(const uint8_t cc, const uint16_t target, const uint16_t next, const uint32_t cycles)
+            {
+                code.test32(Reg::R8, cc < 2 ? ZERO_FLAG_MASK : CARRY_FLAG_MASK);
+                const std::size_t notTaken = code.jcc((cc & 1) ? Cond::E : Cond::NE);
+
+                exit(target, cycles + 4);
+                code.bind(notTaken);
+                exit(next, cycles);
+            }
+
+            // ESI = r16 index p of the (BC) (DE) (HL+) (HL-) addressing modes
+            void loadAddress(const uint8_t p)
+            {
+                code.movzx16(Reg::RSI, Reg::RBP, REG16_OFFSET[std::min<uint8_t>(p, 2)]);
+            }
+
+            // ESI = address of the LDH and absolute loads of A
+            void loadHighAddress(const uint8_t opcode, const uint8_t imm8, const uint16_t imm16)
+            {
+                if ((opcode & 0x0F) == 0x0A) {
+                    code.movImm32(Reg::RSI, imm16);
+                } else if ((opcode & 0x0F) == 0x02) {
+                    code.movzx8(Reg::RSI, Reg::RBP, offsetof(State, bc));
+                    code.alu32(AluOp::Or, Reg::RSI, 0xFF00);
+                } else {
+                    code.movImm32(Reg::RSI, 0xFF00 | imm8);
+                }
+            }
+
+            // (HL+) and (HL-) step HL once the access is done
+            void stepHL(const uint8_t p)
+            {
+                if (p == 2)
+                    code.inc16(Reg::RBX);
+                else if (p == 3)
+                    code.dec16(Reg::RBX);
+            }
+
+            // Memory goes through CPU::readMemory/writeMemory, so the bus and
+            // the block cache invalidation behave as in the interpreter. The
+            // host registers are caller saved: they round trip through State.
+            template <typename LoadAddress>
+            void read(const uint32_t cycles, LoadAddress&& loadAddress)
+            {
+                store();
+                commitCycles(cycles);
+                committed = cycles;
+                code.mov(Reg::RDI, Reg::RBP);
+                loadAddress();
+                code.movImm64(Reg::RAX, reinterpret_cast<uint64_t>(&Recompiler::readByte));
+                code.call(Reg::RAX);
+                code.store8(Reg::RBP, offsetof(State, value), Reg8::AL);
+                load();
+            }
+
+            template <typename LoadAddress, typename LoadValue>
+            void write(const uint32_t cycles, LoadAddress&& loadAddress, LoadValue&& loadValue)
+            {
+                store();
+                commitCycles(cycles);
+                committed = cycles;
+                code.mov(Reg::RDI, Reg::RBP);
+                loadAddress();
+                loadValue();
+                code.movImm64(Reg::RAX, reinterpret_cast<uint64_t>(&Recompiler::writeByte));
+                code.call(Reg::RAX);
+                load();
+            }
+
+            // ALU index `y` on A and `src`. ADC and SBC take their carry in
+            // from F; the flags are then rebuilt from the host ones.
+            void alu(const uint8_t y, const Reg8 src)
+            {
+                if (y == 1 || y == 3)
+                    code.bt32(Reg::R8, 4);
+                code.alu(ALU_OP[y], Reg8::AL, src);
+                if (y < 4 || y == 7)
+                    packFlags(HOST_ZERO | HOST_ADJUST | HOST_CARRY, y >= 2 ? SUBTRACT_FLAG_MASK : 0, false);
+                else
+                    packFlags(HOST_ZERO, y == 4 ? HALF_CARRY_FLAG_MASK : 0, false);
+            }
+
+            // F = host flags in `hostMask` moved to their SM83 bits, | `set`.
+            // Z and H sit one bit above ZF and AF, C four bits above CF.
+            void packFlags(const uint8_t hostMask, const uint8_t set, const bool keepCarry)
+            {
+                if (!flagsLive)
+                    return;
+                code.lahf();
+                code.movzx8(Reg::RSI, Reg8::AH);
+                code.mov32(Reg::RDI, Reg::RSI);
+                code.alu32(AluOp::And, Reg::RDI, hostMask & (HOST_ZERO | HOST_ADJUST));
+                code.shl32(Reg::RDI, 1);
+                if (hostMask & HOST_CARRY) {
+                    code.alu32(AluOp::And, Reg::RSI, HOST_CARRY);
+                    code.shl32(Reg::RSI, 4);
+                    code.alu32(AluOp::Or, Reg::RDI, Reg::RSI);
+                }
+                if (set != 0)
+                    code.alu32(AluOp::Or, Reg::RDI, set);
+                if (keepCarry) {
+                    code.alu32(AluOp::And, Reg::R8, CARRY_FLAG_MASK);
+                    code.alu32(AluOp::Or, Reg::R8, Reg::RDI);
+                } else {
+                    code.mov32(Reg::R8, Reg::RDI);
+                }
+            }
+        };
+    }
+
+    CodeArena::CodeArena(const std::size_t capacity): capacity(capacity)
+    {
+        void* memory = mmap(nullptr, capacity, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        // Without executable memory nothing gets translated
+        if (memory != MAP_FAILED)
+            base = static_cast<uint8_t*>(memory);
+    }
+
+    CodeArena::~CodeArena()
+    {
+        if (base != nullptr)
+            munmap(base, capacity);
+    }
+
+    const uint8_t* CodeArena::add(const uint8_t* code, const std::size_t size)
+    {
+        static const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+
+        if (base == nullptr || used + size > capacity)
+            return nullptr;
+
+        uint8_t* destination = base + used;
+        uint8_t* first = base + (used / pageSize) * pageSize;
+        const std::size_t length = destination + size - first;
+
+        if (mprotect(first, length, PROT_READ | PROT_WRITE) != 0)
+            return nullptr;
+        std::memcpy(destination, code, size);
+        mprotect(first, length, PROT_READ | PROT_EXEC);
+        used += (size + 15) & ~std::size_t{15};
+        return destination;
+    }
+
+    uint8_t Recompiler::readByte(State* state, const uint16_t addr)
+    {
+        state->cpu->cycles = state->cycles;
+        return state->cpu->readMemory(addr);
+    }
+
+    void Recompiler::writeByte(State* state, const uint16_t addr, const uint8_t value)
+    {
+        state->cpu->cycles = state->cycles;
+        state->cpu->writeMemory(addr, value);
+    }
+
+    Recompiler::Recompiler(CPU& cpu, const uint32_t hotThreshold, const std::size_t codeSize):
+        cpu(cpu), hotThreshold(hotThreshold), arena(codeSize), lookup(0x10000, nullptr)
+    {
+
+    }
+
+    uint64_t Recompiler::runFor(const uint32_t tCycles)
+    {
+        const uint64_t start = cpu.beginSlice(tCycles);
+
+        if (tCycles == 0)
+            return 0;
+
+        // Native blocks never write I/O registers halfway, so the slice end
+        // is only lowered between steps
+        while (cpu.state == CpuState::Running && cpu.cycles < cpu.sliceEnd)
+            step(cpu.sliceEnd, true);
+
+        // Time keeps flowing while the CPU is halted, stopped or locked
+        cpu.skipTo(cpu.sliceEnd);
+        return cpu.cycles - start;
+    }
+
+    void Recompiler::flush()
+    {
+        translations.clear();
+        std::fill(lookup.begin(), lookup.end(), nullptr);
+        arena.clear();
+        translated = 0;
+    }
+
+    uint32_t Recompiler::step(const uint64_t deadline, const bool loop)
+    {
+        const uint16_t pc = cpu.PC;
+        const Block* block = cpu.blockCache.find(pc, cpu.codeBank(pc));
+
+        if (block == nullptr && (block = cpu.compileBlock(pc)) == nullptr) {
+            cpu.executeInstruction();
+            return 1;
+        }
+
+        // A block re-decoded after a write gets a new id, and a new translation
+        Translation* entry = lookup[pc];
+
+        if (entry == nullptr || entry->blockId != block->id) {
+            entry = &translations[(block->bank << 16) | pc];
+            if (entry->blockId != block->id)
+                *entry = Translation{block->id};
+            lookup[pc] = entry;
+        }
+
+        Translation& translation = *entry;
+        if (translation.code == nullptr) {
+            if (!translation.attempted && ++translation.hits >= hotThreshold)
+                translate(*block, translation);
+            if (translation.code == nullptr)
+                return interpret(*block, deadline);
+        }
+        if (cpu.cycles + translation.maxCycles > deadline)
+            return interpret(*block, deadline);
+
+        // A limit below the current time allows a single pass
+        return runNative(translation, loop ? deadline - translation.maxCycles : 0);
+    }
+
+    uint32_t Recompiler::interpret(const Block& block, const uint64_t deadline)
+    {
+        uint32_t executed = 0;
+
+        while (executed < block.ops.size()) {
+            cpu.executeInstruction();
+            ++executed;
+            if (cpu.state != CpuState::Running || !block.valid || cpu.cycles >= deadline)
+                break;
+        }
+        return executed;
+    }
+
+    uint32_t Recompiler::runNative(const Translation& translation, const uint64_t limit)
+    {
+        State state{cpu.getFlags(), cpu.A, cpu.BC, cpu.DE, cpu.HL, cpu.SP, cpu.PC, 0, cpu.cycles, limit, 0, &cpu};
+
+        translation.code(&state);
+        cpu.setFlags(state.f);
+        cpu.A = state.a;
+        cpu.BC = state.bc;
+        cpu.DE = state.de;
+        cpu.HL = state.hl;
+        cpu.SP = state.sp;
+        cpu.PC = state.pc;
+        cpu.cycles = state.cycles;
+        return translation.instructions * (state.loops + 1);
+    }
+
+    void Recompiler::translate(const Block& block, Translation& translation)
+    {
+        BlockBuilder builder(block.start);
+        uint16_t pc = block.start;
+        uint32_t cycles = 0;
+        uint16_t instructions = 0;
+        bool ended = false;
+
+        // Flags still needed after each instruction, all of them past the end
+        std::vector<uint8_t> liveAfter(block.ops.size());
+        uint8_t live = ALL_FLAGS;
+
+        for (std::size_t i = block.ops.size(); i-- > 0;) {
+            const FlagAccess access = flagAccess(block.ops[i].opcode);
+
+            liveAfter[i] = live;
+            live = (live & ~access.writes) | access.reads;
+        }
+
+        translation.attempted = true;
+        // Operands are baked into the code: one fetched live has no fixed value
+        if (block.liveOperands)
+            return;
+        for (std::size_t i = 0; i < block.ops.size(); ++i) {
+            const MicroOp& op = block.ops[i];
+            const uint8_t bytes[3] = {op.opcode, static_cast<uint8_t>(op.operand),
+                static_cast<uint8_t>(op.operand >> 8)};
+
+            const uint16_t next = pc + op.length;
+            const auto step = builder.instruction(bytes, next, cycles + INSTRUCTION_CYCLES[op.opcode],
+                (liveAfter[i] & flagAccess(op.opcode).writes) != 0);
+
+            if (step == BlockBuilder::Step::Unsupported)
+                break;
+            pc = next;
+            cycles += INSTRUCTION_CYCLES[op.opcode];
+            ++instructions;
+            if (step == BlockBuilder::Step::End) {
+                ended = true;
+                break;
+            }
+        }
+        if (instructions == 0)
+            return;
+        if (!ended)
+            builder.exit(pc, cycles);
+        builder.finish();
+
+        const std::vector<uint8_t>& code = builder.emitter().code();
+        const uint8_t* native = arena.add(code.data(), code.size());
+
+        // A full arena starts over: every other translation is dropped
+        if (native == nullptr) {
+            arena.clear();
+            for (auto& [key, entry] : translations)
+                entry = Translation{entry.blockId};
+            translated = 0;
+            translation.attempted = true;
+            native = arena.add(code.data(), code.size());
+            if (native == nullptr)
+                return;
+        }
+        translation.code = reinterpret_cast<BlockFunction>(const_cast<uint8_t*>(native));
+        translation.instructions = instructions;
+        translation.maxCycles = builder.maxCycles();
+        ++translated;
+    }
+}
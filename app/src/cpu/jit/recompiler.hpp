@@ -0,0 +1,135 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: recompiler.hpp
+ * Description: Dynamic recompiler translating hot SM83 basic blocks
+ *              to native x86-64 code. Blocks it cannot translate,
+ *              cold blocks and code patched at run time go through
+ *              the instruction table interpreter instead.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef RECOMPILER_HPP
+#define RECOMPILER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace emulator::jit
+{
+    // Register file seen by the translated code. Each block loads it into
+    // host registers on entry and writes it back on exit:
+    // A=AL, F=R8B, BC=ECX, DE=EDX, HL=EBX, SP=R9D, and RBP points here.
+    struct State
+    {
+        uint8_t f;
+        uint8_t a;
+        uint16_t bc;
+        uint16_t de;
+        uint16_t hl;
+        uint16_t sp;
+        uint16_t pc;
+        uint8_t value;    // Byte returned by the last memory read
+        uint64_t cycles;
+        uint64_t limit;   // A block jumping to its own start loops while cycles <= limit
+        uint64_t loops;   // Extra passes made that way
+        CPU* cpu;
+    };
+
+    // Executable memory the translations are copied to. Pages are only
+    // writable while code is being added to them.
+    class CodeArena
+    {
+    public:
+        explicit CodeArena(std::size_t capacity);
+        ~CodeArena();
+
+        CodeArena(const CodeArena&) = delete;
+        CodeArena& operator=(const CodeArena&) = delete;
+
+        // Copies `size` bytes of code and returns where they landed,
+        // or nullptr once the arena is full
+        const uint8_t* add(const uint8_t* code, std::size_t size);
+        void clear() { used = 0; }
+
+    private:
+        uint8_t* base = nullptr;
+        std::size_t capacity;
+        std::size_t used = 0;
+    };
+
+    class Recompiler
+    {
+    public:
+        static constexpr uint32_t DEFAULT_HOT_THRESHOLD = 8;
+        static constexpr std::size_t DEFAULT_CODE_SIZE = 4 * 1024 * 1024;
+
+        // Blocks run `hotThreshold` times by the interpreter before being translated
+        explicit Recompiler(CPU& cpu, uint32_t hotThreshold = DEFAULT_HOT_THRESHOLD,
+            std::size_t codeSize = DEFAULT_CODE_SIZE);
+        ~Recompiler() = default;
+
+        Recompiler(const Recompiler&) = delete;
+        Recompiler& operator=(const Recompiler&) = delete;
+
+        // Same contract as CPU::runFor: a native block is only entered if
+        // it fits the remaining budget, so the overshoot stays below one
+        // instruction
+        uint64_t runFor(uint32_t tCycles);
+
+        // Runs the block at PC, natively or through the interpreter, and
+        // returns the number of instructions executed. Used to check the
+        // translations against the interpreter in lockstep.
+        uint32_t step() { return step(UINT64_MAX, false); }
+
+        // Drops every translation
+        void flush();
+
+        [[nodiscard]] std::size_t translatedBlocks() const { return translated; }
+
+        // Memory accesses of the translated code. The CPU cycle count is
+        // brought up to date first, as the interpreter has it at that point.
+        static uint8_t readByte(State* state, uint16_t addr);
+        static void writeByte(State* state, uint16_t addr, uint8_t value);
+
+    private:
+        using BlockFunction = void (*)(State*);
+
+        struct Translation
+        {
+            uint32_t blockId = 0;     // Block::id of the decoded block
+            uint32_t hits = 0;
+            bool attempted = false;
+            BlockFunction code = nullptr;
+            uint16_t instructions = 0; // Leading instructions of the block covered by `code`
+            uint16_t maxCycles = 0;    // T-cycles of the longest path through `code`
+        };
+
+        CPU& cpu;
+        uint32_t hotThreshold;
+        CodeArena arena;
+        std::size_t translated = 0;
+
+        // Keyed by bank and start address, like the block cache
+        std::unordered_map<uint32_t, Translation> translations;
+        std::vector<Translation*> lookup; // Last translation seen at each address, any bank
+
+        uint32_t step(uint64_t deadline, bool loop);
+        uint32_t interpret(const Block& block, uint64_t deadline);
+        uint32_t runNative(const Translation& translation, uint64_t limit);
+        void translate(const Block& block, Translation& translation);
+    };
+}
+
+#endif // RECOMPILER_HPP
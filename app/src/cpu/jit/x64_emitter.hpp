@@ -0,0 +1,239 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: x64_emitter.hpp
+ * Description: Minimal x86-64 machine code emitter used by the
+ *              recompiler. It only encodes the handful of
+ *              instructions the translated SM83 blocks need.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef X64_EMITTER_HPP
+#define X64_EMITTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace emulator::x64
+{
+    enum class Reg : uint8_t
+    {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+    };
+
+    // Byte registers encodable without a REX prefix. AH..BH are only
+    // reachable this way, so instructions using them never take a REX.
+    enum class Reg8 : uint8_t
+    {
+        AL, CL, DL, BL, AH, CH, DH, BH,
+    };
+
+    enum class Cond : uint8_t
+    {
+        O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G,
+    };
+
+    // Group 1 arithmetic, in ModRM /digit order
+    enum class AluOp : uint8_t
+    {
+        Add, Or, Adc, Sbb, And, Sub, Xor, Cmp,
+    };
+
+    class Emitter
+    {
+    public:
+        [[nodiscard]] const std::vector<uint8_t>& code() const { return buffer; }
+        [[nodiscard]] std::size_t size() const { return buffer.size(); }
+
+        void push(const Reg r) { rex(false, 0, id(r)); emit(0x50 + (id(r) & 7)); }
+        void pop(const Reg r) { rex(false, 0, id(r)); emit(0x58 + (id(r) & 7)); }
+        void ret() { emit(0xC3); }
+        void call(const Reg r) { rex(false, 0, id(r)); emit(0xFF); modrm(2, id(r)); }
+        void lahf() { emit(0x9F); }
+
+        // mov dst, src (64 and 32 bits)
+        void mov(const Reg dst, const Reg src) { rex(true, id(src), id(dst)); emit(0x89); modrm(id(src), id(dst)); }
+        void mov32(const Reg dst, const Reg src) { rex(false, id(src), id(dst)); emit(0x89); modrm(id(src), id(dst)); }
+
+        void movImm32(const Reg dst, const uint32_t imm)
+        {
+            rex(false, 0, id(dst));
+            emit(0xB8 + (id(dst) & 7));
+            emit32(imm);
+        }
+
+        void movImm64(const Reg dst, const uint64_t imm)
+        {
+            rex(true, 0, id(dst));
+            emit(0xB8 + (id(dst) & 7));
+            emit64(imm);
+        }
+
+        // movzx dst32, byte/word [base + disp]
+        void movzx8(const Reg dst, const Reg base, const int32_t disp) { rex(false, id(dst), id(base)); emit(0x0F); emit(0xB6); mem(id(dst), base, disp); }
+        void movzx16(const Reg dst, const Reg base, const int32_t disp) { rex(false, id(dst), id(base)); emit(0x0F); emit(0xB7); mem(id(dst), base, disp); }
+
+        // mov dst, qword [base + disp]
+        void load64(const Reg dst, const Reg base, const int32_t disp) { rex(true, id(dst), id(base)); emit(0x8B); mem(id(dst), base, disp); }
+
+        // mov r8, byte [base + disp] with a legacy byte register: `base` must be below R8
+        void load8(const Reg8 dst, const Reg base, const int32_t disp) { emit(0x8A); mem(id(dst), base, disp); }
+
+        // movzx dst32, r8 with a legacy byte register: `dst` must be below R8
+        void movzx8(const Reg dst, const Reg8 src) { emit(0x0F); emit(0xB6); modrm(id(dst), id(src)); }
+
+        // mov byte [base + disp], src with a legacy byte register: `base` must be below R8
+        void store8(const Reg base, const int32_t disp, const Reg8 src) { emit(0x88); mem(id(src), base, disp); }
+
+        // mov byte [base + disp], low byte of src
+        void store8(const Reg base, const int32_t disp, const Reg src) { rex(false, id(src), id(base), true); emit(0x88); mem(id(src), base, disp); }
+
+        void store16(const Reg base, const int32_t disp, const Reg src)
+        {
+            emit(0x66);
+            rex(false, id(src), id(base));
+            emit(0x89);
+            mem(id(src), base, disp);
+        }
+
+        void store16Imm(const Reg base, const int32_t disp, const uint16_t imm)
+        {
+            emit(0x66);
+            rex(false, 0, id(base));
+            emit(0xC7);
+            mem(0, base, disp);
+            emit16(imm);
+        }
+
+        // add qword [base + disp], imm
+        void add64Mem(const Reg base, const int32_t disp, const int32_t imm)
+        {
+            rex(true, 0, id(base));
+            emit(isInt8(imm) ? 0x83 : 0x81);
+            mem(0, base, disp);
+            immediate(imm);
+        }
+
+        // op r8, r8 and op r8, imm8 on legacy byte registers
+        void alu(const AluOp op, const Reg8 dst, const Reg8 src) { emit(static_cast<uint8_t>(op) << 3); modrm(id(src), id(dst)); }
+        void alu(const AluOp op, const Reg8 dst, const uint8_t imm) { emit(0x80); modrm(static_cast<uint8_t>(op), id(dst)); emit(imm); }
+
+        // op r32, r32 and op r32, imm
+        void alu32(const AluOp op, const Reg dst, const Reg src)
+        {
+            rex(false, id(src), id(dst));
+            emit((static_cast<uint8_t>(op) << 3) | 1);
+            modrm(id(src), id(dst));
+        }
+
+        void alu32(const AluOp op, const Reg dst, const int32_t imm)
+        {
+            rex(false, 0, id(dst));
+            emit(isInt8(imm) ? 0x83 : 0x81);
+            modrm(static_cast<uint8_t>(op), id(dst));
+            immediate(imm);
+        }
+
+        void alu64(const AluOp op, const Reg dst, const int32_t imm)
+        {
+            rex(true, 0, id(dst));
+            emit(isInt8(imm) ? 0x83 : 0x81);
+            modrm(static_cast<uint8_t>(op), id(dst));
+            immediate(imm);
+        }
+
+        void mov(const Reg8 dst, const Reg8 src) { emit(0x88); modrm(id(src), id(dst)); }
+        void mov(const Reg8 dst, const uint8_t imm) { emit(0xB0 + id(dst)); emit(imm); }
+        void inc(const Reg8 r) { emit(0xFE); modrm(0, id(r)); }
+        void dec(const Reg8 r) { emit(0xFE); modrm(1, id(r)); }
+        void notOp(const Reg8 r) { emit(0xF6); modrm(2, id(r)); }
+
+        // 16-bit forms, the upper half of the register is left untouched
+        void inc16(const Reg r) { emit(0x66); rex(false, 0, id(r)); emit(0xFF); modrm(0, id(r)); }
+        void dec16(const Reg r) { emit(0x66); rex(false, 0, id(r)); emit(0xFF); modrm(1, id(r)); }
+
+        void mov16Imm(const Reg dst, const uint16_t imm)
+        {
+            emit(0x66);
+            rex(false, 0, id(dst));
+            emit(0xB8 + (id(dst) & 7));
+            emit16(imm);
+        }
+
+        void shl32(const Reg r, const uint8_t count) { rex(false, 0, id(r)); emit(0xC1); modrm(4, id(r)); emit(count); }
+        void bt32(const Reg r, const uint8_t bit) { rex(false, 0, id(r)); emit(0x0F); emit(0xBA); modrm(4, id(r)); emit(bit); }
+
+        void test32(const Reg r, const uint32_t imm) { rex(false, 0, id(r)); emit(0xF7); modrm(0, id(r)); emit32(imm); }
+        void test32(const Reg a, const Reg b) { rex(false, id(b), id(a)); emit(0x85); modrm(id(b), id(a)); }
+
+        // cmp a, qword [base + disp]
+        void cmp64(const Reg a, const Reg base, const int32_t disp) { rex(true, id(a), id(base)); emit(0x3B); mem(id(a), base, disp); }
+
+        // Backward jump to `target`, a position already emitted
+        void jmpTo(const std::size_t target) { emit(0xE9); emit32(target - (buffer.size() + 4)); }
+
+        // Forward jumps: return the position of the rel32 to patch with bind()
+        std::size_t jcc(const Cond cond) { emit(0x0F); emit(0x80 + static_cast<uint8_t>(cond)); return placeholder(); }
+        std::size_t jmp() { emit(0xE9); return placeholder(); }
+
+        // Points the jump whose rel32 sits at `at` to the current position
+        void bind(const std::size_t at)
+        {
+            const uint32_t rel = buffer.size() - (at + 4);
+
+            for (int i = 0; i < 4; ++i)
+                buffer[at + i] = rel >> (8 * i);
+        }
+
+    private:
+        std::vector<uint8_t> buffer;
+
+        template <typename R> static constexpr uint8_t id(const R r) { return static_cast<uint8_t>(r); }
+        static constexpr bool isInt8(const int32_t value) { return value >= -128 && value <= 127; }
+
+        void emit(const uint8_t byte) { buffer.push_back(byte); }
+        void emit16(const uint16_t value) { emit(value); emit(value >> 8); }
+        void emit32(const uint32_t value) { emit16(value); emit16(value >> 16); }
+        void emit64(const uint64_t value) { emit32(value); emit32(value >> 32); }
+        void immediate(const int32_t imm) { isInt8(imm) ? emit(imm) : emit32(imm); }
+
+        std::size_t placeholder()
+        {
+            emit32(0);
+            return buffer.size() - 4;
+        }
+
+        // REX prefix, only emitted when needed (or forced, to reach SPL..DIL)
+        void rex(const bool w, const uint8_t reg, const uint8_t rm, const bool force = false)
+        {
+            const uint8_t prefix = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+
+            if (prefix != 0x40 || force)
+                emit(prefix);
+        }
+
+        void modrm(const uint8_t reg, const uint8_t rm) { emit(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+        // [base + disp8/disp32]
+        void mem(const uint8_t reg, const Reg base, const int32_t disp)
+        {
+            const uint8_t mod = isInt8(disp) ? 0x40 : 0x80;
+
+            emit(mod | ((reg & 7) << 3) | (id(base) & 7));
+            if ((id(base) & 7) == 4)
+                emit(0x24); // SIB: base only
+            immediate(disp);
+        }
+    };
+}
+
+#endif // X64_EMITTER_HPP
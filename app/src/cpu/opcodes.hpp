@@ -0,0 +1,136 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: opcodes.hpp
+ * Description: Static properties of the SM83 base opcodes, such as
+ *              instruction length and control flow, used when the
+ *              instruction stream is decoded ahead of execution.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef OPCODES_HPP
+#define OPCODES_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace emulator
+{
+    // Duration in T-cycles of each base opcode. Branches are listed with
+    // their not-taken timing and their handler adds the taken penalty,
+    // which unconditional branches always pay (JR/JP +4, CALL/RET +12).
+    // 0xCB is the prefix fetch only, see cbInstructionCycles.
+    constexpr std::array<uint8_t, 256> INSTRUCTION_CYCLES = {
+    //  x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+         4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8,  8,  4,  4,  8,  4,  // 0x
+         4, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,  // 1x
+         8, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,  // 2x
+         8, 12,  8,  8, 12, 12, 12,  4,  8,  8,  8,  8,  4,  4,  8,  4,  // 3x
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 4x
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 5x
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 6x
+         8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,  // 7x
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 8x
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 9x
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // Ax
+         4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // Bx
+         8, 12, 12, 12, 12, 16,  8, 16,  8,  4, 12,  4, 12, 12,  8, 16,  // Cx
+         8, 12, 12,  4, 12, 16,  8, 16,  8, 16, 12,  4, 12,  4,  8, 16,  // Dx
+        12, 12,  8,  4,  4, 16,  8, 16, 16,  4, 16,  4,  4,  4,  8, 16,  // Ex
+        12, 12,  8,  4,  4, 16,  8, 16, 12,  8, 16,  4,  4,  4,  8, 16,  // Fx
+    };
+
+    // T-cycles of a CB prefixed opcode after its prefix: (HL) operands
+    // cost a read, and a write back unless the opcode is BIT
+    constexpr uint8_t cbInstructionCycles(const uint8_t opcode)
+    {
+        if ((opcode & 7) != 6)
+            return 4;
+        return (opcode >> 6) == 1 ? 8 : 12;
+    }
+
+    // Length in bytes of an instruction, opcode and operands included
+    constexpr uint8_t instructionLength(const uint8_t opcode)
+    {
+        switch (opcode) {
+            case 0x01: case 0x11: case 0x21: case 0x31:             // LD r16,d16
+            case 0x08:                                              // LD (a16),SP
+            case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:  // JP
+            case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:  // CALL
+            case 0xEA: case 0xFA:                                   // LD (a16),A / LD A,(a16)
+                return 3;
+            case 0x06: case 0x0E: case 0x16: case 0x1E:             // LD r8,d8
+            case 0x26: case 0x2E: case 0x36: case 0x3E:
+            case 0x10:                                              // STOP 0
+            case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:  // JR
+            case 0xC6: case 0xCE: case 0xD6: case 0xDE:             // ALU A,d8
+            case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+            case 0xE0: case 0xF0:                                   // LDH
+            case 0xE8: case 0xF8:                                   // ADD SP,r8 / LD HL,SP+r8
+            case 0xCB:                                              // CB prefix
+                return 2;
+            default:
+                return 1;
+        }
+    }
+
+    // True if the instruction may change the flow of execution (jumps, calls,
+    // returns, HALT/STOP, interrupt enable changes, illegal opcodes)
+    constexpr bool endsBasicBlock(const uint8_t opcode)
+    {
+        switch (opcode) {
+            case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:  // JR
+            case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:  // JP
+            case 0xE9:                                              // JP HL
+            case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:  // CALL
+            case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8:  // RET
+            case 0xD9:                                              // RETI
+            case 0xC7: case 0xCF: case 0xD7: case 0xDF:             // RST
+            case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            case 0x76: case 0x10:                                   // HALT / STOP
+            case 0xF3: case 0xFB:                                   // DI / EI
+            case 0xD3: case 0xDB: case 0xDD: case 0xE3:             // Illegal opcodes
+            case 0xE4: case 0xEB: case 0xEC: case 0xED:
+            case 0xF4: case 0xFC: case 0xFD:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // True for the jumps to an immediate target (JR, JP, conditional or
+    // not), the ones that can close a loop
+    constexpr bool isLoopJump(const uint8_t opcode)
+    {
+        switch (opcode) {
+            case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:  // JR
+            case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:  // JP
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // True if the instruction can leave the running state (HALT, STOP, illegal opcodes)
+    constexpr bool suspendsExecution(const uint8_t opcode)
+    {
+        switch (opcode) {
+            case 0x76: case 0x10:                                   // HALT / STOP
+            case 0xD3: case 0xDB: case 0xDD: case 0xE3:             // Illegal opcodes
+            case 0xE4: case 0xEB: case 0xEC: case 0xED:
+            case 0xF4: case 0xFC: case 0xFD:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+#endif // OPCODES_HPP
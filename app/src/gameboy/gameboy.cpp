@@ -0,0 +1,834 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: gameboy.cpp
+ * Description: This file contains the implementation of the
+ *              GameBoy class.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "gameboy.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+namespace emulator
+{
+    static_assert(offsetof(GameBoy::SystemMemory, wram) <= 1024, "The hot regions fit in the first KB");
+    static_assert(offsetof(GameBoy::SystemMemory, wram) % 64 == 0, "WRAM starts on its own cache line");
+    static_assert(offsetof(GameBoy::SystemMemory, objPalettes) == offsetof(GameBoy::SystemMemory, bgPalettes) + GameBoy::PALETTE_SIZE,
+        "The PPU reads both palette memories as one");
+
+    GameBoy::GameBoy()
+    {
+        cpu.setIoHandler(this);
+        reset();
+    }
+
+    void GameBoy::reset()
+    {
+        cpu.reset();
+        mapper.reset();
+        ppu.reset();
+
+        MemoryBus& bus = cpu.getMemoryBus();
+
+        bus.map(0xC0, WRAM_BANK_SIZE / MemoryBus::PAGE_SIZE, memory.wram.data());
+        bus.map(0xE0, WRAM_BANK_SIZE / MemoryBus::PAGE_SIZE, memory.wram.data());  // Echo
+        bus.mapReadOnly(0xFE, 1, memory.oam.data(), this);
+        bus.map(0xFF, 1, memory.high.data());
+        mapWram(1);
+        mapVram(0);
+        cpu.setIoRegister(KEY1_REGISTER, 0x7E);
+        cpu.setIoRegister(VBK_REGISTER, 0xFE);
+        cpu.setIoRegister(SVBK_REGISTER, 0xF8);
+        cpu.setIoRegister(HDMA5_REGISTER, 0xFF);
+        scheduler.clear();
+        doubleSpeed = false;
+        dmaActive = false;
+        hdmaActive = false;
+        hdmaBlocks = 0;
+        dmaStall = 0;
+        apuFrameStep = 0;
+
+        const uint64_t now = cpu.getCycles();
+
+        frameEnd = now;
+
+        divBase = now;
+        timaSync = now;
+        tima = 0;
+        tac = 0xF8;
+        reloadedAt = UINT64_MAX;
+        cpu.setIoRegister(TMA_REGISTER, 0);
+        cpu.setIoRegister(TAC_REGISTER, tac);
+        cpu.setIoRegister(SB_REGISTER, 0);
+        cpu.setIoRegister(SC_REGISTER, 0x7E);
+        cpu.setIoRegister(IF_REGISTER, 0xE1);
+        cpu.setIoRegister(NR52_REGISTER, 0xF1);
+        cpu.setIoRegister(LCDC_REGISTER, 0x91);
+        cpu.setIoRegister(STAT_REGISTER, 0x80);
+        cpu.setIoRegister(LYC_REGISTER, 0);
+
+        line = 0;
+        drawnLine = 0;
+        drawnX = 0;
+        displayChanged = true;
+        displayChangedBefore = true;
+        startLine(now);
+        scheduleEvent(EventType::ApuFrameSequencer, now + APU_FRAME_CYCLES * speedFactor());
+    }
+
+    bool GameBoy::loadRom(const std::filesystem::path& path)
+    {
+        Rom image;
+
+        if (!image.open(path))
+            return false;
+        insertRom(std::move(image));
+        mapper.attachSave(std::filesystem::path(path).replace_extension(".sav"), saveInterval);
+        return true;
+    }
+
+    void GameBoy::insertRom(Rom image)
+    {
+        rom = std::move(image);
+        if (rom.empty())
+            mapper.unload();
+        else
+            mapper.load(rom);
+        cpu.flushBlocks();
+        ppu.setColor(rom.empty() || mapper.getHeader().color);
+        reset();
+    }
+
+    uint64_t GameBoy::runFrame()
+    {
+        const uint64_t start = cpu.getCycles();
+
+        frameEnd += doubleSpeed ? FRAME_CYCLES * 2 : FRAME_CYCLES;
+
+        while (cpu.getCycles() < frameEnd) {
+            dispatchEvents();
+            if (dmaStall != 0) {
+                // The events due while the CPU is held are dispatched first
+                cpu.stall(dmaStall);
+                dmaStall = 0;
+                continue;
+            }
+            cpu.serviceInterrupts();
+            if (cpu.getState() == CpuState::Stopped && (ioRegister(KEY1_REGISTER) & 0x01))
+                switchSpeed();
+
+            const uint64_t now = cpu.getCycles();
+            const uint64_t target = std::min(frameEnd, scheduler.nextTimestamp());
+
+            if (cpu.getState() != CpuState::Running) {
+                cpu.skipTo(fastForward(false));
+            } else if (cpu.isIdleLooping() && !cpu.idleLoopReads(STAT_REGISTER, STAT_REGISTER)) {
+                // The loop can't see the PPU modes, and sees the lines only
+                // if it reads LY: it spins through the rest
+                const uint64_t end = fastForward(cpu.idleLoopReads(LY_REGISTER, LY_REGISTER));
+
+                if (end > now)
+                    cpu.runFor(static_cast<uint32_t>(end - now));
+            } else if (target > now) {
+                cpu.runFor(static_cast<uint32_t>(target - now));
+            }
+        }
+
+        dispatchEvents();
+        catchUp();
+        mapper.clock(FRAME_CYCLES);  // A frame lasts the same at both speeds
+        return cpu.getCycles() - start;
+    }
+
+    uint64_t GameBoy::fastForward(const bool seesLines)
+    {
+        uint64_t target = frameEnd;
+
+        for (const EventType type : {EventType::TimerOverflow, EventType::SerialTransfer,
+                                     EventType::DmaEnd, EventType::ApuFrameSequencer, EventType::SpeedSwitch})
+            target = std::min(target, scheduler.timestampOf(type));
+
+        // Without STAT interrupts the only PPU event the CPU can observe
+        // is the VBlank one, or each line change if it watches LY, so the
+        // events in between are jumped over instead of dispatched. An HBlank
+        // DMA needs every HBlank.
+        if ((ioRegister(STAT_REGISTER) & 0x78) != 0 || hdmaActive || !scheduler.isScheduled(EventType::LineChange))
+            return std::min(target, scheduler.nextTimestamp());
+        target = std::min(target, seesLines ? scheduler.timestampOf(EventType::LineChange) : nextVBlank());
+        seekPpu(target);
+        return target;
+    }
+
+    void GameBoy::scheduleEvent(const EventType type, const uint64_t timestamp)
+    {
+        scheduler.schedule(type, timestamp);
+        cpu.endSliceAt(timestamp);
+    }
+
+    void GameBoy::dispatchEvents()
+    {
+        Event event{};
+
+        while (scheduler.popDue(cpu.getCycles(), event)) {
+            switch (event.type) {
+                case EventType::LineChange:
+                    line = (line + 1) % LINES;
+                    startLine(event.timestamp);
+                    break;
+                case EventType::StatMode:
+                    advanceMode(event.timestamp);
+                    break;
+                case EventType::TimerOverflow:
+                    overflowTimer(event.timestamp);
+                    break;
+                case EventType::SerialTransfer:
+                    finishSerial();
+                    break;
+                case EventType::DmaEnd:
+                    dmaActive = false;
+                    break;
+                case EventType::ApuFrameSequencer:
+                    stepApuFrame(event.timestamp);
+                    break;
+                case EventType::SpeedSwitch:
+                    cpu.resume();
+                    break;
+                case EventType::Count:
+                    break;
+            }
+        }
+    }
+
+    constexpr std::array<GameBoy::IoRegister, 256> GameBoy::makeIoTable()
+    {
+        std::array<IoRegister, 256> table{};
+        const auto set = [&table](const uint16_t addr, const uint8_t readMask, const uint8_t writeMask,
+                                  void (*write)(GameBoy&, uint8_t) = nullptr) {
+            table[addr & 0xFF] = {readMask, writeMask, nullptr, write};
+        };
+
+        set(0xFF00, 0xC0, 0x30);                                        // P1
+        set(SB_REGISTER, 0x00, 0xFF);
+        set(SC_REGISTER, 0x7C, 0x83, [](GameBoy& gb, const uint8_t value) { gb.startSerial(value); });
+        set(DIV_REGISTER, 0x00, 0x00, [](GameBoy& gb, uint8_t) { gb.resetDivider(gb.cpu.getCycles()); });
+        table[DIV_REGISTER & 0xFF].read = [](GameBoy& gb) {
+            return static_cast<uint8_t>((gb.cpu.getCycles() - gb.divBase) >> 8);
+        };
+        // TIMA and TMA are stored by their hooks: a reload due before the
+        // write must still see the old TMA
+        set(TIMA_REGISTER, 0x00, 0x00, [](GameBoy& gb, const uint8_t value) { gb.writeTima(value); });
+        table[TIMA_REGISTER & 0xFF].read = [](GameBoy& gb) {
+            gb.syncTimer(gb.cpu.getCycles());
+            return gb.tima;
+        };
+        set(TMA_REGISTER, 0x00, 0x00, [](GameBoy& gb, const uint8_t value) { gb.writeTma(value); });
+        set(TAC_REGISTER, 0xF8, 0x07, [](GameBoy& gb, const uint8_t value) { gb.writeTac(value); });
+        set(IF_REGISTER, 0xE0, 0x1F);
+
+        // Sound: the frequency and length bits are write only
+        set(0xFF10, 0x80, 0x7F);                                        // NR10
+        set(0xFF11, 0x3F, 0xFF);
+        set(0xFF12, 0x00, 0xFF);
+        set(0xFF13, 0xFF, 0xFF);
+        set(0xFF14, 0xBF, 0xC7);
+        set(0xFF16, 0x3F, 0xFF);                                        // NR21
+        set(0xFF17, 0x00, 0xFF);
+        set(0xFF18, 0xFF, 0xFF);
+        set(0xFF19, 0xBF, 0xC7);
+        set(0xFF1A, 0x7F, 0x80);                                        // NR30
+        set(0xFF1B, 0xFF, 0xFF);
+        set(0xFF1C, 0x9F, 0x60);
+        set(0xFF1D, 0xFF, 0xFF);
+        set(0xFF1E, 0xBF, 0xC7);
+        set(0xFF20, 0xFF, 0x3F);                                        // NR41
+        set(0xFF21, 0x00, 0xFF);
+        set(0xFF22, 0x00, 0xFF);
+        set(0xFF23, 0xBF, 0xC0);
+        set(0xFF24, 0x00, 0xFF);                                        // NR50
+        set(0xFF25, 0x00, 0xFF);
+        set(NR52_REGISTER, 0x70, 0x80, [](GameBoy& gb, const uint8_t value) {
+            if (!(value & 0x80))
+                gb.scheduler.cancel(EventType::ApuFrameSequencer);
+            else if (!gb.scheduler.isScheduled(EventType::ApuFrameSequencer))
+                gb.scheduleEvent(EventType::ApuFrameSequencer,
+                    gb.cpu.getCycles() + APU_FRAME_CYCLES * gb.speedFactor());
+        });
+        for (uint16_t addr = 0xFF30; addr < 0xFF40; ++addr)             // Wave RAM
+            set(addr, 0x00, 0xFF);
+
+        // PPU: the mode and coincidence bits of STAT and LY are the PPU's
+        // The registers the drawing reads are stored by writeDisplay() once
+        // the frame is drawn up to the write; reading LY or STAT draws it too
+        set(LCDC_REGISTER, 0x00, 0x00, [](GameBoy& gb, const uint8_t value) {
+            writeDisplay<LCDC_REGISTER>(gb, value);
+            gb.setLcdEnabled(value & 0x80);
+        });
+        set(STAT_REGISTER, 0x80, 0x78);
+        table[STAT_REGISTER & 0xFF].read = [](GameBoy& gb) {
+            gb.catchUp();
+            return gb.ioRegister(STAT_REGISTER);
+        };
+        set(0xFF42, 0x00, 0x00, &writeDisplay<0xFF42>);                // SCY
+        set(0xFF43, 0x00, 0x00, &writeDisplay<0xFF43>);                // SCX
+        set(LY_REGISTER, 0x00, 0x00);
+        table[LY_REGISTER & 0xFF].read = [](GameBoy& gb) {
+            gb.catchUp();
+            return gb.ioRegister(LY_REGISTER);
+        };
+        set(LYC_REGISTER, 0x00, 0xFF, [](GameBoy& gb, uint8_t) { gb.compareLine(); });
+        set(DMA_REGISTER, 0x00, 0xFF, [](GameBoy& gb, const uint8_t value) { gb.startDma(value); });
+        set(0xFF47, 0x00, 0x00, &writeDisplay<0xFF47>);                // BGP
+        set(0xFF48, 0x00, 0x00, &writeDisplay<0xFF48>);                // OBP0
+        set(0xFF49, 0x00, 0x00, &writeDisplay<0xFF49>);                // OBP1
+        set(0xFF4A, 0x00, 0x00, &writeDisplay<0xFF4A>);                // WY
+        set(0xFF4B, 0x00, 0x00, &writeDisplay<0xFF4B>);                // WX
+
+        // CGB: bit 7 of KEY1 is the current speed
+        set(KEY1_REGISTER, 0x7E, 0x01);
+        set(VBK_REGISTER, 0xFE, 0x01, [](GameBoy& gb, const uint8_t value) { gb.mapVram(value & 0x01); });
+        set(0xFF51, 0xFF, 0xFF);                                        // HDMA1-4: source and destination
+        set(0xFF52, 0xFF, 0xF0);
+        set(0xFF53, 0xFF, 0x1F);
+        set(0xFF54, 0xFF, 0xF0);
+        set(HDMA5_REGISTER, 0x00, 0x00, [](GameBoy& gb, const uint8_t value) { gb.startHdma(value); });
+        set(0xFF56, 0x3C, 0xC1);                                        // RP
+        set(BCPS_REGISTER, 0x40, 0xBF);
+        set(BCPS_REGISTER + 1, 0x00, 0x00, [](GameBoy& gb, const uint8_t value) { gb.writePalette(BCPS_REGISTER, value); });
+        table[(BCPS_REGISTER + 1) & 0xFF].read = [](GameBoy& gb) { return gb.paletteByte(BCPS_REGISTER); };
+        set(OCPS_REGISTER, 0x40, 0xBF);
+        set(OCPS_REGISTER + 1, 0x00, 0x00, [](GameBoy& gb, const uint8_t value) { gb.writePalette(OCPS_REGISTER, value); });
+        table[(OCPS_REGISTER + 1) & 0xFF].read = [](GameBoy& gb) { return gb.paletteByte(OCPS_REGISTER); };
+        set(0xFF6C, 0xFE, 0x01);                                        // OPRI
+        set(SVBK_REGISTER, 0xF8, 0x07, [](GameBoy& gb, const uint8_t value) { gb.mapWram(value & 0x07); });
+        set(0xFF72, 0x00, 0xFF);
+        set(0xFF73, 0x00, 0xFF);
+        set(0xFF74, 0x00, 0xFF);
+        set(0xFF75, 0x8F, 0x70);
+        set(0xFF76, 0x00, 0x00);                                        // PCM12, PCM34
+        set(0xFF77, 0x00, 0x00);
+
+        set(CPU::IE_REGISTER, 0x00, 0xFF);                              // HRAM never comes here
+        return table;
+    }
+
+    constexpr std::array<GameBoy::IoRegister, 256> GameBoy::IO_TABLE = makeIoTable();
+
+    uint8_t GameBoy::readIo(const uint16_t addr)
+    {
+        const IoRegister& reg = IO_TABLE[addr & 0xFF];
+
+        if (reg.read != nullptr) [[unlikely]]
+            return reg.read(*this) | reg.readMask;
+        return ioRegister(addr) | reg.readMask;
+    }
+
+    void GameBoy::writeIo(const uint16_t addr, const uint8_t value)
+    {
+        const IoRegister& reg = IO_TABLE[addr & 0xFF];
+
+        // Plain storage is the common case: stored as is, nothing to notify
+        if (reg.writeMask == 0xFF && reg.write == nullptr) [[likely]] {
+            cpu.setIoRegister(addr, value);
+            return;
+        }
+        cpu.setIoRegister(addr, (ioRegister(addr) & ~reg.writeMask) | (value & reg.writeMask));
+        if (reg.write != nullptr)
+            reg.write(*this, value);
+    }
+
+    // CGB banks and speed
+
+    void GameBoy::mapWram(const uint8_t bank)
+    {
+        MemoryBus& bus = cpu.getMemoryBus();
+
+        wramBank = bank == 0 ? 1 : bank;  // Bank 0 is always at 0xC000
+        uint8_t* bytes = memory.wram.data() + wramBank * WRAM_BANK_SIZE;
+
+        bus.map(0xD0, WRAM_BANK_SIZE / MemoryBus::PAGE_SIZE, bytes, wramBank);
+        bus.map(0xF0, 0x0E, bytes, wramBank);  // Echo up to 0xFDFF, OAM and I/O follow
+    }
+
+    void GameBoy::mapVram(const uint8_t bank)
+    {
+        vramBank = bank;
+        cpu.getMemoryBus().mapReadOnly(VRAM >> MemoryBus::PAGE_BITS, VRAM_BANK_SIZE / MemoryBus::PAGE_SIZE,
+            memory.vram.data() + bank * VRAM_BANK_SIZE, this, bank);
+    }
+
+    uint8_t GameBoy::read(const uint16_t addr)
+    {
+        if (addr >= OAM)
+            return memory.oam[addr & 0xFF];
+        return memory.vram[vramBank * VRAM_BANK_SIZE + (addr - VRAM)];
+    }
+
+    void GameBoy::write(const uint16_t addr, const uint8_t value)
+    {
+        if (addr >= OAM) {
+            if (memory.oam[addr & 0xFF] != value) {
+                displayWrite();
+                memory.oam[addr & 0xFF] = value;
+            }
+            return;
+        }
+
+        const std::size_t offset = vramBank * VRAM_BANK_SIZE + (addr - VRAM);
+
+        if (memory.vram[offset] == value)
+            return;
+        displayWrite();
+        memory.vram[offset] = value;
+        ppu.invalidateTile(offset);
+    }
+
+    uint8_t* GameBoy::copyTarget(const uint16_t addr, const uint16_t length)
+    {
+        // A transfer past the end of OAM or VRAM is written one byte at a time
+        if (addr >= OAM) {
+            if (static_cast<std::size_t>(addr & 0xFF) + length > memory.oam.size())
+                return nullptr;
+            displayWrite();
+            return memory.oam.data() + (addr & 0xFF);
+        }
+        if (addr + length > VRAM + VRAM_BANK_SIZE)
+            return nullptr;
+
+        const std::size_t offset = vramBank * VRAM_BANK_SIZE + (addr - VRAM);
+
+        displayWrite();
+        ppu.invalidateTiles(offset, length);
+        return memory.vram.data() + offset;
+    }
+
+    uint8_t& GameBoy::paletteByte(const uint16_t select)
+    {
+        auto& palettes = select == BCPS_REGISTER ? memory.bgPalettes : memory.objPalettes;
+
+        return palettes[ioRegister(select) & 0x3F];
+    }
+
+    void GameBoy::writePalette(const uint16_t select, const uint8_t value)
+    {
+        const uint8_t index = ioRegister(select);
+
+        if (paletteByte(select) != value) {
+            displayWrite();
+            paletteByte(select) = value;
+            ppu.invalidatePalettes();
+        }
+        if (index & 0x80)
+            cpu.setIoRegister(select, 0x80 | ((index + 1) & 0x3F));
+    }
+
+    void GameBoy::switchSpeed()
+    {
+        const uint64_t now = cpu.getCycles();
+        const uint32_t multiplier = doubleSpeed ? 1 : 2;
+        const uint32_t divisor = doubleSpeed ? 2 : 1;
+
+        // The PPU and APU keep their pace in real time, so there are twice
+        // as many CPU cycles (or half as many) left before their events.
+        // The timer, serial and DMA run off the CPU clock and keep theirs.
+        doubleSpeed = !doubleSpeed;
+        for (const EventType type : {EventType::LineChange, EventType::StatMode, EventType::ApuFrameSequencer})
+            scheduler.rescale(type, now, multiplier, divisor);
+        frameEnd = now + (frameEnd - now) * multiplier / divisor;
+
+        resetDivider(now);  // STOP resets the divider
+        cpu.setIoRegister(KEY1_REGISTER, (doubleSpeed ? 0x80 : 0x00) | 0x7E);
+        scheduleEvent(EventType::SpeedSwitch, now + SPEED_SWITCH_CYCLES);
+    }
+
+    // PPU
+
+    void GameBoy::startLine(const uint64_t timestamp)
+    {
+        if (line == 0)
+            startFrame();
+        cpu.setIoRegister(LY_REGISTER, line);
+        compareLine();
+
+        if (line < VISIBLE_LINES) {
+            setMode(PpuMode::OamScan);
+            scheduleEvent(EventType::StatMode, timestamp + OAM_SCAN_CYCLES * speedFactor());
+        } else if (line == VISIBLE_LINES) {
+            catchUp();  // The frame is complete
+            setMode(PpuMode::VBlank);
+            cpu.requestInterrupt(Interrupt::VBlank);
+        }
+        scheduleEvent(EventType::LineChange, timestamp + LINE_CYCLES * speedFactor());
+    }
+
+    void GameBoy::advanceMode(const uint64_t timestamp)
+    {
+        if (ppuMode == PpuMode::OamScan) {
+            setMode(PpuMode::Drawing);
+            scheduleEvent(EventType::StatMode, timestamp + DRAWING_CYCLES * speedFactor());
+        } else if (ppuMode == PpuMode::Drawing) {
+            setMode(PpuMode::HBlank);
+            if (hdmaActive)
+                transferHdma(1);
+        }
+    }
+
+    void GameBoy::setMode(const PpuMode mode)
+    {
+        const uint8_t stat = ioRegister(STAT_REGISTER);
+
+        ppuMode = mode;
+        cpu.setIoRegister(STAT_REGISTER, (stat & ~0x03) | static_cast<uint8_t>(mode));
+
+        // STAT bits 3-5 enable the HBlank, VBlank and OAM scan interrupts
+        if (mode != PpuMode::Drawing && (stat & (0x08 << static_cast<uint8_t>(mode))))
+            cpu.requestInterrupt(Interrupt::LcdStat);
+    }
+
+    void GameBoy::compareLine()
+    {
+        const uint8_t stat = ioRegister(STAT_REGISTER);
+
+        if (ioRegister(LYC_REGISTER) != line) {
+            cpu.setIoRegister(STAT_REGISTER, stat & ~0x04);
+            return;
+        }
+        cpu.setIoRegister(STAT_REGISTER, stat | 0x04);
+        if (stat & 0x40)
+            cpu.requestInterrupt(Interrupt::LcdStat);
+    }
+
+    uint64_t GameBoy::nextVBlank() const
+    {
+        const uint8_t lines = (VISIBLE_LINES + LINES - line - 1) % LINES;
+
+        return scheduler.timestampOf(EventType::LineChange) + static_cast<uint64_t>(lines) * LINE_CYCLES * speedFactor();
+    }
+
+    void GameBoy::seekPpu(const uint64_t timestamp)
+    {
+        const uint64_t lineCycles = LINE_CYCLES * speedFactor();
+        const uint64_t lineStart = scheduler.timestampOf(EventType::LineChange) - lineCycles;
+
+        // The PPU state just before `timestamp`: events due right at it stay pending
+        const uint64_t lines = (timestamp - 1 - lineStart) / lineCycles;
+        const uint64_t start = lineStart + lines * lineCycles;
+        const uint64_t offset = timestamp - start;
+
+        // Never past a VBlank: only a seek from VBlank starts a frame. Its
+        // lines are drawn by the next catch-up.
+        if (line + lines >= LINES)
+            startFrame();
+        line = static_cast<uint8_t>((line + lines) % LINES);
+        cpu.setIoRegister(LY_REGISTER, line);
+        compareLine();
+        scheduler.schedule(EventType::LineChange, start + lineCycles);
+        scheduler.cancel(EventType::StatMode);
+
+        if (line >= VISIBLE_LINES) {
+            setMode(PpuMode::VBlank);
+        } else if (offset <= OAM_SCAN_CYCLES * speedFactor()) {
+            setMode(PpuMode::OamScan);
+            scheduler.schedule(EventType::StatMode, start + OAM_SCAN_CYCLES * speedFactor());
+        } else if (offset <= (OAM_SCAN_CYCLES + DRAWING_CYCLES) * speedFactor()) {
+            setMode(PpuMode::Drawing);
+            scheduler.schedule(EventType::StatMode, start + (OAM_SCAN_CYCLES + DRAWING_CYCLES) * speedFactor());
+        } else {
+            setMode(PpuMode::HBlank);
+        }
+    }
+
+    void GameBoy::setLcdEnabled(const bool enabled)
+    {
+        if (enabled == scheduler.isScheduled(EventType::LineChange))
+            return;
+
+        line = 0;
+        if (enabled) {
+            startLine(cpu.getCycles());
+            return;
+        }
+
+        // LY stays at 0 and the PPU idles in HBlank until it is turned back on
+        scheduler.cancel(EventType::LineChange);
+        scheduler.cancel(EventType::StatMode);
+        cpu.setIoRegister(LY_REGISTER, 0);
+        ppuMode = PpuMode::HBlank;
+        cpu.setIoRegister(STAT_REGISTER, ioRegister(STAT_REGISTER) & ~0x03);
+    }
+
+    void GameBoy::startFrame()
+    {
+        drawnLine = 0;
+        drawnX = 0;
+        displayChangedBefore = displayChanged;
+        displayChanged = false;
+    }
+
+    void GameBoy::catchUp()
+    {
+        if (!(ioRegister(LCDC_REGISTER) & 0x80))
+            return;
+
+        // Where the PPU is: the pixels of a line are output through the
+        // drawing mode at an even pace
+        const uint8_t targetLine = std::min(line, VISIBLE_LINES);
+        uint8_t targetX = 0;
+
+        if (line < VISIBLE_LINES) {
+            const uint64_t elapsed = cpu.getCycles() + LINE_CYCLES * speedFactor()
+                - scheduler.timestampOf(EventType::LineChange);
+            const uint64_t scan = OAM_SCAN_CYCLES * speedFactor();
+
+            if (elapsed > scan)
+                targetX = static_cast<uint8_t>(std::min<uint64_t>(Ppu::WIDTH,
+                    (elapsed - scan) * Ppu::WIDTH / (DRAWING_CYCLES * speedFactor())));
+        }
+
+        // Nothing written since the start of the previous frame: the
+        // frame already holds these pixels
+        const bool unchanged = !displayChanged && !displayChangedBefore;
+
+        while (drawnLine < targetLine || (drawnLine == targetLine && drawnX < targetX)) {
+            const uint8_t last = drawnLine < targetLine ? Ppu::WIDTH : targetX;
+
+            if (unchanged)
+                ppu.skipLine(drawnLine, drawnX, last);
+            else
+                ppu.renderLine(drawnLine, drawnX, last);
+            drawnX = last == Ppu::WIDTH ? 0 : last;
+            drawnLine += last == Ppu::WIDTH;
+        }
+    }
+
+    void GameBoy::displayWrite()
+    {
+        catchUp();
+        displayChanged = true;
+    }
+
+    template <uint16_t Addr>
+    void GameBoy::writeDisplay(GameBoy& gb, const uint8_t value)
+    {
+        if (gb.ioRegister(Addr) == value)
+            return;
+        gb.displayWrite();
+        gb.cpu.setIoRegister(Addr, value);
+    }
+
+    // Timer
+
+    uint64_t GameBoy::timerTicks(const uint64_t from, const uint64_t to) const
+    {
+        const uint32_t period = TIMER_PERIODS[tac & 0x03];
+
+        return (to - divBase) / period - (from - divBase) / period;
+    }
+
+    bool GameBoy::timerInput(const uint8_t control, const uint64_t now) const
+    {
+        return (control & 0x04) && ((now - divBase) & (TIMER_PERIODS[control & 0x03] / 2));
+    }
+
+    bool GameBoy::reloadPending(const uint64_t now) const
+    {
+        return scheduler.timestampOf(EventType::TimerOverflow) - TIMA_RELOAD_DELAY <= now;
+    }
+
+    void GameBoy::syncTimer(const uint64_t now)
+    {
+        // A reload due by `now` comes first: TIMA counts on from TMA
+        while (scheduler.timestampOf(EventType::TimerOverflow) <= now) {
+            const uint64_t timestamp = scheduler.timestampOf(EventType::TimerOverflow);
+
+            scheduler.cancel(EventType::TimerOverflow);
+            overflowTimer(timestamp);
+        }
+
+        // Up to the overflow itself, after which it stays 0 until the reload
+        if (tac & 0x04)
+            tima = static_cast<uint8_t>(tima + timerTicks(timaSync, now));
+        timaSync = now;
+    }
+
+    void GameBoy::resetDivider(const uint64_t now)
+    {
+        syncTimer(now);
+
+        // The selected divider bit drops to 0 with the rest of the divider
+        const bool edge = timerInput(tac, now);
+
+        divBase = now;
+        if (edge)
+            stepTimer(now);
+        else if (!reloadPending(now))
+            scheduleTimer();
+    }
+
+    void GameBoy::writeTima(const uint8_t value)
+    {
+        const uint64_t now = cpu.getCycles();
+
+        // Written during the reload delay, it cancels the reload and the
+        // interrupt; written as the reload happens, TMA wins
+        syncTimer(now);
+        if (reloadedAt == now)
+            return;
+        tima = value;
+        scheduleTimer();
+    }
+
+    void GameBoy::writeTma(const uint8_t value)
+    {
+        const uint64_t now = cpu.getCycles();
+
+        // Written as the reload happens, the new value is loaded too
+        syncTimer(now);
+        cpu.setIoRegister(TMA_REGISTER, value);
+        if (reloadedAt == now)
+            tima = value;
+    }
+
+    void GameBoy::writeTac(const uint8_t value)
+    {
+        const uint64_t now = cpu.getCycles();
+
+        syncTimer(now);
+
+        // Disabling the timer or selecting a bit at 0 while the old one is
+        // at 1 is a falling edge too
+        const bool edge = timerInput(tac, now) && !timerInput(value, now);
+
+        tac = value;
+        if (edge)
+            stepTimer(now);
+        else if (!reloadPending(now))
+            scheduleTimer();
+    }
+
+    void GameBoy::stepTimer(const uint64_t now)
+    {
+        if (reloadPending(now))
+            return;
+        tima = static_cast<uint8_t>(tima + 1);
+        if (tima != 0) {
+            scheduleTimer();
+            return;
+        }
+        scheduler.cancel(EventType::TimerOverflow);
+        scheduleEvent(EventType::TimerOverflow, now + TIMA_RELOAD_DELAY);
+    }
+
+    void GameBoy::overflowTimer(const uint64_t timestamp)
+    {
+        tima = ioRegister(TMA_REGISTER);
+        timaSync = timestamp;
+        reloadedAt = timestamp;
+        cpu.requestInterrupt(Interrupt::Timer);
+        scheduleTimer();
+    }
+
+    void GameBoy::scheduleTimer()
+    {
+        scheduler.cancel(EventType::TimerOverflow);
+        if (!(tac & 0x04))
+            return;
+
+        // TIMA steps each time the divider crosses a multiple of the
+        // period; the reload follows the step that wraps it
+        const uint32_t period = TIMER_PERIODS[tac & 0x03];
+        const uint64_t elapsed = (timaSync - divBase) / period;
+
+        scheduleEvent(EventType::TimerOverflow,
+            divBase + (elapsed + 0x100 - tima) * period + TIMA_RELOAD_DELAY);
+    }
+
+    // Serial, DMA and APU
+
+    void GameBoy::startSerial(const uint8_t control)
+    {
+        // Only a transfer on the internal clock completes without a link partner
+        if ((control & 0x81) != 0x81) {
+            scheduler.cancel(EventType::SerialTransfer);
+            return;
+        }
+        scheduleEvent(EventType::SerialTransfer,
+            cpu.getCycles() + ((control & 0x02) ? SERIAL_FAST_CYCLES : SERIAL_CYCLES));
+    }
+
+    void GameBoy::finishSerial()
+    {
+        // Nothing is connected, so 0xFF is shifted in
+        cpu.setIoRegister(SB_REGISTER, 0xFF);
+        cpu.setIoRegister(SC_REGISTER, ioRegister(SC_REGISTER) & 0x7F);
+        cpu.requestInterrupt(Interrupt::Serial);
+    }
+
+    void GameBoy::startDma(const uint8_t source)
+    {
+        // Sources past WRAM read its echo
+        const uint16_t base = (source >= 0xE0 ? source - 0x20 : source) << 8;
+
+        cpu.copyMemory(OAM, base, 0xA0);
+        dmaActive = true;
+        scheduleEvent(EventType::DmaEnd, cpu.getCycles() + DMA_CYCLES);
+    }
+
+    void GameBoy::startHdma(const uint8_t control)
+    {
+        // Bit 7 clear while an HBlank transfer runs stops it
+        if (hdmaActive && !(control & 0x80)) {
+            hdmaActive = false;
+            cpu.setIoRegister(HDMA5_REGISTER, 0x80 | (hdmaBlocks - 1));
+            return;
+        }
+
+        hdmaSource = (ioRegister(HDMA1_REGISTER) << 8 | ioRegister(HDMA1_REGISTER + 1)) & 0xFFF0;
+        hdmaDest = 0x8000 | ((ioRegister(HDMA1_REGISTER + 2) << 8 | ioRegister(HDMA1_REGISTER + 3)) & 0x1FF0);
+        hdmaBlocks = (control & 0x7F) + 1;
+        if (control & 0x80) {
+            hdmaActive = true;
+            cpu.setIoRegister(HDMA5_REGISTER, hdmaBlocks - 1);
+            return;
+        }
+
+        // The CPU is held once the instruction that started it is over
+        transferHdma(hdmaBlocks);
+        cpu.endSliceAt(cpu.getCycles());
+    }
+
+    void GameBoy::transferHdma(const uint8_t blocks)
+    {
+        // A transfer reaching the end of VRAM stops there
+        const uint16_t length = std::min<uint32_t>(blocks * HDMA_BLOCK_SIZE, 0xA000 - hdmaDest);
+
+        cpu.copyMemory(hdmaDest, hdmaSource, length);
+        hdmaSource += length;
+        hdmaDest += length;
+        hdmaBlocks = hdmaDest == 0xA000 ? 0 : hdmaBlocks - blocks;
+        dmaStall += length / HDMA_BLOCK_SIZE * HDMA_BLOCK_CYCLES * speedFactor();
+
+        if (hdmaBlocks == 0) {
+            hdmaActive = false;
+            cpu.setIoRegister(HDMA5_REGISTER, 0xFF);
+        } else {
+            cpu.setIoRegister(HDMA5_REGISTER, hdmaBlocks - 1);
+        }
+    }
+
+    void GameBoy::stepApuFrame(const uint64_t timestamp)
+    {
+        apuFrameStep = (apuFrameStep + 1) & 0x07;
+        scheduleEvent(EventType::ApuFrameSequencer, timestamp + APU_FRAME_CYCLES * speedFactor());
+    }
+}
@@ -0,0 +1,334 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: gameboy.hpp
+ * Description: This file contains the declaration of the GameBoy
+ *              class, which owns the emulated components of one
+ *              console and steps them a whole frame at a time.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef GAMEBOY_HPP
+#define GAMEBOY_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include "cpu.hpp"
+#include "frame_colors.hpp"
+#include "mapper.hpp"
+#include "ppu.hpp"
+#include "rom.hpp"
+#include "scheduler.hpp"
+
+namespace emulator
+{
+    enum class PpuMode : uint8_t
+    {
+        HBlank,
+        VBlank,
+        OamScan,
+        Drawing,
+    };
+
+    // The peripherals only do work at scheduled events: the CPU runs
+    // uninterrupted up to the next one, then it is dispatched. Writes to
+    // their registers reschedule them through IoHandler::writeIo().
+    // Register accesses are decoded by one table lookup, see IO_TABLE.
+    // VRAM and OAM writes come through MemoryHandler::write(), to draw the
+    // frame up to them first and reach the PPU's tile cache, and DMA
+    // through MemoryHandler::copyTarget(), to do that once per transfer.
+    class GameBoy : public IoHandler, public MemoryHandler
+    {
+    public:
+        // T-cycles in one frame (154 lines of 456 cycles) at normal speed
+        static constexpr uint32_t FRAME_CYCLES = 70224;
+        static constexpr uint32_t LINE_CYCLES = 456;
+        static constexpr uint32_t OAM_SCAN_CYCLES = 80;
+        static constexpr uint32_t DRAWING_CYCLES = 172;
+        static constexpr uint8_t VISIBLE_LINES = 144;
+        static constexpr uint8_t LINES = 154;
+
+        static constexpr uint32_t SERIAL_CYCLES = 4096;      // 8 bits at 8192 Hz
+        static constexpr uint32_t SERIAL_FAST_CYCLES = 128;  // CGB high speed clock
+        static constexpr uint32_t DMA_CYCLES = 640;          // 160 bytes, 4 T-cycles each
+        static constexpr uint16_t HDMA_BLOCK_SIZE = 16;
+        static constexpr uint32_t HDMA_BLOCK_CYCLES = 32;    // CPU held per block, at normal speed
+        static constexpr uint32_t APU_FRAME_CYCLES = 8192;   // 512 Hz
+        static constexpr uint32_t SPEED_SWITCH_CYCLES = 8200; // CPU stopped by a speed switch
+
+        // CGB banked memory
+        static constexpr std::size_t WRAM_BANK_SIZE = 0x1000;
+        static constexpr std::size_t WRAM_BANKS = 8;
+        static constexpr std::size_t VRAM_BANK_SIZE = 0x2000;
+        static constexpr std::size_t VRAM_BANKS = 2;
+        static constexpr std::size_t PALETTE_SIZE = 64;      // 8 palettes of 4 RGB555 colors
+
+        // Everything the memory map holds besides the cartridge, in one
+        // block: an instance makes one allocation, a snapshot is one copy.
+        // What is touched all the time comes first, in the first KB: the
+        // page of the I/O registers, HRAM and IE, OAM and the palettes.
+        struct alignas(64) SystemMemory
+        {
+            std::array<uint8_t, MemoryBus::PAGE_SIZE> high{};    // 0xFF00-0xFFFF
+            std::array<uint8_t, MemoryBus::PAGE_SIZE> oam{};     // 0xFE00-0xFEFF, 160 bytes used
+            std::array<uint8_t, PALETTE_SIZE> bgPalettes{};      // CGB, through BCPS/BCPD
+            std::array<uint8_t, PALETTE_SIZE> objPalettes{};     // CGB, through OCPS/OCPD
+            std::array<uint8_t, WRAM_BANKS * WRAM_BANK_SIZE> wram{};
+            std::array<uint8_t, VRAM_BANKS * VRAM_BANK_SIZE> vram{};
+        };
+
+        // TIMA increment period for each TAC clock select: TIMA steps when
+        // divider bit log2(period) - 1 falls
+        static constexpr std::array<uint32_t, 4> TIMER_PERIODS = {1024, 16, 64, 256};
+        static constexpr uint32_t TIMA_RELOAD_DELAY = 4;     // TIMA reads 0 this long after an overflow
+
+        GameBoy();
+        ~GameBoy() override = default;
+
+        GameBoy(const GameBoy&) = delete;
+        GameBoy& operator=(const GameBoy&) = delete;
+
+        // Resets the CPU and puts the I/O registers in their post boot ROM state
+        void reset();
+
+        // Loads the cartridge ROM (mapped when possible, see Rom::open), sets
+        // up the bank controller its header names and resets. A battery
+        // backed cartridge keeps its RAM in the .sav file next to the ROM
+        // (see Mapper::attachSave). Returns false, changing nothing, if it
+        // can't be loaded.
+        bool loadRom(const std::filesystem::path& path);
+
+        // How often the save file of the next loadRom() is written back
+        void setSaveInterval(const std::chrono::milliseconds interval) { saveInterval = interval; }
+
+        // Same with an image already loaded. An empty one puts the flat
+        // memory back.
+        void insertRom(Rom image);
+
+        // Runs one frame worth of CPU time (twice as many T-cycles in CGB
+        // double-speed mode), dispatching the events due in between, and
+        // returns the cycles consumed. The overshoot of the last instruction
+        // is taken off the next frame, so frames average out to exactly
+        // FRAME_CYCLES.
+        uint64_t runFrame();
+
+        // The last frame as host pixels, for the frontend to present
+        // between runFrame() calls: each line in the colors its palettes
+        // had when it was drawn
+        void setColorCorrection(const ColorCorrection mode) { converter.setCorrection(mode); }
+        void convertFrame(uint32_t* rgba) const { converter.convert(ppu, rgba); }
+        void convertFrame(uint16_t* rgb565) const { converter.convert(ppu, rgb565); }
+
+        uint8_t readIo(uint16_t addr) override;
+        void writeIo(uint16_t addr, uint8_t value) override;
+
+        // VRAM and OAM: read directly, written through here
+        uint8_t read(uint16_t addr) override;
+        void write(uint16_t addr, uint8_t value) override;
+        uint8_t* copyTarget(uint16_t addr, uint16_t length) override;
+
+        [[nodiscard]] CPU& getCPU() { return cpu; }
+        [[nodiscard]] const CPU& getCPU() const { return cpu; }
+        [[nodiscard]] const Scheduler& getScheduler() const { return scheduler; }
+        [[nodiscard]] const Rom& getRom() const { return rom; }
+        [[nodiscard]] Mapper& getMapper() { return mapper; }
+        [[nodiscard]] const Ppu& getPpu() const { return ppu; }
+
+        [[nodiscard]] bool isDoubleSpeed() const { return doubleSpeed; }
+        [[nodiscard]] uint8_t getWramBank() const { return wramBank; }
+        [[nodiscard]] uint8_t getVramBank() const { return vramBank; }
+        [[nodiscard]] const uint8_t* getVram(const uint8_t bank) const { return memory.vram.data() + bank * VRAM_BANK_SIZE; }
+        [[nodiscard]] const SystemMemory& getMemory() const { return memory; }
+        [[nodiscard]] bool isDmaActive() const { return dmaActive; }
+        [[nodiscard]] bool isHdmaActive() const { return hdmaActive; }
+        [[nodiscard]] PpuMode getPpuMode() const { return ppuMode; }
+        [[nodiscard]] uint8_t getApuFrameStep() const { return apuFrameStep; }
+
+    private:
+        static constexpr uint16_t SB_REGISTER = 0xFF01;
+        static constexpr uint16_t SC_REGISTER = 0xFF02;
+        static constexpr uint16_t DIV_REGISTER = 0xFF04;
+        static constexpr uint16_t TIMA_REGISTER = 0xFF05;
+        static constexpr uint16_t TMA_REGISTER = 0xFF06;
+        static constexpr uint16_t TAC_REGISTER = 0xFF07;
+        static constexpr uint16_t IF_REGISTER = 0xFF0F;
+        static constexpr uint16_t NR52_REGISTER = 0xFF26;
+        static constexpr uint16_t LCDC_REGISTER = 0xFF40;
+        static constexpr uint16_t STAT_REGISTER = 0xFF41;
+        static constexpr uint16_t LY_REGISTER = 0xFF44;
+        static constexpr uint16_t LYC_REGISTER = 0xFF45;
+        static constexpr uint16_t DMA_REGISTER = 0xFF46;
+        static constexpr uint16_t KEY1_REGISTER = 0xFF4D;
+        static constexpr uint16_t HDMA1_REGISTER = 0xFF51;
+        static constexpr uint16_t HDMA5_REGISTER = 0xFF55;
+        static constexpr uint16_t VBK_REGISTER = 0xFF4F;
+        static constexpr uint16_t BCPS_REGISTER = 0xFF68;
+        static constexpr uint16_t OCPS_REGISTER = 0xFF6A;
+        static constexpr uint16_t SVBK_REGISTER = 0xFF70;
+        static constexpr uint16_t OAM = 0xFE00;
+        static constexpr uint16_t VRAM = 0x8000;
+
+        // How one 0xFFxx register behaves: the bits that always read as 1
+        // (unused or write only), the bits software can change, and hooks
+        // for the registers that do more than store their value. A register
+        // without a read hook reads from the bus's storage.
+        struct IoRegister
+        {
+            uint8_t readMask = 0xFF;    // Unmapped registers read 0xFF...
+            uint8_t writeMask = 0x00;   // ...and ignore writes
+            uint8_t (*read)(GameBoy&) = nullptr;
+            void (*write)(GameBoy&, uint8_t) = nullptr;
+        };
+
+        // Indexed by the low address byte, built at compile time
+        static const std::array<IoRegister, 256> IO_TABLE;
+        static constexpr std::array<IoRegister, 256> makeIoTable();
+
+        SystemMemory memory;
+        Ppu ppu{memory.vram.data(), memory.oam.data(), memory.high.data(), memory.bgPalettes.data()};
+        ColorConverter converter;
+        CPU cpu;
+        Scheduler scheduler;
+        Rom rom;
+        Mapper mapper{cpu.getMemoryBus()};
+        std::chrono::milliseconds saveInterval = SaveFile::DEFAULT_INTERVAL;
+
+        // WRAM bank 0 sits at 0xC000, the one SVBK selects (1-7) at 0xD000;
+        // VBK selects the VRAM bank at 0x8000. A switch repoints bus pages.
+        uint8_t wramBank = 1;
+        uint8_t vramBank = 0;
+
+        // Event deadlines are in CPU cycles: a speed switch rescales the
+        // pending ones instead of the CPU checking the speed
+        bool doubleSpeed = false;
+        uint64_t frameEnd = 0;       // Cycle the current frame ends at
+
+        // PPU: the frame is drawn by catch-up, only when something the PPU
+        // reads is written (then up to the pixel reached before the write),
+        // when LY or STAT is read and at VBlank. drawnLine and drawnX are
+        // where it is drawn up to. A frame without any such write since
+        // the start of the previous one is left as it is: it's the same.
+        uint8_t line = 0;
+        PpuMode ppuMode = PpuMode::OamScan;
+        uint8_t drawnLine = 0;
+        uint8_t drawnX = 0;
+        bool displayChanged = true;        // This frame
+        bool displayChangedBefore = true;  // The previous one
+
+        // Timer: nothing runs per instruction. The divider counts T-cycles
+        // since divBase, tima is TIMA as of timaSync; both registers are
+        // computed when read. The only event is the reload after the next
+        // overflow, rescheduled on timer writes.
+        uint64_t divBase = 0;
+        uint64_t timaSync = 0;
+        uint64_t reloadedAt = UINT64_MAX;  // Last TMA reload
+        uint8_t tima = 0;
+        uint8_t tac = 0;
+
+        bool dmaActive = false;
+
+        // CGB VRAM DMA: the next block to copy, the blocks left, and the
+        // cycles the CPU still has to be held for the copies already made
+        uint16_t hdmaSource = 0;
+        uint16_t hdmaDest = 0;
+        uint8_t hdmaBlocks = 0;
+        bool hdmaActive = false;     // HBlank mode, one block per HBlank
+        uint32_t dmaStall = 0;
+        uint8_t apuFrameStep = 0;
+
+        [[nodiscard]] uint32_t speedFactor() const { return doubleSpeed ? 2 : 1; }
+        // Stored register value, as the hardware sees it
+        [[nodiscard]] uint8_t ioRegister(const uint16_t addr) const { return cpu.getIoRegister(addr); }
+
+        void mapWram(uint8_t bank);
+        void mapVram(uint8_t bank);
+
+        // BCPD/OCPD: the byte BCPS/OCPS (`select`) points at, which steps
+        // after a write when its bit 7 is set
+        [[nodiscard]] uint8_t& paletteByte(uint16_t select);
+        void writePalette(uint16_t select, uint8_t value);
+
+        // STOP with KEY1 armed: flips the speed, rescaling what runs off the
+        // fixed clock (PPU, APU, the rest of the frame), and holds the CPU
+        // stopped for SPEED_SWITCH_CYCLES
+        void switchSpeed();
+
+        // Schedules `type` and makes the running CPU slice stop there
+        void scheduleEvent(EventType type, uint64_t timestamp);
+        void dispatchEvents();
+
+        // For a CPU that can't observe the PPU modes (halted, stopped or
+        // spinning in an idle loop that doesn't read STAT): returns the next
+        // cycle something it can see changes, at most the end of the frame,
+        // and moves the PPU there. `seesLines` if it reads LY.
+        uint64_t fastForward(bool seesLines);
+
+        void startLine(uint64_t timestamp);
+        void startFrame();
+
+        // Draws what the PPU has shown up to now, before a write changes
+        // what it reads (see displayWrite()) or a read shows where it is
+        void catchUp();
+        void displayWrite();
+
+        // LCD registers the drawing reads: drawn up to the write, then stored
+        template <uint16_t Addr>
+        static void writeDisplay(GameBoy& gb, uint8_t value);
+        void advanceMode(uint64_t timestamp);
+        void setMode(PpuMode mode);
+        void compareLine();
+        void setLcdEnabled(bool enabled);
+
+        // Start of the next line 144, which raises the VBlank interrupt
+        [[nodiscard]] uint64_t nextVBlank() const;
+
+        // Moves the PPU to where its events would have left it just before
+        // `timestamp`, without raising any interrupt. Only valid while the
+        // STAT interrupts are disabled and up to the next VBlank.
+        void seekPpu(uint64_t timestamp);
+
+        // Brings tima to `now`, doing the reloads due by then
+        void syncTimer(uint64_t now);
+        void resetDivider(uint64_t now);
+        void writeTima(uint8_t value);
+        void writeTma(uint8_t value);
+        void writeTac(uint8_t value);
+        void overflowTimer(uint64_t timestamp);
+        void scheduleTimer();
+
+        // One TIMA step out of schedule: the falling edge a DIV reset or a
+        // TAC write can make
+        void stepTimer(uint64_t now);
+        [[nodiscard]] uint64_t timerTicks(uint64_t from, uint64_t to) const;
+
+        // The signal whose falling edges step TIMA: enabled, and the divider
+        // bit the clock select picks
+        [[nodiscard]] bool timerInput(uint8_t control, uint64_t now) const;
+
+        // Between an overflow and its reload, when TIMA reads 0
+        [[nodiscard]] bool reloadPending(uint64_t now) const;
+
+        void startSerial(uint8_t control);
+        void finishSerial();
+        void startDma(uint8_t source);
+
+        // HDMA5 write: a general purpose transfer copies everything at once,
+        // an HBlank one a block at the start of each HBlank
+        void startHdma(uint8_t control);
+        void transferHdma(uint8_t blocks);
+        void stepApuFrame(uint64_t timestamp);
+    };
+}
+
+#endif // GAMEBOY_HPP
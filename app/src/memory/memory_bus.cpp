@@ -0,0 +1,144 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: memory_bus.cpp
+ * Description: This file contains the page mapping of the memory
+ *              bus.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "memory_bus.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace emulator
+{
+    namespace
+    {
+        constexpr std::array<uint8_t, MemoryBus::PAGE_SIZE> OPEN_BUS = [] {
+            std::array<uint8_t, MemoryBus::PAGE_SIZE> page{};
+            page.fill(0xFF);
+            return page;
+        }();
+    }
+
+    MemoryBus::MemoryBus()
+    {
+        unmap(0, PAGES);
+    }
+
+    MemoryBus::MemoryBus(const MemoryBus& other): flat(other.flat)
+    {
+        rebase(other);
+    }
+
+    MemoryBus& MemoryBus::operator=(const MemoryBus& other)
+    {
+        if (this != &other) {
+            flat = other.flat;
+            rebase(other);
+        }
+        return *this;
+    }
+
+    void MemoryBus::rebase(const MemoryBus& other)
+    {
+        const auto begin = reinterpret_cast<uintptr_t>(other.flat.data());
+        const auto onFlat = [&](const uint8_t* page) {
+            return reinterpret_cast<uintptr_t>(page) - begin < other.flat.size();
+        };
+
+        handlers = other.handlers;
+        banks = other.banks;
+        for (uint32_t page = 0; page < PAGES; ++page) {
+            const uint8_t* read = other.readPages[page];
+            uint8_t* write = other.writePages[page];
+
+            readPages[page] = onFlat(read) ? flat.data() + (read - other.flat.data()) : read;
+            fetchPages[page] = read != nullptr ? readPages[page] : OPEN_BUS.data();
+            writePages[page] = onFlat(write) ? flat.data() + (write - other.flat.data()) : write;
+        }
+    }
+
+    void MemoryBus::copy(uint16_t dest, uint16_t source, uint16_t length)
+    {
+        // A handler taking the whole destination leaves only the source to page through
+        uint8_t* target = nullptr;
+
+        if (writePages[dest >> PAGE_BITS] == nullptr && handlers[dest >> PAGE_BITS] != nullptr)
+            target = handlers[dest >> PAGE_BITS]->copyTarget(dest, length);
+
+        while (length > 0) {
+            // Up to the next page boundary on either side
+            const uint16_t run = std::min<uint32_t>({length, PAGE_SIZE - (dest & PAGE_MASK),
+                                                     PAGE_SIZE - (source & PAGE_MASK)});
+            const uint8_t* from = readPages[source >> PAGE_BITS];
+            uint8_t* to = target;
+
+            if (to == nullptr && writePages[dest >> PAGE_BITS] != nullptr)
+                to = writePages[dest >> PAGE_BITS] + (dest & PAGE_MASK);
+
+            if (from != nullptr && to != nullptr) [[likely]] {
+                std::memcpy(to, from + (source & PAGE_MASK), run);
+            } else if (to != nullptr) {
+                for (uint16_t i = 0; i < run; ++i)
+                    to[i] = read(source + i);
+            } else {
+                for (uint16_t i = 0; i < run; ++i)
+                    write(dest + i, read(source + i));
+            }
+            if (target != nullptr)
+                target += run;
+            dest += run;
+            source += run;
+            length -= run;
+        }
+    }
+
+    void MemoryBus::map(const uint8_t first, const uint32_t count, uint8_t* data, const uint16_t bank)
+    {
+        assert(first + count <= PAGES);
+        remap(first, count, data, bank);
+        for (uint32_t i = 0; i < count; ++i) {
+            writePages[first + i] = data + i * PAGE_SIZE;
+            handlers[first + i] = nullptr;
+        }
+    }
+
+    void MemoryBus::mapReadOnly(const uint8_t first, const uint32_t count, const uint8_t* data,
+        MemoryHandler* handler, const uint16_t bank)
+    {
+        assert(first + count <= PAGES);
+        remap(first, count, data, bank);
+        for (uint32_t i = 0; i < count; ++i) {
+            writePages[first + i] = nullptr;
+            handlers[first + i] = handler;
+        }
+    }
+
+    void MemoryBus::mapHandler(const uint8_t first, const uint32_t count, MemoryHandler* handler)
+    {
+        assert(first + count <= PAGES && handler != nullptr);
+        for (uint32_t i = 0; i < count; ++i) {
+            readPages[first + i] = nullptr;
+            fetchPages[first + i] = OPEN_BUS.data();
+            writePages[first + i] = nullptr;
+            banks[first + i] = 0;
+            handlers[first + i] = handler;
+        }
+    }
+
+    void MemoryBus::unmap(const uint8_t first, const uint32_t count)
+    {
+        map(first, count, flat.data() + first * PAGE_SIZE);
+    }
+}
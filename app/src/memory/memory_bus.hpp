@@ -0,0 +1,167 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: memory_bus.hpp
+ * Description: Page table translating the 16-bit address space to
+ *              host memory. Each 256-byte page either points straight
+ *              at its bytes (ROM, WRAM, HRAM, cartridge RAM) or hands
+ *              the access to a MemoryHandler (mapper registers).
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef MEMORY_BUS_HPP
+#define MEMORY_BUS_HPP
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+namespace emulator
+{
+    // Receives the accesses to the pages it is mapped on that have no
+    // direct pointer for them
+    class MemoryHandler
+    {
+    public:
+        virtual ~MemoryHandler() = default;
+        virtual uint8_t read(uint16_t addr) = 0;
+        virtual void write(uint16_t addr, uint8_t value) = 0;
+
+        // Bulk transfer (MemoryBus::copy()) to the `length` bytes from
+        // `addr`: the host bytes to store them at, about to change, or
+        // nullptr to have them written one by one
+        virtual uint8_t* copyTarget(uint16_t, uint16_t) { return nullptr; }
+    };
+
+    // Reads and writes have their own page table, so a ROM page can be
+    // read directly while its writes reach the mapper. On the common path
+    // an access is one table load, a null check and the byte itself.
+    class MemoryBus
+    {
+    public:
+        static constexpr uint32_t PAGE_BITS = 8;
+        static constexpr uint32_t PAGE_SIZE = 1 << PAGE_BITS;
+        static constexpr uint32_t PAGES = 0x10000 / PAGE_SIZE;
+        static constexpr uint16_t PAGE_MASK = PAGE_SIZE - 1;
+
+        // Banked memory is switched in aligned 4KB units at least
+        static constexpr uint32_t BANK_BITS = 12;
+
+        // Every page starts mapped read-write on the bus's own flat 64KB
+        MemoryBus();
+        ~MemoryBus() = default;
+
+        // Pages on the flat memory of `other` are moved to the copy's own
+        MemoryBus(const MemoryBus& other);
+        MemoryBus& operator=(const MemoryBus& other);
+
+        [[nodiscard]] uint8_t read(const uint16_t addr) const
+        {
+            const uint8_t* page = readPages[addr >> PAGE_BITS];
+
+            if (page != nullptr) [[likely]]
+                return page[addr & PAGE_MASK];
+            return handlers[addr >> PAGE_BITS]->read(addr);
+        }
+
+        // Opcode and operand fetch: no handler check, a page read through a
+        // handler fetches 0xFF (open bus), code never runs from mapper registers
+        [[nodiscard]] uint8_t fetch(const uint16_t addr) const
+        {
+            return fetchPages[addr >> PAGE_BITS][addr & PAGE_MASK];
+        }
+
+        // Little-endian 16-bit fetch, one unaligned load unless it straddles pages
+        [[nodiscard]] uint16_t fetchWord(const uint16_t addr) const
+        {
+            if ((addr & PAGE_MASK) != PAGE_MASK) [[likely]] {
+                uint16_t word;
+
+                std::memcpy(&word, fetchPages[addr >> PAGE_BITS] + (addr & PAGE_MASK), sizeof(word));
+                if constexpr (std::endian::native == std::endian::big)
+                    word = std::byteswap(word);
+                return word;
+            }
+            return fetch(addr) | (fetch(addr + 1) << 8);
+        }
+
+        // Writes to a read-only page without a handler are dropped
+        void write(const uint16_t addr, const uint8_t value)
+        {
+            uint8_t* page = writePages[addr >> PAGE_BITS];
+
+            if (page != nullptr) [[likely]] {
+                page[addr & PAGE_MASK] = value;
+                return;
+            }
+            if (MemoryHandler* handler = handlers[addr >> PAGE_BITS])
+                handler->write(addr, value);
+        }
+
+        // Bulk transfer (DMA): one memcpy per run of bytes both sides map
+        // directly, byte by byte through read() and write() where a page
+        // goes to a handler. A destination on a handler giving a
+        // copyTarget() is written there whole. The ranges must not overlap.
+        void copy(uint16_t dest, uint16_t source, uint16_t length);
+
+        // Maps `count` pages from `first` read-write onto `data`, which
+        // holds count * PAGE_SIZE bytes. `bank` tells apart the contents the
+        // same pages can show (see bank()).
+        void map(uint8_t first, uint32_t count, uint8_t* data, uint16_t bank = 0);
+
+        // Same, but writes go to `handler` (or are dropped without one):
+        // ROM whose writes program the mapper
+        void mapReadOnly(uint8_t first, uint32_t count, const uint8_t* data, MemoryHandler* handler = nullptr,
+            uint16_t bank = 0);
+
+        // Bank switch: points the reads of pages mapped by mapReadOnly() at
+        // other bytes, leaving their writes alone
+        void remap(const uint8_t first, const uint32_t count, const uint8_t* data, const uint16_t bank)
+        {
+            for (uint32_t i = 0; i < count; ++i) {
+                readPages[first + i] = data + i * PAGE_SIZE;
+                fetchPages[first + i] = data + i * PAGE_SIZE;
+                banks[first + i] = bank;
+            }
+        }
+
+        // Sends every read and write of the pages to `handler`
+        void mapHandler(uint8_t first, uint32_t count, MemoryHandler* handler);
+
+        // Puts the pages back on the flat memory
+        void unmap(uint8_t first, uint32_t count);
+
+        // Host bytes of `page`, nullptr if its reads go to a handler
+        [[nodiscard]] const uint8_t* readPage(const uint8_t page) const { return readPages[page]; }
+
+        // True if writes to `page` store to its bytes, false for ROM and handler pages
+        [[nodiscard]] bool isWritable(const uint8_t page) const { return writePages[page] != nullptr; }
+
+        // Bank mapped on `page`: with the address, identifies the bytes
+        // there, so decoded code can be kept across bank switches
+        [[nodiscard]] uint16_t bank(const uint8_t page) const { return banks[page]; }
+
+    private:
+        std::array<const uint8_t*, PAGES> readPages{};
+        std::array<const uint8_t*, PAGES> fetchPages{};  // readPages, or OPEN_BUS for handler pages
+        std::array<uint8_t*, PAGES> writePages{};
+        std::array<MemoryHandler*, PAGES> handlers{};
+        std::array<uint16_t, PAGES> banks{};
+
+        // Backs the pages nothing else is mapped to: the whole space of a
+        // CPU on its own, the cartridge pages of a GameBoy without one
+        std::array<uint8_t, 0x10000> flat{};
+
+        void rebase(const MemoryBus& other);
+    };
+}
+
+#endif // MEMORY_BUS_HPP
@@ -0,0 +1,135 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: frame_colors.cpp
+ * Description: This file contains the implementation of the frame
+ *              color conversion.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "frame_colors.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace emulator
+{
+    void convertColorsPortable(const uint16_t* colors, const std::size_t count, const uint32_t* table, uint32_t* out)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = table[colors[i] & 0x7FFF];
+    }
+
+    void convertColorsPortable(const uint16_t* colors, const std::size_t count, const uint16_t* table, uint16_t* out)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = table[colors[i] & 0x7FFF];
+    }
+
+    void convertColors(const uint16_t* colors, const std::size_t count, const uint32_t* table, uint32_t* out)
+    {
+#if defined(__AVX2__)
+        // 8 colors widened to 32 bits, then one gather of their pixels
+        const __m256i mask = _mm256_set1_epi32(0x7FFF);
+        std::size_t i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+            const __m256i index = _mm256_and_si256(
+                _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i))), mask);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4));
+        }
+        convertColorsPortable(colors + i, count - i, table, out + i);
+#else
+        convertColorsPortable(colors, count, table, out);
+#endif
+    }
+
+    void convertColors(const uint16_t* colors, const std::size_t count, const uint16_t* table, uint16_t* out)
+    {
+#if defined(__AVX2__)
+        // Two gathers of 8 at a 2-byte scale, each reading its entry and the
+        // next, cut to their low half and packed to 16 bits: the pack works
+        // per 128-bit lane, the permute puts the four quarters back in order
+        const __m256i mask = _mm256_set1_epi32(0x7FFF);
+        const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+        const int* base = reinterpret_cast<const int*>(table);
+        std::size_t i = 0;
+
+        for (; i + 16 <= count; i += 16) {
+            const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+            const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i + 8));
+            const __m256i low = _mm256_and_si256(_mm256_cvtepu16_epi32(first), mask);
+            const __m256i high = _mm256_and_si256(_mm256_cvtepu16_epi32(second), mask);
+            const __m256i packed = _mm256_packus_epi32(
+                _mm256_and_si256(_mm256_i32gather_epi32(base, low, 2), low16),
+                _mm256_and_si256(_mm256_i32gather_epi32(base, high, 2), low16));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+        convertColorsPortable(colors + i, count - i, table, out + i);
+#else
+        convertColorsPortable(colors, count, table, out);
+#endif
+    }
+
+    ColorConverter::ColorConverter(const ColorCorrection correction): correction(correction)
+    {
+        build();
+    }
+
+    void ColorConverter::setCorrection(const ColorCorrection mode)
+    {
+        if (mode == correction)
+            return;
+        correction = mode;
+        build();
+    }
+
+    void ColorConverter::build()
+    {
+        for (std::size_t color = 0; color < COLORS; ++color) {
+            const unsigned r = color & 0x1F;
+            const unsigned g = (color >> 5) & 0x1F;
+            const unsigned b = (color >> 10) & 0x1F;
+            uint8_t pixel[4] = {0, 0, 0, 0xFF};
+
+            if (correction == ColorCorrection::Lcd) {
+                // Each channel bleeds into the others and white tops out
+                // at 240, as on the CGB's reflective screen
+                pixel[0] = static_cast<uint8_t>(std::min(960u, r * 26 + g * 4 + b * 2) >> 2);
+                pixel[1] = static_cast<uint8_t>(std::min(960u, g * 24 + b * 8) >> 2);
+                pixel[2] = static_cast<uint8_t>(std::min(960u, r * 6 + g * 4 + b * 22) >> 2);
+            } else {
+                pixel[0] = static_cast<uint8_t>(r << 3 | r >> 2);
+                pixel[1] = static_cast<uint8_t>(g << 3 | g >> 2);
+                pixel[2] = static_cast<uint8_t>(b << 3 | b >> 2);
+            }
+            std::memcpy(&rgba[color], pixel, sizeof(pixel));
+            rgb565[color] = static_cast<uint16_t>((pixel[0] >> 3) << 11 | (pixel[1] >> 2) << 5 | pixel[2] >> 3);
+        }
+        ++tableBuilds;
+    }
+
+    void ColorConverter::convert(const Ppu& ppu, uint32_t* out) const
+    {
+        convertColors(ppu.getColors().data(), PIXELS, rgba.data(), out);
+    }
+
+    void ColorConverter::convert(const Ppu& ppu, uint16_t* out) const
+    {
+        convertColors(ppu.getColors().data(), PIXELS, rgb565.data(), out);
+    }
+}
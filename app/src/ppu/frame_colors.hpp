@@ -0,0 +1,83 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: frame_colors.hpp
+ * Description: Conversion of the PPU frame's BGR555 colors to host
+ *              RGBA8888 or RGB565 pixels, with an optional LCD color
+ *              correction.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef FRAME_COLORS_HPP
+#define FRAME_COLORS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "ppu.hpp"
+
+namespace emulator
+{
+    enum class ColorCorrection : uint8_t
+    {
+        None,   // The 5-bit channels stretched to 8 bits
+        Lcd,    // Mixed and dimmed like the CGB screen shows them
+    };
+
+    // Writes the host pixels of `count` BGR555 colors (bit 15 ignored) to
+    // `out`: a lookup of each in the 32K entries of `table`. Without AVX2,
+    // one color at a time.
+    void convertColorsPortable(const uint16_t* colors, std::size_t count, const uint32_t* table, uint32_t* out);
+    void convertColorsPortable(const uint16_t* colors, std::size_t count, const uint16_t* table, uint16_t* out);
+
+    // Same; the 16-bit table needs an entry past its 32K, which the AVX2
+    // gathers read 32 bits at a time
+    void convertColors(const uint16_t* colors, std::size_t count, const uint32_t* table, uint32_t* out);
+    void convertColors(const uint16_t* colors, std::size_t count, const uint16_t* table, uint16_t* out);
+
+    // Keeps the host pixel of every BGR555 color in two 32K-entry tables,
+    // built again only when the correction changes, and converts the
+    // PPU's colors frame through them
+    class ColorConverter
+    {
+    public:
+        static constexpr std::size_t COLORS = 0x8000;
+        static constexpr std::size_t PIXELS = Ppu::WIDTH * Ppu::HEIGHT;
+
+        explicit ColorConverter(ColorCorrection correction = ColorCorrection::None);
+
+        void setCorrection(ColorCorrection mode);
+        [[nodiscard]] ColorCorrection getCorrection() const { return correction; }
+
+        // A BGR555 color (bit 15 ignored) as RGBA8888, red in the first
+        // byte in memory, or as RGB565
+        [[nodiscard]] uint32_t toRgba(const uint16_t color) const { return rgba[color & 0x7FFF]; }
+        [[nodiscard]] uint16_t toRgb565(const uint16_t color) const { return rgb565[color & 0x7FFF]; }
+
+        // Converts the colors of the PPU's frame, as each line was drawn
+        // with the palettes of its time, to PIXELS pixels
+        void convert(const Ppu& ppu, uint32_t* out) const;
+        void convert(const Ppu& ppu, uint16_t* out) const;
+
+        // Times the tables were built since construction
+        [[nodiscard]] uint64_t getTableBuilds() const { return tableBuilds; }
+
+    private:
+        ColorCorrection correction;
+        uint64_t tableBuilds = 0;
+        std::array<uint32_t, COLORS> rgba{};
+        std::array<uint16_t, COLORS + 1> rgb565{};  // The last one pads the gathers
+
+        void build();
+    };
+}
+
+#endif // FRAME_COLORS_HPP
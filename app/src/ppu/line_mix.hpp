@@ -0,0 +1,114 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: line_mix.hpp
+ * Description: Mixing of a line's object layer over its background
+ *              and window, by masks rather than per pixel branches:
+ *              SSE2 on x86-64, 64-bit SWAR anywhere else.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef LINE_MIX_HPP
+#define LINE_MIX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace emulator
+{
+    namespace mix
+    {
+        constexpr uint64_t BYTES = 0x0101010101010101;
+
+        // An object layer byte: the frame index in bits 0-5, OPAQUE where
+        // an object has a color other than 0 and BEHIND for its
+        // background priority attribute. 0 is transparent.
+        constexpr uint8_t INDEX = 0x3F;
+        constexpr uint8_t OPAQUE = 0x40;
+        constexpr uint8_t BEHIND = 0x80;
+
+        // 8 pixels at once: an opaque object pixel shows unless the
+        // background color (bits 0-1 of `background`) is not 0 and BEHIND
+        // is set in the object byte masked by `objectPriority` or in the
+        // background byte masked by `backgroundPriority`
+        inline uint64_t mixWord(const uint64_t line, const uint64_t background, const uint64_t objects,
+            const uint8_t objectPriority, const uint8_t backgroundPriority)
+        {
+            const uint64_t opaque = (objects >> 6) & BYTES;
+            const uint64_t colored = (background | background >> 1) & BYTES;
+            const uint64_t behind = ((objects & objectPriority * BYTES) | (background & backgroundPriority * BYTES)) >> 7 & BYTES;
+            const uint64_t shown = (opaque & ~(colored & behind)) * 0xFF;
+
+            return (line & ~shown) | (objects & INDEX * BYTES & shown);
+        }
+    }
+
+    // Mixes `count` pixels of the object layer into the line. Without
+    // SIMD, 8 pixels per mix::mixWord().
+    inline void mixObjectsPortable(uint8_t* line, const uint8_t* background, const uint8_t* objects,
+        const std::size_t count, const uint8_t objectPriority, const uint8_t backgroundPriority)
+    {
+        std::size_t i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+            uint64_t pixels, under, over;
+
+            std::memcpy(&pixels, line + i, sizeof(pixels));
+            std::memcpy(&under, background + i, sizeof(under));
+            std::memcpy(&over, objects + i, sizeof(over));
+            pixels = mix::mixWord(pixels, under, over, objectPriority, backgroundPriority);
+            std::memcpy(line + i, &pixels, sizeof(pixels));
+        }
+        for (; i < count; ++i)
+            line[i] = static_cast<uint8_t>(mix::mixWord(line[i], background[i], objects[i], objectPriority, backgroundPriority));
+    }
+
+    inline void mixObjects(uint8_t* line, const uint8_t* background, const uint8_t* objects,
+        const std::size_t count, const uint8_t objectPriority, const uint8_t backgroundPriority)
+    {
+#if defined(__SSE2__)
+        // 16 pixels per register, each condition a byte mask
+        const __m128i opaqueBit = _mm_set1_epi8(static_cast<char>(mix::OPAQUE));
+        const __m128i behindBit = _mm_set1_epi8(static_cast<char>(mix::BEHIND));
+        const __m128i colorBits = _mm_set1_epi8(0x03);
+        const __m128i indexBits = _mm_set1_epi8(mix::INDEX);
+        const __m128i fromObject = _mm_set1_epi8(static_cast<char>(objectPriority));
+        const __m128i fromBackground = _mm_set1_epi8(static_cast<char>(backgroundPriority));
+        const __m128i zero = _mm_setzero_si128();
+        std::size_t i = 0;
+
+        for (; i + 16 <= count; i += 16) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + i));
+            const __m128i under = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i));
+            const __m128i over = _mm_loadu_si128(reinterpret_cast<const __m128i*>(objects + i));
+
+            const __m128i opaque = _mm_cmpeq_epi8(_mm_and_si128(over, opaqueBit), opaqueBit);
+            const __m128i clear = _mm_cmpeq_epi8(_mm_and_si128(under, colorBits), zero);
+            const __m128i priority = _mm_or_si128(_mm_and_si128(over, fromObject), _mm_and_si128(under, fromBackground));
+            const __m128i behind = _mm_cmpeq_epi8(_mm_and_si128(priority, behindBit), behindBit);
+            const __m128i shown = _mm_andnot_si128(_mm_andnot_si128(clear, behind), opaque);
+
+            const __m128i mixed = _mm_or_si128(_mm_andnot_si128(shown, pixels), _mm_and_si128(shown, _mm_and_si128(over, indexBits)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(line + i), mixed);
+        }
+        if (i < count)
+            mixObjectsPortable(line + i, background + i, objects + i, count - i, objectPriority, backgroundPriority);
+#else
+        mixObjectsPortable(line, background, objects, count, objectPriority, backgroundPriority);
+#endif
+    }
+}
+
+#endif // LINE_MIX_HPP
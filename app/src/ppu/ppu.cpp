@@ -0,0 +1,281 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: ppu.cpp
+ * Description: This file contains the implementation of the
+ *              scanline renderer.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "ppu.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "line_mix.hpp"
+#include "tile_decode.hpp"
+
+namespace emulator
+{
+    void Ppu::reset()
+    {
+        frame.fill(0);
+        colors.fill(0);
+        palettesChanged = true;
+        windowLine = 0;
+        windowShown = false;
+        tiles.invalidateAll();
+    }
+
+    void Ppu::renderLine(const uint8_t ly, const uint8_t first, const uint8_t last)
+    {
+        uint8_t* row = frame.data() + ly * WIDTH;
+        const bool whole = first == 0 && last == WIDTH;
+        uint8_t* line = whole ? row : partial.data();
+
+        startPart(ly, first);
+        tiles.update();
+        drawBackground(line, ly);
+        drawWindow(line, ly);
+        drawObjects(line, ly);
+        if (!whole)
+            std::copy(line + first, line + last, row + first);
+        colorLine(ly, line, first, last);
+        if (last == WIDTH)
+            ++renderedLines;
+        endPart(last);
+    }
+
+    void Ppu::skipLine(const uint8_t ly, const uint8_t first, const uint8_t last)
+    {
+        startPart(ly, first);
+        if (windowVisible(ly))
+            windowShown = true;
+        endPart(last);
+    }
+
+    void Ppu::colorLine(const uint8_t ly, const uint8_t* line, const uint8_t first, const uint8_t last)
+    {
+        if (palettesChanged) {
+            palettesChanged = false;
+            for (std::size_t index = 0; index < INDICES; ++index) {
+                // Little-endian colors, twice the index in
+                indexColors[index] = color ? static_cast<uint16_t>(palettes[2 * index] | palettes[2 * index + 1] << 8)
+                    : DMG_SHADES[index & 0x03];
+            }
+        }
+
+        uint16_t* out = colors.data() + ly * WIDTH;
+
+        for (std::size_t x = first; x < last; ++x)
+            out[x] = indexColors[line[x] & 0x3F];
+    }
+
+    void Ppu::startPart(const uint8_t ly, const uint8_t first)
+    {
+        if (ly == 0 && first == 0)
+            windowLine = 0;
+        if (first == 0)
+            objectsSelected = false;
+    }
+
+    void Ppu::endPart(const uint8_t last)
+    {
+        // The window line count steps once per line the window shows on
+        if (last == WIDTH) {
+            windowLine += windowShown;
+            windowShown = false;
+        }
+    }
+
+    std::size_t Ppu::tileIndex(const uint8_t tile) const
+    {
+        // LCDC bit 4: tiles 0-255 from 0x8000, or -128-127 around 0x9000
+        if (io[LCDC] & 0x10)
+            return tile;
+        return 256 + static_cast<int8_t>(tile);
+    }
+
+    void Ppu::fetchTiles(const uint16_t map, const uint8_t y, const uint8_t column)
+    {
+        const std::size_t mapRow = map + (y / 8) * 32;
+        const uint8_t row = y & 0x07;
+
+        for (std::size_t i = 0; i < LINE_TILES; ++i) {
+            const std::size_t entry = mapRow + ((column + i) & 0x1F);
+            const uint8_t attribute = color ? vram[VRAM_BANK_SIZE + entry] : 0;
+            const std::size_t index = tileIndex(vram[entry]) + (attribute & 0x08 ? TileCache::BANK_TILES : 0);
+            const uint8_t bits = static_cast<uint8_t>((attribute & 0x07) << 2 | (attribute & PRIORITY));
+            uint64_t row8;
+
+            std::memcpy(&row8, tiles.row(index, attribute & 0x40 ? 7 - row : row, attribute & 0x20), sizeof(row8));
+            row8 |= bits * tile::BYTES;
+            std::memcpy(pixels.data() + 8 * i, &row8, sizeof(row8));
+        }
+    }
+
+    void Ppu::drawTiles(uint8_t* line, const std::size_t x, const uint8_t* source, const std::size_t count)
+    {
+        if (color) {
+            for (std::size_t i = 0; i < count; ++i) {
+                line[x + i] = source[i] & 0x1F;
+                background[x + i] = source[i] & (PRIORITY | 0x03);
+            }
+            return;
+        }
+
+        const uint8_t bgp = io[BGP];
+        const uint8_t shades[4] = {
+            static_cast<uint8_t>(bgp & 0x03), static_cast<uint8_t>((bgp >> 2) & 0x03),
+            static_cast<uint8_t>((bgp >> 4) & 0x03), static_cast<uint8_t>(bgp >> 6),
+        };
+
+        for (std::size_t i = 0; i < count; ++i) {
+            line[x + i] = shades[source[i]];
+            background[x + i] = source[i];
+        }
+    }
+
+    void Ppu::drawBackground(uint8_t* line, const uint8_t ly)
+    {
+        const uint8_t lcdc = io[LCDC];
+
+        // DMG: LCDC bit 0 clear blanks the background and window. On the
+        // CGB it only takes their priority over the objects away.
+        if (!color && !(lcdc & 0x01)) {
+            std::fill_n(line, WIDTH, 0);
+            background.fill(0);
+            return;
+        }
+
+        const uint8_t scx = io[SCX];
+
+        fetchTiles(lcdc & 0x08 ? 0x1C00 : 0x1800, static_cast<uint8_t>(io[SCY] + ly), scx / 8);
+        drawTiles(line, 0, pixels.data() + (scx & 0x07), WIDTH);
+    }
+
+    bool Ppu::windowVisible(const uint8_t ly) const
+    {
+        const uint8_t lcdc = io[LCDC];
+
+        return (lcdc & 0x20) && (color || (lcdc & 0x01)) && io[WY] <= ly && io[WX] <= WIDTH + 6;
+    }
+
+    void Ppu::drawWindow(uint8_t* line, const uint8_t ly)
+    {
+        const uint8_t lcdc = io[LCDC];
+
+        if (!windowVisible(ly))
+            return;
+
+        // WX is the window's left edge plus 7
+        const int start = io[WX] - 7;
+        const std::size_t x = std::max(start, 0);
+
+        fetchTiles(lcdc & 0x40 ? 0x1C00 : 0x1800, windowLine, 0);
+        drawTiles(line, x, pixels.data() + (static_cast<int>(x) - start), WIDTH - x);
+        windowShown = true;
+    }
+
+    void Ppu::selectObjects(const uint8_t ly, const int height)
+    {
+        selectedCount = 0;
+        objectsSelected = true;
+
+        // The first 10 objects of OAM on the line are drawn
+        for (std::size_t i = 0; i < OAM_OBJECTS && selectedCount < LINE_OBJECTS; ++i) {
+            const int row = ly + 16 - oam[4 * i];
+
+            if (row >= 0 && row < height)
+                selected[selectedCount++] = static_cast<uint8_t>(i);
+        }
+
+        // CGB: the first in OAM is on top. DMG (or OPRI bit 0 set): the
+        // leftmost, then the first in OAM. Insertion sort, stable and
+        // without the allocation of std::stable_sort.
+        if (!color || (io[OPRI] & 0x01)) {
+            for (std::size_t i = 1; i < selectedCount; ++i) {
+                const uint8_t index = selected[i];
+                std::size_t j = i;
+
+                for (; j > 0 && oam[4 * selected[j - 1] + 1] > oam[4 * index + 1]; --j)
+                    selected[j] = selected[j - 1];
+                selected[j] = index;
+            }
+        }
+    }
+
+    void Ppu::drawObjects(uint8_t* line, const uint8_t ly)
+    {
+        const uint8_t lcdc = io[LCDC];
+
+        if (!(lcdc & 0x02))
+            return;
+
+        const int height = lcdc & 0x04 ? 16 : 8;
+
+        if (!objectsSelected)
+            selectObjects(ly, height);
+        if (selectedCount == 0)
+            return;
+
+        // The layer is drawn bottom up, each object over the ones below it
+        // where it has a color: a pixel taken by an object is lost to the
+        // ones below it, even if the background then hides it
+        objects.fill(0);
+        for (std::size_t n = selectedCount; n-- > 0;) {
+            const uint8_t* object = oam + 4 * selected[n];
+            const uint8_t attribute = object[3];
+
+            if (object[1] >= WIDTH + 8)
+                continue;  // Off screen
+
+            // Clamped for an object size changed since the selection
+            const int line16 = std::clamp(ly + 16 - object[0], 0, height - 1);
+            const int row = attribute & 0x40 ? height - 1 - line16 : line16;
+
+            // Objects always take their tiles from 0x8000; an 8x16 one is
+            // the even tile then the odd one
+            const std::size_t index = (height == 16 ? object[2] & 0xFE : object[2]) + row / 8
+                + (color && (attribute & 0x08) ? TileCache::BANK_TILES : 0);
+            const uint8_t* colors = tiles.row(index, row % 8, attribute & 0x20);
+
+            const uint8_t palette = color ? attribute & 0x07 : (attribute >> 4) & 0x01;
+            const uint8_t shades = color ? 0xE4 : io[OBP0 + palette];
+            const uint8_t base = static_cast<uint8_t>(mix::OPAQUE | (attribute & mix::BEHIND) | OBJECT | palette << 2);
+            const uint8_t layer[4] = {
+                0, static_cast<uint8_t>(base | ((shades >> 2) & 0x03)),
+                static_cast<uint8_t>(base | ((shades >> 4) & 0x03)), static_cast<uint8_t>(base | shades >> 6),
+            };
+            uint8_t bytes[8];
+            uint64_t pixels, below;
+
+            for (int i = 0; i < 8; ++i)
+                bytes[i] = layer[colors[i]];
+            std::memcpy(&pixels, bytes, sizeof(pixels));
+
+            // The object's 8 pixels start at x = object[1] - 8, 8 into the layer
+            uint8_t* at = objects.data() + object[1];
+            const uint64_t opaque = ((pixels >> 6) & mix::BYTES) * 0xFF;
+
+            std::memcpy(&below, at, sizeof(below));
+            below = (below & ~opaque) | pixels;
+            std::memcpy(at, &below, sizeof(below));
+        }
+
+        // Background colors 1-3 hide the objects BEHIND them. On the CGB
+        // the tile's PRIORITY also does, and LCDC bit 0 clear lets every
+        // object over the background.
+        const bool master = !color || (lcdc & 0x01);
+
+        mixObjects(line, background.data(), objects.data() + 8, WIDTH,
+            master ? mix::BEHIND : 0, color && master ? PRIORITY : 0);
+    }
+}
@@ -0,0 +1,169 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: ppu.hpp
+ * Description: Scanline renderer: draws one line of background,
+ *              window and objects from VRAM, OAM and the LCD
+ *              registers into the frame, as palette indices and
+ *              as the BGR555 colors they had when drawn.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef PPU_HPP
+#define PPU_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "tile_cache.hpp"
+
+namespace emulator
+{
+    // Reads the console memory in place: it is given both VRAM banks, OAM,
+    // the page of the 0xFFxx registers and the CGB palette memory, and
+    // draws whole lines when told to. Each frame pixel is a palette index:
+    // bits 0-1 the color, bits 2-4 the CGB palette and OBJECT set for the
+    // object palettes, so that twice the index is the byte offset of its
+    // color in the palette memory. In DMG mode the color is already the
+    // BGP/OBP shade. The colors frame holds the same pixels as BGR555,
+    // looked up as each part of a line is drawn, so palettes rewritten
+    // between lines keep their colors. Tiles are read decoded from a
+    // TileCache, which VRAM writes must be reported to, and so must
+    // palette memory writes.
+    class Ppu
+    {
+    public:
+        static constexpr uint8_t WIDTH = 160;
+        static constexpr uint8_t HEIGHT = 144;
+        static constexpr uint8_t OBJECT = 0x20;
+        static constexpr std::size_t VRAM_BANK_SIZE = TileCache::VRAM_BANK_SIZE;
+        static constexpr std::size_t OAM_OBJECTS = 40;
+        static constexpr std::size_t LINE_OBJECTS = 10;     // Drawn per line at most
+        static constexpr std::size_t PALETTE_SIZE = 128;    // Background then object palettes
+        static constexpr std::size_t INDICES = 64;          // Palette indices a pixel can have
+
+        // The DMG shades 0-3 as BGR555, from white to black
+        static constexpr std::array<uint16_t, 4> DMG_SHADES = {0x7FFF, 0x56B5, 0x294A, 0x0000};
+
+        using Frame = std::array<uint8_t, WIDTH * HEIGHT>;
+        using ColorFrame = std::array<uint16_t, WIDTH * HEIGHT>;
+
+        // `palettes` holds the 64 bytes of the background palettes, then
+        // the 64 of the object palettes
+        Ppu(const uint8_t* vram, const uint8_t* oam, const uint8_t* io, const uint8_t* palettes):
+            vram(vram), oam(oam), io(io), palettes(palettes), tiles(vram) {}
+
+        // CGB mode: tile attributes, VRAM bank 1, the CGB palettes and
+        // priorities. Off for DMG cartridges.
+        void setColor(const bool enabled)
+        {
+            color = enabled;
+            palettesChanged = true;
+        }
+        [[nodiscard]] bool isColor() const { return color; }
+
+        // Clears the frame and redecodes every tile
+        void reset();
+
+        // The VRAM byte at `offset` (bank 1 from VRAM_BANK_SIZE) was written
+        void invalidateTile(const std::size_t offset) { tiles.invalidate(offset); }
+        void invalidateTiles(const std::size_t offset, const std::size_t length) { tiles.invalidate(offset, length); }
+
+        // The palette memory was written
+        void invalidatePalettes() { palettesChanged = true; }
+
+        // Draws pixels `first` to `last` (excluded) of line `ly` with the
+        // registers and memory as they are now. A line can be drawn in
+        // several parts, from left to right, for mid-line register writes.
+        void renderLine(uint8_t ly, uint8_t first = 0, uint8_t last = WIDTH);
+
+        // Same when the frame already holds these pixels as they would be
+        // drawn: only counts the window lines
+        void skipLine(uint8_t ly, uint8_t first = 0, uint8_t last = WIDTH);
+
+        [[nodiscard]] const Frame& getFrame() const { return frame; }
+        [[nodiscard]] const uint8_t* getLine(const uint8_t ly) const { return frame.data() + ly * WIDTH; }
+        [[nodiscard]] const ColorFrame& getColors() const { return colors; }
+        [[nodiscard]] const uint16_t* getColorLine(const uint8_t ly) const { return colors.data() + ly * WIDTH; }
+        [[nodiscard]] const TileCache& getTileCache() const { return tiles; }
+
+        // Lines finished by renderLine() since construction
+        [[nodiscard]] uint64_t getRenderedLines() const { return renderedLines; }
+
+    private:
+        static constexpr uint8_t LCDC = 0x40;
+        static constexpr uint8_t SCY = 0x42;
+        static constexpr uint8_t SCX = 0x43;
+        static constexpr uint8_t BGP = 0x47;
+        static constexpr uint8_t OBP0 = 0x48;
+        static constexpr uint8_t WY = 0x4A;
+        static constexpr uint8_t WX = 0x4B;
+        static constexpr uint8_t OPRI = 0x6C;
+
+        static constexpr std::size_t LINE_TILES = WIDTH / 8 + 1;  // A scrolled line spans 21 tiles
+        static constexpr uint8_t PRIORITY = 0x80;                // CGB tile attribute: over the objects
+
+        const uint8_t* vram;
+        const uint8_t* oam;
+        const uint8_t* io;
+        const uint8_t* palettes;
+        bool color = true;
+        bool palettesChanged = true;  // Since indexColors was filled
+        uint8_t windowLine = 0;  // Window lines drawn this frame
+        bool windowShown = false;  // On the line being drawn
+        uint64_t renderedLines = 0;
+        bool objectsSelected = false;  // For the line being drawn
+        std::size_t selectedCount = 0;
+        std::array<uint8_t, LINE_OBJECTS> selected{};  // OAM numbers, the one on top first
+
+        TileCache tiles;
+        Frame frame{};
+        ColorFrame colors{};
+        std::array<uint16_t, INDICES> indexColors{};  // The color of each palette index
+
+        // The line being drawn: the fetched tile rows, and the background
+        // color (0-3) and PRIORITY bit under each pixel, which decide
+        // whether the objects show
+        alignas(16) std::array<uint8_t, 8 * LINE_TILES> pixels{};
+        std::array<uint8_t, WIDTH> background{};
+        std::array<uint8_t, WIDTH> partial{};  // A whole line, for the part of it drawn
+
+        // The objects of the line as mix:: layer bytes, with 8 pixels on
+        // both sides for the objects partly off screen
+        alignas(16) std::array<uint8_t, WIDTH + 16> objects{};
+
+        // Copies the LINE_TILES tile rows of map row `y` (0-255) from
+        // column `column` into pixels, with their CGB palette and PRIORITY bits
+        void fetchTiles(uint16_t map, uint8_t y, uint8_t column);
+
+        // Copies `count` fetched pixels to the line from `source`
+        void drawTiles(uint8_t* line, std::size_t x, const uint8_t* source, std::size_t count);
+        void drawBackground(uint8_t* line, uint8_t ly);
+        void drawWindow(uint8_t* line, uint8_t ly);
+        [[nodiscard]] bool windowVisible(uint8_t ly) const;
+        void drawObjects(uint8_t* line, uint8_t ly);
+
+        // Picks the objects of the line, once per line like the OAM scan
+        void selectObjects(uint8_t ly, int height);
+
+        // Writes the colors of pixels `first` to `last` of the drawn `line`
+        void colorLine(uint8_t ly, const uint8_t* line, uint8_t first, uint8_t last);
+
+        // Line bookkeeping shared by renderLine() and skipLine()
+        void startPart(uint8_t ly, uint8_t first);
+        void endPart(uint8_t last);
+
+        // Cache index of a background or window tile number
+        [[nodiscard]] std::size_t tileIndex(uint8_t tile) const;
+    };
+}
+
+#endif // PPU_HPP
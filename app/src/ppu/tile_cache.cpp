@@ -0,0 +1,55 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: tile_cache.cpp
+ * Description: This file contains the implementation of the decoded
+ *              tile cache.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "tile_cache.hpp"
+
+#include <bit>
+#include <cstring>
+
+#include "tile_decode.hpp"
+
+namespace emulator
+{
+    void TileCache::update()
+    {
+        for (std::size_t word = 0; word < dirty.size(); ++word) {
+            uint64_t bits = dirty[word];
+
+            dirty[word] = 0;
+            for (; bits != 0; bits &= bits - 1)
+                decode(word * 64 + std::countr_zero(bits));
+        }
+    }
+
+    void TileCache::decode(const std::size_t tile)
+    {
+        const uint8_t* planes = vram + tile / BANK_TILES * VRAM_BANK_SIZE + tile % BANK_TILES * TILE_SIZE;
+        Tile& decoded = tiles[tile];
+
+        // The 16 bytes of a tile are its 8 rows of plane pairs
+        decodeTileRows(planes, 8, decoded.plain.data());
+
+        // Reversing the bytes of a row mirrors it
+        for (std::size_t row = 0; row < 8; ++row) {
+            uint64_t pixels;
+
+            std::memcpy(&pixels, decoded.plain.data() + 8 * row, sizeof(pixels));
+            pixels = std::byteswap(pixels);
+            std::memcpy(decoded.mirrored.data() + 8 * row, &pixels, sizeof(pixels));
+        }
+        ++decodedTiles;
+    }
+}
@@ -0,0 +1,92 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: tile_cache.hpp
+ * Description: The tiles of both VRAM banks decoded to 8x8 palette
+ *              indices, plain and mirrored, redecoded only after
+ *              their bytes are written.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace emulator
+{
+    // A VRAM write sets the dirty bit of its tile, update() decodes the
+    // dirty tiles before a line is drawn. Vertically flipped rows are the
+    // same rows read bottom up, so only the horizontal mirror is stored.
+    class TileCache
+    {
+    public:
+        static constexpr std::size_t TILE_SIZE = 16;       // Bytes of a tile in VRAM
+        static constexpr std::size_t BANK_TILES = 384;     // 0x8000-0x97FF
+        static constexpr std::size_t TILES = 2 * BANK_TILES;
+        static constexpr std::size_t VRAM_BANK_SIZE = 0x2000;
+
+        // `vram` holds both banks
+        explicit TileCache(const uint8_t* vram): vram(vram) { invalidateAll(); }
+
+        // The VRAM byte at `offset` (bank 1 from VRAM_BANK_SIZE) was written
+        void invalidate(const std::size_t offset)
+        {
+            const std::size_t inBank = offset % VRAM_BANK_SIZE;
+
+            if (inBank >= BANK_TILES * TILE_SIZE)
+                return;  // Tile maps
+
+            const std::size_t tile = offset / VRAM_BANK_SIZE * BANK_TILES + inBank / TILE_SIZE;
+
+            dirty[tile / 64] |= uint64_t{1} << (tile % 64);
+        }
+
+        // Same for the `length` bytes from `offset`, within one bank
+        void invalidate(const std::size_t offset, const std::size_t length)
+        {
+            for (std::size_t byte = offset - offset % TILE_SIZE; byte < offset + length; byte += TILE_SIZE)
+                invalidate(byte);
+        }
+
+        void invalidateAll() { dirty.fill(~uint64_t{0}); }
+
+        // Decodes the tiles written since the last call
+        void update();
+
+        // Row `row` (0-7) of `tile` (bank 1 tiles follow bank 0's): 8
+        // palette indices, the leftmost first, or the rightmost if `mirrored`
+        [[nodiscard]] const uint8_t* row(const std::size_t tile, const unsigned row, const bool mirrored) const
+        {
+            return (mirrored ? tiles[tile].mirrored : tiles[tile].plain).data() + 8 * row;
+        }
+
+        // Tiles decoded since construction
+        [[nodiscard]] uint64_t getDecodedTiles() const { return decodedTiles; }
+
+    private:
+        struct Tile
+        {
+            std::array<uint8_t, 64> plain;
+            std::array<uint8_t, 64> mirrored;
+        };
+
+        const uint8_t* vram;
+        std::array<uint64_t, TILES / 64> dirty{};
+        alignas(64) std::array<Tile, TILES> tiles{};
+        uint64_t decodedTiles = 0;
+
+        void decode(std::size_t tile);
+    };
+}
+
+#endif // TILE_CACHE_HPP
@@ -0,0 +1,111 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: tile_decode.hpp
+ * Description: Decoding of 2bpp tile rows (two bitplane bytes) to
+ *              8 palette indices at once: SSE2 on x86-64, 64-bit
+ *              SWAR anywhere else.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef TILE_DECODE_HPP
+#define TILE_DECODE_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace emulator
+{
+    namespace tile
+    {
+        constexpr uint64_t BYTES = 0x0101010101010101;
+        constexpr uint64_t PIXEL_BITS = 0x0102040810204080;  // Byte i keeps bit 7 - i
+
+        // One byte per bit of `plane`, 0 or 1, leftmost pixel (bit 7) in the low byte
+        constexpr uint64_t spreadBits(const uint8_t plane)
+        {
+            const uint64_t bits = (plane * BYTES) & PIXEL_BITS;
+
+            return ((bits + 0x7F * BYTES) >> 7) & BYTES;
+        }
+
+        // Reverses the bits of a plane byte, for horizontally flipped tiles
+        constexpr uint8_t flip(uint8_t plane)
+        {
+            plane = static_cast<uint8_t>((plane & 0xF0) >> 4 | (plane & 0x0F) << 4);
+            plane = static_cast<uint8_t>((plane & 0xCC) >> 2 | (plane & 0x33) << 2);
+            return static_cast<uint8_t>((plane & 0xAA) >> 1 | (plane & 0x55) << 1);
+        }
+    }
+
+    // The 8 pixels (0-3) of a tile row as they are laid out in memory:
+    // the leftmost one in the first byte
+    constexpr uint64_t decodeTileRow(const uint8_t low, const uint8_t high)
+    {
+        const uint64_t pixels = tile::spreadBits(low) | tile::spreadBits(high) << 1;
+
+        if constexpr (std::endian::native == std::endian::big)
+            return std::byteswap(pixels);
+        return pixels;
+    }
+
+    // `count` rows, given as low/high plane byte pairs, to 8 * `count`
+    // pixels. Without SIMD, one decodeTileRow() per row.
+    inline void decodeTileRowsPortable(const uint8_t* planes, const std::size_t count, uint8_t* out)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            const uint64_t pixels = decodeTileRow(planes[2 * i], planes[2 * i + 1]);
+
+            std::memcpy(out + 8 * i, &pixels, sizeof(pixels));
+        }
+    }
+
+    inline void decodeTileRows(const uint8_t* planes, const std::size_t count, uint8_t* out)
+    {
+#if defined(__SSE2__)
+        // Two rows per register: each plane byte is broadcast to the 8
+        // bytes of its row, masked down to one bit per byte and turned to
+        // its weight, then the two planes of a row are added up
+        const __m128i mask = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i weights = _mm_set_epi8(2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1);
+        std::size_t i = 0;
+
+        for (; i + 2 <= count; i += 2) {
+            uint32_t packed;
+
+            std::memcpy(&packed, planes + 2 * i, sizeof(packed));
+
+            __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(packed));  // l0 h0 l1 h1
+            bytes = _mm_unpacklo_epi8(bytes, bytes);
+            bytes = _mm_unpacklo_epi16(bytes, bytes);                      // l0 x4, h0 x4, l1 x4, h1 x4
+
+            __m128i first = _mm_unpacklo_epi32(bytes, bytes);              // l0 x8, h0 x8
+            __m128i second = _mm_unpackhi_epi32(bytes, bytes);
+            first = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(first, mask), mask), weights);
+            second = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(second, mask), mask), weights);
+
+            const __m128i pixels = _mm_or_si128(_mm_unpacklo_epi64(first, second), _mm_unpackhi_epi64(first, second));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8 * i), pixels);
+        }
+        if (i < count)
+            decodeTileRowsPortable(planes + 2 * i, count - i, out + 8 * i);
+#else
+        decodeTileRowsPortable(planes, count, out);
+#endif
+    }
+}
+
+#endif // TILE_DECODE_HPP
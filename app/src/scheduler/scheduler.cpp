@@ -0,0 +1,138 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: scheduler.cpp
+ * Description: This file contains the implementation of the event
+ *              scheduler.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#include "scheduler.hpp"
+
+namespace emulator
+{
+    Scheduler::Scheduler()
+    {
+        position.fill(NONE);
+    }
+
+    void Scheduler::schedule(const EventType type, const uint64_t timestamp)
+    {
+        const uint8_t slot = position[index(type)];
+
+        if (slot == NONE) {
+            place(count, {timestamp, type});
+            siftUp(count++);
+            return;
+        }
+
+        const bool earlier = timestamp < heap[slot].timestamp;
+
+        heap[slot].timestamp = timestamp;
+        earlier ? siftUp(slot) : siftDown(slot);
+    }
+
+    void Scheduler::cancel(const EventType type)
+    {
+        const uint8_t slot = position[index(type)];
+
+        if (slot != NONE)
+            remove(slot);
+    }
+
+    void Scheduler::rescale(const EventType type, const uint64_t now, const uint32_t multiplier,
+        const uint32_t divisor)
+    {
+        const uint64_t timestamp = timestampOf(type);
+
+        if (timestamp == NEVER || timestamp <= now)
+            return;
+        schedule(type, now + (timestamp - now) * multiplier / divisor);
+    }
+
+    void Scheduler::clear()
+    {
+        count = 0;
+        position.fill(NONE);
+    }
+
+    uint64_t Scheduler::timestampOf(const EventType type) const
+    {
+        const uint8_t slot = position[index(type)];
+
+        return slot == NONE ? NEVER : heap[slot].timestamp;
+    }
+
+    bool Scheduler::popDue(const uint64_t now, Event& event)
+    {
+        if (count == 0 || heap[0].timestamp > now)
+            return false;
+        event = heap[0];
+        remove(0);
+        return true;
+    }
+
+    void Scheduler::remove(const uint8_t slot)
+    {
+        position[index(heap[slot].type)] = NONE;
+        if (slot == --count)
+            return;
+
+        // The last event fills the hole and moves whichever way it must
+        place(slot, heap[count]);
+        siftUp(slot);
+        siftDown(position[index(heap[slot].type)]);
+    }
+
+    void Scheduler::place(const uint8_t slot, const Event& event)
+    {
+        heap[slot] = event;
+        position[index(event.type)] = slot;
+    }
+
+    void Scheduler::siftUp(uint8_t slot)
+    {
+        const Event event = heap[slot];
+
+        while (slot > 0) {
+            const uint8_t parent = (slot - 1) / 2;
+
+            if (!before(event, heap[parent]))
+                break;
+            place(slot, heap[parent]);
+            slot = parent;
+        }
+        place(slot, event);
+    }
+
+    void Scheduler::siftDown(uint8_t slot)
+    {
+        const Event event = heap[slot];
+
+        for (;;) {
+            const uint8_t left = slot * 2 + 1;
+            const uint8_t right = left + 1;
+            uint8_t smallest = slot;
+            const Event* best = &event;
+
+            if (left < count && before(heap[left], *best)) {
+                smallest = left;
+                best = &heap[left];
+            }
+            if (right < count && before(heap[right], *best))
+                smallest = right;
+            if (smallest == slot)
+                break;
+            place(slot, heap[smallest]);
+            slot = smallest;
+        }
+        place(slot, event);
+    }
+}
@@ -0,0 +1,96 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: scheduler.hpp
+ * Description: Cycle-stamped event queue driving the peripherals.
+ *              The CPU runs until the earliest pending event, which
+ *              is then dispatched, instead of every component being
+ *              ticked after each instruction.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace emulator
+{
+    enum class EventType : uint8_t
+    {
+        LineChange,         // PPU enters the next line (LY)
+        StatMode,           // PPU mode transition inside a visible line
+        TimerOverflow,      // TIMA wraps around
+        SerialTransfer,     // Serial byte shifted out
+        DmaEnd,             // OAM DMA done
+        ApuFrameSequencer,  // 512 Hz APU step
+        SpeedSwitch,        // CGB speed switch done, the CPU leaves STOP
+        Count,
+    };
+
+    struct Event
+    {
+        uint64_t timestamp; // Absolute T-cycle the event is due at
+        EventType type;
+    };
+
+    // Min-heap holding at most one pending event per type. Ties are
+    // broken by type, so dispatch order never depends on insertion order.
+    class Scheduler
+    {
+    public:
+        static constexpr uint64_t NEVER = UINT64_MAX;
+
+        Scheduler();
+        ~Scheduler() = default;
+
+        // Schedules `type` at `timestamp`, replacing its pending occurrence
+        void schedule(EventType type, uint64_t timestamp);
+        void cancel(EventType type);
+
+        // Multiplies the time left before the pending `type`, counted from
+        // `now`, by multiplier / divisor: a clock rate change
+        void rescale(EventType type, uint64_t now, uint32_t multiplier, uint32_t divisor);
+        void clear();
+
+        [[nodiscard]] bool isScheduled(const EventType type) const { return position[index(type)] != NONE; }
+
+        // Timestamp of the pending `type`, NEVER if none
+        [[nodiscard]] uint64_t timestampOf(EventType type) const;
+
+        // Timestamp of the earliest pending event, NEVER if none
+        [[nodiscard]] uint64_t nextTimestamp() const { return count == 0 ? NEVER : heap[0].timestamp; }
+
+        // Removes the earliest event into `event` if it is due at `now`
+        bool popDue(uint64_t now, Event& event);
+
+    private:
+        static constexpr std::size_t CAPACITY = static_cast<std::size_t>(EventType::Count);
+        static constexpr uint8_t NONE = 0xFF;
+
+        static constexpr std::size_t index(const EventType type) { return static_cast<std::size_t>(type); }
+        static bool before(const Event& a, const Event& b)
+        {
+            return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.type < b.type);
+        }
+
+        std::array<Event, CAPACITY> heap{};
+        std::array<uint8_t, CAPACITY> position{}; // Heap slot of each type, NONE if not pending
+        uint8_t count = 0;
+
+        void remove(uint8_t slot);
+        void place(uint8_t slot, const Event& event);
+        void siftUp(uint8_t slot);
+        void siftDown(uint8_t slot);
+    };
+}
+
+#endif // SCHEDULER_HPP
@@ -0,0 +1,50 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench.hpp
+ * Description: Minimal timing helpers shared by the benchmark
+ *              executables. Results are printed, not asserted.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace bench
+{
+    // Keeps `value` alive so the optimizer can't drop the measured work
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Runs `fn` once and returns the elapsed wall time in seconds
+    template <typename Fn>
+    double time(Fn&& fn)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+    // Prints a throughput line: `operations` done in `seconds`, in millions per second
+    inline void report(const char* name, const uint64_t operations, const double seconds, const char* unit = "Mops/s")
+    {
+        std::printf("%-40s %10.2f %s  (%.3f s)\n", name, static_cast<double>(operations) / seconds / 1e6, unit, seconds);
+    }
+}
+
+#endif // BENCH_HPP
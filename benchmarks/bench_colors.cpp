@@ -0,0 +1,114 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_colors.cpp
+ * Description: Cost of converting a whole frame of BGR555 colors
+ *              to RGBA8888 and RGB565 with ColorConverter, against the
+ *              correction computed per pixel, and of building the
+ *              color tables for a correction mode.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "bench.hpp"
+#include "frame_colors.hpp"
+
+namespace
+{
+    constexpr int FRAMES = 20'000;
+    constexpr int BUILDS = 200;
+    constexpr uint64_t PIXELS = static_cast<uint64_t>(FRAMES) * emulator::ColorConverter::PIXELS;
+
+    uint32_t next(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Without the tables: each pixel's color corrected on the spot
+    void convertComputing(const emulator::Ppu& ppu, uint32_t* out)
+    {
+        const emulator::Ppu::ColorFrame& colors = ppu.getColors();
+
+        for (std::size_t i = 0; i < colors.size(); ++i) {
+            const unsigned color = colors[i];
+            const unsigned r = color & 0x1F, g = (color >> 5) & 0x1F, b = (color >> 10) & 0x1F;
+
+            out[i] = (std::min(960u, r * 26 + g * 4 + b * 2) >> 2) | (std::min(960u, g * 24 + b * 8) >> 2) << 8
+                | (std::min(960u, r * 6 + g * 4 + b * 22) >> 2) << 16 | 0xFF000000u;
+        }
+    }
+}
+
+int main()
+{
+    std::array<uint8_t, 2 * emulator::Ppu::VRAM_BANK_SIZE> vram{};
+    std::array<uint8_t, 256> oam{};
+    std::array<uint8_t, 256> io{};
+    std::array<uint8_t, emulator::Ppu::PALETTE_SIZE> palettes{};
+    uint32_t state = 0x12345678;
+
+    // A random picture: random tiles and maps, objects over it
+    for (uint8_t& byte : vram)
+        byte = static_cast<uint8_t>(next(state));
+    for (std::size_t i = 0; i < emulator::Ppu::OAM_OBJECTS * 4; ++i)
+        oam[i] = static_cast<uint8_t>(next(state) % 168);
+    for (uint8_t& byte : palettes)
+        byte = static_cast<uint8_t>(next(state));
+    io[0x40] = 0x93;
+
+    emulator::Ppu ppu{vram.data(), oam.data(), io.data(), palettes.data()};
+    for (uint8_t ly = 0; ly < emulator::Ppu::HEIGHT; ++ly)
+        ppu.renderLine(ly);
+
+    emulator::ColorConverter converter{emulator::ColorCorrection::Lcd};
+    std::vector<uint32_t> rgba(emulator::ColorConverter::PIXELS);
+    std::vector<uint16_t> rgb565(emulator::ColorConverter::PIXELS);
+
+    const double wide = bench::time([&] {
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            converter.convert(ppu, rgba.data());
+            bench::doNotOptimize(rgba);
+        }
+    });
+    bench::report("ColorConverter::convert (RGBA8888)", PIXELS, wide, "Mpixels/s");
+
+    const double narrow = bench::time([&] {
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            converter.convert(ppu, rgb565.data());
+            bench::doNotOptimize(rgb565);
+        }
+    });
+    bench::report("ColorConverter::convert (RGB565)", PIXELS, narrow, "Mpixels/s");
+
+    const double computing = bench::time([&] {
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            convertComputing(ppu, rgba.data());
+            bench::doNotOptimize(rgba);
+        }
+    });
+    bench::report("corrected per pixel", PIXELS, computing, "Mpixels/s");
+
+    const double builds = bench::time([&] {
+        for (int i = 0; i < BUILDS; ++i) {
+            converter.setCorrection(i % 2 ? emulator::ColorCorrection::Lcd : emulator::ColorCorrection::None);
+            bench::doNotOptimize(converter);
+        }
+    });
+    bench::report("table build", BUILDS * emulator::ColorConverter::COLORS, builds, "Mcolors/s");
+
+    std::printf("frame: %.2f us RGBA8888, %.2f us RGB565, %.2f us corrected per pixel; table build %.1f us\n",
+        wide / FRAMES * 1e6, narrow / FRAMES * 1e6, computing / FRAMES * 1e6, builds / BUILDS * 1e6);
+    return 0;
+}
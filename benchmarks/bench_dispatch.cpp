@@ -0,0 +1,94 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_dispatch.cpp
+ * Description: Compares the MIPS of the threaded interpreter loop
+ *              (CPU::run) with the instruction table fallback
+ *              (CPU::runTable) and the block cache replay
+ *              (CPU::runCached) on simple register opcodes, then
+ *              the threaded loop on opcodes with immediate operands.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include "bench.hpp"
+#include "cpu.hpp"
+
+namespace
+{
+    constexpr uint64_t INSTRUCTIONS = 200'000'000;
+
+    // Straight-line register code: PC wraps around the 64KB space forever
+    void loadProgram(emulator::CPU& cpu)
+    {
+        constexpr uint8_t program[] = {
+            0x41, // LD B,C
+            0x80, // ADD A,B
+            0x0C, // INC C
+            0x57, // LD D,A
+            0x91, // SUB A,C
+            0x5A, // LD E,D
+            0xA8, // XOR A,B
+            0x15, // DEC D
+        };
+
+        cpu.reset();
+        for (uint32_t addr = 0; addr < 0x10000; ++addr)
+            cpu.writeMemory(addr, program[addr % sizeof(program)]);
+    }
+
+    // Same with immediate operands, 16 bytes so every instruction stays whole across the wrap
+    void loadOperandProgram(emulator::CPU& cpu)
+    {
+        constexpr uint8_t program[] = {
+            0x01, 0x34, 0x12, // LD BC,0x1234
+            0x3E, 0x56,       // LD A,0x56
+            0xC6, 0x07,       // ADD A,0x07
+            0x21, 0x78, 0x56, // LD HL,0x5678
+            0xFE, 0x42,       // CP 0x42
+            0x11, 0xBC, 0x9A, // LD DE,0x9ABC
+            0x00,             // NOP
+        };
+
+        cpu.reset();
+        for (uint32_t addr = 0; addr < 0x10000; ++addr)
+            cpu.writeMemory(addr, program[addr % sizeof(program)]);
+    }
+}
+
+int main()
+{
+    emulator::CPU cpu;
+
+    loadProgram(cpu);
+    const double table = bench::time([&] { bench::doNotOptimize(cpu.runTable(INSTRUCTIONS)); });
+    bench::report("runTable (function pointer table)", INSTRUCTIONS, table, "MIPS");
+
+    loadProgram(cpu);
+    const double threaded = bench::time([&] { bench::doNotOptimize(cpu.run(INSTRUCTIONS)); });
+    bench::report("run (threaded dispatch)", INSTRUCTIONS, threaded, "MIPS");
+
+    // Replay saves the opcode and operand fetches but pays for walking the
+    // block: expect it to land around run, not above it
+    loadProgram(cpu);
+    const double cached = bench::time([&] { bench::doNotOptimize(cpu.runCached(INSTRUCTIONS)); });
+    bench::report("runCached (predecoded blocks)", INSTRUCTIONS, cached, "MIPS");
+
+    std::printf("speedup: threaded %.2fx, cached %.2fx\n", table / threaded, table / cached);
+
+    loadOperandProgram(cpu);
+    const double operands = bench::time([&] { bench::doNotOptimize(cpu.run(INSTRUCTIONS)); });
+    bench::report("run, immediate operands", INSTRUCTIONS, operands, "MIPS");
+
+    loadOperandProgram(cpu);
+    const double predecoded = bench::time([&] { bench::doNotOptimize(cpu.runCached(INSTRUCTIONS)); });
+    bench::report("runCached, predecoded operands", INSTRUCTIONS, predecoded, "MIPS");
+
+    std::printf("immediate operands: cached %.2fx run\n", operands / predecoded);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_flags.cpp
+ * Description: Compares the ADD/ADC/SUB/SBC/CP flag formulas
+ *              (computeAlu) with the precomputed flag tables
+ *              (lookupAlu) on random operands, to pick the
+ *              GCOLOR_FLAG_TABLES setting for a host.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <vector>
+
+#include "bench.hpp"
+#include "cpu.hpp"
+#include "flags.hpp"
+
+namespace
+{
+    constexpr std::size_t OPERANDS = 1 << 20;
+    constexpr int PASSES = 100;
+    constexpr uint64_t LOOP_INSTRUCTIONS = 200'000'000;
+
+    struct Operation
+    {
+        emulator::FlagOp op;
+        uint8_t rhs;
+        bool useCarry;  // ADC/SBC rather than ADD/SUB
+    };
+
+    // Random mix of ADD, ADC, SUB, SBC and CP, so branches can't be learned
+    std::vector<Operation> makeOperations()
+    {
+        std::vector<Operation> operations(OPERANDS);
+        uint32_t state = 0x12345678;
+
+        for (Operation& operation : operations) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            operation = {(state & 1) ? emulator::FlagOp::Add : emulator::FlagOp::Sub,
+                static_cast<uint8_t>(state >> 8), ((state >> 1) & 1) != 0};
+        }
+        return operations;
+    }
+
+    // A counted loop: DEC B reads the carry it keeps, JR NZ the zero flag
+    void loadCountedLoop(emulator::CPU& cpu)
+    {
+        constexpr uint8_t program[] = {
+            0x05,       // DEC B
+            0x20, 0xFD, // JR NZ,-3
+            0x18, 0xFB, // JR -5
+        };
+
+        cpu.reset();
+        for (uint16_t addr = 0; addr < sizeof(program); ++addr)
+            cpu.writeMemory(addr, program[addr]);
+        cpu.setPC(0x0000);
+    }
+
+    // Chains every operation through A and the carry flag, like a game would
+    template <typename Alu>
+    uint8_t run(const std::vector<Operation>& operations, Alu&& alu)
+    {
+        uint8_t a = 0;
+        uint8_t flags = 0;
+
+        for (int pass = 0; pass < PASSES; ++pass) {
+            for (const Operation& operation : operations) {
+                const uint8_t carry = operation.useCarry && (flags & CARRY_FLAG_MASK);
+                const emulator::AluResult result = alu(operation.op, a, operation.rhs, carry);
+
+                a = result.result;
+                flags = result.flags;
+            }
+        }
+        return a ^ flags;
+    }
+}
+
+int main()
+{
+    const std::vector<Operation> operations = makeOperations();
+    const uint64_t count = OPERANDS * PASSES;
+
+    const double formulas = bench::time([&] {
+        bench::doNotOptimize(run(operations, [](auto... args) { return emulator::computeAlu(args...); }));
+    });
+    bench::report("computeAlu (formulas)", count, formulas, "Mops/s");
+
+    const double tables = bench::time([&] {
+        bench::doNotOptimize(run(operations, [](auto... args) { return emulator::lookupAlu(args...); }));
+    });
+    bench::report("lookupAlu (GCOLOR_FLAG_TABLES)", count, tables, "Mops/s");
+
+    std::printf("speedup: tables %.2fx\n", formulas / tables);
+
+    // bench_flags_lazy runs this on the GCOLOR_LAZY_FLAGS CPU
+    emulator::CPU cpu;
+
+    loadCountedLoop(cpu);
+    const double loop = bench::time([&] { bench::doNotOptimize(cpu.run(LOOP_INSTRUCTIONS)); });
+#if defined(GCOLOR_LAZY_FLAGS)
+    bench::report("DEC B; JR NZ loop (lazy flags)", LOOP_INSTRUCTIONS, loop, "MIPS");
+#else
+    bench::report("DEC B; JR NZ loop (eager flags)", LOOP_INSTRUCTIONS, loop, "MIPS");
+#endif
+    return 0;
+}
@@ -0,0 +1,102 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_halt.cpp
+ * Description: Headless frame rate of an idle game waiting for
+ *              VBlank: polling LY, polling a flag its VBlank handler
+ *              sets (both spinning in idle loops) and with HALT.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <initializer_list>
+
+#include "bench.hpp"
+#include "gameboy.hpp"
+
+namespace
+{
+    constexpr uint64_t FRAMES = 20'000;
+
+    // The VBlank handler sets the flag at 0xC000
+    void loadProgram(emulator::GameBoy& gameboy, const std::initializer_list<uint8_t> program)
+    {
+        constexpr uint8_t handler[] = {
+            0x3E, 0x01,        // LD A,1
+            0xEA, 0x00, 0xC0,  // LD (0xC000),A
+            0xD9,              // RETI
+        };
+        emulator::CPU& cpu = gameboy.getCPU();
+        uint16_t addr = 0x0100;
+
+        gameboy.reset();
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        for (uint16_t i = 0; i < sizeof(handler); ++i)
+            cpu.writeMemory(0x0040 + i, handler[i]);
+        cpu.writeMemory(0xFF0F, 0x00);
+        cpu.writeMemory(0xFFFF, 0x01);  // IE = VBlank
+    }
+
+    double skippedPercent(const uint64_t skipped)
+    {
+        return 100.0 * static_cast<double>(skipped) / static_cast<double>(FRAMES * emulator::GameBoy::FRAME_CYCLES);
+    }
+
+    double runFrames(emulator::GameBoy& gameboy)
+    {
+        return bench::time([&] {
+            for (uint64_t frame = 0; frame < FRAMES; ++frame)
+                bench::doNotOptimize(gameboy.runFrame());
+        });
+    }
+}
+
+int main()
+{
+    emulator::GameBoy gameboy;
+
+    loadProgram(gameboy, {
+        0xF0, 0x44,  // LDH A,(LY)   <- loop
+        0xFE, 0x90,  // CP 144
+        0x20, 0xFA,  // JR NZ,loop
+        0x18, 0xF8,  // JR loop
+    });
+    const double polling = runFrames(gameboy);
+    bench::report("GameBoy::runFrame (polling LY)", FRAMES, polling, "Mframes/s");
+    std::printf("idle loop: %.1f%% of the cycles skipped\n",
+        skippedPercent(gameboy.getCPU().getIdleLoopStats().skippedCycles));
+
+    loadProgram(gameboy, {
+        0xFB,              // EI
+        0xFA, 0x00, 0xC0,  // LD A,(0xC000)  <- loop
+        0xA7,              // AND A
+        0x28, 0xFA,        // JR Z,loop
+        0xAF,              // XOR A
+        0xEA, 0x00, 0xC0,  // LD (0xC000),A
+        0x18, 0xF4,        // JR loop
+    });
+    const uint64_t skippedBefore = gameboy.getCPU().getIdleLoopStats().skippedCycles;
+    const double flag = runFrames(gameboy);
+    bench::report("GameBoy::runFrame (polling a flag)", FRAMES, flag, "Mframes/s");
+    std::printf("idle loop: %.1f%% of the cycles skipped\n",
+        skippedPercent(gameboy.getCPU().getIdleLoopStats().skippedCycles - skippedBefore));
+
+    loadProgram(gameboy, {
+        0xFB,        // EI
+        0x76,        // HALT         <- loop
+        0x18, 0xFD,  // JR loop
+    });
+    const double halted = runFrames(gameboy);
+    bench::report("GameBoy::runFrame (HALT until VBlank)", FRAMES, halted, "Mframes/s");
+    std::printf("HALT: %.1f%% of the cycles skipped\n",
+        skippedPercent(gameboy.getCPU().getHaltStats().skippedCycles));
+
+    std::printf("speedup: flag %.2fx, HALT %.2fx\n", polling / flag, polling / halted);
+    return 0;
+}
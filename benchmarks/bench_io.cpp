@@ -0,0 +1,57 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_io.cpp
+ * Description: Cost of LDH-heavy code: a loop reading and writing
+ *              I/O registers through the register table, against
+ *              the same loop on HRAM, which stays plain memory.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include "bench.hpp"
+#include "gameboy.hpp"
+
+namespace
+{
+    constexpr uint64_t FRAMES = 2'000;
+    constexpr uint64_t LOOP_CYCLES = 12 * 4 + 4 + 12;  // 4 LDH, INC A, JR
+    constexpr uint64_t ACCESSES = FRAMES * emulator::GameBoy::FRAME_CYCLES / LOOP_CYCLES * 4;
+
+    // LDH A,(a);  INC A;  LDH (a),A;  LDH A,(b);  LDH (c),A;  JR loop
+    double run(emulator::GameBoy& gameboy, const uint8_t a, const uint8_t b, const uint8_t c)
+    {
+        const uint8_t program[] = {0xF0, a, 0x3C, 0xE0, a, 0xF0, b, 0xE0, c, 0x18, 0xF5};
+        emulator::CPU& cpu = gameboy.getCPU();
+
+        gameboy.reset();
+        for (uint16_t i = 0; i < sizeof(program); ++i)
+            cpu.writeMemory(0x0100 + i, program[i]);
+        return bench::time([&] {
+            for (uint64_t frame = 0; frame < FRAMES; ++frame)
+                bench::doNotOptimize(gameboy.runFrame());
+        });
+    }
+}
+
+int main()
+{
+    emulator::GameBoy gameboy;
+
+    const double io = run(gameboy, 0x43, 0x42, 0x47);  // SCX, SCY, BGP
+    bench::report("LDH on I/O registers", ACCESSES, io, "Maccesses/s");
+
+    const double hooked = run(gameboy, 0x43, 0x41, 0x45);  // SCX, STAT, LYC (compare hook)
+    bench::report("LDH on I/O registers (masked, hooked)", ACCESSES, hooked, "Maccesses/s");
+
+    const double hram = run(gameboy, 0x80, 0x81, 0x82);
+    bench::report("LDH on HRAM", ACCESSES, hram, "Maccesses/s");
+
+    std::printf("I/O register overhead: %.2fx, hooked %.2fx\n", io / hram, hooked / hram);
+    return 0;
+}
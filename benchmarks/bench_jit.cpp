@@ -0,0 +1,72 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_jit.cpp
+ * Description: Compares the T-cycle throughput of the threaded
+ *              interpreter (CPU::runFor) with the x86-64 recompiler
+ *              (jit::Recompiler::runFor) on a register loop.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include "bench.hpp"
+#include "cpu.hpp"
+#include "recompiler.hpp"
+
+namespace
+{
+    constexpr uint32_t FRAME_CYCLES = 70224;
+    constexpr uint64_t FRAMES = 20'000;
+
+    // Register arithmetic in a counted loop, as found in decompression routines
+    void loadProgram(emulator::CPU& cpu)
+    {
+        constexpr uint8_t program[] = {
+            0x06, 0x00,  // LD B,0x00
+            0x41,        // LD B,C      <- loop
+            0x80,        // ADD A,B
+            0x0C,        // INC C
+            0x57,        // LD D,A
+            0x91,        // SUB A,C
+            0x5A,        // LD E,D
+            0xA8,        // XOR A,B
+            0x15,        // DEC D
+            0x05,        // DEC B
+            0x20, 0xF5,  // JR NZ,loop
+            0x18, 0xF3,  // JR loop
+        };
+
+        cpu.reset();
+        for (uint16_t addr = 0; addr < sizeof(program); ++addr)
+            cpu.writeMemory(0x0100 + addr, program[addr]);
+    }
+}
+
+int main()
+{
+    emulator::CPU cpu;
+    const uint64_t cycles = FRAMES * FRAME_CYCLES;
+
+    loadProgram(cpu);
+    const double interpreter = bench::time([&] {
+        for (uint64_t frame = 0; frame < FRAMES; ++frame)
+            bench::doNotOptimize(cpu.runFor(FRAME_CYCLES));
+    });
+    bench::report("CPU::runFor (threaded interpreter)", cycles, interpreter, "MHz");
+
+    loadProgram(cpu);
+    emulator::jit::Recompiler jit(cpu);
+    const double recompiled = bench::time([&] {
+        for (uint64_t frame = 0; frame < FRAMES; ++frame)
+            bench::doNotOptimize(jit.runFor(FRAME_CYCLES));
+    });
+    bench::report("Recompiler::runFor (x86-64)", cycles, recompiled, "MHz");
+
+    std::printf("speedup: %.2fx\n", interpreter / recompiled);
+    return 0;
+}
@@ -0,0 +1,110 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_mapper.cpp
+ * Description: Cost of an MBC5 bank switch followed by a read from
+ *              the switched bank, against the same reads without the
+ *              switch, for a 2MB ROM. A switch repoints 64 bus pages
+ *              and copies nothing, so it must cost the same whatever
+ *              the bank size.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench.hpp"
+#include "mapper.hpp"
+
+namespace
+{
+    constexpr int SWITCHES = 20'000'000;
+    constexpr std::size_t BANKS = 128;
+}
+
+int main()
+{
+    std::vector<uint8_t> image(BANKS * emulator::Rom::BANK_SIZE);
+
+    for (std::size_t i = 0; i < image.size(); ++i)
+        image[i] = static_cast<uint8_t>(i * 7 + i / emulator::Rom::BANK_SIZE);
+    image[emulator::CartridgeHeader::TYPE] = 0x19;  // MBC5
+
+    emulator::Rom rom;
+    emulator::MemoryBus bus;
+    emulator::Mapper mapper(bus);
+
+    rom.assign(image.data(), image.size());
+    mapper.load(rom);
+
+    const double reads = bench::time([&] {
+        uint32_t sum = 0;
+
+        for (int i = 0; i < SWITCHES; ++i)
+            sum += bus.read(0x4000 + (i * 97 & 0x3FFF));
+        bench::doNotOptimize(sum);
+    });
+    bench::report("read, no switch", SWITCHES, reads);
+
+    // Banks 1..127 in turn, reading a different offset each time
+    const double switched = bench::time([&] {
+        uint32_t sum = 0;
+
+        for (int i = 0; i < SWITCHES; ++i) {
+            bus.write(0x2000, 1 + i % (BANKS - 1));
+            sum += bus.read(0x4000 + (i * 97 & 0x3FFF));
+        }
+        bench::doNotOptimize(sum);
+    });
+    bench::report("switch + read", SWITCHES, switched);
+
+    const double same = bench::time([&] {
+        uint32_t sum = 0;
+
+        for (int i = 0; i < SWITCHES; ++i) {
+            bus.write(0x2000, 5);
+            sum += bus.read(0x4000 + (i * 97 & 0x3FFF));
+        }
+        bench::doNotOptimize(sum);
+    });
+    bench::report("switch to the current bank + read", SWITCHES, same);
+
+    std::printf("per switch: %.1f ns (current bank: %.1f ns)\n",
+        (switched - reads) / SWITCHES * 1e9, (same - reads) / SWITCHES * 1e9);
+
+    // Battery RAM written all the time, in memory then saved to a file
+    const auto writeRam = [&] {
+        return bench::time([&] {
+            for (int i = 0; i < SWITCHES; ++i)
+                bus.write(0xA000 + (i * 97 & 0x1FFF), static_cast<uint8_t>(i));
+        });
+    };
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / ("gcolor_bench_" + std::to_string(getpid()) + ".sav");
+
+    image[emulator::CartridgeHeader::TYPE] = 0x1B;  // MBC5, RAM, battery
+    image[emulator::CartridgeHeader::RAM_SIZE] = 0x03;
+    rom.assign(image.data(), image.size());
+    mapper.load(rom);
+    bus.write(0x0000, 0x0A);
+    const double memory = writeRam();
+    bench::report("RAM write", SWITCHES, memory);
+
+    mapper.attachSave(path);
+    const double saved = writeRam();
+    bench::report("RAM write, save file attached", SWITCHES, saved);
+    std::printf("msync calls: %llu, tracking: %.1f ns per write\n",
+        static_cast<unsigned long long>(mapper.getSave().getSyncCount()), (saved - memory) / SWITCHES * 1e9);
+    mapper.unload();
+    std::filesystem::remove(path);
+    return 0;
+}
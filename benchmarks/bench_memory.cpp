@@ -0,0 +1,182 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_memory.cpp
+ * Description: Per-access cost of the memory bus page table against
+ *              a flat 64KB array, on random addresses laid out like a
+ *              game's accesses (ROM, WRAM, HRAM), and through a
+ *              handler page.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <array>
+#include <vector>
+
+#include "bench.hpp"
+#include "memory_bus.hpp"
+
+namespace
+{
+    constexpr std::size_t ADDRESSES = 1 << 20;
+    constexpr int PASSES = 100;
+
+    // Register-like handler: reads return the last byte written
+    class LatchHandler : public emulator::MemoryHandler
+    {
+    public:
+        uint8_t read(uint16_t) override { return latch; }
+        void write(uint16_t, const uint8_t value) override { latch = value; }
+
+    private:
+        uint8_t latch = 0;
+    };
+
+    // VRAM-like: read directly, written through the handler, which can
+    // take bulk transfers whole (copyTarget()) or one byte at a time
+    class VramHandler : public emulator::MemoryHandler
+    {
+    public:
+        std::array<uint8_t, 0x2000> vram{};
+        bool bulk = true;
+        uint64_t stores = 0;
+
+        uint8_t read(const uint16_t addr) override { return vram[addr & 0x1FFF]; }
+        void write(const uint16_t addr, const uint8_t value) override
+        {
+            if (vram[addr & 0x1FFF] != value) {
+                ++stores;
+                vram[addr & 0x1FFF] = value;
+            }
+        }
+        uint8_t* copyTarget(const uint16_t addr, const uint16_t) override
+        {
+            if (!bulk)
+                return nullptr;
+            ++stores;
+            return vram.data() + (addr & 0x1FFF);
+        }
+    };
+
+    // Half ROM, a third WRAM, the rest HRAM
+    std::vector<uint16_t> makeAddresses(const uint16_t handlerPage)
+    {
+        std::vector<uint16_t> addresses(ADDRESSES);
+        uint32_t state = 0x12345678;
+
+        for (uint16_t& addr : addresses) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            switch (state % 6) {
+                case 0: case 1: case 2: addr = state >> 17; break;                        // ROM
+                case 3: case 4: addr = 0xC000 | ((state >> 8) & 0x1FFF); break;            // WRAM
+                default: addr = 0xFF80 | ((state >> 8) & 0x7F); break;                    // HRAM
+            }
+            if (handlerPage != 0 && (state >> 28) == 0)
+                addr = handlerPage | ((state >> 8) & 0xFF);                               // 1/16
+        }
+        return addresses;
+    }
+
+    // Reads at every address and writes the running sum back to WRAM, HRAM or the handler
+    template <typename Read, typename Write>
+    uint8_t run(const std::vector<uint16_t>& addresses, Read&& read, Write&& write)
+    {
+        uint8_t sum = 0;
+
+        for (int pass = 0; pass < PASSES; ++pass) {
+            for (const uint16_t addr : addresses) {
+                sum += read(addr);
+                if (addr >= 0x8000)
+                    write(addr, sum);
+            }
+        }
+        return sum;
+    }
+}
+
+int main()
+{
+    const std::vector<uint16_t> addresses = makeAddresses(0);
+    const uint64_t count = ADDRESSES * PASSES;
+    static std::array<uint8_t, 0x10000> flat{};
+    static std::array<uint8_t, 0x8000> rom{};
+    static emulator::MemoryBus bus;
+
+    bus.mapReadOnly(0x00, 0x80, rom.data());
+
+    const double array = bench::time([&] {
+        bench::doNotOptimize(run(addresses,
+            [&](const uint16_t addr) { return flat[addr]; },
+            [&](const uint16_t addr, const uint8_t value) { flat[addr] = value; }));
+    });
+    bench::report("flat array", count, array, "Maccesses/s");
+
+    const double direct = bench::time([&] {
+        bench::doNotOptimize(run(addresses,
+            [&](const uint16_t addr) { return bus.read(addr); },
+            [&](const uint16_t addr, const uint8_t value) { bus.write(addr, value); }));
+    });
+    bench::report("MemoryBus (direct pages)", count, direct, "Maccesses/s");
+
+    LatchHandler handler;
+    const std::vector<uint16_t> mixed = makeAddresses(0xA000);
+
+    bus.mapHandler(0xA0, 1, &handler);
+    const double handled = bench::time([&] {
+        bench::doNotOptimize(run(mixed,
+            [&](const uint16_t addr) { return bus.read(addr); },
+            [&](const uint16_t addr, const uint8_t value) { bus.write(addr, value); }));
+    });
+    bench::report("MemoryBus (1/16 on a handler)", count, handled, "Maccesses/s");
+
+    std::printf("cost: direct pages %.2fx, with handler %.2fx the flat array\n", direct / array, handled / array);
+
+    // OAM DMA sized transfers, WRAM to OAM: bulk copy against a byte loop
+    constexpr uint64_t TRANSFERS = 1'000'000;
+    const double bulk = bench::time([&] {
+        for (uint64_t i = 0; i < TRANSFERS; ++i) {
+            bus.copy(0xFE00, 0xC000 + (i & 0x0F), 0xA0);
+            bench::doNotOptimize(bus.read(0xFE00));
+        }
+    });
+    bench::report("MemoryBus::copy (160 bytes)", TRANSFERS * 0xA0, bulk, "MB/s");
+
+    const double bytewise = bench::time([&] {
+        for (uint64_t i = 0; i < TRANSFERS; ++i) {
+            for (uint16_t j = 0; j < 0xA0; ++j)
+                bus.write(0xFE00 + j, bus.read(0xC000 + (i & 0x0F) + j));
+            bench::doNotOptimize(bus.read(0xFE00));
+        }
+    });
+    bench::report("read/write loop (160 bytes)", TRANSFERS * 0xA0, bytewise, "MB/s");
+    std::printf("copy speedup: %.1fx\n", bytewise / bulk);
+
+    // General purpose VRAM DMA sized transfers, WRAM to a handler's pages
+    constexpr uint64_t GDMAS = 100'000;
+    constexpr uint16_t GDMA_LENGTH = 0x800;
+    VramHandler vram;
+    const auto transfer = [&] {
+        for (uint64_t i = 0; i < GDMAS; ++i) {
+            bus.copy(0x8000 + (i & 0x0F) * 0x10, 0xC000 + (i & 0xFF), GDMA_LENGTH);
+            bench::doNotOptimize(bus.read(0x8000));
+        }
+    };
+
+    bus.mapReadOnly(0x80, 0x20, vram.vram.data(), &vram);
+    const double target = bench::time(transfer);
+    bench::report("MemoryBus::copy to a copyTarget (2KB)", GDMAS * GDMA_LENGTH, target, "MB/s");
+
+    vram.bulk = false;
+    const double handlerBytes = bench::time(transfer);
+    bench::report("MemoryBus::copy through write() (2KB)", GDMAS * GDMA_LENGTH, handlerBytes, "MB/s");
+    std::printf("copyTarget speedup: %.1fx\n", handlerBytes / target);
+    bench::doNotOptimize(vram.stores);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_ppu.cpp
+ * Description: Per-scanline cost of the renderer on random tiles,
+ *              maps and objects, in DMG and CGB mode, with the tile
+ *              cache warm and with every tile rewritten each frame,
+ *              then of the tile row decoding and the object mixing
+ *              alone: SIMD, SWAR and a pixel at a time.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <array>
+#include <vector>
+
+#include "bench.hpp"
+#include "line_mix.hpp"
+#include "ppu.hpp"
+#include "tile_decode.hpp"
+
+namespace
+{
+    constexpr int FRAMES = 20'000;
+    constexpr uint64_t LINES = static_cast<uint64_t>(FRAMES) * emulator::Ppu::HEIGHT;
+    constexpr std::size_t LINE_TILES = 21;
+    constexpr int DECODES = 2'000'000;
+    constexpr int MIXES = 2'000'000;
+
+    uint32_t next(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // What the renderer did before: one pixel per shift of both planes
+    void decodeShifting(const uint8_t* planes, const std::size_t count, uint8_t* out)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            for (int bit = 7; bit >= 0; --bit)
+                *out++ = ((planes[2 * i] >> bit) & 1) | ((planes[2 * i + 1] >> bit) & 1) << 1;
+    }
+
+    // What the renderer did before: a branch per condition of each pixel
+    void mixBranching(uint8_t* line, const uint8_t* background, const uint8_t* objects,
+        const std::size_t count, const uint8_t objectPriority, const uint8_t backgroundPriority)
+    {
+        for (std::size_t x = 0; x < count; ++x) {
+            if (!(objects[x] & emulator::mix::OPAQUE))
+                continue;
+            if ((background[x] & 0x03) && ((objects[x] & objectPriority) || (background[x] & backgroundPriority)))
+                continue;
+            line[x] = objects[x] & emulator::mix::INDEX;
+        }
+    }
+
+    template <typename Mix>
+    double mix(const std::vector<uint8_t>& layers, Mix&& fn)
+    {
+        std::array<uint8_t, emulator::Ppu::WIDTH> line{};
+        const std::size_t lines = layers.size() / (2 * emulator::Ppu::WIDTH);
+
+        return bench::time([&] {
+            for (int i = 0; i < MIXES; ++i) {
+                const uint8_t* background = layers.data() + (i % lines) * 2 * emulator::Ppu::WIDTH;
+
+                fn(line.data(), background, background + emulator::Ppu::WIDTH, line.size(), 0x80, 0x80);
+                bench::doNotOptimize(line);
+            }
+        });
+    }
+
+    template <typename Decode>
+    double decode(const std::vector<uint8_t>& planes, Decode&& fn)
+    {
+        alignas(16) std::array<uint8_t, 8 * LINE_TILES> pixels{};
+        const std::size_t lines = planes.size() / (2 * LINE_TILES);
+
+        return bench::time([&] {
+            for (int i = 0; i < DECODES; ++i) {
+                fn(planes.data() + (i % lines) * 2 * LINE_TILES, LINE_TILES, pixels.data());
+                bench::doNotOptimize(pixels);
+            }
+        });
+    }
+}
+
+int main()
+{
+    std::array<uint8_t, 2 * emulator::Ppu::VRAM_BANK_SIZE> vram{};
+    std::array<uint8_t, 256> oam{};
+    std::array<uint8_t, 256> io{};
+    std::array<uint8_t, emulator::Ppu::PALETTE_SIZE> palettes{};
+    uint32_t state = 0x12345678;
+
+    for (uint8_t& byte : vram)
+        byte = static_cast<uint8_t>(next(state));
+    for (std::size_t i = 0; i < emulator::Ppu::OAM_OBJECTS * 4; ++i)
+        oam[i] = static_cast<uint8_t>(next(state) % 168);
+    io[0x40] = 0xE3;  // Background, window, objects, window map at 0x9C00
+    io[0x43] = 5;     // SCX
+    io[0x4A] = 72;    // WY: the window on the bottom half
+    io[0x4B] = 87;
+    io[0x47] = 0xE4;
+
+    emulator::Ppu ppu{vram.data(), oam.data(), io.data(), palettes.data()};
+
+    const auto render = [&](const char* name, const bool color, const bool rewrite) {
+        ppu.setColor(color);
+        const double seconds = bench::time([&] {
+            for (int frame = 0; frame < FRAMES; ++frame) {
+                io[0x42] = static_cast<uint8_t>(frame);  // SCY
+                if (rewrite) {
+                    for (std::size_t offset = 0; offset < vram.size(); offset += emulator::TileCache::TILE_SIZE)
+                        ppu.invalidateTile(offset);
+                }
+                for (uint8_t ly = 0; ly < emulator::Ppu::HEIGHT; ++ly)
+                    ppu.renderLine(ly);
+                bench::doNotOptimize(ppu.getFrame());
+            }
+        });
+
+        bench::report(name, LINES, seconds, "Mlines/s");
+        return seconds;
+    };
+
+    render("Ppu::renderLine (DMG)", false, false);
+    const double warm = render("Ppu::renderLine (CGB)", true, false);
+    const double rewritten = render("Ppu::renderLine (CGB, tiles rewritten)", true, true);
+    std::printf("per line: %.1f ns with the tile cache warm, %.1f ns with every tile redecoded each frame\n",
+        warm / LINES * 1e9, rewritten / LINES * 1e9);
+
+    // The 21 tile rows of a line, from random planes
+    std::vector<uint8_t> planes(2 * LINE_TILES * 1024);
+    for (uint8_t& byte : planes)
+        byte = static_cast<uint8_t>(next(state));
+
+    const double simd = decode(planes, emulator::decodeTileRows);
+    bench::report("decodeTileRows (SIMD)", DECODES * LINE_TILES, simd, "Mrows/s");
+    const double swar = decode(planes, emulator::decodeTileRowsPortable);
+    bench::report("decodeTileRowsPortable (SWAR)", DECODES * LINE_TILES, swar, "Mrows/s");
+    const double shifting = decode(planes, decodeShifting);
+    bench::report("pixel at a time", DECODES * LINE_TILES, shifting, "Mrows/s");
+
+    std::printf("line decode: %.1f ns, %.1fx faster than a pixel at a time (SWAR %.1fx)\n",
+        simd / DECODES * 1e9, shifting / simd, shifting / swar);
+
+    // Background and object layer bytes of 1024 lines, a third of the
+    // object pixels opaque
+    std::vector<uint8_t> layers(2 * emulator::Ppu::WIDTH * 1024);
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        const uint32_t random = next(state);
+
+        layers[i] = (i / emulator::Ppu::WIDTH) % 2 == 0 ? random & 0x83
+            : static_cast<uint8_t>(random % 3 == 0 ? (random >> 8) | emulator::mix::OPAQUE : 0);
+    }
+
+    const double mixed = mix(layers, emulator::mixObjects);
+    bench::report("mixObjects (SIMD)", MIXES, mixed, "Mlines/s");
+    const double mixedSwar = mix(layers, emulator::mixObjectsPortable);
+    bench::report("mixObjectsPortable (SWAR)", MIXES, mixedSwar, "Mlines/s");
+    const double branching = mix(layers, mixBranching);
+    bench::report("branch per pixel", MIXES, branching, "Mlines/s");
+
+    std::printf("line mix: %.1f ns, %.1fx faster than a branch per pixel (SWAR %.1fx)\n",
+        mixed / MIXES * 1e9, branching / mixed, branching / mixedSwar);
+    return 0;
+}
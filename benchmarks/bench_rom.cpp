@@ -0,0 +1,74 @@
+/* ================================================================
+ * Project: Gameboy Color Emulator
+ * File: bench_rom.cpp
+ * Description: Time to load an 8MB ROM mapped (Rom::open) against
+ *              copied into memory (Rom::read), and to then read one
+ *              byte of every bank, as a game's first frames would.
+ *
+ * Author: Guillaume MICHEL
+ * Created on: September 24, 2024
+ *
+ * License: MIT License
+ *
+ * Copyright (c) 2024 Guillaume MICHEL
+ * ================================================================
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench.hpp"
+#include "rom.hpp"
+
+namespace
+{
+    constexpr int LOADS = 200;
+
+    uint8_t touchBanks(const emulator::Rom& rom)
+    {
+        uint8_t sum = 0;
+
+        for (std::size_t bank = 0; bank < rom.banks(); ++bank)
+            sum += rom.bank(bank)[0x100];
+        return sum;
+    }
+
+    template <typename Load>
+    double run(Load&& load)
+    {
+        return bench::time([&] {
+            for (int i = 0; i < LOADS; ++i) {
+                emulator::Rom rom;
+
+                load(rom);
+                bench::doNotOptimize(touchBanks(rom));
+            }
+        });
+    }
+}
+
+int main()
+{
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / ("gcolor_bench_" + std::to_string(getpid()) + ".gbc");
+    {
+        const std::vector<char> image(emulator::Rom::MAX_SIZE, 0x5A);
+        std::ofstream file(path, std::ios::binary);
+
+        file.write(image.data(), static_cast<std::streamsize>(image.size()));
+    }
+
+    const double mapped = run([&](emulator::Rom& rom) { rom.open(path); });
+    bench::report("Rom::open (mmap, 8MB)", LOADS * emulator::Rom::MAX_SIZE, mapped, "MB/s");
+
+    const double buffered = run([&](emulator::Rom& rom) { rom.read(path); });
+    bench::report("Rom::read (buffered, 8MB)", LOADS * emulator::Rom::MAX_SIZE, buffered, "MB/s");
+
+    std::printf("per load: mapped %.1f us, buffered %.1f us (%.0fx)\n",
+        mapped / LOADS * 1e6, buffered / LOADS * 1e6, buffered / mapped);
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include <array>
+#include "cpu.hpp"
+
+class CPUBlockCacheTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+};
+
+// Test that replaying cached blocks matches the threaded loop
+TEST_F(CPUBlockCacheTest, RUNCACHED_MatchesRun) {
+    loadProgram({0x3C, 0x47, 0x80, 0x05, 0x90, 0xA8, 0x3D, 0x3E, 0x42, 0x80});
+
+    emulator::CPU reference = cpu;
+    EXPECT_EQ(cpu.runCached(9), 9u);
+    EXPECT_EQ(reference.run(9), 9u);
+
+    EXPECT_EQ(cpu.getA(), reference.getA());
+    EXPECT_EQ(cpu.getB(), reference.getB());
+    EXPECT_EQ(cpu.getFlags(), reference.getFlags());
+    EXPECT_EQ(cpu.getPC(), reference.getPC());
+}
+
+// Test that a block replayed a second time gives the same result
+TEST_F(CPUBlockCacheTest, RUNCACHED_ReplaysBlock) {
+    loadProgram({0x3C, 0x3C, 0x47});  // INC A, INC A, LD B,A
+    cpu.setA(0x00);
+
+    EXPECT_EQ(cpu.runCached(3), 3u);
+    cpu.setPC(0x0100);
+    EXPECT_EQ(cpu.runCached(3), 3u);
+
+    EXPECT_EQ(cpu.getA(), 0x04);
+    EXPECT_EQ(cpu.getB(), 0x04);
+    EXPECT_EQ(cpu.getPC(), 0x0103);
+}
+
+// Test that a write inside the running block is seen by the next instruction
+TEST_F(CPUBlockCacheTest, RUNCACHED_SelfModifyingCode) {
+    loadProgram({
+        0x21, 0x07, 0x01,  // LD HL,0x0107
+        0x3E, 0x3C,        // LD A,0x3C (INC A opcode)
+        0x77,              // LD (HL),A
+        0x00,              // NOP
+        0x3D,              // DEC A, overwritten with INC A
+    });
+
+    EXPECT_EQ(cpu.runCached(5), 5u);
+    EXPECT_EQ(cpu.getA(), 0x3D);
+    EXPECT_EQ(cpu.readMemory(0x0107), 0x3C);
+}
+
+// Test that code patched between two runs invalidates the cached block
+TEST_F(CPUBlockCacheTest, RUNCACHED_InvalidatedByWrite) {
+    loadProgram({0x3C, 0x3C});  // INC A, INC A
+    cpu.setA(0x10);
+    EXPECT_EQ(cpu.runCached(2), 2u);
+
+    cpu.writeMemory(0x0101, 0x3D);  // INC A -> DEC A
+    cpu.setPC(0x0100);
+    EXPECT_EQ(cpu.runCached(2), 2u);
+
+    EXPECT_EQ(cpu.getA(), 0x12);
+}
+
+// Test that replay stops on an illegal opcode with PC pointing at it
+TEST_F(CPUBlockCacheTest, RUNCACHED_StopsOnIllegalOpcode) {
+    loadProgram({0x3C, 0x3C, 0xD3});  // INC A, INC A, illegal
+
+    EXPECT_EQ(cpu.runCached(10), 3u);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Locked);
+    EXPECT_EQ(cpu.getPC(), 0x0102);
+}
+
+// Test that replaying immediates predecoded into the block matches the threaded loop, and that
+// patching an operand is seen
+TEST_F(CPUBlockCacheTest, RUNCACHED_PredecodedOperands) {
+    loadProgram({
+        0x01, 0x34, 0x12,  // LD BC,0x1234
+        0x3E, 0x80,        // LD A,0x80
+        0xC6, 0x81,        // ADD A,0x81
+        0xCB, 0x37,        // SWAP A
+        0xE0, 0x90,        // LDH (0x90),A
+        0xEA, 0x00, 0xC0,  // LD (0xC000),A
+        0x18, 0x02,        // JR +2
+        0x00, 0x00,
+        0xCD, 0x00, 0x02,  // CALL 0x0200
+    });
+    cpu.writeMemory(0x0200, 0x06);  // LD B,0x55
+    cpu.writeMemory(0x0201, 0x55);
+
+    emulator::CPU reference = cpu;
+    EXPECT_EQ(cpu.runCached(9), 9u);
+    EXPECT_EQ(reference.run(9), 9u);
+    EXPECT_EQ(cpu.getAF(), reference.getAF());
+    EXPECT_EQ(cpu.getBC(), reference.getBC());
+    EXPECT_EQ(cpu.getSP(), reference.getSP());
+    EXPECT_EQ(cpu.getPC(), reference.getPC());
+    EXPECT_EQ(cpu.readMemory(0xFF90), reference.readMemory(0xFF90));
+    EXPECT_EQ(cpu.readMemory(0xC000), reference.readMemory(0xC000));
+    EXPECT_EQ(cpu.getB(), 0x55);
+
+    cpu.writeMemory(0x0104, 0x42);  // LD A,0x42
+    cpu.setPC(0x0100);
+    EXPECT_EQ(cpu.runCached(2), 2u);
+    EXPECT_EQ(cpu.getA(), 0x42);
+}
+
+// Test that an instruction running into the next bank region reads the operand of the bank mapped there
+TEST_F(CPUBlockCacheTest, RUNCACHED_OperandInNextBank) {
+    std::array<uint8_t, 0x1000> first{};
+    std::array<uint8_t, 0x1000> second{};
+    first[0] = 0x12;
+    second[0] = 0x56;
+    loadProgram({0x01, 0x34}, 0x3FFE);  // LD BC,0x??34
+    cpu.getMemoryBus().mapReadOnly(0x40, 0x10, first.data(), nullptr, 1);
+
+    EXPECT_EQ(cpu.runCached(1), 1u);
+    EXPECT_EQ(cpu.getBC(), 0x1234);
+
+    cpu.getMemoryBus().remap(0x40, 0x10, second.data(), 2);
+    cpu.setPC(0x3FFE);
+    EXPECT_EQ(cpu.runCached(1), 1u);
+    EXPECT_EQ(cpu.getBC(), 0x5634);
+    EXPECT_EQ(cpu.getPC(), 0x4001);
+}
+
+// Test that a block on a handler page is decoded as it runs: from open bus, not the handler's reads
+TEST_F(CPUBlockCacheTest, RUNCACHED_HandlerPageFetchesOpenBus) {
+    class IncHandler : public emulator::MemoryHandler {
+    public:
+        uint8_t read(uint16_t) override { return 0x3C; }  // INC A
+        void write(uint16_t, uint8_t) override {}
+    } handler;
+
+    cpu.getMemoryBus().mapHandler(0xA0, 1, &handler);
+    cpu.setPC(0xA000);
+    cpu.setSP(0xFFFE);
+
+    emulator::CPU reference = cpu;
+    EXPECT_EQ(cpu.runCached(1), 1u);
+    EXPECT_EQ(reference.run(1), 1u);
+    EXPECT_EQ(cpu.getA(), reference.getA());
+    EXPECT_EQ(cpu.getPC(), reference.getPC());
+    EXPECT_EQ(cpu.getPC(), 0x0038);  // RST 38
+}
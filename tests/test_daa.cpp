@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPUDaaTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+};
+
+// Test that DAA fixes up a BCD addition
+TEST_F(CPUDaaTest, DAA_AfterAdd) {
+    cpu.setA(0x19);
+    cpu.setB(0x28);
+    cpu.execute(0x80);  // ADD A,B: 0x41 with half carry
+    cpu.execute(0x27);  // DAA
+
+    EXPECT_EQ(cpu.getA(), 0x47);                  // 19 + 28 = 47
+    EXPECT_FALSE(cpu.getCarryFlag());
+    EXPECT_FALSE(cpu.getHalfCarryFlag());
+}
+
+// Test that DAA sets carry when the BCD sum overflows
+TEST_F(CPUDaaTest, DAA_AfterAddCarry) {
+    cpu.setA(0x99);
+    cpu.setB(0x01);
+    cpu.execute(0x80);  // ADD A,B
+    cpu.execute(0x27);  // DAA
+
+    EXPECT_EQ(cpu.getA(), 0x00);                  // 99 + 1 = 100
+    EXPECT_TRUE(cpu.getCarryFlag());
+    EXPECT_TRUE(cpu.getZeroFlag());
+}
+
+// Test that DAA fixes up a BCD subtraction
+TEST_F(CPUDaaTest, DAA_AfterSub) {
+    cpu.setA(0x42);
+    cpu.setB(0x15);
+    cpu.execute(0x90);  // SUB A,B
+    cpu.execute(0x27);  // DAA
+
+    EXPECT_EQ(cpu.getA(), 0x27);                  // 42 - 15 = 27
+    EXPECT_TRUE(cpu.getSubtractFlag());
+}
+
+// Test for CPL, SCF and CCF
+TEST_F(CPUDaaTest, CPL_SCF_CCF) {
+    cpu.setA(0x0F);
+    cpu.clearFlags();
+    cpu.execute(0x2F);  // CPL
+    EXPECT_EQ(cpu.getA(), 0xF0);
+    EXPECT_EQ(cpu.getFlags(), SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK);
+
+    cpu.execute(0x37);  // SCF
+    EXPECT_EQ(cpu.getFlags(), CARRY_FLAG_MASK);
+
+    cpu.setZeroFlag(true);
+    cpu.execute(0x3F);  // CCF
+    EXPECT_EQ(cpu.getFlags(), ZERO_FLAG_MASK);
+}
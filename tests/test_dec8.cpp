@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPUDecTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+};
+
+// Test for decrement that sets the half-carry flag (borrow from bit 4)
+TEST_F(CPUDecTest, DEC8_A_HalfCarryFlag) {
+    cpu.setA(0x10);
+    cpu.clearFlags();
+    cpu.execute(0x3D);  // DEC A
+
+    EXPECT_EQ(cpu.getA(), 0x0F);              // A should be 0x0F
+    EXPECT_TRUE(cpu.getHalfCarryFlag());      // Half-carry flag should be set
+    EXPECT_FALSE(cpu.getZeroFlag());          // Zero flag should NOT be set
+    EXPECT_TRUE(cpu.getSubtractFlag());       // Subtract flag should be set
+}
+
+// Test for decrement that reaches zero
+TEST_F(CPUDecTest, DEC8_A_ZeroFlag) {
+    cpu.setA(0x01);
+    cpu.clearFlags();
+    cpu.execute(0x3D);  // DEC A
+
+    EXPECT_EQ(cpu.getA(), 0x00);              // A should be 0x00
+    EXPECT_TRUE(cpu.getZeroFlag());           // Zero flag should be set
+    EXPECT_FALSE(cpu.getHalfCarryFlag());     // Half-carry flag should NOT be set
+    EXPECT_TRUE(cpu.getSubtractFlag());       // Subtract flag should be set
+}
+
+// Test for decrement that wraps around from 0x00 to 0xFF
+TEST_F(CPUDecTest, DEC8_B_Wraps) {
+    cpu.setB(0x00);
+    cpu.clearFlags();
+    cpu.execute(0x05);  // DEC B
+
+    EXPECT_EQ(cpu.getB(), 0xFF);              // B should wrap to 0xFF
+    EXPECT_TRUE(cpu.getHalfCarryFlag());      // Half-carry flag should be set
+    EXPECT_FALSE(cpu.getCarryFlag());         // Carry flag is not affected by DEC
+}
+
+// Test that the carry flag is preserved, set or clear
+TEST_F(CPUDecTest, DEC8_C_PreservesCarryFlag) {
+    cpu.setC(0x05);
+    cpu.setCarryFlag(true);
+    cpu.execute(0x0D);  // DEC C
+
+    EXPECT_EQ(cpu.getC(), 0x04);
+    EXPECT_TRUE(cpu.getCarryFlag());          // Carry flag should be preserved
+
+    cpu.setCarryFlag(false);
+    cpu.execute(0x0D);  // DEC C
+
+    EXPECT_EQ(cpu.getC(), 0x03);
+    EXPECT_FALSE(cpu.getCarryFlag());         // Carry flag should stay clear
+}
+
+// Test for decrement of the byte at (HL)
+TEST_F(CPUDecTest, DEC_MemHL) {
+    cpu.setHL(0xC000);
+    cpu.writeMemory(0xC000, 0x20);
+    cpu.clearFlags();
+    cpu.execute(0x35);  // DEC (HL)
+
+    EXPECT_EQ(cpu.readMemory(0xC000), 0x1F);  // Memory should be 0x1F
+    EXPECT_TRUE(cpu.getHalfCarryFlag());      // Half-carry flag should be set
+    EXPECT_TRUE(cpu.getSubtractFlag());       // Subtract flag should be set
+}
+
+// Test for 16-bit decrement, flags are not affected
+TEST_F(CPUDecTest, DEC16_BC_NoFlags) {
+    cpu.setBC(0x0000);
+    cpu.clearFlags();
+    cpu.execute(0x0B);  // DEC BC
+
+    EXPECT_EQ(cpu.getBC(), 0xFFFF);           // BC should wrap to 0xFFFF
+    EXPECT_EQ(cpu.getFlags(), 0);             // No flags should be set
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+// Exhaustive flag checks against reference formulas. The suite also runs
+// in runTestsLazyFlags, which proves the lazy path matches bit for bit.
+class CPUFlagsTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void load(const uint8_t a, const uint8_t b, const bool carry) {
+        cpu.setA(a);
+        cpu.setB(b);
+        cpu.setCarryFlag(carry);
+    }
+
+    static uint8_t addFlags(const int a, const int b, const int carry) {
+        const int result = a + b + carry;
+        return (((result & 0xFF) == 0) ? ZERO_FLAG_MASK : 0) |
+            (((a & 0xF) + (b & 0xF) + carry > 0xF) ? HALF_CARRY_FLAG_MASK : 0) |
+            ((result > 0xFF) ? CARRY_FLAG_MASK : 0);
+    }
+
+    static uint8_t subFlags(const int a, const int b, const int carry) {
+        const int result = a - b - carry;
+        return SUBTRACT_FLAG_MASK |
+            (((result & 0xFF) == 0) ? ZERO_FLAG_MASK : 0) |
+            (((a & 0xF) - (b & 0xF) - carry < 0) ? HALF_CARRY_FLAG_MASK : 0) |
+            ((result < 0) ? CARRY_FLAG_MASK : 0);
+    }
+};
+
+// Test ADD A,B and ADC A,B for every operand pair and carry in
+TEST_F(CPUFlagsTest, ADD_ADC_AllOperands) {
+    for (int a = 0; a < 0x100; ++a) {
+        for (int b = 0; b < 0x100; ++b) {
+            for (int carry = 0; carry < 2; ++carry) {
+                load(a, b, carry);
+                cpu.execute(0x80);
+                ASSERT_EQ(cpu.getA(), (a + b) & 0xFF);
+                ASSERT_EQ(cpu.getFlags(), addFlags(a, b, 0)) << a << " + " << b;
+
+                load(a, b, carry);
+                cpu.execute(0x88);
+                ASSERT_EQ(cpu.getA(), (a + b + carry) & 0xFF);
+                ASSERT_EQ(cpu.getFlags(), addFlags(a, b, carry)) << a << " + " << b << " + " << carry;
+            }
+        }
+    }
+}
+
+// Test SUB A,B, SBC A,B and CP A,B for every operand pair and carry in
+TEST_F(CPUFlagsTest, SUB_SBC_CP_AllOperands) {
+    for (int a = 0; a < 0x100; ++a) {
+        for (int b = 0; b < 0x100; ++b) {
+            for (int carry = 0; carry < 2; ++carry) {
+                load(a, b, carry);
+                cpu.execute(0x90);
+                ASSERT_EQ(cpu.getA(), (a - b) & 0xFF);
+                ASSERT_EQ(cpu.getFlags(), subFlags(a, b, 0)) << a << " - " << b;
+
+                load(a, b, carry);
+                cpu.execute(0x98);
+                ASSERT_EQ(cpu.getA(), (a - b - carry) & 0xFF);
+                ASSERT_EQ(cpu.getFlags(), subFlags(a, b, carry)) << a << " - " << b << " - " << carry;
+
+                load(a, b, carry);
+                cpu.execute(0xB8);
+                ASSERT_EQ(cpu.getA(), a);
+                ASSERT_EQ(cpu.getFlags(), subFlags(a, b, 0)) << "cp " << a << ", " << b;
+            }
+        }
+    }
+}
+
+// Test INC B and DEC B for every value, carry must be preserved
+TEST_F(CPUFlagsTest, INC_DEC_AllValues) {
+    for (int b = 0; b < 0x100; ++b) {
+        for (int carry = 0; carry < 2; ++carry) {
+            const uint8_t carryFlag = carry ? CARRY_FLAG_MASK : 0;
+
+            load(0, b, carry);
+            cpu.execute(0x04);
+            ASSERT_EQ(cpu.getB(), (b + 1) & 0xFF);
+            ASSERT_EQ(cpu.getFlags(), carryFlag | (addFlags(b, 1, 0) & ~CARRY_FLAG_MASK)) << "inc " << b;
+
+            load(0, b, carry);
+            cpu.execute(0x05);
+            ASSERT_EQ(cpu.getB(), (b - 1) & 0xFF);
+            ASSERT_EQ(cpu.getFlags(), carryFlag | (subFlags(b, 1, 0) & ~CARRY_FLAG_MASK)) << "dec " << b;
+        }
+    }
+}
+
+// Test that Z and C computed alone match the packed flags of every operation
+TEST_F(CPUFlagsTest, ZeroCarryAlone) {
+    using emulator::FlagOp;
+    for (const FlagOp op : {FlagOp::Add, FlagOp::Sub, FlagOp::Inc, FlagOp::Dec}) {
+        for (int lhs = 0; lhs < 0x100; ++lhs) {
+            for (int rhs = 0; rhs < 0x100; ++rhs) {
+                for (uint8_t carry = 0; carry < 2; ++carry) {
+                    const uint8_t flags = emulator::computeFlags(op, lhs, rhs, carry);
+                    ASSERT_EQ(emulator::computeZero(op, lhs, rhs, carry), (flags & ZERO_FLAG_MASK) != 0);
+                    ASSERT_EQ(emulator::computeCarry(op, lhs, rhs, carry), (flags & CARRY_FLAG_MASK) != 0);
+                }
+            }
+        }
+    }
+}
+
+// Test that DEC B; JR NZ reads Z and INC/DEC the carry of a pending operation
+TEST_F(CPUFlagsTest, ConditionsOnPendingOperations) {
+    cpu.setA(0xFF);
+    cpu.setB(0x01);
+    cpu.execute(0x80);  // ADD A,B: carry out, then pending
+    cpu.execute(0x05);  // DEC B: B = 0, keeps the carry
+    EXPECT_TRUE(cpu.getZeroFlag());
+    EXPECT_TRUE(cpu.getCarryFlag());
+
+    cpu.execute(0x05);  // DEC B: B = 0xFF
+    EXPECT_FALSE(cpu.getZeroFlag());
+    EXPECT_TRUE(cpu.getCarryFlag());
+    EXPECT_EQ(cpu.getFlags(), SUBTRACT_FLAG_MASK | HALF_CARRY_FLAG_MASK | CARRY_FLAG_MASK);
+}
+
+// Test that a carry produced by a deferred operation feeds the next one
+TEST_F(CPUFlagsTest, CarryChainsThroughPendingOperations) {
+    cpu.setA(0xFF);
+    cpu.setB(0x01);
+    cpu.execute(0x80);  // ADD A,B: A = 0x00, carry out
+    cpu.execute(0x04);  // INC B keeps the carry
+    cpu.execute(0x88);  // ADC A,B: 0x00 + 0x02 + 1
+
+    EXPECT_EQ(cpu.getA(), 0x03);
+    EXPECT_EQ(cpu.getFlags(), 0);
+}
+
+// Test that setting a single flag keeps the others from a pending operation
+TEST_F(CPUFlagsTest, SetFlagAfterPendingOperation) {
+    cpu.setA(0x0F);
+    cpu.setB(0x01);
+    cpu.execute(0x80);  // ADD A,B: half carry
+    cpu.setCarryFlag(true);
+
+    EXPECT_EQ(cpu.getFlags(), HALF_CARRY_FLAG_MASK | CARRY_FLAG_MASK);
+}
@@ -0,0 +1,708 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "gameboy.hpp"
+
+class GameBoyTest : public ::testing::Test {
+protected:
+    emulator::GameBoy gameboy;
+
+    void SetUp() override {
+        gameboy.reset();
+    }
+};
+
+// Test that a frame runs 70224 cycles, up to the last instruction
+TEST_F(GameBoyTest, RUNFRAME_FrameCycles) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+
+    const uint64_t consumed = gameboy.runFrame();
+
+    EXPECT_GE(consumed, emulator::GameBoy::FRAME_CYCLES);
+    EXPECT_LT(consumed, emulator::GameBoy::FRAME_CYCLES + 24);
+}
+
+// Test that the overshoot is taken off the next frames
+TEST_F(GameBoyTest, RUNFRAME_AveragesOut) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0x18);  // JR -2, 12 cycles
+    cpu.writeMemory(0x0101, 0xFE);
+
+    uint64_t total = 0;
+    for (int frame = 0; frame < 60; ++frame)
+        total += gameboy.runFrame();
+
+    EXPECT_GE(total, 60u * emulator::GameBoy::FRAME_CYCLES);
+    EXPECT_LT(total, 60u * emulator::GameBoy::FRAME_CYCLES + 12);
+    EXPECT_EQ(cpu.getCycles(), total);
+}
+
+// Test that LY wraps to line 0 after 154 lines, once per frame
+TEST_F(GameBoyTest, EVENTS_LineCounter) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+
+    gameboy.runFrame();
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);
+    EXPECT_EQ(gameboy.getScheduler().timestampOf(emulator::EventType::LineChange),
+              emulator::GameBoy::FRAME_CYCLES + emulator::GameBoy::LINE_CYCLES);
+
+    gameboy.runFrame();
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);
+    EXPECT_EQ(gameboy.getScheduler().timestampOf(emulator::EventType::LineChange),
+              2u * emulator::GameBoy::FRAME_CYCLES + emulator::GameBoy::LINE_CYCLES);
+}
+
+// Test that the VBlank interrupt is taken once per frame
+TEST_F(GameBoyTest, EVENTS_VBlankInterrupt) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x01);  // IE = VBlank
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0x0040, 0x04);  // INC B
+    cpu.writeMemory(0x0041, 0xD9);  // RETI
+    cpu.writeMemory(0x0100, 0x06);  // LD B,0
+    cpu.writeMemory(0x0101, 0x00);
+    cpu.writeMemory(0x0102, 0xFB);  // EI
+    cpu.writeMemory(0x0103, 0x76);  // HALT
+    cpu.writeMemory(0x0104, 0x18);  // JR -3
+    cpu.writeMemory(0x0105, 0xFD);
+
+    for (int frame = 0; frame < 5; ++frame)
+        gameboy.runFrame();
+
+    EXPECT_EQ(cpu.getBC() >> 8, 5);
+}
+
+// Test that the VBlank interrupt is delivered when line 144 starts
+TEST_F(GameBoyTest, EVENTS_VBlankTiming) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x01);
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0x0040, 0xFA);  // LD A,(0xFF44)
+    cpu.writeMemory(0x0041, 0x44);
+    cpu.writeMemory(0x0042, 0xFF);
+    cpu.writeMemory(0x0043, 0x76);  // HALT
+    cpu.writeMemory(0x0100, 0xFB);  // EI
+    cpu.writeMemory(0x0101, 0x18);  // JR -2
+    cpu.writeMemory(0x0102, 0xFE);
+
+    gameboy.runFrame();
+
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    EXPECT_EQ(cpu.getPC(), 0x0044);
+    EXPECT_EQ(cpu.getAF() >> 8, 144);
+}
+
+// Test that TIMA overflows at the programmed rate and raises the timer interrupt
+TEST_F(GameBoyTest, EVENTS_TimerOverflow) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x04);  // IE = Timer
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0x0050, 0x0C);  // INC C
+    cpu.writeMemory(0x0051, 0xD9);  // RETI
+    cpu.writeMemory(0x0100, 0x0E);  // LD C,0
+    cpu.writeMemory(0x0101, 0x00);
+    cpu.writeMemory(0x0102, 0xFB);  // EI
+    cpu.writeMemory(0x0103, 0x18);  // JR -2
+    cpu.writeMemory(0x0104, 0xFE);
+    cpu.writeMemory(0xFF06, 0xC0);  // TMA: 64 ticks between overflows
+    cpu.writeMemory(0xFF04, 0x00);  // Divider restarts here
+    cpu.writeMemory(0xFF05, 0xC0);
+    cpu.writeMemory(0xFF07, 0x05);  // Enabled, 16 cycles per tick
+
+    gameboy.runFrame();
+
+    // 1024 cycles per overflow
+    EXPECT_EQ(cpu.getBC() & 0xFF, emulator::GameBoy::FRAME_CYCLES / 1024);
+}
+
+// Test that DIV follows the cycle count and restarts when written
+TEST_F(GameBoyTest, EVENTS_Divider) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+
+    gameboy.runFrame();
+    EXPECT_EQ(cpu.readMemory(0xFF04), static_cast<uint8_t>(cpu.getCycles() >> 8));
+
+    cpu.writeMemory(0xFF04, 0x42);
+    EXPECT_EQ(cpu.readMemory(0xFF04), 0);
+}
+
+// Test that resetting DIV while the selected divider bit is set steps TIMA
+TEST_F(GameBoyTest, TIMER_DividerResetEdge) {
+    emulator::CPU& cpu = gameboy.getCPU();  // Runs the NOPs of the empty memory
+    cpu.writeMemory(0xFF07, 0x05);  // 16 cycles per step: divider bit 3
+    cpu.writeMemory(0xFF04, 0x00);
+    cpu.writeMemory(0xFF05, 0x10);
+
+    cpu.runFor(8);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x10);
+    cpu.writeMemory(0xFF04, 0x00);  // Bit 3 was set: falling edge
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x11);
+
+    cpu.runFor(4);
+    cpu.writeMemory(0xFF04, 0x00);  // Bit 3 clear: no edge
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x11);
+    cpu.runFor(16);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x12);
+}
+
+// Test that a TAC write taking the timer input from 1 to 0 steps TIMA
+TEST_F(GameBoyTest, TIMER_TacEdge) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFF07, 0x05);
+    cpu.writeMemory(0xFF04, 0x00);
+    cpu.writeMemory(0xFF05, 0x20);
+
+    cpu.runFor(8);
+    cpu.writeMemory(0xFF07, 0x06);  // 64 cycles: bit 5, still 0
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x21);
+    cpu.writeMemory(0xFF07, 0x05);  // Back to bit 3: 0 to 1 isn't an edge
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x21);
+    cpu.writeMemory(0xFF07, 0x01);  // Disabled with bit 3 set
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x22);
+    cpu.runFor(64);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x22);
+}
+
+// Test that TIMA reads 0 for 4 cycles after an overflow, then TMA with the interrupt
+TEST_F(GameBoyTest, TIMER_OverflowReload) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0xFF06, 0x80);
+    cpu.writeMemory(0xFF07, 0x05);
+    cpu.writeMemory(0xFF04, 0x00);
+    cpu.writeMemory(0xFF05, 0xFF);
+
+    cpu.runFor(16);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x00);
+    EXPECT_EQ(cpu.readMemory(0xFF0F) & 0x04, 0);
+    cpu.runFor(4);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x80);
+    EXPECT_EQ(cpu.readMemory(0xFF0F) & 0x04, 0x04);
+
+    // A TIMA write on the reload cycle is lost
+    cpu.writeMemory(0xFF05, 0x40);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x80);
+
+    // A TIMA write during the delay cancels the reload and the interrupt
+    cpu.runFor(4);
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0xFF05, 0xFF);
+    cpu.runFor(8);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x00);
+    cpu.writeMemory(0xFF05, 0x33);
+    cpu.runFor(4);
+    EXPECT_EQ(cpu.readMemory(0xFF05), 0x33);
+    EXPECT_EQ(cpu.readMemory(0xFF0F) & 0x04, 0);
+}
+
+// Test that a serial transfer on the internal clock completes with the interrupt
+TEST_F(GameBoyTest, EVENTS_SerialTransfer) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+    cpu.writeMemory(0xFF01, 0x5A);
+    cpu.writeMemory(0xFF02, 0x81);
+
+    EXPECT_TRUE(gameboy.getScheduler().isScheduled(emulator::EventType::SerialTransfer));
+    gameboy.runFrame();
+
+    EXPECT_EQ(cpu.readMemory(0xFF01), 0xFF);
+    EXPECT_EQ(cpu.readMemory(0xFF02) & 0x80, 0);
+    EXPECT_TRUE(cpu.readMemory(0xFF0F) & 0x08);
+}
+
+// Test that OAM DMA copies 160 bytes and stays active for 640 cycles
+TEST_F(GameBoyTest, EVENTS_OamDma) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    for (uint16_t i = 0; i < 0xA0; ++i)
+        cpu.writeMemory(0xC000 + i, static_cast<uint8_t>(i ^ 0x5A));
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+    cpu.writeMemory(0xFF46, 0xC0);
+
+    EXPECT_TRUE(gameboy.isDmaActive());
+    for (uint16_t i = 0; i < 0xA0; ++i)
+        EXPECT_EQ(cpu.readMemory(0xFE00 + i), static_cast<uint8_t>(i ^ 0x5A));
+
+    gameboy.runFrame();
+    EXPECT_FALSE(gameboy.isDmaActive());
+}
+
+// Test that a general purpose VRAM DMA copies every block at once and holds the CPU 32 cycles per block
+TEST_F(GameBoyTest, CGB_GeneralDma) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    for (uint16_t i = 0; i < 0x40; ++i)
+        cpu.writeMemory(0xD100 + i, static_cast<uint8_t>(i + 1));
+    cpu.writeMemory(0xFF4F, 0x01);
+    cpu.writeMemory(0xFF51, 0xD1);
+    cpu.writeMemory(0xFF52, 0x0F);  // Low nibble ignored
+    cpu.writeMemory(0xFF53, 0xE8);  // Top bits ignored: 0x8800
+    cpu.writeMemory(0xFF54, 0x00);
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+
+    cpu.writeMemory(0xFF55, 0x03);  // 4 blocks
+    EXPECT_EQ(cpu.readMemory(0xFF55), 0xFF);
+    for (uint16_t i = 0; i < 0x40; ++i)
+        EXPECT_EQ(gameboy.getVram(1)[0x0800 + i], i + 1);
+    EXPECT_EQ(gameboy.getVram(0)[0x0800], 0x00);
+
+    // Each pass through JR -2 is 12 cycles, the stall shifts the frame end by 128
+    const uint64_t start = cpu.getCycles();
+    gameboy.runFrame();
+    EXPECT_EQ((cpu.getCycles() - start - 128) % 12, 0u);
+}
+
+// Test that an HBlank DMA copies one block per HBlank and can be stopped
+TEST_F(GameBoyTest, CGB_HBlankDma) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const uint8_t program[] = {
+        0xF0, 0x44,  // LDH A,(LY)   <- wait for line 140
+        0xFE, 0x8C,  // CP 140
+        0x20, 0xFA,  // JR NZ,-6
+        0x3E, 0x87,  // LD A,0x87    8 blocks, HBlank mode
+        0xE0, 0x55,  // LDH (HDMA5),A
+        0x76,        // HALT         <- no interrupt enabled, the PPU is only stepped for the DMA
+        0x18, 0xFD,  // JR -3
+    };
+    for (uint16_t i = 0; i < sizeof(program); ++i)
+        cpu.writeMemory(0x0100 + i, program[i]);
+    for (uint16_t i = 0; i < 0x80; ++i)
+        cpu.writeMemory(0xC200 + i, static_cast<uint8_t>(0x80 | i));
+    cpu.writeMemory(0xFFFF, 0x00);
+    cpu.writeMemory(0xFF51, 0xC2);
+    cpu.writeMemory(0xFF52, 0x00);
+    cpu.writeMemory(0xFF53, 0x01);
+    cpu.writeMemory(0xFF54, 0x00);
+
+    // Lines 140-143 have their HBlank in this frame
+    gameboy.runFrame();
+    EXPECT_TRUE(gameboy.isHdmaActive());
+    EXPECT_EQ(cpu.readMemory(0xFF55), 0x03);
+    for (uint16_t i = 0; i < 0x40; ++i)
+        EXPECT_EQ(cpu.readMemory(0x8100 + i), 0x80 | i);
+    EXPECT_EQ(cpu.readMemory(0x8140), 0x00);
+
+    cpu.writeMemory(0xFF55, 0x00);
+    EXPECT_FALSE(gameboy.isHdmaActive());
+    EXPECT_EQ(cpu.readMemory(0xFF55), 0x83);
+    gameboy.runFrame();
+    EXPECT_EQ(cpu.readMemory(0x8140), 0x00);
+}
+
+// Test that turning the LCD off stops the PPU and turning it on restarts line 0
+TEST_F(GameBoyTest, EVENTS_LcdOff) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+    cpu.runFor(1000);
+    cpu.writeMemory(0xFF40, 0x11);
+
+    EXPECT_FALSE(gameboy.getScheduler().isScheduled(emulator::EventType::LineChange));
+    gameboy.runFrame();
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);
+
+    cpu.writeMemory(0xFF40, 0x91);
+    EXPECT_EQ(gameboy.getScheduler().timestampOf(emulator::EventType::LineChange),
+              cpu.getCycles() + emulator::GameBoy::LINE_CYCLES);
+    EXPECT_EQ(gameboy.getPpuMode(), emulator::PpuMode::OamScan);
+}
+
+// Test that the APU frame sequencer steps at 512 Hz while the APU is on
+TEST_F(GameBoyTest, EVENTS_ApuFrameSequencer) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0x18);  // JR -2
+    cpu.writeMemory(0x0101, 0xFE);
+
+    // 17 steps in two frames
+    gameboy.runFrame();
+    gameboy.runFrame();
+    EXPECT_EQ(gameboy.getApuFrameStep(), 1);
+
+    cpu.writeMemory(0xFF26, 0x00);
+    EXPECT_FALSE(gameboy.getScheduler().isScheduled(emulator::EventType::ApuFrameSequencer));
+    gameboy.runFrame();
+    EXPECT_EQ(gameboy.getApuFrameStep(), 1);
+}
+
+// Test that a CPU halted waiting for VBlank skips the frame instead of running it
+TEST_F(GameBoyTest, HALT_FastForward) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x01);  // IE = VBlank
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0x0040, 0xD9);  // RETI
+    cpu.writeMemory(0x0100, 0xFB);  // EI
+    cpu.writeMemory(0x0101, 0x76);  // HALT
+    cpu.writeMemory(0x0102, 0x18);  // JR -3
+    cpu.writeMemory(0x0103, 0xFD);
+
+    for (int frame = 0; frame < 10; ++frame)
+        gameboy.runFrame();
+
+    const emulator::HaltStats& stats = cpu.getHaltStats();
+    EXPECT_EQ(stats.halts, 11u);  // Once at start, then after each VBlank
+    EXPECT_GT(stats.skippedCycles, 10u * (emulator::GameBoy::FRAME_CYCLES - 100));
+}
+
+// Test that the lines jumped over while halted leave the PPU where its events would have
+TEST_F(GameBoyTest, HALT_PpuSeek) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x00);  // Nothing can wake the CPU
+    cpu.writeMemory(0xFF0F, 0x00);
+    cpu.writeMemory(0xFF45, 0x00);  // LYC = 0
+    cpu.writeMemory(0x0100, 0x76);  // HALT
+
+    for (int frame = 0; frame < 3; ++frame)
+        gameboy.runFrame();
+
+    const emulator::Scheduler& scheduler = gameboy.getScheduler();
+    EXPECT_EQ(cpu.getCycles(), 3u * emulator::GameBoy::FRAME_CYCLES);
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);
+    EXPECT_EQ(cpu.readMemory(0xFF41) & 0x07, 0x06);  // Coincidence, OAM scan
+    EXPECT_EQ(gameboy.getPpuMode(), emulator::PpuMode::OamScan);
+    EXPECT_EQ(scheduler.timestampOf(emulator::EventType::LineChange), cpu.getCycles() + emulator::GameBoy::LINE_CYCLES);
+    EXPECT_EQ(scheduler.timestampOf(emulator::EventType::StatMode), cpu.getCycles() + emulator::GameBoy::OAM_SCAN_CYCLES);
+    EXPECT_EQ(cpu.readMemory(0xFF0F) & 0x03, 0x01);  // VBlank requested, STAT never
+}
+
+// Test that each visible line is drawn, running or halted through them
+TEST_F(GameBoyTest, PPU_FrameDrawn) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x00);
+    cpu.writeMemory(0xFF47, 0xE4);  // BGP
+    for (uint16_t row = 0; row < 8; ++row) {
+        cpu.writeMemory(0x8000 + row * 2, 0xFF);  // Tile 0: color 1 on even rows, 3 on odd ones
+        cpu.writeMemory(0x8001 + row * 2, row & 1 ? 0xFF : 0x00);
+    }
+
+    gameboy.runFrame();  // NOPs
+    const emulator::Ppu& ppu = gameboy.getPpu();
+    for (uint8_t ly = 0; ly < emulator::Ppu::HEIGHT; ++ly)
+        ASSERT_EQ(ppu.getLine(ly)[ly], ly & 1 ? 3 : 1) << "line " << int(ly);
+
+    cpu.writeMemory(0xFF42, 1);     // SCY: every line changes
+    cpu.writeMemory(0x0100, 0x76);  // HALT, the lines are jumped over
+    gameboy.reset();
+    gameboy.runFrame();
+    gameboy.runFrame();
+    EXPECT_GT(cpu.getHaltStats().skippedCycles, emulator::GameBoy::FRAME_CYCLES);
+    for (uint8_t ly = 0; ly < emulator::Ppu::HEIGHT; ++ly)
+        ASSERT_EQ(ppu.getLine(ly)[ly], ly & 1 ? 1 : 3) << "line " << int(ly);
+}
+
+// Test that lines drawn before and after a palette write in the same frame keep their own colors
+TEST_F(GameBoyTest, PPU_PaletteLines) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const uint8_t program[] = {
+        0x3E, 0x80, 0xE0, 0x68,         // BCPS: color 0 of palette 0, auto-increment
+        0x3E, 0x1F, 0xE0, 0x69,         // Red
+        0xAF, 0xE0, 0x69,
+        0xF0, 0x44, 0xFE, 0x0A,         // Wait for LY 10
+        0x20, 0xFA,
+        0x3E, 0x80, 0xE0, 0x68,
+        0xAF, 0xE0, 0x69,               // Blue
+        0x3E, 0x7C, 0xE0, 0x69,
+        0x76,                           // HALT
+    };
+    cpu.writeMemory(0xFFFF, 0x00);
+    for (std::size_t i = 0; i < sizeof(program); ++i)
+        cpu.writeMemory(0x0100 + i, program[i]);
+
+    gameboy.runFrame();
+    const emulator::Ppu& ppu = gameboy.getPpu();
+    for (uint8_t ly = 0; ly < 10; ++ly)
+        ASSERT_EQ(ppu.getColorLine(ly)[80], 0x001F) << "line " << int(ly);
+    for (uint8_t ly = 11; ly < emulator::Ppu::HEIGHT; ++ly)
+        ASSERT_EQ(ppu.getColorLine(ly)[80], 0x7C00) << "line " << int(ly);
+
+    std::vector<uint16_t> pixels(emulator::ColorConverter::PIXELS);
+    gameboy.convertFrame(pixels.data());
+    EXPECT_EQ(pixels[80], 0xF800);      // RGB565
+    EXPECT_EQ(pixels[143 * emulator::Ppu::WIDTH + 80], 0x001F);
+}
+
+// Test that a register written halfway through a line's drawing applies from the pixel reached
+TEST_F(GameBoyTest, PPU_MidLineWrite) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFFFF, 0x00);
+    for (uint16_t row = 0; row < 8; ++row) {
+        cpu.writeMemory(0x8000 + row * 2, 0xFF);  // Color 1 on even rows, 3 on odd ones
+        cpu.writeMemory(0x8001 + row * 2, row & 1 ? 0xFF : 0x00);
+    }
+
+    cpu.runFor(emulator::GameBoy::OAM_SCAN_CYCLES + 86);  // 168 cycles: pixel 81
+    cpu.writeMemory(0xFF42, 1);     // SCY
+    gameboy.runFrame();
+
+    const uint8_t* line = gameboy.getPpu().getLine(0);
+    EXPECT_EQ(std::vector<uint8_t>(line, line + 81), std::vector<uint8_t>(81, 1));
+    EXPECT_EQ(std::vector<uint8_t>(line + 81, line + 160), std::vector<uint8_t>(79, 3));
+    EXPECT_EQ(gameboy.getPpu().getLine(1)[0], 1);
+}
+
+// Test that reading STAT or LY draws up to where the PPU is
+TEST_F(GameBoyTest, PPU_ReadsCatchUp) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const emulator::Ppu& ppu = gameboy.getPpu();
+    cpu.writeMemory(0x8000, 0xFF);  // Color 1 on row 0
+
+    cpu.runFor(emulator::GameBoy::OAM_SCAN_CYCLES + 43);  // 124 cycles: pixel 40
+    EXPECT_EQ(ppu.getLine(0)[0], 0);
+    static_cast<void>(cpu.readMemory(0xFF41));
+    EXPECT_EQ(ppu.getLine(0)[39], 1);
+    EXPECT_EQ(ppu.getLine(0)[40], 0);
+    EXPECT_EQ(ppu.getRenderedLines(), 0u);
+
+    cpu.runFor(emulator::GameBoy::DRAWING_CYCLES);
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);
+    EXPECT_EQ(ppu.getLine(0)[159], 1);
+    EXPECT_EQ(ppu.getRenderedLines(), 1u);
+}
+
+// Test that frames nothing the PPU reads was written in are not drawn again
+TEST_F(GameBoyTest, PPU_StaticFrames) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const emulator::Ppu& ppu = gameboy.getPpu();
+    cpu.writeMemory(0xFFFF, 0x00);
+    cpu.writeMemory(0x0100, 0x76);  // HALT
+    cpu.writeMemory(0x8000, 0xF0);  // Color 1 on the left of row 0
+
+    for (int frame = 0; frame < 10; ++frame)
+        gameboy.runFrame();
+    EXPECT_EQ(ppu.getRenderedLines(), 2u * 144);  // The frame written in, and the next
+
+    cpu.writeMemory(0xFF43, 4);     // SCX: this frame and the next are drawn
+    cpu.writeMemory(0xFF43, 4);     // Unchanged, nothing to draw
+    for (int frame = 0; frame < 10; ++frame)
+        gameboy.runFrame();
+    EXPECT_EQ(ppu.getRenderedLines(), 4u * 144);
+    EXPECT_EQ(ppu.getLine(0)[0], 0);
+    EXPECT_EQ(ppu.getLine(0)[4], 1);
+}
+
+// Test that an OAM DMA is drawn up to like a CPU write, and its objects show
+TEST_F(GameBoyTest, PPU_OamDma) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const emulator::Ppu& ppu = gameboy.getPpu();
+    cpu.writeMemory(0xFFFF, 0x00);
+    cpu.writeMemory(0x0100, 0x76);  // HALT
+    cpu.writeMemory(0xFF40, cpu.readMemory(0xFF40) | 0x02);  // Objects on
+    cpu.writeMemory(0x8010, 0xFF);  // Tile 1, color 3 on row 0
+    cpu.writeMemory(0x8011, 0xFF);
+    for (int frame = 0; frame < 10; ++frame)
+        gameboy.runFrame();
+    EXPECT_EQ(ppu.getRenderedLines(), 2u * 144);
+    EXPECT_EQ(ppu.getLine(0)[0], 0);
+
+    const uint8_t object[] = {16, 8, 1, 0};  // Top left, tile 1
+    for (uint16_t i = 0; i < 0xA0; ++i)
+        cpu.writeMemory(0xC000 + i, i < 4 ? object[i] : 0);
+    cpu.writeMemory(0xFF46, 0xC0);
+    for (int frame = 0; frame < 10; ++frame)
+        gameboy.runFrame();
+    EXPECT_EQ(ppu.getRenderedLines(), 4u * 144);
+    EXPECT_NE(ppu.getLine(0)[0], 0);
+    EXPECT_EQ(ppu.getLine(0)[8], 0);
+}
+
+// Test that the CPU's and the DMA's tile data writes reach the tile cache, the map's don't
+TEST_F(GameBoyTest, PPU_TileWrites) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const emulator::TileCache& cache = gameboy.getPpu().getTileCache();
+    gameboy.runFrame();
+    const uint64_t decoded = cache.getDecodedTiles();
+
+    cpu.writeMemory(0x9800, 0x00);  // Map
+    cpu.writeMemory(0x8000, 0x00);  // Same value
+    gameboy.runFrame();
+    EXPECT_EQ(cache.getDecodedTiles(), decoded);
+
+    cpu.writeMemory(0x8001, 0x80);
+    cpu.writeMemory(0xFF4F, 0x01);  // VBK
+    cpu.writeMemory(0x8010, 0xFF);
+    gameboy.runFrame();
+    EXPECT_EQ(cache.getDecodedTiles(), decoded + 2);
+    EXPECT_EQ(gameboy.getPpu().getLine(0)[0], 2);
+    EXPECT_EQ(cache.row(emulator::TileCache::BANK_TILES + 1, 0, false)[7], 1);
+
+    // General purpose DMA of two tiles from WRAM
+    for (uint16_t i = 0; i < 32; ++i)
+        cpu.writeMemory(0xC000 + i, 0xFF);
+    cpu.writeMemory(0xFF51, 0xC0);
+    cpu.writeMemory(0xFF52, 0x00);
+    cpu.writeMemory(0xFF53, 0x00);
+    cpu.writeMemory(0xFF54, 0x40);
+    cpu.writeMemory(0xFF55, 0x01);
+    gameboy.runFrame();
+    EXPECT_EQ(cache.getDecodedTiles(), decoded + 4);
+    EXPECT_EQ(cache.row(emulator::TileCache::BANK_TILES + 4, 7, false)[0], 3);
+}
+
+// Test that SVBK swaps the WRAM bank at 0xD000 and its echo, leaving 0xC000
+TEST_F(GameBoyTest, CGB_WramBanks) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xC000, 0x10);
+    cpu.writeMemory(0xFF70, 0x02);
+    cpu.writeMemory(0xD000, 0x22);
+    cpu.writeMemory(0xFF70, 0x03);
+    cpu.writeMemory(0xD000, 0x33);
+
+    EXPECT_EQ(cpu.readMemory(0xFF70), 0xFB);
+    EXPECT_EQ(cpu.readMemory(0xF000), 0x33);  // Echo
+    cpu.writeMemory(0xFF70, 0x02);
+    EXPECT_EQ(cpu.readMemory(0xD000), 0x22);
+    EXPECT_EQ(cpu.readMemory(0xC000), 0x10);
+    EXPECT_EQ(cpu.readMemory(0xE000), 0x10);
+
+    cpu.writeMemory(0xFF70, 0x00);  // Selects bank 1
+    EXPECT_EQ(gameboy.getWramBank(), 1);
+    EXPECT_EQ(cpu.getMemoryBus().bank(0xD0), 1);
+    EXPECT_EQ(cpu.readMemory(0xD000), 0x00);
+}
+
+// Test that VBK swaps the whole VRAM between its two banks
+TEST_F(GameBoyTest, CGB_VramBanks) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x8000, 0x11);
+    cpu.writeMemory(0xFF4F, 0x01);
+    EXPECT_EQ(cpu.readMemory(0xFF4F), 0xFF);
+    EXPECT_EQ(cpu.readMemory(0x8000), 0x00);
+    cpu.writeMemory(0x9FFF, 0x99);
+
+    cpu.writeMemory(0xFF4F, 0x00);
+    EXPECT_EQ(cpu.readMemory(0x8000), 0x11);
+    EXPECT_EQ(cpu.readMemory(0x9FFF), 0x00);
+    EXPECT_EQ(gameboy.getVram(1)[0x1FFF], 0x99);
+}
+
+// Test that STOP with KEY1 armed doubles the CPU cycles in a frame and a line, then halves them back
+TEST_F(GameBoyTest, CGB_SpeedSwitch) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const emulator::Scheduler& scheduler = gameboy.getScheduler();
+    cpu.writeMemory(0x0100, 0x3E);  // LD A,1
+    cpu.writeMemory(0x0101, 0x01);
+    cpu.writeMemory(0x0102, 0xE0);  // LDH (0x4D),A
+    cpu.writeMemory(0x0103, 0x4D);
+    cpu.writeMemory(0x0104, 0x10);  // STOP
+    cpu.writeMemory(0x0105, 0x00);
+    cpu.writeMemory(0x0106, 0x18);  // JR -2
+    cpu.writeMemory(0x0107, 0xFE);
+
+    // The switch happens at the STOP, 24 cycles in: what is left of the
+    // frame then lasts twice as many cycles
+    const uint64_t first = gameboy.runFrame();
+    EXPECT_TRUE(gameboy.isDoubleSpeed());
+    EXPECT_EQ(cpu.readMemory(0xFF4D), 0xFE);
+    EXPECT_GE(first, 24 + 2u * (emulator::GameBoy::FRAME_CYCLES - 24));
+    EXPECT_LT(first, 24 + 2u * (emulator::GameBoy::FRAME_CYCLES - 24) + 12);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Running);
+
+    const uint64_t consumed = gameboy.runFrame();
+    EXPECT_GE(consumed, 2u * emulator::GameBoy::FRAME_CYCLES);
+    EXPECT_LT(consumed, 2u * emulator::GameBoy::FRAME_CYCLES + 24);
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);
+    EXPECT_LE(scheduler.timestampOf(emulator::EventType::LineChange), cpu.getCycles() + 2 * emulator::GameBoy::LINE_CYCLES);
+    EXPECT_GT(scheduler.timestampOf(emulator::EventType::LineChange), cpu.getCycles() + 2 * emulator::GameBoy::LINE_CYCLES - 24);
+
+    // Same sequence once more at 0x0108, reached by turning the JR -2 into JR +0
+    for (uint16_t i = 0; i < 8; ++i)
+        cpu.writeMemory(0x0108 + i, cpu.readMemory(0x0100 + i));
+    cpu.writeMemory(0x0107, 0x00);
+    gameboy.runFrame();
+    EXPECT_FALSE(gameboy.isDoubleSpeed());
+    EXPECT_EQ(cpu.readMemory(0xFF4D), 0x7E);
+
+    const uint64_t normal = gameboy.runFrame();
+    EXPECT_LT(normal, emulator::GameBoy::FRAME_CYCLES + 24);
+}
+
+// Test that unused bits read as 1, read only bits keep the hardware's value and unmapped registers read 0xFF
+TEST_F(GameBoyTest, IO_RegisterMasks) {
+    emulator::CPU& cpu = gameboy.getCPU();
+
+    cpu.writeMemory(0xFF07, 0x00);
+    EXPECT_EQ(cpu.readMemory(0xFF07), 0xF8);  // TAC: 3 bits
+    cpu.writeMemory(0xFF0F, 0x00);
+    EXPECT_EQ(cpu.readMemory(0xFF0F), 0xE0);
+    cpu.writeMemory(0xFF13, 0x12);
+    EXPECT_EQ(cpu.readMemory(0xFF13), 0xFF);  // NR13 is write only
+
+    const uint8_t stat = cpu.readMemory(0xFF41);
+    cpu.writeMemory(0xFF41, 0x00);
+    EXPECT_EQ(cpu.readMemory(0xFF41), 0x80 | (stat & 0x07));  // Mode and coincidence are the PPU's
+    cpu.writeMemory(0xFF44, 0x42);
+    EXPECT_EQ(cpu.readMemory(0xFF44), 0);  // LY
+
+    cpu.writeMemory(0xFF03, 0x12);
+    EXPECT_EQ(cpu.readMemory(0xFF03), 0xFF);
+    EXPECT_EQ(cpu.readMemory(0xFF7F), 0xFF);
+
+    // Plain storage and HRAM keep every bit
+    cpu.writeMemory(0xFF42, 0x5A);
+    EXPECT_EQ(cpu.readMemory(0xFF42), 0x5A);
+    cpu.writeMemory(0xFF80, 0xA5);
+    EXPECT_EQ(cpu.readMemory(0xFF80), 0xA5);
+    cpu.writeMemory(0xFFFF, 0x1F);
+    EXPECT_EQ(cpu.readMemory(0xFFFF), 0x1F);
+}
+
+// Test that LDH goes through the register table: DIV is computed when read
+TEST_F(GameBoyTest, IO_LdhDivider) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0x0100, 0xE0);  // LDH (0x04),A   divider restarts
+    cpu.writeMemory(0x0101, 0x04);
+    for (uint16_t i = 0; i < 64; ++i)
+        cpu.writeMemory(0x0102 + i, 0x00);  // NOP x 64
+    cpu.writeMemory(0x0142, 0xF0);  // LDH A,(0x04)
+    cpu.writeMemory(0x0143, 0x04);
+    cpu.writeMemory(0x0144, 0x18);  // JR -2
+    cpu.writeMemory(0x0145, 0xFE);
+
+    cpu.runFor(12 + 64 * 4 + 12);
+    EXPECT_EQ(cpu.getAF() >> 8, (64 * 4 + 12) >> 8);
+}
+
+// Test that BCPS/BCPD reach the palette RAM, stepping the index on writes when bit 7 is set
+TEST_F(GameBoyTest, CGB_Palettes) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    cpu.writeMemory(0xFF68, 0xBE);  // Index 0x3E, auto increment
+    cpu.writeMemory(0xFF69, 0x11);
+    cpu.writeMemory(0xFF69, 0x22);
+    cpu.writeMemory(0xFF69, 0x33);  // Wrapped to 0
+    EXPECT_EQ(cpu.readMemory(0xFF68), 0xC1);
+    EXPECT_EQ(gameboy.getMemory().bgPalettes[0x3E], 0x11);
+    EXPECT_EQ(gameboy.getMemory().bgPalettes[0x3F], 0x22);
+    EXPECT_EQ(gameboy.getMemory().bgPalettes[0x00], 0x33);
+
+    cpu.writeMemory(0xFF6A, 0x05);  // No auto increment
+    cpu.writeMemory(0xFF6B, 0x44);
+    cpu.writeMemory(0xFF6B, 0x55);
+    EXPECT_EQ(cpu.readMemory(0xFF6B), 0x55);
+    EXPECT_EQ(cpu.readMemory(0xFF6A), 0x45);
+    EXPECT_EQ(gameboy.getMemory().objPalettes[0x05], 0x55);
+}
+
+// Test that the system memory is one aligned block, the hot pages mapped at their addresses, and copies as a snapshot
+TEST_F(GameBoyTest, MEMORY_SystemArena) {
+    emulator::CPU& cpu = gameboy.getCPU();
+    const emulator::GameBoy::SystemMemory& memory = gameboy.getMemory();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&memory) % 64, 0u);
+
+    cpu.writeMemory(0xFF80, 0x12);
+    cpu.writeMemory(0xFE9F, 0x34);
+    cpu.writeMemory(0xC001, 0x56);
+    EXPECT_EQ(memory.high[0x80], 0x12);
+    EXPECT_EQ(memory.oam[0x9F], 0x34);
+    EXPECT_EQ(memory.wram[0x001], 0x56);
+    EXPECT_EQ(cpu.getMemoryBus().readPage(0xFF), memory.high.data());
+
+    const emulator::GameBoy::SystemMemory snapshot = memory;
+    cpu.writeMemory(0xFF80, 0x00);
+    EXPECT_EQ(snapshot.high[0x80], 0x12);
+}
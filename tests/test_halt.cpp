@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPUHaltTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+        cpu.writeMemory(0xFFFF, 0x00);
+        cpu.writeMemory(0xFF0F, 0x00);
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+
+    // Makes the VBlank interrupt enabled and requested
+    void raiseVBlank() {
+        cpu.writeMemory(0xFFFF, 0x01);
+        cpu.writeMemory(0xFF0F, 0x01);
+    }
+};
+
+// Test that HALT with nothing pending halts and the clock jumps to the end of the slice
+TEST_F(CPUHaltTest, HALT_SkipsToSliceEnd) {
+    loadProgram({0x76, 0x3C});  // HALT, INC A
+    const uint64_t start = cpu.getCycles();
+
+    EXPECT_EQ(cpu.runFor(10000), 10000u);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    EXPECT_EQ(cpu.getCycles() - start, 10000u);
+    EXPECT_EQ(cpu.getHaltStats().halts, 1u);
+    EXPECT_EQ(cpu.getHaltStats().skippedCycles, 10000u - 4u);
+}
+
+// Test that an interrupt wakes a HALT with IME clear without being serviced
+TEST_F(CPUHaltTest, HALT_WakesWithImeClear) {
+    loadProgram({0x76, 0x3C});  // HALT, INC A
+    const uint8_t a = cpu.getAF() >> 8;
+
+    cpu.runFor(100);
+    raiseVBlank();
+    EXPECT_FALSE(cpu.serviceInterrupts());
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Running);
+
+    cpu.run(1);
+    EXPECT_EQ(cpu.getPC(), 0x0102);
+    EXPECT_EQ(cpu.getAF() >> 8, static_cast<uint8_t>(a + 1));
+    EXPECT_EQ(cpu.readMemory(0xFF0F) & 0x01, 0x01);
+}
+
+// Test that a halted CPU with IME set is woken and sent to the vector
+TEST_F(CPUHaltTest, HALT_WakesAndServices) {
+    loadProgram({0xFB, 0x76, 0x3C});  // EI, HALT, INC A
+    cpu.setSP(0xDFFE);
+
+    cpu.runFor(100);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    raiseVBlank();
+    EXPECT_TRUE(cpu.serviceInterrupts());
+    EXPECT_EQ(cpu.getPC(), 0x0040);
+    EXPECT_EQ(cpu.readMemory(0xDFFC) | (cpu.readMemory(0xDFFD) << 8), 0x0102);
+    EXPECT_EQ(cpu.readMemory(0xFF0F) & 0x01, 0x00);
+}
+
+// Test that the HALT bug reads the byte after HALT twice
+TEST_F(CPUHaltTest, HALT_BugRepeatsNextByte) {
+    loadProgram({0x76, 0x3C, 0x00});  // HALT, INC A, NOP
+    const uint8_t a = cpu.getAF() >> 8;
+    raiseVBlank();
+
+    cpu.run(2);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Running);
+    EXPECT_EQ(cpu.getAF() >> 8, static_cast<uint8_t>(a + 2));
+    EXPECT_EQ(cpu.getPC(), 0x0102);
+    EXPECT_EQ(cpu.getHaltStats().haltBugs, 1u);
+    EXPECT_EQ(cpu.getHaltStats().halts, 0u);
+}
+
+// Test that under the HALT bug an operand fetch reads the opcode again
+TEST_F(CPUHaltTest, HALT_BugShiftsOperands) {
+    loadProgram({0x76, 0x3E, 0x14});  // HALT, LD A,0x14
+    const uint16_t de = cpu.getDE();
+    raiseVBlank();
+
+    cpu.run(2);
+    EXPECT_EQ(cpu.getAF() >> 8, 0x3E);              // LD A,0x3E
+    EXPECT_EQ(cpu.getDE(), de + 0x0100);            // then 0x14 runs as INC D
+    EXPECT_EQ(cpu.getPC(), 0x0103);
+}
+
+// Test that HALT with IME set and an interrupt pending does not halt
+TEST_F(CPUHaltTest, HALT_PendingWithImeSet) {
+    loadProgram({0xFB, 0x00, 0x76, 0x3C});  // EI, NOP, HALT, INC A
+    cpu.setSP(0xDFFE);
+    raiseVBlank();
+
+    cpu.run(2);
+    cpu.run(1);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Running);
+    EXPECT_TRUE(cpu.serviceInterrupts());
+    EXPECT_EQ(cpu.readMemory(0xDFFC) | (cpu.readMemory(0xDFFD) << 8), 0x0103);
+}
+
+// Test that EI right before HALT makes the interrupt return to the HALT
+TEST_F(CPUHaltTest, HALT_AfterEiReturnsToHalt) {
+    loadProgram({0xFB, 0x76, 0x3C});  // EI, HALT, INC A
+    cpu.setSP(0xDFFE);
+    raiseVBlank();
+
+    cpu.run(2);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Running);
+    EXPECT_TRUE(cpu.serviceInterrupts());
+    EXPECT_EQ(cpu.readMemory(0xDFFC) | (cpu.readMemory(0xDFFD) << 8), 0x0101);
+}
+
+// Test that STOP keeps the clock running until a joypad interrupt
+TEST_F(CPUHaltTest, STOP_WakesOnJoypad) {
+    loadProgram({0x10, 0x00, 0x3C});  // STOP, INC A
+
+    EXPECT_EQ(cpu.runFor(1000), 1000u);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Stopped);
+
+    cpu.requestInterrupt(emulator::Interrupt::Joypad);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Running);
+    EXPECT_EQ(cpu.getPC(), 0x0102);
+}
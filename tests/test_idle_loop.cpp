@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPUIdleLoopTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+        cpu.writeMemory(0xFFFF, 0x00);
+        cpu.writeMemory(0xFF0F, 0x00);
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+
+    // Runs the same budget on a copy through the table interpreter, which
+    // never skips, and compares the whole state
+    void expectSameAsInterpreter(const uint32_t budget) {
+        emulator::CPU reference = cpu;
+
+        EXPECT_EQ(cpu.runFor(budget), reference.runForTable(budget));
+        EXPECT_EQ(cpu.getAF(), reference.getAF());
+        EXPECT_EQ(cpu.getBC(), reference.getBC());
+        EXPECT_EQ(cpu.getDE(), reference.getDE());
+        EXPECT_EQ(cpu.getHL(), reference.getHL());
+        EXPECT_EQ(cpu.getSP(), reference.getSP());
+        EXPECT_EQ(cpu.getPC(), reference.getPC());
+        EXPECT_EQ(cpu.getCycles(), reference.getCycles());
+    }
+};
+
+// Test that a loop polling memory is skipped to the end of the slice, in the state the interpreter reaches
+TEST_F(CPUIdleLoopTest, IDLE_PollingLoopSkipped) {
+    loadProgram({
+        0xFA, 0x00, 0xC0,  // LD A,(0xC000)  <- loop
+        0xFE, 0x01,        // CP 1
+        0x20, 0xF9,        // JR NZ,loop
+        0x3C,              // INC A
+    });
+
+    expectSameAsInterpreter(10000);
+    EXPECT_EQ(cpu.getIdleLoopStats().skips, 1u);
+    EXPECT_GT(cpu.getIdleLoopStats().skippedCycles, 9000u);
+    EXPECT_TRUE(cpu.isIdleLooping());
+    EXPECT_TRUE(cpu.idleLoopReads(0xC000, 0xC000));
+    EXPECT_FALSE(cpu.idleLoopReads(0xFF00, 0xFFFF));
+}
+
+// Test that the loop exits once the value it polls changes
+TEST_F(CPUIdleLoopTest, IDLE_ExitsOnMemoryChange) {
+    loadProgram({
+        0x21, 0x00, 0xC0,  // LD HL,0xC000
+        0x7E,              // LD A,(HL)      <- loop
+        0xB7,              // OR A
+        0x28, 0xFC,        // JR Z,loop
+        0x76,              // HALT
+    });
+
+    cpu.runFor(5000);
+    EXPECT_TRUE(cpu.isIdleLooping());
+
+    cpu.writeMemory(0xC000, 0x01);
+    EXPECT_FALSE(cpu.isIdleLooping());
+
+    cpu.runFor(100);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    EXPECT_EQ(cpu.getPC(), 0x0108);
+}
+
+// Test that loops with side effects are run, not skipped
+TEST_F(CPUIdleLoopTest, IDLE_SideEffectsNotSkipped) {
+    const std::initializer_list<uint8_t> programs[] = {
+        {0xEA, 0x00, 0xC0, 0x18, 0xFB},  // LD (0xC000),A; JR -5
+        {0x3C, 0x18, 0xFD},              // INC A; JR -3
+        {0xF0, 0x04, 0x18, 0xFC},        // LDH A,(DIV); JR -4
+        {0xC5, 0xC1, 0x18, 0xFC},        // PUSH BC; POP BC; JR -4
+    };
+
+    for (const auto& program : programs) {
+        cpu.reset();
+        cpu.setSP(0xDFFE);
+        loadProgram(program);
+
+        expectSameAsInterpreter(5000);
+        EXPECT_EQ(cpu.getIdleLoopStats().skips, 0u);
+        EXPECT_FALSE(cpu.isIdleLooping());
+    }
+}
+
+// Test that a loop moving its pointer before reading through it is not
+// skipped: the address read is not the one the pass starts with
+TEST_F(CPUIdleLoopTest, IDLE_PointerWrittenBeforeRead) {
+    loadProgram({
+        0x21, 0x43, 0xFF,  // LD HL,0xFF43
+        0x2C,              // INC L        <- loop
+        0x7E,              // LD A,(HL)
+        0x2D,              // DEC L
+        0xFE, 0x40,        // CP 0x40
+        0x20, 0xF9,        // JR NZ,loop
+        0x76,              // HALT
+    });
+
+    expectSameAsInterpreter(5000);
+    EXPECT_EQ(cpu.getIdleLoopStats().skips, 0u);
+    EXPECT_FALSE(cpu.isIdleLooping());
+}
+
+// Test that skips keep the overshoot of the interpreter for any budget
+TEST_F(CPUIdleLoopTest, IDLE_BudgetsMatchInterpreter) {
+    loadProgram({
+        0xF0, 0x80,  // LDH A,(0x80)  <- loop
+        0xA7,        // AND A
+        0x28, 0xFB,  // JR Z,loop
+    });
+
+    for (const uint32_t budget : {3001u, 7u, 64u, 1000u, 13u, 70224u})
+        expectSameAsInterpreter(budget);
+    EXPECT_GT(cpu.getIdleLoopStats().skips, 0u);
+}
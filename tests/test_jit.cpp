@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+#include "recompiler.hpp"
+
+class CPUJitTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+
+    // Steps the recompiler and replays the same instruction count on the
+    // interpreter, comparing the registers after each block
+    void expectLockstep(emulator::jit::Recompiler& jit, emulator::CPU& reference, const int steps) {
+        for (int i = 0; i < steps && cpu.getState() == emulator::CpuState::Running; ++i) {
+            const uint32_t executed = jit.step();
+
+            ASSERT_EQ(reference.run(executed), executed);
+            ASSERT_EQ(cpu.getAF(), reference.getAF()) << "step " << i;
+            ASSERT_EQ(cpu.getBC(), reference.getBC()) << "step " << i;
+            ASSERT_EQ(cpu.getDE(), reference.getDE()) << "step " << i;
+            ASSERT_EQ(cpu.getHL(), reference.getHL()) << "step " << i;
+            ASSERT_EQ(cpu.getSP(), reference.getSP()) << "step " << i;
+            ASSERT_EQ(cpu.getPC(), reference.getPC()) << "step " << i;
+            ASSERT_EQ(cpu.getCycles(), reference.getCycles()) << "step " << i;
+        }
+    }
+};
+
+// Test that translated arithmetic, loads and branches match the interpreter
+TEST_F(CPUJitTest, JIT_LockstepArithmetic) {
+    loadProgram({
+        0x06, 0x10,        // LD B,0x10
+        0x0E, 0x03,        // LD C,0x03
+        0x3C,              // INC A          <- loop
+        0x80,              // ADD A,B
+        0x89,              // ADC A,C
+        0x57,              // LD D,A
+        0x92,              // SUB A,D
+        0x9B,              // SBC A,E
+        0xA1,              // AND A,C
+        0xA8,              // XOR A,B
+        0xB2,              // OR A,D
+        0xB9,              // CP A,C
+        0xC6, 0x7F,        // ADD A,0x7F
+        0xCE, 0x01,        // ADC A,0x01
+        0x1D,              // DEC E
+        0x2F, 0x3F, 0x37,  // CPL, CCF, SCF
+        0x13, 0x2B,        // INC DE, DEC HL
+        0x05,              // DEC B
+        0x20, 0xE9,        // JR NZ,loop
+        0xC3, 0x04, 0x01,  // JP loop
+    });
+
+    emulator::CPU reference = cpu;
+    emulator::jit::Recompiler jit(cpu, 0);
+
+    expectLockstep(jit, reference, 200);
+    EXPECT_GT(jit.translatedBlocks(), 0u);
+}
+
+// Test that memory accesses go through the bus and keep HL stepping
+TEST_F(CPUJitTest, JIT_LockstepMemory) {
+    loadProgram({
+        0x21, 0x00, 0xC0,  // LD HL,0xC000
+        0x01, 0x10, 0xC0,  // LD BC,0xC010
+        0x3E, 0x55,        // LD A,0x55
+        0x22,              // LD (HL+),A     <- loop
+        0x02,              // LD (BC),A
+        0x0A,              // LD A,(BC)
+        0x2A,              // LD A,(HL+)
+        0x86,              // ADD A,(HL)
+        0x46,              // LD B,(HL)
+        0xE0, 0x80,        // LDH (0x80),A
+        0xF0, 0x80,        // LDH A,(0x80)
+        0xEA, 0x20, 0xC0,  // LD (0xC020),A
+        0xFA, 0x20, 0xC0,  // LD A,(0xC020)
+        0x36, 0x42,        // LD (HL),0x42
+        0x06, 0xC0,        // LD B,0xC0
+        0x18, 0xEA,        // JR loop
+    });
+
+    emulator::CPU reference = cpu;
+    emulator::jit::Recompiler jit(cpu, 0);
+
+    expectLockstep(jit, reference, 200);
+    EXPECT_EQ(cpu.readMemory(0xC020), reference.readMemory(0xC020));
+    EXPECT_EQ(cpu.readMemory(0xFF80), reference.readMemory(0xFF80));
+}
+
+// Test that code patched by a translated block is translated again
+TEST_F(CPUJitTest, JIT_SelfModifyingCode) {
+    loadProgram({
+        0x21, 0x08, 0x01,  // LD HL,0x0108
+        0x3E, 0x3D,        // LD A,0x3D (DEC A opcode)
+        0x77,              // LD (HL),A   <- loop
+        0xEE, 0x01,        // XOR A,0x01 (toggles INC A / DEC A)
+        0x3C,              // INC A, patched every pass
+        0x00,              // NOP
+        0x18, 0xF9,        // JR loop
+    });
+
+    emulator::CPU reference = cpu;
+    emulator::jit::Recompiler jit(cpu, 0);
+
+    expectLockstep(jit, reference, 100);
+}
+
+// Test that cold blocks run through the interpreter until they get hot
+TEST_F(CPUJitTest, JIT_HotThreshold) {
+    loadProgram({0x3C, 0x18, 0xFD});  // INC A, JR -3
+
+    emulator::jit::Recompiler jit(cpu, 4);
+
+    for (int i = 0; i < 3; ++i)
+        jit.step();
+    EXPECT_EQ(jit.translatedBlocks(), 0u);
+
+    jit.step();
+    EXPECT_EQ(jit.translatedBlocks(), 1u);
+}
+
+// Test that runFor keeps the budget contract of the interpreter
+TEST_F(CPUJitTest, JIT_RunForMatchesInterpreter) {
+    loadProgram({0x3C, 0x47, 0x80, 0x20, 0xFB, 0x3D, 0xC3, 0x00, 0x01, 0x76});
+
+    emulator::CPU reference = cpu;
+    emulator::jit::Recompiler jit(cpu, 0);
+
+    for (const uint32_t budget : {1000u, 13u, 7u, 250u}) {
+        EXPECT_EQ(jit.runFor(budget), reference.runFor(budget));
+        EXPECT_EQ(cpu.getAF(), reference.getAF());
+        EXPECT_EQ(cpu.getBC(), reference.getBC());
+        EXPECT_EQ(cpu.getPC(), reference.getPC());
+        EXPECT_EQ(cpu.getCycles(), reference.getCycles());
+    }
+}
+
+// Test that instructions the recompiler leaves out fall back to the interpreter
+TEST_F(CPUJitTest, JIT_UnsupportedFallsBack) {
+    loadProgram({
+        0x31, 0xFE, 0xDF,  // LD SP,0xDFFE
+        0x3C,              // INC A          <- loop
+        0xC5,              // PUSH BC
+        0x27,              // DAA
+        0xCB, 0x37,        // SWAP A
+        0xC1,              // POP BC
+        0x09,              // ADD HL,BC
+        0x18, 0xF7,        // JR loop
+    });
+
+    emulator::CPU reference = cpu;
+    emulator::jit::Recompiler jit(cpu, 0);
+
+    expectLockstep(jit, reference, 100);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPUJumpTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+};
+
+// Test for a relative jump backwards
+TEST_F(CPUJumpTest, JR_Backwards) {
+    loadProgram({0x18, 0xFE});  // JR -2
+    cpu.executeInstruction();
+
+    EXPECT_EQ(cpu.getPC(), 0x0100);               // Jumps back onto itself
+}
+
+// Test for conditional relative jumps, taken and not taken
+TEST_F(CPUJumpTest, JR_Conditional) {
+    loadProgram({0x20, 0x10});  // JR NZ,+0x10
+    cpu.setZeroFlag(true);
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getPC(), 0x0102);               // Not taken
+
+    cpu.setPC(0x0100);
+    cpu.setZeroFlag(false);
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getPC(), 0x0112);               // Taken
+}
+
+// Test for absolute jumps
+TEST_F(CPUJumpTest, JP_Conditional) {
+    loadProgram({0xDA, 0x00, 0x20});  // JP C,0x2000
+    cpu.setCarryFlag(false);
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getPC(), 0x0103);               // Not taken
+
+    cpu.setPC(0x0100);
+    cpu.setCarryFlag(true);
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getPC(), 0x2000);               // Taken
+
+    cpu.setHL(0x4000);
+    cpu.execute(0xE9);  // JP HL
+    EXPECT_EQ(cpu.getPC(), 0x4000);
+}
+
+// Test that CALL pushes the return address and RET pops it
+TEST_F(CPUJumpTest, CALL_RET) {
+    loadProgram({0xCD, 0x00, 0x20});  // CALL 0x2000
+    cpu.writeMemory(0x2000, 0xC9);    // RET
+    cpu.setSP(0xFFFE);
+
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getPC(), 0x2000);
+    EXPECT_EQ(cpu.getSP(), 0xFFFC);
+    EXPECT_EQ(cpu.readMemory(0xFFFC), 0x03);      // Return address, low byte first
+    EXPECT_EQ(cpu.readMemory(0xFFFD), 0x01);
+
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getPC(), 0x0103);
+    EXPECT_EQ(cpu.getSP(), 0xFFFE);
+}
+
+// Test that a conditional return not taken leaves the stack alone
+TEST_F(CPUJumpTest, RET_ConditionalNotTaken) {
+    cpu.setSP(0xFFFC);
+    cpu.setZeroFlag(false);
+    cpu.execute(0xC8);  // RET Z
+
+    EXPECT_EQ(cpu.getSP(), 0xFFFC);
+}
+
+// Test for restarts to their fixed vectors
+TEST_F(CPUJumpTest, RST) {
+    cpu.setSP(0xFFFE);
+    cpu.setPC(0x0150);
+    cpu.execute(0xEF);  // RST 28H
+
+    EXPECT_EQ(cpu.getPC(), 0x0028);
+    EXPECT_EQ(cpu.getSP(), 0xFFFC);
+    EXPECT_EQ(cpu.readMemory(0xFFFC), 0x50);
+}
+
+// Test that RETI returns and enables interrupts, DI disables them
+TEST_F(CPUJumpTest, RETI_DI) {
+    cpu.setSP(0xFFFC);
+    cpu.writeMemory(0xFFFC, 0x34);
+    cpu.writeMemory(0xFFFD, 0x12);
+    cpu.execute(0xD9);  // RETI
+
+    EXPECT_EQ(cpu.getPC(), 0x1234);
+    EXPECT_TRUE(cpu.getIME());
+
+    cpu.execute(0xF3);  // DI
+    EXPECT_FALSE(cpu.getIME());
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPULdTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+};
+
+// Test that LD B,d8 writes B (it used to write D)
+TEST_F(CPULdTest, LD_B_d8) {
+    loadProgram({0x06, 0x42});  // LD B,0x42
+    cpu.setD(0x00);
+    cpu.executeInstruction();
+
+    EXPECT_EQ(cpu.getB(), 0x42);                  // B should be loaded
+    EXPECT_EQ(cpu.getD(), 0x00);                  // D should be untouched
+    EXPECT_EQ(cpu.getPC(), 0x0102);               // PC should skip the operand
+}
+
+// Test for register to register loads
+TEST_F(CPULdTest, LD_r8_r8) {
+    cpu.setC(0x12);
+    cpu.execute(0x41);  // LD B,C
+    cpu.execute(0x50);  // LD D,B
+    cpu.execute(0x7A);  // LD A,D
+
+    EXPECT_EQ(cpu.getB(), 0x12);
+    EXPECT_EQ(cpu.getD(), 0x12);
+    EXPECT_EQ(cpu.getA(), 0x12);
+}
+
+// Test for 16-bit immediate loads, little endian
+TEST_F(CPULdTest, LD_r16_d16) {
+    loadProgram({0x01, 0x34, 0x12, 0x31, 0xF0, 0xDF});  // LD BC,0x1234 / LD SP,0xDFF0
+    cpu.executeInstruction();
+    cpu.executeInstruction();
+
+    EXPECT_EQ(cpu.getBC(), 0x1234);
+    EXPECT_EQ(cpu.getSP(), 0xDFF0);
+}
+
+// Test for loads through (HL), including the post increment and decrement forms
+TEST_F(CPULdTest, LD_MemHL) {
+    cpu.setHL(0xC000);
+    cpu.setA(0x99);
+    cpu.execute(0x22);  // LD (HL+),A
+    cpu.execute(0x77);  // LD (HL),A
+    cpu.execute(0x32);  // LD (HL-),A
+
+    EXPECT_EQ(cpu.readMemory(0xC000), 0x99);
+    EXPECT_EQ(cpu.readMemory(0xC001), 0x99);
+    EXPECT_EQ(cpu.getHL(), 0xC000);
+
+    cpu.writeMemory(0xC000, 0x5A);
+    cpu.execute(0x4E);  // LD C,(HL)
+    EXPECT_EQ(cpu.getC(), 0x5A);
+}
+
+// Test for LD (a16),SP, stored little endian
+TEST_F(CPULdTest, LD_MemA16_SP) {
+    loadProgram({0x08, 0x00, 0xC1});  // LD (0xC100),SP
+    cpu.setSP(0xBEEF);
+    cpu.executeInstruction();
+
+    EXPECT_EQ(cpu.readMemory(0xC100), 0xEF);
+    EXPECT_EQ(cpu.readMemory(0xC101), 0xBE);
+}
+
+// Test for the high page loads LDH and LD (C)
+TEST_F(CPULdTest, LDH) {
+    loadProgram({0xE0, 0x80, 0xF0, 0x81});  // LDH (0x80),A / LDH A,(0x81)
+    cpu.setA(0x11);
+    cpu.writeMemory(0xFF81, 0x22);
+    cpu.executeInstruction();
+    cpu.executeInstruction();
+
+    EXPECT_EQ(cpu.readMemory(0xFF80), 0x11);
+    EXPECT_EQ(cpu.getA(), 0x22);
+
+    cpu.setC(0x82);
+    cpu.execute(0xE2);  // LD (C),A
+    EXPECT_EQ(cpu.readMemory(0xFF82), 0x22);
+}
+
+// Test for LD HL,SP+r8 with a negative offset
+TEST_F(CPULdTest, LD_HL_SP_r8) {
+    loadProgram({0xF8, 0xFF});  // LD HL,SP-1
+    cpu.setSP(0x0001);
+    cpu.executeInstruction();
+
+    EXPECT_EQ(cpu.getHL(), 0x0000);
+    EXPECT_TRUE(cpu.getHalfCarryFlag());          // 0x1 + 0xF carries out of bit 3
+    EXPECT_TRUE(cpu.getCarryFlag());              // 0x01 + 0xFF carries out of bit 7
+    EXPECT_FALSE(cpu.getZeroFlag());              // Zero flag is always cleared
+}
@@ -0,0 +1,309 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "cpu.hpp"
+#include "mapper.hpp"
+
+class MapperTest : public ::testing::Test {
+protected:
+    emulator::MemoryBus bus;
+    emulator::Mapper mapper{bus};
+    emulator::Rom rom;
+
+    // ROM of `banks` banks, each starting with its index (low byte, high byte)
+    void loadCartridge(const uint8_t type, const std::size_t banks, const uint8_t ramSize = 0) {
+        std::vector<uint8_t> image(banks * emulator::Rom::BANK_SIZE, 0x00);
+
+        for (std::size_t bank = 0; bank < banks; ++bank) {
+            image[bank * emulator::Rom::BANK_SIZE] = bank & 0xFF;
+            image[bank * emulator::Rom::BANK_SIZE + 1] = bank >> 8;
+        }
+        image[emulator::CartridgeHeader::TYPE] = type;
+        image[emulator::CartridgeHeader::RAM_SIZE] = ramSize;
+        rom.assign(image.data(), image.size());
+        mapper.load(rom);
+    }
+
+    [[nodiscard]] std::size_t bankAt(const uint16_t addr) const {
+        return bus.read(addr) | (bus.read(addr + 1) << 8);
+    }
+};
+
+// Test that the cartridge type byte picks the controller and its extras
+TEST_F(MapperTest, MAPPER_ParseHeader) {
+    loadCartridge(0x03, 4, 0x03);
+    EXPECT_EQ(mapper.getType(), emulator::MapperType::Mbc1);
+    EXPECT_EQ(mapper.getHeader().ramSize, 0x8000u);
+    EXPECT_TRUE(mapper.getHeader().battery);
+
+    loadCartridge(0x06, 4);
+    EXPECT_EQ(mapper.getType(), emulator::MapperType::Mbc2);
+    EXPECT_EQ(mapper.getRam().size(), emulator::Mapper::MBC2_RAM_SIZE);
+
+    loadCartridge(0x10, 4, 0x02);
+    EXPECT_EQ(mapper.getType(), emulator::MapperType::Mbc3);
+    EXPECT_TRUE(mapper.getHeader().timer);
+
+    loadCartridge(0x1A, 4, 0x04);
+    EXPECT_EQ(mapper.getType(), emulator::MapperType::Mbc5);
+    EXPECT_FALSE(mapper.getHeader().battery);
+
+    loadCartridge(0xFC, 4);
+    EXPECT_EQ(mapper.getType(), emulator::MapperType::Unsupported);
+}
+
+// Test that a switch repoints the pages into the image instead of copying the bank
+TEST_F(MapperTest, MAPPER_SwitchRepointsPages) {
+    loadCartridge(0x01, 8);
+
+    EXPECT_EQ(bankAt(0x4000), 1u);
+    bus.write(0x2000, 5);
+    EXPECT_EQ(bankAt(0x4000), 5u);
+    EXPECT_EQ(bankAt(0x0000), 0u);
+    for (uint8_t page = 0x40; page < 0x80; ++page) {
+        EXPECT_EQ(bus.readPage(page), rom.bank(5) + (page - 0x40) * emulator::MemoryBus::PAGE_SIZE);
+        EXPECT_EQ(bus.bank(page), 5u);
+    }
+
+    // ROM writes never reach the image
+    EXPECT_EQ(rom.bank(0)[0x2000], 0x00);
+}
+
+// Test the MBC1 bank 0 quirk, the upper bits and the banking mode
+TEST_F(MapperTest, MAPPER_Mbc1Banking) {
+    loadCartridge(0x03, 128, 0x03);
+
+    bus.write(0x2000, 0x00);
+    EXPECT_EQ(bankAt(0x4000), 1u);
+    bus.write(0x2000, 0x20);  // Only 5 bits: 0 again
+    EXPECT_EQ(bankAt(0x4000), 1u);
+
+    bus.write(0x4000, 0x01);
+    EXPECT_EQ(bankAt(0x4000), 0x21u);
+    EXPECT_EQ(bankAt(0x0000), 0u);
+
+    bus.write(0x6000, 0x01);  // Mode 1: the upper bits also bank 0x0000 and the RAM
+    EXPECT_EQ(bankAt(0x0000), 0x20u);
+    EXPECT_EQ(mapper.getRamBank(), 1u);
+
+    bus.write(0x0000, 0x0A);
+    bus.write(0xA000, 0x11);
+    bus.write(0x4000, 0x02);
+    EXPECT_EQ(bus.read(0xA000), 0xFF);  // Fresh bank
+    bus.write(0x4000, 0x01);
+    EXPECT_EQ(bus.read(0xA000), 0x11);
+    EXPECT_EQ(mapper.getRam()[0x2000], 0x11);
+}
+
+// Test that cartridge RAM only answers while enabled
+TEST_F(MapperTest, MAPPER_RamEnable) {
+    loadCartridge(0x02, 4, 0x02);
+
+    bus.write(0xA123, 0x42);
+    EXPECT_EQ(bus.read(0xA123), 0xFF);
+    EXPECT_EQ(mapper.getRam()[0x123], 0xFF);
+
+    bus.write(0x0000, 0x0A);
+    EXPECT_TRUE(mapper.isRamEnabled());
+    bus.write(0xA123, 0x42);
+    EXPECT_EQ(bus.read(0xA123), 0x42);
+
+    bus.write(0x0000, 0x00);
+    EXPECT_EQ(bus.read(0xA123), 0xFF);
+    EXPECT_EQ(mapper.getRam()[0x123], 0x42);
+}
+
+// Test MBC2's address-selected registers and its 4-bit, mirrored RAM
+TEST_F(MapperTest, MAPPER_Mbc2) {
+    loadCartridge(0x05, 16);
+
+    bus.write(0x2000, 0x03);  // Bit 8 clear: RAM enable register
+    EXPECT_EQ(bankAt(0x4000), 1u);
+    bus.write(0x2100, 0x03);
+    EXPECT_EQ(bankAt(0x4000), 3u);
+
+    bus.write(0x0000, 0x0A);
+    bus.write(0xA005, 0x5C);
+    EXPECT_EQ(bus.read(0xA005), 0xFC);
+    EXPECT_EQ(bus.read(0xA205), 0xFC);  // Mirrored every 512 bytes
+    EXPECT_EQ(bus.read(0xBE05), 0xFC);
+}
+
+// Test MBC3 RAM banks and its clock: latched reads, halt, carry
+TEST_F(MapperTest, MAPPER_Mbc3Clock) {
+    loadCartridge(0x10, 8, 0x03);
+
+    bus.write(0x2000, 0x00);
+    EXPECT_EQ(bankAt(0x4000), 1u);
+    bus.write(0x2000, 0x07);
+    EXPECT_EQ(bankAt(0x4000), 7u);
+
+    bus.write(0x0000, 0x0A);
+    bus.write(0x4000, 0x02);
+    bus.write(0xA000, 0x22);
+    EXPECT_EQ(mapper.getRam()[2 * emulator::Mapper::RAM_BANK_SIZE], 0x22);
+
+    bus.write(0x4000, 0x08);  // Seconds
+    bus.write(0xA000, 58);
+    mapper.clock(3 * emulator::Mapper::RTC_CLOCK);
+    EXPECT_EQ(bus.read(0xA000), 58);  // Not latched yet
+
+    bus.write(0x6000, 0x00);
+    bus.write(0x6000, 0x01);
+    EXPECT_EQ(bus.read(0xA000), 1);
+    bus.write(0x4000, 0x09);
+    EXPECT_EQ(bus.read(0xA000), 1);  // Minutes
+
+    bus.write(0x4000, 0x0C);
+    bus.write(0xA000, 0x40);  // Halt
+    mapper.clock(10 * emulator::Mapper::RTC_CLOCK);
+    bus.write(0x6000, 0x00);
+    bus.write(0x6000, 0x01);
+    bus.write(0x4000, 0x08);
+    EXPECT_EQ(bus.read(0xA000), 1);
+
+    bus.write(0x4000, 0x02);
+    EXPECT_EQ(bus.read(0xA000), 0x22);
+}
+
+// Test MBC5's 9-bit ROM bank, which can be 0, and its 16 RAM banks
+TEST_F(MapperTest, MAPPER_Mbc5) {
+    loadCartridge(0x1B, 512, 0x04);
+
+    bus.write(0x2000, 0x00);
+    EXPECT_EQ(bankAt(0x4000), 0u);
+    bus.write(0x2000, 0x34);
+    bus.write(0x3000, 0x01);
+    EXPECT_EQ(bankAt(0x4000), 0x134u);
+
+    bus.write(0x0000, 0x0A);
+    bus.write(0x4000, 0x0F);
+    bus.write(0xBFFF, 0x99);
+    EXPECT_EQ(mapper.getRam()[0x20000 - 1], 0x99);  // 128KB: banks wrap at 16
+}
+
+// Test that code cached in one bank isn't replayed from another
+TEST_F(MapperTest, MAPPER_CodeCachedPerBank) {
+    std::vector<uint8_t> image(4 * emulator::Rom::BANK_SIZE, 0x00);
+    const std::vector<uint8_t> main = {
+        0x31, 0xFE, 0xDF,  // LD SP,0xDFFE
+        0x3E, 0x02,        // LD A,2
+        0xEA, 0x00, 0x20,  // LD (0x2000),A   select bank 2
+        0xCD, 0x00, 0x40,  // CALL 0x4000
+        0x3E, 0x03,        // LD A,3
+        0xEA, 0x00, 0x20,  // LD (0x2000),A   select bank 3
+        0xCD, 0x00, 0x40,  // CALL 0x4000
+        0x76,              // HALT
+    };
+    std::copy(main.begin(), main.end(), image.begin() + 0x0100);
+    image[emulator::CartridgeHeader::TYPE] = 0x01;
+    // Each bank's routine has another instruction count: LD A,bank*10,
+    // `bank` times INC A, LD (0xC000 + bank),A, RET
+    for (uint8_t bank = 1; bank < 4; ++bank) {
+        std::vector<uint8_t> routine = {0x3E, static_cast<uint8_t>(bank * 10)};
+
+        routine.insert(routine.end(), bank, 0x3C);
+        routine.insert(routine.end(), {0xEA, bank, 0xC0, 0xC9});
+        std::copy(routine.begin(), routine.end(), image.begin() + bank * emulator::Rom::BANK_SIZE);
+    }
+
+    emulator::CPU cpu;
+    emulator::Mapper cartridge(cpu.getMemoryBus());
+
+    rom.assign(image.data(), image.size());
+    cpu.reset();
+    cpu.writeMemory(0xFFFF, 0x00);
+    cartridge.load(rom);
+    cpu.runCached(100);
+
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    EXPECT_EQ(cpu.readMemory(0xC002), 22);
+    EXPECT_EQ(cpu.readMemory(0xC003), 33);
+}
+
+class SaveFileTest : public MapperTest {
+protected:
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / ("gcolor_test_" + std::to_string(getpid()) + ".sav");
+
+    void TearDown() override {
+        mapper.unload();
+        std::filesystem::remove(path);
+    }
+
+    [[nodiscard]] std::vector<uint8_t> fileBytes() const {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+};
+
+// Test that battery RAM is the file's bytes and comes back on the next load
+TEST_F(SaveFileTest, SAVE_RamPersists) {
+    loadCartridge(0x03, 4, 0x03);  // MBC1, 32KB RAM, battery
+    ASSERT_TRUE(mapper.attachSave(path));
+    EXPECT_EQ(mapper.getRam().data(), mapper.getSave().data());
+
+    bus.write(0x0000, 0x0A);
+    bus.write(0x6000, 0x01);
+    bus.write(0x4000, 0x02);
+    bus.write(0xA001, 0x42);
+    EXPECT_EQ(bus.read(0xA001), 0x42);
+    mapper.flushSave();
+
+    const std::vector<uint8_t> bytes = fileBytes();
+    ASSERT_EQ(bytes.size(), 0x8000u);
+    EXPECT_EQ(bytes[2 * emulator::Mapper::RAM_BANK_SIZE + 1], 0x42);
+    EXPECT_EQ(bytes[0], 0xFF);
+
+    mapper.unload();
+    loadCartridge(0x03, 4, 0x03);
+    EXPECT_EQ(mapper.getRam()[2 * emulator::Mapper::RAM_BANK_SIZE + 1], 0xFF);
+    ASSERT_TRUE(mapper.attachSave(path));
+    EXPECT_EQ(mapper.getRam()[2 * emulator::Mapper::RAM_BANK_SIZE + 1], 0x42);
+}
+
+// Test that the MBC3 clock is saved in the footer and restored
+TEST_F(SaveFileTest, SAVE_ClockFooter) {
+    loadCartridge(0x10, 4, 0x02);  // MBC3, timer, 8KB RAM, battery
+    ASSERT_TRUE(mapper.attachSave(path));
+    bus.write(0x0000, 0x0A);
+    bus.write(0x4000, 0x09);  // Minutes
+    bus.write(0xA000, 17);
+    mapper.flushSave();
+
+    const std::vector<uint8_t> bytes = fileBytes();
+    ASSERT_EQ(bytes.size(), 0x2000u + emulator::Mapper::RTC_SAVE_SIZE);
+    EXPECT_EQ(bytes[0x2000 + 4], 17);
+
+    mapper.unload();
+    loadCartridge(0x10, 4, 0x02);
+    ASSERT_TRUE(mapper.attachSave(path));
+    bus.write(0x0000, 0x0A);
+    bus.write(0x4000, 0x09);
+    EXPECT_EQ(bus.read(0xA000), 17);
+}
+
+// Test that writes reach the disk from the background thread, and that carts without a battery don't save
+TEST_F(SaveFileTest, SAVE_BackgroundFlush) {
+    loadCartridge(0x02, 4, 0x02);
+    EXPECT_FALSE(mapper.attachSave(path));
+    EXPECT_FALSE(std::filesystem::exists(path));
+
+    loadCartridge(0x1B, 4, 0x03);
+    ASSERT_TRUE(mapper.attachSave(path, std::chrono::milliseconds(5)));
+    bus.write(0x0000, 0x0A);
+    for (int i = 0; i < 1000; ++i)
+        bus.write(0xA000 + (i & 0xFF), static_cast<uint8_t>(i));
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (mapper.getSave().getSyncCount() == 0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_GT(mapper.getSave().getSyncCount(), 0u);
+    EXPECT_EQ(fileBytes()[999 & 0xFF], static_cast<uint8_t>(999));
+}
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <vector>
+#include "cpu.hpp"
+#include "memory_bus.hpp"
+
+class MemoryBusTest : public ::testing::Test {
+protected:
+    // Records the accesses it receives, reads return the low address byte
+    class RecordingHandler : public emulator::MemoryHandler {
+    public:
+        std::vector<uint16_t> reads;
+        std::vector<std::pair<uint16_t, uint8_t>> writes;
+
+        uint8_t read(const uint16_t addr) override {
+            reads.push_back(addr);
+            return addr & 0xFF;
+        }
+        void write(const uint16_t addr, const uint8_t value) override { writes.emplace_back(addr, value); }
+    };
+
+    // Takes bulk transfers into `target` whole
+    class TargetHandler : public RecordingHandler {
+    public:
+        std::array<uint8_t, 0x200> target{};
+        std::vector<std::pair<uint16_t, uint16_t>> copies;
+
+        uint8_t* copyTarget(const uint16_t addr, const uint16_t length) override {
+            copies.emplace_back(addr, length);
+            return target.data() + (addr & 0x1FF);
+        }
+    };
+
+    emulator::MemoryBus bus;
+    RecordingHandler handler;
+};
+
+// Test that every page starts as read-write memory
+TEST_F(MemoryBusTest, MEMORY_FlatByDefault) {
+    for (const uint16_t addr : {0x0000, 0x0150, 0x8000, 0xC123, 0xFF80, 0xFFFF}) {
+        bus.write(addr, addr >> 8);
+        EXPECT_EQ(bus.read(addr), addr >> 8);
+        EXPECT_EQ(bus.fetch(addr), addr >> 8);
+        EXPECT_TRUE(bus.isWritable(addr >> 8));
+    }
+}
+
+// Test that a read-only page is read from its buffer and its writes reach the handler
+TEST_F(MemoryBusTest, MEMORY_ReadOnlyPages) {
+    std::array<uint8_t, 0x4000> rom{};
+    rom[0x0000] = 0x11;
+    rom[0x3FFF] = 0x22;
+
+    bus.mapReadOnly(0x40, 0x40, rom.data(), &handler);
+    bus.write(0x2000, 0x33);  // Below the mapping
+    bus.write(0x4000, 0x44);
+
+    EXPECT_EQ(bus.read(0x4000), 0x11);
+    EXPECT_EQ(bus.read(0x7FFF), 0x22);
+    EXPECT_EQ(bus.fetch(0x7FFF), 0x22);
+    EXPECT_EQ(bus.read(0x2000), 0x33);
+    EXPECT_EQ(rom[0x0000], 0x11);
+    ASSERT_EQ(handler.writes.size(), 1u);
+    EXPECT_EQ(handler.writes[0], std::make_pair(uint16_t{0x4000}, uint8_t{0x44}));
+    EXPECT_TRUE(handler.reads.empty());
+    EXPECT_FALSE(bus.isWritable(0x40));
+    EXPECT_TRUE(bus.isWritable(0x20));
+}
+
+// Test that a read-only page without a handler drops its writes
+TEST_F(MemoryBusTest, MEMORY_ReadOnlyWithoutHandler) {
+    const std::array<uint8_t, emulator::MemoryBus::PAGE_SIZE> page{0x5A};
+
+    bus.mapReadOnly(0x01, 1, page.data());
+    bus.write(0x0100, 0x00);
+    EXPECT_EQ(bus.read(0x0100), 0x5A);
+}
+
+// Test that handler pages get every read and write, and fetch as open bus
+TEST_F(MemoryBusTest, MEMORY_HandlerPages) {
+    bus.mapHandler(0xA0, 0x20, &handler);
+
+    EXPECT_EQ(bus.read(0xA0C3), 0xC3);
+    EXPECT_EQ(bus.read(0xBFFF), 0xFF);
+    bus.write(0xB000, 0x0A);
+    EXPECT_EQ(bus.fetch(0xA000), 0xFF);
+
+    EXPECT_EQ(handler.reads, (std::vector<uint16_t>{0xA0C3, 0xBFFF}));
+    ASSERT_EQ(handler.writes.size(), 1u);
+    EXPECT_EQ(handler.writes[0], std::make_pair(uint16_t{0xB000}, uint8_t{0x0A}));
+    EXPECT_EQ(bus.readPage(0xA0), nullptr);
+    EXPECT_FALSE(bus.isWritable(0xA0));
+}
+
+// Test that unmapped pages are back on the flat memory, with its old contents
+TEST_F(MemoryBusTest, MEMORY_Unmap) {
+    std::array<uint8_t, emulator::MemoryBus::PAGE_SIZE> page{};
+
+    bus.write(0xC000, 0x77);
+    bus.map(0xC0, 1, page.data());
+    bus.write(0xC000, 0x88);
+    EXPECT_EQ(page[0], 0x88);
+
+    bus.unmap(0xC0, 1);
+    EXPECT_EQ(bus.read(0xC000), 0x77);
+}
+
+// Test that a copy has its own flat memory but shares the external mappings
+TEST_F(MemoryBusTest, MEMORY_CopyRebasesFlatPages) {
+    std::array<uint8_t, emulator::MemoryBus::PAGE_SIZE> page{};
+
+    bus.map(0xD0, 1, page.data());
+    bus.write(0xC000, 0x01);
+
+    emulator::MemoryBus copy = bus;
+    copy.write(0xC000, 0x02);
+    copy.write(0xD000, 0x03);
+
+    EXPECT_EQ(bus.read(0xC000), 0x01);
+    EXPECT_EQ(copy.read(0xC000), 0x02);
+    EXPECT_EQ(bus.read(0xD000), 0x03);
+}
+
+// Test that the CPU runs from a read-only page and its writes there don't change the code
+TEST_F(MemoryBusTest, MEMORY_CpuRunsFromReadOnlyPage) {
+    emulator::CPU cpu;
+    std::array<uint8_t, emulator::MemoryBus::PAGE_SIZE> rom{
+        0x3E, 0x42,        // LD A,0x42
+        0xEA, 0x00, 0x40,  // LD (0x4000),A
+        0xEA, 0x00, 0xC0,  // LD (0xC000),A
+        0x76,              // HALT
+    };
+
+    cpu.reset();
+    cpu.writeMemory(0xFFFF, 0x00);
+    cpu.getMemoryBus().mapReadOnly(0x40, 1, rom.data(), &handler);
+    cpu.setPC(0x4000);
+    cpu.run(4);
+
+    EXPECT_EQ(cpu.readMemory(0x4000), 0x3E);
+    EXPECT_EQ(cpu.readMemory(0xC000), 0x42);
+    ASSERT_EQ(handler.writes.size(), 1u);
+    EXPECT_EQ(handler.writes[0], std::make_pair(uint16_t{0x4000}, uint8_t{0x42}));
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+}
+
+// Test 16-bit fetches inside a page, across two pages and at the end of the address space
+TEST_F(MemoryBusTest, MEMORY_FetchWord) {
+    std::array<uint8_t, emulator::MemoryBus::PAGE_SIZE> rom{};
+    rom[0x00] = 0x34;
+    rom[0x01] = 0x12;
+    rom[0xFF] = 0xCD;
+
+    bus.mapReadOnly(0x40, 1, rom.data(), &handler);
+    bus.write(0x4100, 0xAB);
+    bus.write(0xFFFF, 0x78);
+    bus.write(0x0000, 0x56);
+    bus.mapHandler(0x80, 1, &handler);
+
+    EXPECT_EQ(bus.fetchWord(0x4000), 0x1234);
+    EXPECT_EQ(bus.fetchWord(0x40FF), 0xABCD);
+    EXPECT_EQ(bus.fetchWord(0xFFFF), 0x5678);
+    EXPECT_EQ(bus.fetchWord(0x8010), 0xFFFF);  // Open bus
+    EXPECT_TRUE(handler.reads.empty());
+}
+
+// Test that copy() moves direct pages in bulk and goes through the handler elsewhere
+TEST_F(MemoryBusTest, MEMORY_Copy) {
+    std::array<uint8_t, 0x200> source{};
+    for (std::size_t i = 0; i < source.size(); ++i)
+        source[i] = static_cast<uint8_t>(i * 3);
+    bus.mapReadOnly(0x40, 2, source.data());
+
+    bus.copy(0x8080, 0x4010, 0x100);  // Crosses a page boundary on both sides, apart
+    for (uint16_t i = 0; i < 0x100; ++i)
+        EXPECT_EQ(bus.read(0x8080 + i), source[0x10 + i]);
+    EXPECT_EQ(bus.read(0x807F), 0x00);
+    EXPECT_EQ(bus.read(0x8180), 0x00);
+
+    bus.mapHandler(0xA0, 1, &handler);
+    bus.copy(0xA010, 0x4000, 4);
+    bus.copy(0xC000, 0xA020, 2);
+    ASSERT_EQ(handler.writes.size(), 4u);
+    EXPECT_EQ(handler.writes[3], std::make_pair(uint16_t{0xA013}, source[3]));
+    EXPECT_EQ(handler.reads, (std::vector<uint16_t>{0xA020, 0xA021}));
+    EXPECT_EQ(bus.read(0xC001), 0x21);
+}
+
+// Test that a copy() onto a handler's copyTarget() asks once and pages through the source only
+TEST_F(MemoryBusTest, MEMORY_CopyTarget) {
+    std::array<uint8_t, 0x200> source{};
+    for (std::size_t i = 0; i < source.size(); ++i)
+        source[i] = static_cast<uint8_t>(i * 5);
+    TargetHandler target;
+    bus.mapReadOnly(0x40, 2, source.data());
+    bus.mapReadOnly(0x80, 2, target.target.data(), &target);
+    bus.mapHandler(0xA0, 1, &handler);
+
+    bus.copy(0x8010, 0x4080, 0x100);  // The source crosses a page, the destination doesn't
+    ASSERT_EQ(target.copies.size(), 1u);
+    EXPECT_EQ(target.copies[0], std::make_pair(uint16_t{0x8010}, uint16_t{0x100}));
+    for (uint16_t i = 0; i < 0x100; ++i)
+        EXPECT_EQ(bus.read(0x8010 + i), source[0x80 + i]);
+    EXPECT_TRUE(target.writes.empty());
+
+    bus.copy(0x8180, 0xA004, 2);  // From a handler page
+    EXPECT_EQ(handler.reads, (std::vector<uint16_t>{0xA004, 0xA005}));
+    EXPECT_EQ(bus.read(0x8181), 0x05);
+    EXPECT_TRUE(target.writes.empty());
+}
@@ -0,0 +1,398 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "frame_colors.hpp"
+#include "line_mix.hpp"
+#include "ppu.hpp"
+#include "tile_decode.hpp"
+
+class PpuTest : public ::testing::Test {
+protected:
+    std::array<uint8_t, 2 * emulator::Ppu::VRAM_BANK_SIZE> vram{};
+    std::array<uint8_t, 256> oam{};
+    std::array<uint8_t, 256> io{};
+    std::array<uint8_t, emulator::Ppu::PALETTE_SIZE> palettes{};
+    emulator::Ppu ppu{vram.data(), oam.data(), io.data(), palettes.data()};
+
+    void SetUp() override {
+        io[0x40] = 0x93;  // LCDC: on, tiles at 0x8000, objects, background
+        io[0x47] = 0xE4;  // BGP: shade = color
+        io[0x48] = 0xE4;
+        io[0x49] = 0x1B;  // OBP1: reversed
+        ppu.setColor(false);
+    }
+
+    // Fills row `row` of tile `tile` (at 0x8000) in `bank`
+    void setTileRow(const uint8_t tile, const uint8_t row, const uint8_t low, const uint8_t high, const int bank = 0) {
+        const std::size_t offset = bank * emulator::Ppu::VRAM_BANK_SIZE + tile * 16 + row * 2;
+        vram[offset] = low;
+        vram[offset + 1] = high;
+        ppu.invalidateTile(offset);
+    }
+
+    std::vector<uint8_t> line(const uint8_t ly, const std::size_t from, const std::size_t count) const {
+        const uint8_t* pixels = ppu.getLine(ly) + from;
+        return {pixels, pixels + count};
+    }
+};
+
+// Test that the decoders agree with a pixel at a time for every pair of plane bytes
+TEST_F(PpuTest, PPU_DecodeTileRow) {
+    std::vector<uint8_t> planes;
+    for (int high = 0; high < 256; ++high) {
+        for (int low = 0; low < 256; ++low) {
+            planes.push_back(low);
+            planes.push_back(high);
+        }
+    }
+
+    std::vector<uint8_t> expected;
+    for (std::size_t i = 0; i < planes.size(); i += 2)
+        for (int bit = 7; bit >= 0; --bit)
+            expected.push_back(((planes[i] >> bit) & 1) | ((planes[i + 1] >> bit) & 1) << 1);
+
+    // An odd count takes the tail path of the SIMD decoder too
+    const std::size_t count = planes.size() / 2 - 1;
+    std::vector<uint8_t> simd(count * 8), portable(count * 8);
+    emulator::decodeTileRows(planes.data(), count, simd.data());
+    emulator::decodeTileRowsPortable(planes.data(), count, portable.data());
+
+    expected.resize(count * 8);
+    EXPECT_EQ(simd, expected);
+    EXPECT_EQ(portable, expected);
+    EXPECT_EQ(emulator::tile::flip(0x81), 0x81);
+    EXPECT_EQ(emulator::tile::flip(0xC4), 0x23);
+}
+
+// Test that the mixers agree with a pixel at a time for every object and background byte
+TEST_F(PpuTest, PPU_MixObjects) {
+    std::vector<uint8_t> objects, background;
+    for (int over = 0; over < 256; ++over) {
+        for (const uint8_t under : {0x00, 0x01, 0x02, 0x03, 0x80, 0x81, 0x82, 0x83}) {
+            objects.push_back(over);
+            background.push_back(under);
+        }
+    }
+
+    // DMG, CGB, CGB with LCDC bit 0 clear
+    const uint8_t priorities[][2] = {{0x80, 0x00}, {0x80, 0x80}, {0x00, 0x00}};
+    for (const auto& priority : priorities) {
+        std::vector<uint8_t> expected(objects.size());
+        for (std::size_t i = 0; i < objects.size(); ++i) {
+            const bool behind = ((objects[i] & priority[0]) | (background[i] & priority[1])) & 0x80;
+            const bool shown = (objects[i] & emulator::mix::OPAQUE) && !((background[i] & 0x03) && behind);
+            expected[i] = shown ? objects[i] & emulator::mix::INDEX : 0x1D;
+        }
+
+        // An odd count takes the tail paths too
+        const std::size_t count = objects.size() - 3;
+        std::vector<uint8_t> simd(count, 0x1D), portable(count, 0x1D);
+        emulator::mixObjects(simd.data(), background.data(), objects.data(), count, priority[0], priority[1]);
+        emulator::mixObjectsPortable(portable.data(), background.data(), objects.data(), count, priority[0], priority[1]);
+
+        expected.resize(count);
+        EXPECT_EQ(simd, expected);
+        EXPECT_EQ(portable, expected);
+    }
+}
+
+// Test the color tables with and without correction, and that they are built once per mode
+TEST_F(PpuTest, PPU_ColorTables) {
+    emulator::ColorConverter converter;
+    const auto bytes = [&](const uint16_t color) {
+        const uint32_t pixel = converter.toRgba(color);
+        std::array<uint8_t, 4> rgba{};
+        std::memcpy(rgba.data(), &pixel, sizeof(pixel));
+        return rgba;
+    };
+
+    EXPECT_EQ(bytes(0x7FFF), (std::array<uint8_t, 4>{255, 255, 255, 255}));
+    EXPECT_EQ(bytes(0x001F), (std::array<uint8_t, 4>{255, 0, 0, 255}));  // Red in the low bits
+    EXPECT_EQ(bytes(0x4210), (std::array<uint8_t, 4>{132, 132, 132, 255}));
+    EXPECT_EQ(converter.toRgb565(0x001F), 0xF800);
+    EXPECT_EQ(converter.toRgb565(0x03E0), 0x07E0);
+    EXPECT_EQ(converter.toRgb565(0xFC00), 0x001F);      // Bit 15 ignored
+
+    converter.setCorrection(emulator::ColorCorrection::Lcd);
+    EXPECT_EQ(bytes(0x7FFF), (std::array<uint8_t, 4>{240, 240, 240, 255}));
+    EXPECT_EQ(bytes(0x001F), (std::array<uint8_t, 4>{201, 0, 46, 255}));  // Red bleeds into blue
+    converter.setCorrection(emulator::ColorCorrection::Lcd);
+    EXPECT_EQ(converter.getTableBuilds(), 2u);
+}
+
+// Test that the converters agree with a lookup at a time, for both pixel sizes
+TEST_F(PpuTest, PPU_ConvertColors) {
+    emulator::ColorConverter converter{emulator::ColorCorrection::Lcd};
+
+    // Every color, with bit 15 set on some; an odd count takes the tail paths too
+    std::vector<uint16_t> colors(0x8000 + 11);
+    for (std::size_t i = 0; i < colors.size(); ++i)
+        colors[i] = static_cast<uint16_t>(i * 0x2F1 + (i & 0x8000));
+    colors.back() = 0x7FFF;
+
+    std::vector<uint32_t> table(emulator::ColorConverter::COLORS);
+    std::vector<uint16_t> table16(emulator::ColorConverter::COLORS + 1);
+    for (uint16_t color = 0; color < 0x8000; ++color) {
+        table[color] = converter.toRgba(color);
+        table16[color] = converter.toRgb565(color);
+    }
+
+    std::vector<uint32_t> expected(colors.size()), wide(colors.size()), widePortable(colors.size());
+    std::vector<uint16_t> expected16(colors.size()), narrow(colors.size()), narrowPortable(colors.size());
+    for (std::size_t i = 0; i < colors.size(); ++i) {
+        expected[i] = table[colors[i] & 0x7FFF];
+        expected16[i] = table16[colors[i] & 0x7FFF];
+    }
+
+    emulator::convertColors(colors.data(), colors.size(), table.data(), wide.data());
+    emulator::convertColorsPortable(colors.data(), colors.size(), table.data(), widePortable.data());
+    emulator::convertColors(colors.data(), colors.size(), table16.data(), narrow.data());
+    emulator::convertColorsPortable(colors.data(), colors.size(), table16.data(), narrowPortable.data());
+    EXPECT_EQ(wide, expected);
+    EXPECT_EQ(widePortable, expected);
+    EXPECT_EQ(narrow, expected16);
+    EXPECT_EQ(narrowPortable, expected16);
+}
+
+// Test that each line takes its colors from the palette memory as it is drawn, or the DMG shades
+TEST_F(PpuTest, PPU_LineColors) {
+    setTileRow(1, 0, 0xFF, 0x00);       // Color 1 on the even rows
+    setTileRow(1, 2, 0xFF, 0x00);
+    vram[0x1800 + 1] = 1;
+    oam[0] = 16;
+    oam[1] = 8 + 20;
+    oam[2] = 1;
+    oam[3] = 0x02;                      // CGB object palette 2
+
+    palettes[2] = 0x1F;                 // Background palette 0, color 1: red
+    palettes[64 + 2 * (2 * 4 + 1) + 1] = 0x7C;  // Object palette 2, color 1: blue
+    ppu.invalidatePalettes();
+    ppu.setColor(true);
+    ppu.renderLine(0);
+
+    palettes[2] = 0xE0;                 // Green from line 2
+    palettes[3] = 0x03;
+    ppu.invalidatePalettes();
+    ppu.renderLine(2);
+
+    EXPECT_EQ(ppu.getColorLine(0)[0], 0x0000);
+    EXPECT_EQ(ppu.getColorLine(0)[8], 0x001F);
+    EXPECT_EQ(ppu.getColorLine(0)[20], 0x7C00);
+    EXPECT_EQ(ppu.getColorLine(2)[8], 0x03E0);
+
+    emulator::ColorConverter converter;
+    std::vector<uint16_t> pixels(emulator::ColorConverter::PIXELS);
+    converter.convert(ppu, pixels.data());
+    EXPECT_EQ(pixels[8], 0xF800);
+    EXPECT_EQ(pixels[20], 0x001F);
+    EXPECT_EQ(pixels[2 * emulator::Ppu::WIDTH + 8], 0x07E0);
+
+    ppu.setColor(false);
+    ppu.renderLine(0);
+    EXPECT_EQ(ppu.getColorLine(0)[0], emulator::Ppu::DMG_SHADES[0]);
+    EXPECT_EQ(ppu.getColorLine(0)[8], emulator::Ppu::DMG_SHADES[1]);
+    EXPECT_EQ(ppu.getColorLine(0)[20], emulator::Ppu::DMG_SHADES[1]);
+}
+
+// Test that the background is drawn from the map, scrolled and through BGP
+TEST_F(PpuTest, PPU_Background) {
+    setTileRow(1, 3, 0xF0, 0x0F);  // 1 1 1 1 2 2 2 2
+    vram[0x1800 + 2 * 32 + 1] = 1;  // Map row 2, column 1
+
+    ppu.renderLine(19);
+    EXPECT_EQ(line(19, 6, 12), (std::vector<uint8_t>{0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0}));
+
+    io[0x42] = 4;                   // SCY
+    io[0x43] = 11;                  // SCX
+    io[0x47] = 0x1B;                // BGP reversed
+    ppu.renderLine(15);
+    EXPECT_EQ(line(15, 0, 7), (std::vector<uint8_t>{2, 1, 1, 1, 1, 3, 3}));
+
+    io[0x40] = 0x92;                // DMG: LCDC bit 0 blanks the background
+    ppu.renderLine(15);
+    EXPECT_EQ(line(15, 0, 7), (std::vector<uint8_t>(7, 0)));
+}
+
+// Test that CGB tile attributes pick the palette, the bank and the flips
+TEST_F(PpuTest, PPU_CgbAttributes) {
+    ppu.setColor(true);
+    setTileRow(2, 0, 0xC0, 0x80, 1);   // 3 1 0 ... in bank 1
+    setTileRow(2, 7, 0x01, 0x00, 1);   // ... 0 1 on the last row
+    vram[0x1800] = 2;
+    vram[0x3800] = 0x08 | 0x05;        // Bank 1, palette 5
+    vram[0x1801] = 2;
+    vram[0x3801] = 0x08 | 0x02 | 0x20 | 0x40;  // Bank 1, palette 2, both flips
+
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 0, 3), (std::vector<uint8_t>{5 << 2 | 3, 5 << 2 | 1, 5 << 2}));
+    EXPECT_EQ(line(0, 8, 2), (std::vector<uint8_t>{2 << 2 | 1, 2 << 2}));
+}
+
+// Test that a line drawn in parts keeps each part's registers, the window counting once
+TEST_F(PpuTest, PPU_LineParts) {
+    setTileRow(1, 0, 0xFF, 0x00);
+    setTileRow(1, 1, 0xFF, 0xFF);
+    for (int column = 0; column < 32; ++column)
+        vram[0x1800 + column] = 1;
+    io[0x40] |= 0x20;               // Window from x 96, on line 0
+    io[0x4B] = 7 + 96;
+
+    ppu.renderLine(0, 0, 50);
+    io[0x42] = 1;                   // SCY
+    ppu.renderLine(0, 50, 120);
+    ppu.renderLine(0, 120, emulator::Ppu::WIDTH);
+    EXPECT_EQ(line(0, 48, 4), (std::vector<uint8_t>{1, 1, 3, 3}));
+    EXPECT_EQ(line(0, 94, 4), (std::vector<uint8_t>{3, 3, 1, 1}));  // Window row 0
+    EXPECT_EQ(ppu.getRenderedLines(), 1u);
+
+    io[0x42] = 0;
+    ppu.skipLine(1);                // Window row 1
+    ppu.renderLine(2);
+    EXPECT_EQ(line(2, 96, 1)[0], 0);  // Window row 2, empty
+}
+
+// Test that the window covers the background from WX - 7, on its own line count
+TEST_F(PpuTest, PPU_Window) {
+    setTileRow(1, 0, 0xFF, 0x00);
+    setTileRow(1, 1, 0xFF, 0xFF);
+    vram[0x1C00] = 1;
+    io[0x40] = 0x93 | 0x20 | 0x40;  // Window on, map at 0x9C00
+    io[0x4A] = 10;                  // WY
+    io[0x4B] = 7 + 12;              // WX
+
+    ppu.renderLine(0);
+    for (uint8_t ly = 9; ly <= 11; ++ly)
+        ppu.renderLine(ly);
+    EXPECT_EQ(line(9, 12, 1)[0], 0);
+    EXPECT_EQ(line(10, 11, 2), (std::vector<uint8_t>{0, 1}));
+    EXPECT_EQ(line(11, 12, 8), (std::vector<uint8_t>(8, 3)));  // Window line 1
+
+    io[0x4B] = 3;                   // Starts 4 pixels left of the screen
+    ppu.renderLine(0);
+    ppu.renderLine(10);
+    EXPECT_EQ(line(10, 0, 5), (std::vector<uint8_t>{1, 1, 1, 1, 0}));
+}
+
+// Test the object palettes, flips, 8x16 size, line limit and background priority
+TEST_F(PpuTest, PPU_Objects) {
+    setTileRow(4, 0, 0x80, 0x80);       // Color 3 on the left
+    setTileRow(5, 7, 0x01, 0x00);       // 8x16 bottom half, color 1 on the right
+    setTileRow(1, 0, 0xFF, 0x00);       // Background color 1
+    vram[0x1800 + 1] = 1;
+
+    const uint8_t objects[][4] = {
+        {16, 8, 4, 0x00},               // x 0, OBP0
+        {16, 16, 4, 0x10 | 0x80},       // x 8, OBP1, behind colors 1-3
+        {16, 30, 4, 0x20},              // x 22, flipped
+    };
+    for (std::size_t i = 0; i < std::size(objects); ++i)
+        std::copy(objects[i], objects[i] + 4, oam.begin() + 4 * i);
+
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 0, 1)[0], emulator::Ppu::OBJECT | 3);
+    EXPECT_EQ(line(0, 8, 1)[0], 1);      // Hidden by the background
+    EXPECT_EQ(line(0, 29, 1)[0], emulator::Ppu::OBJECT | 3);
+
+    // 8x16: the second tile on the bottom half, flipped vertically it comes first
+    io[0x40] |= 0x04;
+    oam[4 * 3] = 16 - 15;
+    oam[4 * 3 + 1] = 48;
+    oam[4 * 3 + 2] = 5;
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 47, 1)[0], emulator::Ppu::OBJECT | 1);
+    oam[4 * 3] = 16;
+    oam[4 * 3 + 3] = 0x40;
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 47, 1)[0], emulator::Ppu::OBJECT | 1);
+
+    // Only the first 10 objects on a line are drawn
+    io[0x40] &= ~0x04;
+    for (std::size_t i = 0; i < emulator::Ppu::OAM_OBJECTS; ++i) {
+        oam[4 * i] = 16 + 20;
+        oam[4 * i + 1] = 8 + 8 * i;
+        oam[4 * i + 2] = 4;
+        oam[4 * i + 3] = 0;
+    }
+    ppu.renderLine(20);
+    EXPECT_EQ(line(20, 72, 1)[0], emulator::Ppu::OBJECT | 3);
+    EXPECT_EQ(line(20, 80, 1)[0], 0);
+}
+
+// Test that the objects of a line are picked once, when its drawing starts
+TEST_F(PpuTest, PPU_ObjectsPerLine) {
+    setTileRow(4, 0, 0xFF, 0xFF);
+    setTileRow(4, 1, 0xFF, 0xFF);
+    oam[0] = 16;
+    oam[1] = 8 + 10;
+    oam[2] = 4;
+
+    ppu.renderLine(0, 0, 80);
+    oam[4] = 16 - 1;                // A second object, over lines 0 and 1
+    oam[5] = 8 + 100;
+    oam[6] = 4;
+    ppu.renderLine(0, 80, emulator::Ppu::WIDTH);
+    EXPECT_EQ(line(0, 10, 1)[0], emulator::Ppu::OBJECT | 3);
+    EXPECT_EQ(line(0, 100, 1)[0], 0);
+
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 100, 1)[0], emulator::Ppu::OBJECT | 3);
+}
+
+// Test that DMG objects sort by X and CGB ones by OAM index, and the CGB master priority
+TEST_F(PpuTest, PPU_ObjectOrder) {
+    setTileRow(4, 0, 0xFF, 0x00);       // Color 1
+    setTileRow(6, 0, 0xFF, 0xFF);       // Color 3
+    const uint8_t objects[][4] = {
+        {16, 12, 4, 0x00},              // First in OAM, right
+        {16, 10, 6, 0x01},              // Left, CGB palette 1
+    };
+    for (std::size_t i = 0; i < std::size(objects); ++i)
+        std::copy(objects[i], objects[i] + 4, oam.begin() + 4 * i);
+
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 4, 1)[0], emulator::Ppu::OBJECT | 3);
+
+    ppu.setColor(true);
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 4, 1)[0], emulator::Ppu::OBJECT | 1);
+    io[0x6C] = 0x01;                    // OPRI: by X as on the DMG
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 4, 1)[0], emulator::Ppu::OBJECT | 1 << 2 | 3);
+
+    // A tile with the priority attribute hides objects, unless LCDC bit 0 is clear
+    setTileRow(1, 0, 0xFF, 0x00);
+    vram[0x3800] = 0x80;
+    vram[0x1800] = 1;
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 4, 1)[0], 1);
+    io[0x40] &= ~0x01;
+    ppu.renderLine(0);
+    EXPECT_EQ(line(0, 4, 1)[0], emulator::Ppu::OBJECT | 1 << 2 | 3);
+}
+
+// Test that tiles are decoded once, then again only after a write to their bytes
+TEST_F(PpuTest, PPU_TileCache) {
+    const emulator::TileCache& cache = ppu.getTileCache();
+    setTileRow(1, 0, 0xF0, 0x00);
+    vram[0x1800] = 1;
+
+    ppu.renderLine(0);
+    EXPECT_EQ(cache.getDecodedTiles(), emulator::TileCache::TILES);
+    EXPECT_EQ(line(0, 0, 8), (std::vector<uint8_t>{1, 1, 1, 1, 0, 0, 0, 0}));
+    const uint8_t* mirrored = cache.row(1, 0, true);
+    EXPECT_EQ(std::vector<uint8_t>(mirrored, mirrored + 8), (std::vector<uint8_t>{0, 0, 0, 0, 1, 1, 1, 1}));
+
+    for (uint8_t ly = 0; ly < emulator::Ppu::HEIGHT; ++ly)
+        ppu.renderLine(ly);
+    EXPECT_EQ(cache.getDecodedTiles(), emulator::TileCache::TILES);
+
+    // The map isn't tile data; a write to the other bank's tile 1 is another tile
+    ppu.invalidateTile(0x1800);
+    setTileRow(1, 0, 0x0F, 0x00, 1);
+    setTileRow(1, 0, 0x0F, 0x0F);
+    ppu.renderLine(0);
+    EXPECT_EQ(cache.getDecodedTiles(), emulator::TileCache::TILES + 2);
+    EXPECT_EQ(line(0, 0, 8), (std::vector<uint8_t>{0, 0, 0, 0, 3, 3, 3, 3}));
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "gameboy.hpp"
+#include "rom.hpp"
+
+class RomTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() / ("gcolor_rom_" + std::to_string(getpid()));
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    // Bytes where each 16KB bank starts with its index
+    static std::vector<uint8_t> makeImage(const std::size_t size) {
+        std::vector<uint8_t> image(size);
+
+        for (std::size_t i = 0; i < size; ++i)
+            image[i] = i % emulator::Rom::BANK_SIZE == 0 ? i / emulator::Rom::BANK_SIZE : i * 7;
+        return image;
+    }
+
+    std::filesystem::path writeFile(const std::string& name, const std::vector<uint8_t>& bytes) {
+        const std::filesystem::path path = directory / name;
+        std::ofstream file(path, std::ios::binary);
+
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return path;
+    }
+
+    // gzip stream holding `bytes` in stored (uncompressed) deflate blocks
+    static std::vector<uint8_t> gzip(const std::vector<uint8_t>& bytes) {
+        std::vector<uint8_t> out = {0x1F, 0x8B, 0x08, 0x00, 0, 0, 0, 0, 0x00, 0xFF};
+        uint32_t crc = 0xFFFFFFFF;
+
+        for (const uint8_t byte : bytes) {
+            crc ^= byte;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        crc = ~crc;
+
+        for (std::size_t offset = 0; offset < bytes.size() || offset == 0; offset += 0xFFFF) {
+            const uint16_t length = static_cast<uint16_t>(std::min<std::size_t>(0xFFFF, bytes.size() - offset));
+            const bool last = offset + length >= bytes.size();
+
+            out.insert(out.end(), {static_cast<uint8_t>(last), static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8)});
+            out.insert(out.end(), bytes.begin() + offset, bytes.begin() + offset + length);
+        }
+        for (const uint32_t word : {crc, static_cast<uint32_t>(bytes.size())})
+            for (int shift = 0; shift < 32; shift += 8)
+                out.push_back(static_cast<uint8_t>(word >> shift));
+        return out;
+    }
+};
+
+// Test that a regular file of whole banks is mapped, not copied
+TEST_F(RomTest, ROM_MappedWhenAligned) {
+    const std::vector<uint8_t> image = makeImage(4 * emulator::Rom::BANK_SIZE);
+    emulator::Rom rom;
+
+    ASSERT_TRUE(rom.open(writeFile("game.gbc", image)));
+    EXPECT_TRUE(rom.isMapped());
+    EXPECT_EQ(rom.size(), image.size());
+    EXPECT_EQ(rom.banks(), 4u);
+    EXPECT_TRUE(std::equal(image.begin(), image.end(), rom.data()));
+    EXPECT_EQ(rom.bank(3)[0], 3);
+    EXPECT_EQ(rom.bank(6)[0], 2);  // Wraps around
+}
+
+// Test that a dump that isn't a whole number of banks is read and padded
+TEST_F(RomTest, ROM_ShortFileBuffered) {
+    const std::vector<uint8_t> image = makeImage(100);
+    emulator::Rom rom;
+
+    ASSERT_TRUE(rom.open(writeFile("short.gb", image)));
+    EXPECT_FALSE(rom.isMapped());
+    EXPECT_EQ(rom.size(), emulator::Rom::MIN_SIZE);
+    EXPECT_TRUE(std::equal(image.begin(), image.end(), rom.data()));
+    EXPECT_EQ(rom.data()[100], 0xFF);
+    EXPECT_EQ(rom.data()[rom.size() - 1], 0xFF);
+}
+
+// Test that the buffered loader reads non-regular files
+TEST_F(RomTest, ROM_PipeBuffered) {
+    const std::vector<uint8_t> image = makeImage(3 * emulator::Rom::BANK_SIZE);
+    const std::filesystem::path path = directory / "pipe";
+    emulator::Rom rom;
+
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+    std::thread writer([&] {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+    });
+    const bool opened = rom.open(path);
+    writer.join();
+
+    ASSERT_TRUE(opened);
+    EXPECT_FALSE(rom.isMapped());
+    EXPECT_EQ(rom.size(), image.size());
+    EXPECT_TRUE(std::equal(image.begin(), image.end(), rom.data()));
+}
+
+// Test that gzipped ROMs are inflated, when zlib is available
+TEST_F(RomTest, ROM_GzipBuffered) {
+    const std::vector<uint8_t> image = makeImage(2 * emulator::Rom::BANK_SIZE);
+    emulator::Rom rom;
+
+#if defined(GCOLOR_ZLIB)
+    ASSERT_TRUE(rom.open(writeFile("game.gb.gz", gzip(image))));
+    EXPECT_FALSE(rom.isMapped());
+    EXPECT_EQ(rom.size(), image.size());
+    EXPECT_TRUE(std::equal(image.begin(), image.end(), rom.data()));
+#else
+    EXPECT_FALSE(rom.open(writeFile("game.gb.gz", gzip(image))));
+    EXPECT_TRUE(rom.empty());
+#endif
+}
+
+// Test that a missing file or an empty one fails and leaves the ROM empty
+TEST_F(RomTest, ROM_LoadFailures) {
+    emulator::Rom rom;
+
+    rom.assign(makeImage(10).data(), 10);
+    EXPECT_FALSE(rom.open(directory / "missing.gb"));
+    EXPECT_TRUE(rom.empty());
+    EXPECT_FALSE(rom.open(writeFile("empty.gb", {})));
+    EXPECT_EQ(rom.data(), nullptr);
+}
+
+// Test that a moved ROM keeps its mapping and the source is left empty
+TEST_F(RomTest, ROM_Move) {
+    emulator::Rom rom;
+
+    ASSERT_TRUE(rom.open(writeFile("game.gb", makeImage(emulator::Rom::MIN_SIZE))));
+    const uint8_t* data = rom.data();
+
+    emulator::Rom moved = std::move(rom);
+    EXPECT_EQ(moved.data(), data);
+    EXPECT_TRUE(moved.isMapped());
+    EXPECT_TRUE(rom.empty());
+}
+
+// Test that the GameBoy runs from the mapped ROM, which its writes can't change
+TEST_F(RomTest, ROM_GameBoyRunsFromRom) {
+    std::vector<uint8_t> image(emulator::Rom::MIN_SIZE, 0x00);
+    const std::vector<uint8_t> program = {
+        0x3E, 0x42,        // LD A,0x42
+        0xEA, 0x00, 0xC0,  // LD (0xC000),A
+        0xEA, 0x00, 0x01,  // LD (0x0100),A
+        0xFA, 0x00, 0x40,  // LD A,(0x4000)
+        0xEA, 0x01, 0xC0,  // LD (0xC001),A
+        0x76,              // HALT
+    };
+    std::copy(program.begin(), program.end(), image.begin() + 0x0100);
+    image[0x4000] = 0x99;
+
+    emulator::GameBoy gameboy;
+    ASSERT_TRUE(gameboy.loadRom(writeFile("game.gb", image)));
+    gameboy.getCPU().writeMemory(0xFFFF, 0x00);
+    gameboy.runFrame();
+
+    const emulator::CPU& cpu = gameboy.getCPU();
+    EXPECT_TRUE(gameboy.getRom().isMapped());
+    EXPECT_EQ(cpu.readMemory(0xC000), 0x42);
+    EXPECT_EQ(cpu.readMemory(0xC001), 0x99);
+    EXPECT_EQ(cpu.readMemory(0x0100), 0x3E);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+
+    gameboy.insertRom({});
+    gameboy.getCPU().writeMemory(0x0100, 0x12);
+    EXPECT_EQ(gameboy.getCPU().readMemory(0x0100), 0x12);
+}
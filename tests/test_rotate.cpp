@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPURotateTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    // Runs a CB prefixed instruction
+    void executeCB(const uint8_t opcode) {
+        cpu.writeMemory(cpu.getPC(), opcode);
+        cpu.execute(0xCB);
+    }
+};
+
+// Test that RLCA rotates bit 7 into carry and always clears Z
+TEST_F(CPURotateTest, RLCA) {
+    cpu.setA(0x80);
+    cpu.execute(0x07);  // RLCA
+
+    EXPECT_EQ(cpu.getA(), 0x01);
+    EXPECT_EQ(cpu.getFlags(), CARRY_FLAG_MASK);
+}
+
+// Test that RRA rotates through the carry
+TEST_F(CPURotateTest, RRA) {
+    cpu.setA(0x01);
+    cpu.clearFlags();
+    cpu.execute(0x1F);  // RRA
+
+    EXPECT_EQ(cpu.getA(), 0x00);
+    EXPECT_EQ(cpu.getFlags(), CARRY_FLAG_MASK);   // Z stays clear for RRA
+
+    cpu.execute(0x1F);  // RRA
+    EXPECT_EQ(cpu.getA(), 0x80);
+    EXPECT_EQ(cpu.getFlags(), 0);
+}
+
+// Test that the CB rotates set Z on a zero result
+TEST_F(CPURotateTest, CB_RL_ZeroFlag) {
+    cpu.setB(0x80);
+    cpu.clearFlags();
+    executeCB(0x10);  // RL B
+
+    EXPECT_EQ(cpu.getB(), 0x00);
+    EXPECT_EQ(cpu.getFlags(), ZERO_FLAG_MASK | CARRY_FLAG_MASK);
+}
+
+// Test for the arithmetic and logical shifts
+TEST_F(CPURotateTest, CB_Shifts) {
+    cpu.setC(0x81);
+    executeCB(0x29);  // SRA C
+    EXPECT_EQ(cpu.getC(), 0xC0);                  // Bit 7 is kept
+    EXPECT_TRUE(cpu.getCarryFlag());
+
+    executeCB(0x39);  // SRL C
+    EXPECT_EQ(cpu.getC(), 0x60);
+    EXPECT_FALSE(cpu.getCarryFlag());
+
+    executeCB(0x21);  // SLA C
+    EXPECT_EQ(cpu.getC(), 0xC0);
+}
+
+// Test for SWAP on the byte at (HL)
+TEST_F(CPURotateTest, CB_SWAP_MemHL) {
+    cpu.setHL(0xC000);
+    cpu.writeMemory(0xC000, 0xAB);
+    executeCB(0x36);  // SWAP (HL)
+
+    EXPECT_EQ(cpu.readMemory(0xC000), 0xBA);
+    EXPECT_EQ(cpu.getFlags(), 0);
+}
+
+// Test for BIT, RES and SET
+TEST_F(CPURotateTest, CB_BIT_RES_SET) {
+    cpu.setA(0x00);
+    cpu.setCarryFlag(true);
+    executeCB(0xFF);  // SET 7,A
+    EXPECT_EQ(cpu.getA(), 0x80);
+
+    executeCB(0x7F);  // BIT 7,A
+    EXPECT_EQ(cpu.getFlags(), HALF_CARRY_FLAG_MASK | CARRY_FLAG_MASK);
+
+    executeCB(0xBF);  // RES 7,A
+    EXPECT_EQ(cpu.getA(), 0x00);
+
+    executeCB(0x7F);  // BIT 7,A
+    EXPECT_TRUE(cpu.getZeroFlag());
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPURunTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+};
+
+// Test that the threaded loop executes the requested number of instructions
+TEST_F(CPURunTest, RUN_ExecutesCount) {
+    loadProgram({0x3C, 0x3C, 0x3C, 0x47, 0x80});  // INC A x3, LD B,A, ADD A,B
+    cpu.setA(0x00);
+
+    EXPECT_EQ(cpu.run(5), 5u);
+    EXPECT_EQ(cpu.getA(), 0x06);
+    EXPECT_EQ(cpu.getB(), 0x03);
+    EXPECT_EQ(cpu.getPC(), 0x0105);
+}
+
+// Test that run() and runTable() leave the CPU in the same state
+TEST_F(CPURunTest, RUN_MatchesTable) {
+    loadProgram({0x3C, 0x47, 0x80, 0x05, 0x90, 0xA8, 0x3D});
+
+    emulator::CPU reference = cpu;
+    EXPECT_EQ(cpu.run(7), 7u);
+    EXPECT_EQ(reference.runTable(7), 7u);
+
+    EXPECT_EQ(cpu.getA(), reference.getA());
+    EXPECT_EQ(cpu.getB(), reference.getB());
+    EXPECT_EQ(cpu.getFlags(), reference.getFlags());
+    EXPECT_EQ(cpu.getPC(), reference.getPC());
+}
+
+// Test that zero instructions leaves PC untouched
+TEST_F(CPURunTest, RUN_ZeroCount) {
+    loadProgram({0x3C});
+
+    EXPECT_EQ(cpu.run(0), 0u);
+    EXPECT_EQ(cpu.getPC(), 0x0100);
+}
+
+// Test that every base and CB prefixed opcode has a handler
+TEST_F(CPURunTest, EXECUTE_AllOpcodes) {
+    for (int opcode = 0; opcode < 0x100; ++opcode) {
+        cpu.reset();
+        cpu.execute(opcode);
+
+        cpu.reset();
+        cpu.writeMemory(cpu.getPC(), opcode);
+        cpu.execute(0xCB);
+    }
+}
+
+// Test that HALT stops the loop after executing it
+TEST_F(CPURunTest, RUN_StopsOnHalt) {
+    loadProgram({0x3C, 0x76, 0x3C});  // INC A, HALT, INC A
+    cpu.setA(0x00);
+
+    EXPECT_EQ(cpu.run(10), 2u);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    EXPECT_EQ(cpu.getA(), 0x01);
+    EXPECT_EQ(cpu.getPC(), 0x0102);
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPURunForTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+    }
+
+    void loadProgram(const std::initializer_list<uint8_t> program, const uint16_t origin = 0x0100) {
+        uint16_t addr = origin;
+        for (const uint8_t byte : program)
+            cpu.writeMemory(addr++, byte);
+        cpu.setPC(origin);
+    }
+};
+
+// Test that instructions are counted with their T-cycles
+TEST_F(CPURunForTest, EXECUTE_CountsCycles) {
+    const uint64_t start = cpu.getCycles();
+
+    cpu.execute(0x00);  // NOP
+    EXPECT_EQ(cpu.getCycles() - start, 4u);
+
+    cpu.execute(0x86);  // ADD A,(HL)
+    EXPECT_EQ(cpu.getCycles() - start, 12u);
+
+    cpu.writeMemory(cpu.getPC(), 0x46);
+    cpu.execute(0xCB);  // BIT 0,(HL)
+    EXPECT_EQ(cpu.getCycles() - start, 24u);
+}
+
+// Test that taken branches cost more than branches not taken
+TEST_F(CPURunForTest, EXECUTE_BranchCycles) {
+    loadProgram({0x20, 0x00});  // JR NZ,+0
+
+    cpu.setZeroFlag(true);
+    uint64_t start = cpu.getCycles();
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getCycles() - start, 8u);
+
+    cpu.setPC(0x0100);
+    cpu.setZeroFlag(false);
+    start = cpu.getCycles();
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getCycles() - start, 12u);
+
+    loadProgram({0xCD, 0x00, 0x02});  // CALL 0x0200
+    cpu.writeMemory(0x0200, 0xC9);    // RET
+    start = cpu.getCycles();
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getCycles() - start, 24u);
+    cpu.executeInstruction();
+    EXPECT_EQ(cpu.getCycles() - start, 40u);
+}
+
+// Test that runFor stops once the budget is spent and reports it
+TEST_F(CPURunForTest, RUNFOR_ConsumesBudget) {
+    loadProgram({0x18, 0xFE});  // JR -2, 12 cycles each
+
+    const uint64_t start = cpu.getCycles();
+    EXPECT_EQ(cpu.runFor(120), 120u);
+    EXPECT_EQ(cpu.getCycles() - start, 120u);
+
+    // 13 more cycles can only stop after two more jumps
+    EXPECT_EQ(cpu.runFor(13), 24u);
+    EXPECT_EQ(cpu.getPC(), 0x0100);
+}
+
+// Test that the threaded loop and the table loop agree
+TEST_F(CPURunForTest, RUNFOR_MatchesTable) {
+    loadProgram({0x3C, 0x47, 0x80, 0x20, 0xFB, 0x3D, 0xC3, 0x00, 0x01});
+
+    emulator::CPU reference = cpu;
+    EXPECT_EQ(cpu.runFor(1000), reference.runForTable(1000));
+
+    EXPECT_EQ(cpu.getA(), reference.getA());
+    EXPECT_EQ(cpu.getB(), reference.getB());
+    EXPECT_EQ(cpu.getFlags(), reference.getFlags());
+    EXPECT_EQ(cpu.getPC(), reference.getPC());
+    EXPECT_EQ(cpu.getCycles(), reference.getCycles());
+}
+
+// Test that a halted CPU lets the whole budget elapse
+TEST_F(CPURunForTest, RUNFOR_HaltedConsumesBudget) {
+    loadProgram({0x00, 0x76});  // NOP, HALT
+
+    EXPECT_EQ(cpu.runFor(100), 100u);
+    EXPECT_EQ(cpu.getState(), emulator::CpuState::Halted);
+    EXPECT_EQ(cpu.runFor(50), 50u);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "scheduler.hpp"
+
+class SchedulerTest : public ::testing::Test {
+protected:
+    emulator::Scheduler scheduler;
+};
+
+// Test that events come out in timestamp order
+TEST_F(SchedulerTest, SCHEDULER_PopsInOrder) {
+    scheduler.schedule(emulator::EventType::TimerOverflow, 300);
+    scheduler.schedule(emulator::EventType::LineChange, 100);
+    scheduler.schedule(emulator::EventType::DmaEnd, 200);
+
+    EXPECT_EQ(scheduler.nextTimestamp(), 100u);
+
+    emulator::Event event{};
+    ASSERT_TRUE(scheduler.popDue(1000, event));
+    EXPECT_EQ(event.type, emulator::EventType::LineChange);
+    ASSERT_TRUE(scheduler.popDue(1000, event));
+    EXPECT_EQ(event.type, emulator::EventType::DmaEnd);
+    ASSERT_TRUE(scheduler.popDue(1000, event));
+    EXPECT_EQ(event.type, emulator::EventType::TimerOverflow);
+    EXPECT_FALSE(scheduler.popDue(1000, event));
+    EXPECT_EQ(scheduler.nextTimestamp(), emulator::Scheduler::NEVER);
+}
+
+// Test that nothing is popped before it is due
+TEST_F(SchedulerTest, SCHEDULER_NotDueYet) {
+    scheduler.schedule(emulator::EventType::SerialTransfer, 500);
+
+    emulator::Event event{};
+    EXPECT_FALSE(scheduler.popDue(499, event));
+    EXPECT_TRUE(scheduler.popDue(500, event));
+    EXPECT_EQ(event.timestamp, 500u);
+}
+
+// Test that scheduling a pending type moves it instead of adding a second one
+TEST_F(SchedulerTest, SCHEDULER_Reschedule) {
+    scheduler.schedule(emulator::EventType::TimerOverflow, 100);
+    scheduler.schedule(emulator::EventType::LineChange, 200);
+    scheduler.schedule(emulator::EventType::TimerOverflow, 300);
+
+    EXPECT_EQ(scheduler.timestampOf(emulator::EventType::TimerOverflow), 300u);
+    EXPECT_EQ(scheduler.nextTimestamp(), 200u);
+
+    scheduler.schedule(emulator::EventType::TimerOverflow, 50);
+    EXPECT_EQ(scheduler.nextTimestamp(), 50u);
+
+    emulator::Event event{};
+    int popped = 0;
+    while (scheduler.popDue(1000, event))
+        ++popped;
+    EXPECT_EQ(popped, 2);
+}
+
+// Test that cancelled events are never dispatched
+TEST_F(SchedulerTest, SCHEDULER_Cancel) {
+    scheduler.schedule(emulator::EventType::LineChange, 100);
+    scheduler.schedule(emulator::EventType::StatMode, 50);
+    scheduler.schedule(emulator::EventType::DmaEnd, 75);
+    scheduler.cancel(emulator::EventType::StatMode);
+
+    EXPECT_FALSE(scheduler.isScheduled(emulator::EventType::StatMode));
+    EXPECT_EQ(scheduler.timestampOf(emulator::EventType::StatMode), emulator::Scheduler::NEVER);
+    EXPECT_EQ(scheduler.nextTimestamp(), 75u);
+
+    scheduler.clear();
+    EXPECT_EQ(scheduler.nextTimestamp(), emulator::Scheduler::NEVER);
+    EXPECT_FALSE(scheduler.isScheduled(emulator::EventType::LineChange));
+}
+
+// Test that events due at the same cycle come out in type order
+TEST_F(SchedulerTest, SCHEDULER_TiesByType) {
+    scheduler.schedule(emulator::EventType::ApuFrameSequencer, 100);
+    scheduler.schedule(emulator::EventType::SerialTransfer, 100);
+    scheduler.schedule(emulator::EventType::LineChange, 100);
+
+    emulator::Event event{};
+    ASSERT_TRUE(scheduler.popDue(100, event));
+    EXPECT_EQ(event.type, emulator::EventType::LineChange);
+    ASSERT_TRUE(scheduler.popDue(100, event));
+    EXPECT_EQ(event.type, emulator::EventType::SerialTransfer);
+    ASSERT_TRUE(scheduler.popDue(100, event));
+    EXPECT_EQ(event.type, emulator::EventType::ApuFrameSequencer);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "cpu.hpp"
+
+class CPUStackTest : public ::testing::Test {
+protected:
+    emulator::CPU cpu;
+
+    void SetUp() override {
+        cpu.reset();
+        cpu.setSP(0xFFFE);
+    }
+};
+
+// Test that PUSH and POP round trip a register pair
+TEST_F(CPUStackTest, PUSH_POP_BC_DE) {
+    cpu.setBC(0x1234);
+    cpu.execute(0xC5);  // PUSH BC
+    EXPECT_EQ(cpu.getSP(), 0xFFFC);
+
+    cpu.execute(0xD1);  // POP DE
+    EXPECT_EQ(cpu.getDE(), 0x1234);
+    EXPECT_EQ(cpu.getSP(), 0xFFFE);
+}
+
+// Test that PUSH AF stores the flags computed so far
+TEST_F(CPUStackTest, PUSH_AF_StoresFlags) {
+    cpu.setA(0xFF);
+    cpu.setB(0x01);
+    cpu.execute(0x80);  // ADD A,B: Z, H and C
+    cpu.execute(0xF5);  // PUSH AF
+
+    EXPECT_EQ(cpu.readMemory(0xFFFC), ZERO_FLAG_MASK | HALF_CARRY_FLAG_MASK | CARRY_FLAG_MASK);
+    EXPECT_EQ(cpu.readMemory(0xFFFD), 0x00);
+}
+
+// Test that POP AF drops the low nibble of F
+TEST_F(CPUStackTest, POP_AF_MasksLowNibble) {
+    cpu.setSP(0xFFFC);
+    cpu.writeMemory(0xFFFC, 0xFF);
+    cpu.writeMemory(0xFFFD, 0x12);
+    cpu.execute(0xF1);  // POP AF
+
+    EXPECT_EQ(cpu.getA(), 0x12);
+    EXPECT_EQ(cpu.getFlags(), 0xF0);
+}
+
+// Test for 16-bit additions to HL and SP
+TEST_F(CPUStackTest, ADD_HL_r16_ADD_SP_r8) {
+    cpu.setHL(0x0FFF);
+    cpu.setBC(0x0001);
+    cpu.setZeroFlag(true);
+    cpu.execute(0x09);  // ADD HL,BC
+
+    EXPECT_EQ(cpu.getHL(), 0x1000);
+    EXPECT_TRUE(cpu.getHalfCarryFlag());          // Carry out of bit 11
+    EXPECT_FALSE(cpu.getCarryFlag());
+    EXPECT_TRUE(cpu.getZeroFlag());               // Zero flag is preserved
+
+    cpu.setHL(0x8000);
+    cpu.execute(0x29);  // ADD HL,HL
+    EXPECT_EQ(cpu.getHL(), 0x0000);
+    EXPECT_TRUE(cpu.getCarryFlag());              // Carry out of bit 15
+
+    cpu.writeMemory(cpu.getPC(), 0x02);
+    cpu.setSP(0xFFF0);
+    cpu.execute(0xE8);  // ADD SP,+2
+    EXPECT_EQ(cpu.getSP(), 0xFFF2);
+    EXPECT_FALSE(cpu.getZeroFlag());
+}